@@ -0,0 +1,115 @@
+#include "Adc.h"
+#include "PerDevice.h"
+
+#include <wiring_private.h>
+
+typedef struct AdcChannel {
+    uint8_t pin;
+    uint8_t mux;
+    uint8_t shift;          // filter weight 1/2^shift
+    bool primed;
+    volatile uint32_t acc;  // filtered value << shift
+} AdcChannel;
+
+static PER_DEVICE AdcChannel channels[ADC_MAX_CHANNELS];
+static PER_DEVICE volatile uint8_t channelCount = 0;
+static PER_DEVICE volatile uint8_t current = 0;
+static PER_DEVICE volatile bool converting = false;
+static PER_DEVICE volatile bool blocking = false;     // adcConvertNow() has the ADC
+
+static void adcSync() {
+    while (ADC->STATUS.bit.SYNCBUSY);
+}
+
+static void adcStart(uint8_t channel) {
+    ADC->INPUTCTRL.reg = ADC_INPUTCTRL_MUXNEG_GND | ADC_INPUTCTRL_GAIN_DIV2
+        | ADC_INPUTCTRL_MUXPOS(channels[channel].mux);
+    adcSync();
+    ADC->SWTRIG.reg = ADC_SWTRIG_START;
+    converting = true;
+}
+
+static void adcCollect(uint8_t channel) {
+    AdcChannel &ch = channels[channel];
+    uint32_t value = ADC->RESULT.reg;
+    converting = false;
+
+    if (!ch.primed) {
+        ch.acc = value << ch.shift;
+        ch.primed = true;
+    }
+    else {
+        ch.acc += value - (ch.acc >> ch.shift);
+    }
+}
+
+void adcBegin() {
+    channelCount = 0;
+    current = 0;
+    converting = false;
+
+    ADC->CTRLA.reg = 0;
+    adcSync();
+
+    // 16 samples accumulated and shifted back to 12 bits, 3.3 V full scale
+    ADC->REFCTRL.reg = ADC_REFCTRL_REFSEL_INTVCC1;
+    ADC->CTRLB.reg = ADC_CTRLB_PRESCALER_DIV32 | ADC_CTRLB_RESSEL_16BIT;
+    adcSync();
+    ADC->AVGCTRL.reg = ADC_AVGCTRL_SAMPLENUM_16 | ADC_AVGCTRL_ADJRES(4);
+    ADC->SAMPCTRL.reg = ADC_SAMPCTRL_SAMPLEN(2);
+
+    ADC->CTRLA.reg = ADC_CTRLA_ENABLE;
+    adcSync();
+}
+
+// Returns the channel index, primed with one blocking conversion, or -1
+int8_t adcAddChannel(uint8_t pin, uint8_t filterShift) {
+    if (channelCount >= ADC_MAX_CHANNELS) return -1;
+
+    pinPeripheral(pin, PIO_ANALOG);
+    AdcChannel &ch = channels[channelCount];
+    ch.pin = pin;
+    ch.mux = g_APinDescription[pin].ulADCChannelNumber;
+    ch.shift = filterShift;
+    ch.primed = false;
+    ch.acc = 0;
+
+    uint8_t channel = channelCount++;
+    adcConvertNow(channel);
+    return channel;
+}
+
+// Tick job: collect the finished conversion and start the next channel
+void adcService() {
+    if (channelCount == 0 || blocking) return;
+
+    if (converting) {
+        if (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY)) return;
+        adcCollect(current);
+        if (++current >= channelCount) current = 0;
+    }
+    adcStart(current);
+}
+
+// Blocking conversion, for when the tick is stopped (standby). Interrupts
+// stay on through the waits, up to two oversampled conversions, so the
+// sync timer keeps its timing; the tick job stays off the ADC meanwhile.
+void adcConvertNow(uint8_t channel) {
+    blocking = true;
+
+    if (converting) {
+        while (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY));
+        adcCollect(current);
+        if (++current >= channelCount) current = 0;
+    }
+    adcStart(channel);
+    while (!(ADC->INTFLAG.reg & ADC_INTFLAG_RESRDY));
+    adcCollect(channel);
+
+    blocking = false;
+}
+
+uint16_t adcRead(uint8_t channel) {
+    if (channel >= channelCount) return 0;
+    return channels[channel].acc >> channels[channel].shift;
+}
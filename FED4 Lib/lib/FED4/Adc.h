@@ -0,0 +1,22 @@
+#ifndef ADC_H
+#define ADC_H
+
+// Background ADC sampler. Channels are converted round robin from the
+// service tick with 16x hardware oversampling, and each result feeds a
+// per-channel IIR low-pass filter, so readers get a cached 12-bit value
+// without blocking. The sampler owns the ADC: analogRead() must not be
+// used once adcBegin() has run.
+
+#include <Arduino.h>
+
+constexpr uint8_t ADC_MAX_CHANNELS = 6;
+constexpr uint16_t ADC_PERIOD      = 2;  // ms between conversions
+constexpr uint16_t ADC_FULL_SCALE  = 4096;
+
+void adcBegin();
+int8_t adcAddChannel(uint8_t pin, uint8_t filterShift);
+void adcService();
+void adcConvertNow(uint8_t channel);
+uint16_t adcRead(uint8_t channel);
+
+#endif
@@ -0,0 +1,155 @@
+#include "Cue.h"
+#include "PerDevice.h"
+
+static PER_DEVICE Adafruit_NeoPixel *cueStrip = nullptr;
+static PER_DEVICE uint8_t cueRail = 0;
+
+static PER_DEVICE volatile uint32_t base[CUE_PIXELS];
+static PER_DEVICE uint32_t shown[CUE_PIXELS];
+static PER_DEVICE uint32_t fadeFrom[CUE_PIXELS];
+static PER_DEVICE uint32_t ready[CUE_PIXELS];       // composed, for cueShow()
+static PER_DEVICE volatile bool readyNew = false;
+static PER_DEVICE volatile bool railOn = false;
+static PER_DEVICE volatile bool held = false;
+
+static PER_DEVICE const CueStep *volatile seq = nullptr;
+static PER_DEVICE volatile uint8_t seqLen = 0;
+static PER_DEVICE volatile uint8_t seqIdx = 0;
+static PER_DEVICE volatile uint32_t seqT = 0;       // ms into the current step
+static PER_DEVICE volatile bool seqRestart = false;
+
+static uint32_t lerpColor(uint32_t from, uint32_t to, uint32_t t, uint32_t span) {
+    uint32_t out = 0;
+    for (uint8_t shift = 0; shift < 32; shift += 8) {
+        int32_t a = (from >> shift) & 0xFF;
+        int32_t b = (to >> shift) & 0xFF;
+        out |= (uint32_t)(a + (b - a) * (int32_t)t / (int32_t)span) << shift;
+    }
+    return out;
+}
+
+static bool anyLit(const uint32_t *frame) {
+    for (uint8_t i = 0; i < CUE_PIXELS; i++) {
+        if (frame[i] != 0) return true;
+    }
+    return false;
+}
+
+void cueBegin(Adafruit_NeoPixel *strip, uint8_t railPin) {
+    cueStrip = strip;
+    cueRail = railPin;
+    memset((void*)base, 0, sizeof(base));
+    memset(shown, 0, sizeof(shown));
+    readyNew = false;
+    seq = nullptr;
+    seqLen = 0;
+    held = false;
+    railOn = digitalRead(railPin) == HIGH;
+}
+
+void cueSet(uint8_t pixel, uint32_t color) {
+    if (pixel < CUE_PIXELS) base[pixel] = color;
+}
+
+void cuePlay(const CueStep *steps, uint8_t len) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    seq = steps;
+    seqLen = len;
+    seqIdx = 0;
+    seqT = 0;
+    seqRestart = true;
+    __set_PRIMASK(primask);
+}
+
+bool cuePlaying() {
+    return seq != nullptr || readyNew;
+}
+
+// While held the rail belongs to the caller. Releasing assumes the rail
+// was switched off, so the strip lost its state and is sent again.
+void cueHold(bool hold) {
+    held = hold;
+    if (!hold) {
+        railOn = digitalRead(cueRail) == HIGH;
+        if (!railOn) {
+            memset(shown, 0, sizeof(shown));
+        }
+    }
+}
+
+void cueService() {
+    if (cueStrip == nullptr) return;
+
+    uint32_t frame[CUE_PIXELS];
+    for (uint8_t i = 0; i < CUE_PIXELS; i++) {
+        frame[i] = base[i];
+    }
+
+    if (seq != nullptr) {
+        if (seqRestart) {
+            memcpy(fadeFrom, shown, sizeof(fadeFrom));
+            seqRestart = false;
+        }
+        else {
+            seqT += CUE_PERIOD;
+        }
+        while (seq != nullptr && seqT >= seq[seqIdx].ms) {
+            seqT -= seq[seqIdx].ms;
+            if (++seqIdx >= seqLen) {
+                seq = nullptr;
+            }
+            else {
+                memcpy(fadeFrom, shown, sizeof(fadeFrom));
+            }
+        }
+    }
+
+    if (seq != nullptr) {
+        const CueStep &step = seq[seqIdx];
+        for (uint8_t i = 0; i < CUE_PIXELS; i++) {
+            if (!(step.pixels & (1 << i))) continue;
+            frame[i] = step.fade ? lerpColor(fadeFrom[i], step.color, seqT, step.ms) : step.color;
+        }
+    }
+
+    if (held) return;
+    if (memcmp(frame, shown, sizeof(frame)) == 0) return;
+
+    if (!railOn) {
+        // Power up and let the rail settle; the frame goes out next period
+        digitalWrite(cueRail, HIGH);
+        railOn = true;
+        return;
+    }
+
+    memcpy(ready, frame, sizeof(ready));
+    readyNew = true;
+}
+
+// show() masks interrupts for the whole frame, about 300 us for the strip,
+// so it runs from the main loop rather than the service tick
+void cueShow() {
+    if (!readyNew || held) return;
+
+    uint32_t frame[CUE_PIXELS];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(frame, ready, sizeof(frame));
+    readyNew = false;
+    __set_PRIMASK(primask);
+
+    for (uint8_t i = 0; i < CUE_PIXELS; i++) {
+        cueStrip->setPixelColor(i, frame[i]);
+    }
+    cueStrip->show();
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(shown, frame, sizeof(shown));
+    if (!anyLit(frame) && !readyNew) {
+        digitalWrite(cueRail, LOW);
+        railOn = false;
+    }
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,33 @@
+#ifndef CUE_H
+#define CUE_H
+
+// NeoPixel cue driver. Callers set the steady colour of each pixel and may
+// start a timed sequence drawn over it; a service tick job composes the
+// frame and, when it differs from what the strip is showing, powers the
+// LED rail and hands it to cueShow(), which the main loop calls to
+// transmit it. The rail (MTR_EN) is shared with the motor driver, so the
+// motor holds the driver off while it runs.
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+constexpr uint8_t CUE_PIXELS    = 10;
+constexpr uint16_t CUE_PERIOD   = 20;   // ms between frames
+constexpr uint16_t CUE_ALL      = (1 << CUE_PIXELS) - 1;
+
+typedef struct CueStep {
+    uint16_t pixels;    // mask of pixels the step draws
+    uint32_t color;     // Adafruit_NeoPixel::Color(r, g, b, w)
+    uint16_t ms;
+    bool fade;          // ramp from the previous frame instead of a cut
+} CueStep;
+
+void cueBegin(Adafruit_NeoPixel *strip, uint8_t railPin);
+void cueSet(uint8_t pixel, uint32_t color);
+void cuePlay(const CueStep *steps, uint8_t len);
+bool cuePlaying();
+void cueHold(bool hold);
+void cueService();
+void cueShow();
+
+#endif
@@ -0,0 +1,119 @@
+#include "Env.h"
+
+#include <Wire.h>
+
+namespace AhtCmd {
+    constexpr uint8_t INIT      = 0xBE;
+    constexpr uint8_t TRIGGER   = 0xAC;
+};
+
+namespace AhtStatus {
+    constexpr uint8_t BUSY          = 0x80;
+    constexpr uint8_t CALIBRATED    = 0x08;
+};
+
+static uint8_t aht_crc(const uint8_t* data, uint8_t n) {
+    uint8_t crc = 0xFF;
+    for (uint8_t i = 0; i < n; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// The pin and alarm handlers read the RTC over the same bus. Masking just
+// those keeps their pending interrupts and leaves TC4 free for sync pulses.
+static void aht_mask(bool mask) {
+    if (mask) {
+        NVIC_DisableIRQ(EIC_IRQn);
+        NVIC_DisableIRQ(RTC_IRQn);
+    }
+    else {
+        NVIC_EnableIRQ(RTC_IRQn);
+        NVIC_EnableIRQ(EIC_IRQn);
+    }
+}
+
+static bool aht_command(uint8_t cmd, uint8_t arg0, uint8_t arg1) {
+    aht_mask(true);
+    Wire.beginTransmission(ENV_ADDRESS);
+    Wire.write(cmd);
+    Wire.write(arg0);
+    Wire.write(arg1);
+    bool ok = Wire.endTransmission() == 0;
+    aht_mask(false);
+    return ok;
+}
+
+static uint8_t aht_read(uint8_t* data, uint8_t n) {
+    aht_mask(true);
+    uint8_t got = Wire.requestFrom(ENV_ADDRESS, (size_t)n);
+    for (uint8_t i = 0; i < got; i++) {
+        data[i] = Wire.read();
+    }
+    aht_mask(false);
+    return got;
+}
+
+bool envBegin(EnvSensor &env) {
+    memset(&env, 0, sizeof(env));
+    Wire.begin();
+
+    uint8_t status;
+    if (aht_read(&status, 1) != 1) return false;
+    if (!(status & AhtStatus::CALIBRATED)) {
+        aht_command(AhtCmd::INIT, 0x08, 0x00);
+    }
+    env.present = true;
+    return true;
+}
+
+void envStart(EnvSensor &env, uint32_t nowMs, uint32_t nowUnix) {
+    if (!env.present || env.measuring) return;
+    if (!aht_command(AhtCmd::TRIGGER, 0x33, 0x00)) {
+        env.errors++;
+        return;
+    }
+    env.measuring = true;
+    env.startMs = nowMs;
+    env.startUnix = nowUnix;
+}
+
+bool envPoll(EnvSensor &env, uint32_t nowMs, uint32_t nowUnix) {
+    if (!env.measuring) return false;
+    if (nowMs - env.startMs < ENV_MEASURE_MS && nowUnix == env.startUnix) return false;
+
+    uint8_t data[7];
+    if (aht_read(data, sizeof(data)) != sizeof(data) || (data[0] & AhtStatus::BUSY)) {
+        if (nowUnix - env.startUnix > ENV_TIMEOUT) {
+            env.measuring = false;
+            env.errors++;
+        }
+        return false;
+    }
+    env.measuring = false;
+    if (aht_crc(data, 6) != data[6]) {
+        env.errors++;
+        return false;
+    }
+
+    // 20-bit fractions of 100 %RH and of 200 °C from -50 °C
+    uint32_t rawRh = ((uint32_t)data[1] << 12) | ((uint32_t)data[2] << 4) | (data[3] >> 4);
+    uint32_t rawT = ((uint32_t)(data[3] & 0x0F) << 16) | ((uint32_t)data[4] << 8) | data[5];
+    uint32_t rh = (rawRh * 625) >> 16;
+    int16_t temp = (int16_t)((rawT * 625) >> 15) - 5000;
+
+    EnvBatch &batch = env.batch;
+    if (batch.count == 0 || temp < batch.tempMin) batch.tempMin = temp;
+    if (batch.count == 0 || temp > batch.tempMax) batch.tempMax = temp;
+    batch.tempSum += temp;
+    batch.rhSum += rh;
+    batch.count++;
+    return true;
+}
+
+void envClearBatch(EnvSensor &env) {
+    memset(&env.batch, 0, sizeof(env.batch));
+}
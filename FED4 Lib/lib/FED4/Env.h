@@ -0,0 +1,46 @@
+#ifndef ENV_H
+#define ENV_H
+
+// Cage temperature and humidity from the AHT20 (Adafruit AHTX0 board) on
+// the I2C bus shared with the RTC. The Adafruit driver waits out the 80 ms
+// conversion, so the sensor is driven here in two steps instead:
+// envStart() sends the trigger and envPoll() reads the result once it is
+// ready, or on a later wake-up. Each step is one short transfer with the
+// pin and alarm interrupts masked, so their RTC reads never land in the
+// middle of it; call them from the main loop or the alarm handler, where
+// both are enabled. Readings are averaged in batches of FED4's choosing.
+
+#include <Arduino.h>
+
+constexpr uint8_t ENV_ADDRESS       = 0x38;
+constexpr uint16_t ENV_MEASURE_MS   = 80;
+constexpr uint8_t ENV_TIMEOUT       = 3;    // seconds before a conversion is dropped
+constexpr uint16_t ENV_PERIOD       = 300;  // seconds between readings
+constexpr uint8_t ENV_BATCH         = 4;    // readings per log record
+
+typedef struct EnvBatch {
+    uint8_t count;
+    int32_t tempSum;            // 0.01 °C
+    int16_t tempMin;
+    int16_t tempMax;
+    uint32_t rhSum;             // 0.01 %RH
+} EnvBatch;
+
+typedef struct EnvSensor {
+    bool present;
+    bool measuring;
+    uint32_t startMs;
+    uint32_t startUnix;         // when the conversion in progress started
+    uint32_t errors;            // bad CRCs and conversions that never finished
+    EnvBatch batch;
+} EnvSensor;
+
+bool envBegin(EnvSensor &env);
+void envStart(EnvSensor &env, uint32_t nowMs, uint32_t nowUnix);
+// Adds a finished reading to the batch and returns true, false while the
+// sensor is busy or idle. millis() stands still in standby, so a
+// conversion started before sleeping is read once nowUnix has moved on.
+bool envPoll(EnvSensor &env, uint32_t nowMs, uint32_t nowUnix);
+void envClearBatch(EnvSensor &env);
+
+#endif
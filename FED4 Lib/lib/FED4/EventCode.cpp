@@ -0,0 +1,89 @@
+#include "EventCode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const char* const EventCode::NAMES[EventCode::COUNT] = {
+    "",
+    "Dropped Pellet",
+    "Well Cleared",
+    "Set VI",
+    "Reset Device",
+    "WatchDog Reset Device",
+    "Seed",
+    "Param",
+    "Error:",
+    "Memory",
+    "Battery",
+    "SD Slow",
+    "Env",
+    "Sync",
+};
+
+// Events of classes left out of the build are never logged, and read back
+// as an empty column
+int eventText(uint8_t code, const EventData &data, const char* subject, char* out, size_t size) {
+    if (code >= EventCode::COUNT || !eventEnabled(code)) {
+        return snprintf(out, size, "%s", "");
+    }
+    const char* name = EventCode::NAMES[code];
+
+    switch (code) {
+    case EventCode::POKE:
+        return snprintf(out, size, "%s", subject ? subject : "");
+
+    case EventCode::SEED:
+        return snprintf(out, size, "%s %lu", name, (unsigned long)data.seed);
+
+    case EventCode::PARAM:
+        return snprintf(
+            out, size, "%s %s=%s was=%s",
+            name, data.param.name, data.param.now, data.param.was
+        );
+
+    case EventCode::ERROR:
+        return snprintf(out, size, "%s %s", name, data.text);
+
+    case EventCode::MEM:
+        return snprintf(
+            out, size, "%s stack=%lu free=%lu block=%lu frags=%u",
+            name, (unsigned long)data.mem.stack, (unsigned long)data.mem.free,
+            (unsigned long)data.mem.block, data.mem.frags
+        );
+
+    case EventCode::SD_SLOW:
+        return snprintf(
+            out, size, "%s p95=%lu worst=%lu",
+            name, (unsigned long)data.sd.p95Us, (unsigned long)data.sd.worstUs
+        );
+
+    case EventCode::ENV:
+        return snprintf(
+            out, size, "%s T=%.2f min=%.2f max=%.2f RH=%.1f n=%u",
+            name, data.env.tempSum / 100.0 / data.env.count,
+            data.env.tempMin / 100.0, data.env.tempMax / 100.0,
+            data.env.rhSum / 100.0 / data.env.count, data.env.count
+        );
+
+    case EventCode::SYNC:
+        return snprintf(
+            out, size, "%s %s n=%u us=%lu",
+            name, subject ? subject : "", data.sync.pulses, (unsigned long)data.sync.us
+        );
+
+    default:
+        break;
+    }
+    return snprintf(out, size, "%s", name);
+}
+
+uint8_t eventCodeOf(const char* text, size_t len) {
+    for (uint8_t code = 1; code < EventCode::COUNT; code++) {
+        const char* name = EventCode::NAMES[code];
+        size_t n = strlen(name);
+        if (len >= n && memcmp(text, name, n) == 0 && (len == n || text[n] == ' ')) {
+            return code;
+        }
+    }
+    return EventCode::COUNT;
+}
@@ -0,0 +1,106 @@
+#ifndef EVENTCODE_H
+#define EVENTCODE_H
+
+// Log events by code. An event is its code and, for some codes, a typed
+// payload; the text of the log's Event column is only put together when
+// the row is written: the code's name, then the payload, e.g.
+//
+//   Memory stack=1840 free=20112 block=19876 frags=3
+//
+// A poke is written as its sensor's "<name> <action>" instead. The names
+// are a const table, which stays in flash on the SAMD21.
+//
+// Each code belongs to a class, and FED4_EVENTS, a mask of EventClass
+// bits (all of them by default), leaves classes out of a build: logging
+// an event of a class that is left out compiles to nothing. tools/replay
+// needs BEHAVIOR and SESSION.
+//
+// Plain C++ so the host tools can share the names.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace EventClass {
+    constexpr uint8_t BEHAVIOR = 0x01;  // pokes, pellets, VI draws
+    constexpr uint8_t SESSION  = 0x02;  // resets, seeds, settings, errors
+    constexpr uint8_t HEALTH   = 0x04;  // memory, battery, SD card
+    constexpr uint8_t ENV      = 0x08;
+    constexpr uint8_t SYNC     = 0x10;
+    constexpr uint8_t ALL      = 0x1F;
+};
+
+#if !defined(FED4_EVENTS)
+#define FED4_EVENTS EventClass::ALL
+#endif
+
+namespace EventCode {
+    constexpr uint8_t POKE     = 0;  // data.sensor
+    constexpr uint8_t PEL      = 1;
+    constexpr uint8_t WELL     = 2;
+    constexpr uint8_t SET_VI   = 3;
+    constexpr uint8_t RESET    = 4;
+    constexpr uint8_t WTD_RTS  = 5;
+    constexpr uint8_t SEED     = 6;  // data.seed
+    constexpr uint8_t PARAM    = 7;  // data.param
+    constexpr uint8_t ERROR    = 8;  // data.text
+    constexpr uint8_t MEM      = 9;  // data.mem
+    constexpr uint8_t BATTERY  = 10;
+    constexpr uint8_t SD_SLOW  = 11; // data.sd
+    constexpr uint8_t ENV      = 12; // data.env
+    constexpr uint8_t SYNC     = 13; // data.sync
+    constexpr uint8_t COUNT    = 14;
+    extern const char* const NAMES[COUNT];
+};
+
+constexpr uint8_t eventClass(uint8_t code) {
+    return code <= EventCode::SET_VI ? EventClass::BEHAVIOR
+        : code <= EventCode::ERROR ? EventClass::SESSION
+        : code <= EventCode::SD_SLOW ? EventClass::HEALTH
+        : code == EventCode::ENV ? EventClass::ENV
+        : EventClass::SYNC;
+}
+
+constexpr bool eventEnabled(uint8_t code) {
+    return (eventClass(code) & (FED4_EVENTS)) != 0;
+}
+
+typedef union EventData {
+    uint8_t sensor;
+    uint32_t seed;
+    const char* text;
+    struct {
+        const char* name;
+        char now[16];
+        char was[16];
+    } param;
+    struct {
+        uint32_t stack;
+        uint32_t free;
+        uint32_t block;         // largest free block
+        uint16_t frags;
+    } mem;
+    struct {
+        uint32_t p95Us;
+        uint32_t worstUs;
+    } sd;
+    struct {
+        uint8_t count;
+        int32_t tempSum;        // 0.01 °C
+        int16_t tempMin;
+        int16_t tempMax;
+        uint32_t rhSum;         // 0.01 %RH
+    } env;
+    struct {
+        uint8_t event;          // see SyncEvent
+        uint8_t pulses;
+        uint32_t us;
+    } sync;
+} EventData;
+
+// The Event column for the event. subject is the sensor's "<name>
+// <action>" for POKE, and what the train marked for SYNC.
+int eventText(uint8_t code, const EventData &data, const char* subject, char* out, size_t size);
+// The code of an Event column, COUNT for a poke or anything unknown
+uint8_t eventCodeOf(const char* text, size_t len);
+
+#endif
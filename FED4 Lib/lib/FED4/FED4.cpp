@@ -1,19 +1,36 @@
 #include "FED4.h"
 
-FED4 *FED4::instance = nullptr;
+PER_DEVICE FED4 *FED4::instance = nullptr;
+
+static_assert(MAX_SENSORS == 4, "update FED4::_sensor_ISRs");
+static_assert(TELEM_RING_SIZE > TELEM_MAX_ENCODED, "the telemetry ring must hold the longest frame");
+void (* const FED4::_sensor_ISRs[MAX_SENSORS])() = {
+    sensor_ISR<0>, sensor_ISR<1>, sensor_ISR<2>, sensor_ISR<3>
+};
 
 void __delay(uint32_t ms) {
     unsigned long startT = millis();
-    while(millis() - startT > ms);
+    while(millis() - startT < ms);
 }
 
-void HardFault_Handler(void) {
-    __asm("BKPT #0");
-    while(1){}
-}
+static const CueStep REWARD_CUE[] = {
+    {CUE_ALL, Adafruit_NeoPixel::Color(0, 0, 0, 40), 80, false},
+    {CUE_ALL, 0, 80, false},
+    {CUE_ALL, Adafruit_NeoPixel::Color(0, 0, 0, 40), 80, false},
+    {CUE_ALL, 0, 80, false},
+};
+
+static const CueStep WINDOW_CLOSE_CUE[] = {
+    {CUE_ALL, 0, 2000, true},
+};
 
 void FED4::begin() {
     instance = this;
+    paintStack();
+
+    uint32_t resetCause = PM->RCAUSE.reg;
+    traceInit();
+    trace(TraceEv::BOOT, resetCause, traceRing.bootCount);
 
     // Motor pins
     pinMode(FED4Pins::MTR_EN, OUTPUT);
@@ -22,20 +39,14 @@ void FED4::begin() {
     pinMode(FED4Pins::MTR_3, OUTPUT);
     pinMode(FED4Pins::MTR_4, OUTPUT);
     
-    // Input pins
-    pinMode(FED4Pins::LFT_POKE, INPUT_PULLUP);
-    pinMode(FED4Pins::RGT_POKE, INPUT_PULLUP);
+    // Input pins, the sensors are set up once the config is loaded
     pinMode(FED4Pins::WELL, INPUT);
     digitalWrite(FED4Pins::WELL, HIGH);
     
     // Interrupts
-    attachInterrupt(digitalPinToInterrupt(FED4Pins::LFT_POKE), left_poke_IRS, CHANGE);
-    attachInterrupt(digitalPinToInterrupt(FED4Pins::RGT_POKE), right_poke_IRS, CHANGE);
     attachInterrupt(digitalPinToInterrupt(FED4Pins::WELL), well_ISR, CHANGE);
     
     // Wakeup sources
-    EIC->WAKEUP.reg |= (1 << 4);   // FED4Pins::LFT_POKE
-    EIC->WAKEUP.reg |= (1 << 15);  // FED4Pins::RGT_POKE
     EIC->WAKEUP.reg |= (1 << 16);  // RTC peripheral
     
     // Clock setup
@@ -58,21 +69,55 @@ void FED4::begin() {
     rtcZero.attachInterrupt(alarm_ISR);
     rtcZero.enableAlarm(RTCZero::MATCH_SS);
     
-    randomSeed(rtc.now().unixtime());
+    _seed = rtc.now().unixtime();
+    randomSeed(_seed);
+    _rng_state = _seed;
     
     digitalWrite(FED4Pins::MTR_EN, HIGH);
     __delay(2);
     strip.begin();
     strip.clear();
     strip.show();
+    cueBegin(&strip, FED4Pins::MTR_EN);
     
     SdFile::dateTimeCallback(dateTime);
     initSD();
+
+    if (
+        (resetCause & PM_RCAUSE_WDT)
+        || ((resetCause & PM_RCAUSE_SYST) && traceRing.faultPc != 0)
+    ) {
+        save_trace(resetCause);
+    }
+    traceRing.bootUnix = getDateTime().unixtime();
+    traceRing.faultPc = 0;
+    traceRing.faultLr = 0;
     
+    flushInit(flushPolicy, FLUSH_MAX_AGE, FLUSH_MAX_EVENTS);
     loadConfig();
+    summaryReset(summary, traceRing.bootUnix);
+    if (_telem_enabled) {
+        Serial.begin(TELEM_BAUD);
+    }
+    if (_env_period > 0) {
+        envBegin(env);
+    }
+
+    soundBegin(FED4Pins::BUZZER);
+    syncBegin(FED4Pins::BNC_OUT, _sync_width, _sync_gap);
+    adcBegin();
+    _battery_channel = adcAddChannel(FED4Pins::VBAT, 4);
+    init_sensors();
+    init_shell();
+    tickerBegin();
+    tickerAttach(adcService, ADC_PERIOD);
+    tickerAttach(cueService, CUE_PERIOD);
+    tickerAttach(soundService, SOUND_PERIOD);
     
-    if (PM->RCAUSE.reg & PM_RCAUSE_WDT) {
+    if (resetCause & PM_RCAUSE_WDT) {
         wtd_restart();
+        log_seed();
+        sampleMemory();
         displayLayout();
         return;
     }
@@ -98,6 +143,8 @@ void FED4::begin() {
     }
 
     initLogFile();
+    log_seed();
+    sampleMemory();
     
     saveConfig();
     displayLayout();
@@ -106,15 +153,98 @@ void FED4::begin() {
 }
 
 void FED4::run() {
+    trace(TraceEv::RUN);
+
     setLightCue();
+    cueShow();
+
+    poll_sensors();
 
     updateDisplay();    
     
     if (checkCondition()) {
+        syncPulse(SyncEvent::REWARD, _sync_pulses[SyncEvent::REWARD]);
         feed(_reward);
     }
+    log_sync();
+
+    if (flush_due()) {
+        flush_to_sd();
+    }
+
+    // Rows from before the boundary stay in the old segment
+    if (_roll_hour >= 0 && !_roll_due && roll_day() != _segment_day) {
+        flush_to_sd();
+        _roll_due = true;
+    }
+    // Rolled here rather than by the next flush, which may come from a
+    // handler; see flush_to_sd()
+    if (_roll_due && _next_segment_ready) {
+        pause_interrupts();
+        digitalWrite(FED4Pins::CARD_SEL, LOW);
+        digitalWrite(FED4Pins::SHRP_CS, HIGH);
+        roll_segment();
+        start_interrupts();
+    }
+    if (_index_pending > 0) {
+        pause_interrupts();
+        digitalWrite(FED4Pins::CARD_SEL, LOW);
+        digitalWrite(FED4Pins::SHRP_CS, HIGH);
+        write_index();
+        start_interrupts();
+    }
+    if (
+        !_next_segment_ready
+        && (
+            _spare_sector < _spare_end
+            || _last_segment_try == 0 || millis() - _last_segment_try > SEGMENT_RETRY * 1000UL
+        )
+    ) {
+        prepare_segment();
+    }
+    if (_rows_lost > 0) {
+        _rows_lost = 0;
+        logError(ErrorMsg::LOG_FULL);
+    }
+
+    if (millis() - _last_mem_sample > MEM_SAMPLE_PERIOD * 1000UL) {
+        sampleMemory();
+    }
+    if (millis() - _last_battery_log > BATTERY_LOG_PERIOD * 1000UL) {
+        logBattery();
+    }
+    if (
+        (sdStats.degraded && !_card_degraded_logged)
+        || millis() - _last_card_report > CARD_REPORT_PERIOD * 1000UL
+    ) {
+        saveCardHealth();
+    }
+    if (millis() - _last_summary_check > 1000UL) {
+        update_summary();
+    }
+    if (millis() - _last_env_check > 1000UL) {
+        sample_env();
+    }
+    if (_telem_enabled) {
+        service_requests();
+        if (_dl_file.isOpen()) {
+            send_chunk();
+        }
+        if (_last_telem_hello == 0 || millis() - _last_telem_hello > TELEM_HELLO_PERIOD * 1000UL) {
+            send_hello();
+        }
+        if (_telem_period > 0 && millis() - _last_telem_counters > _telem_period * 1000UL) {
+            send_counters();
+        }
+        service_telemetry();
+    }
     
-    if (!checkFeedingWindow()) {
+    // Analog sensors are polled, so they keep the device awake. The service
+    // tick stops in standby, so running light and sound cues finish first.
+    if (
+        !checkFeedingWindow() && !_analog_sensors
+        && !cuePlaying() && !soundPlaying() && !syncBusy() && _sync_released == 0
+    ) {
         sleep();
     }
 
@@ -122,11 +252,13 @@ void FED4::run() {
 }
 
 void FED4::sleep() {
+    trace(TraceEv::SLEEP);
     _sleep_mode = true;
     __DSB();
     while(_sleep_mode) {
         __WFI();
     }
+    trace(TraceEv::WAKE);
 }
 
 void FED4::feed(int pellets, bool wait) {
@@ -134,6 +266,11 @@ void FED4::feed(int pellets, bool wait) {
 
     _pellet_dropped = false;
 
+    // A motor stall can brown out or reset the board
+    flush_to_sd();
+
+    trace(TraceEv::FEED, 0, pellets);
+
     long startOfFeed;
     for (int i = 0; i < pellets; i++) {
         startOfFeed = millis();
@@ -160,16 +297,20 @@ void FED4::feed(int pellets, bool wait) {
             }
             else {
                 logError("Clogged or No Pellets");
+                summary.jams++;
                 _jam_error = true;
+                trace(TraceEv::FEED_END, 1);
                 updateDisplay();
                 return;
             }
         }
 
         pelletsDispensed++;
+        summaryPellet(summary, millis() - startOfFeed);
         Event event = {
             .time = getDateTime(),
-            .message = EventMsg::PEL
+            .code = EventCode::PEL,
+            .data = {}
         };
         logEvent(event);
         __delay(200);
@@ -179,19 +320,26 @@ void FED4::feed(int pellets, bool wait) {
 #endif
     }
 
-    _left_poke = false;
-    _right_poke = false;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        sensors[i].poked = false;
+    }
+    cuePlay(REWARD_CUE, sizeof(REWARD_CUE) / sizeof(REWARD_CUE[0]));
+    playSound(SoundCue::REWARD);
+    trace(TraceEv::FEED_END);
 
     updateDisplay();
 }
 
 void FED4::rotateWheel(int degrees) {
+    trace(TraceEv::MOTOR, 0, degrees);
+    cueHold(true);
     digitalWrite(FED4Pins::MTR_EN, HIGH);
 
     int steps = (STEPS * degrees / 360);
     stepper.step(steps);
 
     digitalWrite(FED4Pins::MTR_EN, LOW);
+    cueHold(false);
 }
 
 void FED4::loadConfig() {
@@ -216,16 +364,90 @@ void FED4::loadConfig() {
         chance = config["mode"]["chance"];
     }
 
-    if (config["active sensor"] == "left") {
-        activeSensor = ActiveSensor::LEFT;
-    } else if (config["active sensor"] == "right") {
-        activeSensor = ActiveSensor::RIGHT;
-    } else if (config["active sensor"] == "both") {
-        activeSensor = ActiveSensor::BOTH;
+    JsonVariant sensorList = config["sensors"];
+    if (sensorList.size() > 0) {
+        sensorCount = 0;
+        for (size_t i = 0; i < sensorList.size(); i++) {
+            JsonVariant sensor = sensorList[i];
+            if (sensor["pin"].isNull()) continue;
+
+            const char* type = sensor["type"] | "digital";
+            int8_t idx = addSensor(
+                sensor["name"] | "Sensor",
+                sensor["pin"] | 0,
+                strcmp(type, "analog") == 0 ? SensorType::ANALOG : SensorType::DIGITAL,
+                sensor["action"] | "Poke"
+            );
+            if (idx < 0) break;
+
+            sensors[idx].threshold = sensor["threshold"] | SENSOR_THRESHOLD;
+            sensors[idx].debounce = sensor["debounce"] | SENSOR_DEBOUNCE;
+            sensors[idx].pixel = sensor["pixel"] | 0xFF;
+        }
+        if (sensorCount == 0) {
+            setDefaultSensors();
+        }
+    }
+
+    // Each sound is a list of notes: {"hz": 0 for a rest, "ms", "vol": 0-100,
+    // "end": volume at the end of the note, defaults to "vol"}
+    JsonVariant sounds = config["sounds"];
+    for (uint8_t c = 0; c < SoundCue::COUNT; c++) {
+        JsonVariant notes = sounds[SoundCue::NAMES[c]];
+        _sound_len[c] = 0;
+        for (size_t i = 0; i < notes.size() && i < SOUND_MAX_NOTES; i++) {
+            SoundNote &note = _sounds[c][_sound_len[c]++];
+            note.hz = notes[i]["hz"] | 0;
+            note.ms = notes[i]["ms"] | 100;
+            note.vol = constrain(notes[i]["vol"] | 100, 0, 100);
+            note.end = constrain(notes[i]["end"] | (int)note.vol, 0, 100);
+        }
+    }
+
+    JsonVariant active = config["active sensor"];
+    uint8_t activeMask = 0;
+    if (active.is<const char*>()) {
+        activeMask = sensor_mask(active.as<const char*>());
     }
+    else {
+        for (size_t i = 0; i < active.size(); i++) {
+            activeMask |= sensor_mask(active[i].as<const char*>());
+        }
+    }
+    if (activeMask != 0) {
+        activeSensor = activeMask;
+    }
+
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char key[8];
+        sensor_key(i, key);
+        sensors[i].reward = config["reward"][key] | sensors[i].reward;
+    }
+    flushPolicy.maxAge = config["log"]["max age"] | flushPolicy.maxAge;
+    flushPolicy.maxEvents = config["log"]["max events"] | flushPolicy.maxEvents;
+    uint32_t segmentMb = config["log"]["segment mb"] | (int)(_segment_size / (1024UL * 1024UL));
+    _segment_size = max((uint32_t)(segmentMb * 1024UL * 1024UL), (uint32_t)SEGMENT_MIN_SIZE);
+    _roll_hour = config["log"]["roll hour"] | _roll_hour;
+    _raw_log_enabled = config["log"]["raw"] | _raw_log_enabled;
+    _index_rows = config["log"]["index rows"] | _index_rows;
+    _index_period = config["log"]["index min"] | _index_period;
+    _env_period = config["env"]["period"] | _env_period;
+    _env_batch = max(config["env"]["batch"] | (int)_env_batch, 1);
+    _telem_enabled = config["telemetry"]["enabled"] | _telem_enabled;
+    _telem_period = config["telemetry"]["period"] | _telem_period;
+    _telem_rate = max(config["telemetry"]["rate"] | (int)_telem_rate, 100);
+
+    JsonVariant sync = config["sync"];
+    _sync_width = sync["width us"] | _sync_width;
+    _sync_gap = sync["gap us"] | _sync_gap;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char key[sizeof(Sensor::name)];
+        sensor_key(i, key);
+        _sync_pulses[i] = sync["pulses"][key] | 0;
+    }
+    _sync_pulses[SyncEvent::REWARD] = sync["pulses"]["reward"] | 0;
+    _sync_pulses[SyncEvent::PELLET] = sync["pulses"]["pellet"] | 0;
 
-    leftReward = config["reward"]["left"];
-    rightReward = config["reward"]["right"];
     if (config["reward"]["window"] == true) {
         feedWindow = true;
         windowStart = config["reward"]["time"]["start"];
@@ -240,74 +462,198 @@ void FED4::loadConfig() {
 void FED4::saveConfig() {
     sd.remove("CONFIG.json");
     File configFile = sd.open("CONFIG.json", FILE_WRITE);
-    JsonDocument config;
+    configJson(configFile);
+    configFile.close();
+}
 
-    config["device number"] = deviceNumber;
-    config["animal"] = animal;
+// The settings as CONFIG.json keeps them, also written into each log
+// segment's preamble. Written a token at a time, so a roll from a flush in
+// an interrupt handler can write it too.
+void FED4::configJson(Print &out) {
+    JsonOut config(out);
+    config.beginObject();
+    config.key("device number").value(deviceNumber);
+    config.key("animal").value(animal);
 
     switch (mode) {
     case Mode::FR:
-        config["mode"]["name"] = "FR";
-        config["mode"]["ratio"] = ratio;
+        config.key("mode").beginObject();
+        config.key("name").value("FR");
+        config.key("ratio").value(ratio);
+        config.end();
         break;
 
     case Mode::VI:
-        config["mode"]["name"] = "VI";
-        config["mode"]["avg"] = viAvg;
-        config["mode"]["spread"] = viSpread;
+        config.key("mode").beginObject();
+        config.key("name").value("VI");
+        config.key("avg").value(viAvg);
+        config.key("spread").value(viSpread);
+        config.end();
         break;
 
     case Mode::CHANCE:
-        config["mode"]["name"] = "CHANCE";
-        config["mode"]["chance"] = chance;
-    
-    default:
-        break;
-    }
-
-    switch (activeSensor) {
-    case ActiveSensor::LEFT:
-        config["active sensor"] = "left";
-        break;
-
-    case ActiveSensor::RIGHT:
-        config["active sensor"] = "right";
+        config.key("mode").beginObject();
+        config.key("name").value("CHANCE");
+        config.key("chance").value(chance);
+        config.end();
         break;
 
     default:
         break;
     }
 
-    config["reward"]["left"] = leftReward;
-    config["reward"]["right"] = rightReward;
+    config.key("sensors").beginArray();
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        Sensor &sensor = sensors[i];
+        config.beginObject();
+        config.key("name").value(sensor.name);
+        config.key("pin").value(sensor.pin);
+        config.key("action").value(sensor.action);
+        config.key("debounce").value(sensor.debounce);
+        if (sensor.type == SensorType::ANALOG) {
+            config.key("type").value("analog");
+            config.key("threshold").value(sensor.threshold);
+        }
+        else {
+            config.key("type").value("digital");
+        }
+        if (sensor.pixel != 0xFF) {
+            config.key("pixel").value(sensor.pixel);
+        }
+        config.end();
+    }
+    config.end();
+
+    config.key("reward").beginObject();
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char key[8];
+        sensor_key(i, key);
+        config.key(key).value(sensors[i].reward);
+    }
+    config.key("window").value(feedWindow);
     if (feedWindow) {
-        config["reward"]["window"] = true;
-        config["reward"]["time"]["start"] = windowStart;
-        config["reward"]["time"]["end"] = windowEnd;
-    } else {
-        config["reward"]["window"] = false;
+        config.key("time").beginObject();
+        config.key("start").value(windowStart);
+        config.key("end").value(windowEnd);
+        config.end();
     }
-    
-    serializeJson(config, configFile);
-    configFile.close();
+    config.end();
+
+    uint8_t allSensors = (1 << sensorCount) - 1;
+    if (activeSensor == allSensors) {
+        config.key("active sensor").value(sensorCount == 2 ? "both" : "all");
+    }
+    else {
+        config.key("active sensor").beginArray();
+        for (uint8_t i = 0; i < sensorCount; i++) {
+            if (isActive(i)) config.value(sensors[i].name);
+        }
+        config.end();
+    }
+
+    config.key("sounds").beginObject();
+    for (uint8_t c = 0; c < SoundCue::COUNT; c++) {
+        if (_sound_len[c] == 0) continue;
+        config.key(SoundCue::NAMES[c]).beginArray();
+        for (uint8_t i = 0; i < _sound_len[c]; i++) {
+            const SoundNote &note = _sounds[c][i];
+            config.beginObject();
+            config.key("hz").value(note.hz);
+            config.key("ms").value(note.ms);
+            config.key("vol").value(note.vol);
+            if (note.end != note.vol) {
+                config.key("end").value(note.end);
+            }
+            config.end();
+        }
+        config.end();
+    }
+    config.end();
+
+    config.key("log").beginObject();
+    config.key("max age").value(flushPolicy.maxAge);
+    config.key("max events").value(flushPolicy.maxEvents);
+    config.key("segment mb").value(_segment_size / (1024UL * 1024UL));
+    config.key("roll hour").value(_roll_hour);
+    config.key("raw").value(_raw_log_enabled);
+    config.key("index rows").value(_index_rows);
+    config.key("index min").value(_index_period);
+    config.end();
+
+    config.key("env").beginObject();
+    config.key("period").value(_env_period);
+    config.key("batch").value(_env_batch);
+    config.end();
+
+    config.key("telemetry").beginObject();
+    config.key("enabled").value(_telem_enabled);
+    config.key("period").value(_telem_period);
+    config.key("rate").value(_telem_rate);
+    config.end();
+
+    config.key("sync").beginObject();
+    config.key("width us").value(_sync_width);
+    config.key("gap us").value(_sync_gap);
+    config.key("pulses").beginObject();
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char key[sizeof(Sensor::name)];
+        sensor_key(i, key);
+        config.key(key).value(_sync_pulses[i]);
+    }
+    config.key("reward").value(_sync_pulses[SyncEvent::REWARD]);
+    config.key("pellet").value(_sync_pulses[SyncEvent::PELLET]);
+    config.end();
+    config.end();
+
+    config.end();
 }
 
-bool FED4::getLeftPoke() {
-    if (_left_poke)
+void FED4::setDefaultSensors() {
+    sensorCount = 0;
+    addSensor("Left", FED4Pins::LFT_POKE);
+    addSensor("Right", FED4Pins::RGT_POKE);
+    sensors[0].pixel = 9;
+    sensors[1].pixel = 8;
+    activeSensor = ActiveSensor::BOTH;
+}
+
+int8_t FED4::addSensor(const char* name, uint8_t pin, uint8_t type, const char* action) {
+    if (sensorCount >= MAX_SENSORS) return -1;
+
+    Sensor &sensor = sensors[sensorCount];
+    memset(&sensor, 0, sizeof(Sensor));
+    strncpy(sensor.name, name, sizeof(sensor.name) - 1);
+    strncpy(sensor.action, action, sizeof(sensor.action) - 1);
+    snprintf(sensor.message, sizeof(sensor.message), "%.7s %.7s", name, action);
+    sensor.pin = pin;
+    sensor.type = type;
+    sensor.pixel = 0xFF;
+    sensor.reward = 1;
+    sensor.threshold = SENSOR_THRESHOLD;
+    sensor.debounce = SENSOR_DEBOUNCE;
+
+    return sensorCount++;
+}
+
+bool FED4::isActive(uint8_t sensor) {
+    return activeSensor & (1 << sensor);
+}
+
+bool FED4::getPoke(uint8_t sensor) {
+    if (sensor < sensorCount && sensors[sensor].poked)
     {
-        _left_poke = false;
+        sensors[sensor].poked = false;
         return true;
     }
     return false;
 }
 
+bool FED4::getLeftPoke() {
+    return getPoke(0);
+}
+
 bool FED4::getRightPoke() {
-    if (_right_poke)
-    {
-        _right_poke = false;
-        return true;
-    }
-    return false;
+    return getPoke(1);
 }
 
 bool FED4::getWellStatus() {
@@ -319,7 +665,9 @@ bool FED4::getWellStatus() {
 }
 
 void FED4::initSD() {
+    cueHold(true);
     digitalWrite(FED4Pins::MTR_EN, LOW);
+    cueHold(false);
 
     while (!sd.begin(FED4Pins::CARD_SEL, SD_SCK_MHZ(4)))
     {
@@ -344,41 +692,240 @@ void FED4::showSdError() {
 }
 
 void FED4::initLogFile() {   
+    cueHold(true);
     digitalWrite(FED4Pins::MTR_EN, LOW);
-    char fileName[30] = "";
+    cueHold(false);
 
-    DateTime now = getDateTime();
+    char fileName[30];
+    log_file_name(fileName, sizeof(fileName));
+    char indexName[30];
+    logIndexName(fileName, indexName, sizeof(indexName));
+    sd.remove(indexName);
     
-    strcat(fileName, "FED");
-    if (deviceNumber < 10) strcat(fileName, "0");
-    strcat(fileName, String(deviceNumber).c_str());
-    strcat(fileName, "_");
-    if (now.day() < 10) strcat(fileName, "0");
-    strcat(fileName, String(now.day()).c_str());
-    strcat(fileName, "-");
-    if (now.month() < 10) strcat(fileName, "0");
-    strcat(fileName, String(now.month()).c_str());
-    strcat(fileName, "-");
-    if (now.year() % 100 < 10) strcat(fileName, "0");
-    strcat(fileName, String(now.year() % 100).c_str());
-    strcat(fileName, "_");
-    strcat(fileName, "01.csv");
-    
-    // fed1_06-03-25_01.csv
-    
-    int fileIndex = 1;
-    while (sd.exists(fileName))
-    {
-        fileIndex++;
-        fileName[15] = '0' + fileIndex / 10;
-        fileName[16] = '0' + fileIndex % 10;
+    trace(TraceEv::SD_OPEN);
+    create_segment(fileName, _segment_size);
+    uint32_t opStart = micros();
+    logFile.open(fileName, O_RDWR | O_CREAT);
+    sd_timed(SdOp::OPEN, opStart);
+    logFile.rewind();
+    log_open_raw(0);
+
+    _segment_index = 1;
+    _segment_day = roll_day();
+    _roll_due = false;
+    _index_pending = 0;
+    _index_due = true;
+
+    // A spare from an earlier session may be half erased
+    sd.remove(NEXT_SEGMENT);
+    _next_segment_ready = false;
+    _spare_sector = _spare_end = 0;
+    _last_segment_try = 0;
+
+    pause_interrupts();
+    write_log_header(nullptr, 0);
+    start_interrupts();
+}
+
+// FED01_06-03-25_001.csv, the first free index for today
+void FED4::log_file_name(char* name, size_t len) {
+    DateTime now = getDateTime();
+    for (uint16_t index = 1; index <= 999; index++) {
+        snprintf(
+            name, len, "FED%02u_%02u-%02u-%02u_%03u.csv",
+            deviceNumber, now.day(), now.month(), now.year() % 100, index
+        );
+        if (!sd.exists(name)) return;
     }
-    
-    logFile.open(fileName, FILE_WRITE);
-    logFile.createContiguous(fileName, FILE_PREALLOC_SIZE);
+}
+
+// Segments are preallocated in one extent and erased, so the rows end at
+// the first byte that reads as erased, see log_data_end()
+bool FED4::create_segment(const char* name, uint32_t size) {
+    File file;
+    if (!file.createContiguous(name, size)) return false;
+
+    uint32_t firstSector, lastSector;
+    if (file.contiguousRange(&firstSector, &lastSector)) {
+        sd.card()->erase(firstSector, lastSector);
+    }
+    file.close();
+    return true;
+}
+
+// Runs when idle, so a rollover only has to rename the spare. A step per
+// pass: the first creates the spare, the rest erase it SEGMENT_ERASE_STEP
+// sectors at a time. The FAT scan can take seconds, so the sensor lines
+// stay live; while _card_busy their handlers only buffer rows, and
+// flush_to_sd() leaves the card to this.
+void FED4::prepare_segment() {
+    flush_to_sd();
+
+    digitalWrite(FED4Pins::CARD_SEL, LOW);
+    digitalWrite(FED4Pins::SHRP_CS, HIGH);
+    _card_busy = true;
+
+    if (_spare_sector < _spare_end) {
+        uint32_t last = min(_spare_sector + SEGMENT_ERASE_STEP, _spare_end) - 1;
+        sd.card()->erase(_spare_sector, last);
+        _spare_sector = last + 1;
+        _next_segment_ready = _spare_sector == _spare_end;
+        _card_busy = false;
+        return;
+    }
+
+    _last_segment_try = millis();
+    trace(TraceEv::SD_OPEN, 1);
+
+    sd.remove(NEXT_SEGMENT);
+    File file;
+    if (file.createContiguous(NEXT_SEGMENT, _segment_size)) {
+        uint32_t firstSector, lastSector;
+        if (file.contiguousRange(&firstSector, &lastSector)) {
+            _spare_sector = firstSector;
+            _spare_end = lastSector + 1;
+        }
+        else {
+            _next_segment_ready = true;
+        }
+        file.close();
+    }
+    _card_busy = false;
+}
+
+void FED4::roll_segment() {
+    trace(TraceEv::SD_OPEN, 2);
+
+    if (_index_pending > 0) write_index();
+
+    char prevName[30];
+    logFile.getName(prevName, sizeof(prevName));
+    uint32_t prevBytes = log_position();
+    logFile.truncate(prevBytes);
+    logFile.close();
+
+    char fileName[30];
+    log_file_name(fileName, sizeof(fileName));
+    char indexName[30];
+    logIndexName(fileName, indexName, sizeof(indexName));
+    sd.remove(indexName);
+    sd.rename(NEXT_SEGMENT, fileName);
+    _next_segment_ready = false;
+    _spare_sector = _spare_end = 0;
+    _last_segment_try = 0;
+
+    uint32_t opStart = micros();
+    logFile.open(fileName, O_RDWR);
+    sd_timed(SdOp::OPEN, opStart);
     logFile.rewind();
+    log_open_raw(0);
 
-    char header[500] = "";
+    _segment_index++;
+    _segment_day = roll_day();
+    _roll_due = false;
+    _index_due = true;
+
+    write_log_header(prevName, prevBytes);
+}
+
+void FED4::log_open_raw(uint32_t position) {
+    _raw_log = false;
+    if (!_raw_log_enabled) return;
+
+    uint32_t firstSector, lastSector;
+    if (!logFile.contiguousRange(&firstSector, &lastSector)) return;
+    uint32_t sectors = min(lastSector - firstSector + 1, (uint32_t)(logFile.fileSize() / RAW_BLOCK));
+    _raw_log = rawOpen(_raw, sd.card(), firstSector, sectors, position);
+}
+
+void FED4::log_write(const char* data, size_t len) {
+    if (_raw_log) {
+        uint32_t position = rawPosition(_raw);
+        if (rawWrite(_raw, sd.card(), data, len)) return;
+
+        // Past the extent or refused by the card: carry on through SdFat
+        _raw_log = false;
+        logFile.seekSet(position);
+    }
+    logFile.write(data, len);
+}
+
+uint32_t FED4::log_position() {
+    return _raw_log ? rawPosition(_raw) : logFile.curPosition();
+}
+
+// Days counted from the configured rollover hour
+uint32_t FED4::roll_day() {
+    if (_roll_hour < 0) return 0;
+    return (getDateTime().unixtime() - _roll_hour * 3600UL) / 86400UL;
+}
+
+// Binary search for the first erased block, then the first erased byte
+// in the block before it. Files that were not preallocated end at their
+// size.
+uint32_t FED4::log_data_end(SdFile &file) {
+    auto erased = [](int c) { return c == 0x00 || c == 0xFF || c < 0; };
+
+    uint32_t lo = 0;
+    uint32_t hi = (file.fileSize() + 511) / 512;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        file.seekSet(mid * 512UL);
+        if (erased(file.read())) hi = mid;
+        else lo = mid + 1;
+    }
+    if (lo == 0) return 0;
+
+    uint32_t end = (lo - 1) * 512UL;
+    file.seekSet(end);
+    for (uint16_t i = 0; i < 512; i++, end++) {
+        if (erased(file.read())) break;
+    }
+    return min(end, (uint32_t)file.fileSize());
+}
+
+void FED4::write_log_header(const char* prevName, uint32_t prevBytes) {
+    char line[ROW_MAX_LEN];
+    LogPrint out(this);
+    snprintf(
+        line, sizeof(line), "#segment=%u,session=%lu,prev=%s,prev_bytes=%lu\n",
+        _segment_index, (unsigned long)traceRing.bootUnix,
+        prevName ? prevName : "", (unsigned long)prevBytes
+    );
+    out.write(line);
+
+    // The preamble, see LogSchema.h
+    snprintf(
+        line, sizeof(line), "#schema=%u,build=%s,old_well=%d,steps=%u,seed=%lu\n",
+        LOG_SCHEMA_VERSION, LOG_BUILD, OLD_WELL ? 1 : 0, STEPS, (unsigned long)_seed
+    );
+    out.write(line);
+    out.write("#config=");
+    configJson(out);
+    out.write("\n");
+    log_types(line);
+    out.write(line);
+
+    log_columns(line);
+    out.write(line);
+
+    char trailer[LOG_TRAILER_LEN];
+    logTrailer(trailer, sizeof(trailer), _block_seq++, out.len, out.crc);
+    log_write(trailer, strlen(trailer));
+    if (!_raw_log) logFile.sync();
+}
+
+size_t FED4::LogPrint::write(const uint8_t* buf, size_t n) {
+    _fed->log_write((const char*)buf, n);
+    crc = crc32Update(crc, buf, n);
+    len += n;
+    return n;
+}
+
+// Column header of the log, with its '\n'
+void FED4::log_columns(char header[ROW_MAX_LEN]) {
+    header[0] = '\0';
+    strcat(header, "Seq,");
     strcat(header, "TimeStamp,");
     strcat(header, "Device Number,");
     strcat(header, "Animal,");
@@ -388,12 +935,18 @@ void FED4::initLogFile() {
     strcat(header, "In Window,");
     strcat(header, "Event,");
     strcat(header, "Active Sensor,");
-    strcat(header, "Left Reward,");
-    strcat(header, "Right Reward,");
-    strcat(header, "Left Poke Count,");
-    strcat(header, "Right Poke Count,");
-    strcat(header, "Pellet Count");
-
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        strcat(header, sensors[i].name);
+        strcat(header, " Reward,");
+    }
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        strcat(header, sensors[i].name);
+        strcat(header, " ");
+        strcat(header, sensors[i].action);
+        strcat(header, " Count,");
+    }
+    strcat(header, "Pellet Count,");
+    strcat(header, "Battery mV");
 
     switch (mode) {
     case Mode::VI:
@@ -413,16 +966,65 @@ void FED4::initLogFile() {
     }
 
     strcat(header, "\n");
+}
 
-    pause_interrupts();
-    logFile.print(header);
-    logFile.flush();
-    start_interrupts();
+// Type of each column of log_columns(), see LogSchema.h
+void FED4::log_types(char types[ROW_MAX_LEN]) {
+    auto add = [&](uint8_t type) {
+        logTypeName(types, ROW_MAX_LEN, type);
+        strcat(types, ",");
+    };
+    strcpy(types, "#types=");
+    add(LogType::U32);                          // Seq
+    add(LogType::TIME);                         // TimeStamp
+    add(LogType::U8);                           // Device Number
+    add(LogType::U8);                           // Animal
+    add(LogType::TEXT);                         // Mode
+    add(LogType::U8 | LogType::NULLABLE);       // Window Start
+    add(LogType::U8 | LogType::NULLABLE);       // Window End
+    add(LogType::U8 | LogType::NULLABLE);       // In Window
+    add(LogType::TEXT);                         // Event
+    add(LogType::TEXT);                         // Active Sensor
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        add(LogType::U8 | LogType::NULLABLE);   // Reward
+    }
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        add(LogType::U16);                      // Count
+    }
+    add(LogType::U16);                          // Pellet Count
+    add(LogType::U16);                          // Battery mV
+
+    switch (mode) {
+    case Mode::VI:
+        add(LogType::U16);
+        break;
+
+    case Mode::FR:
+        add(LogType::U8);
+        break;
+
+    case Mode::CHANCE:
+        add(LogType::F32);
+        break;
+    
+    default:
+        break;
+    }
+
+    types[strlen(types) - 1] = '\n';
 }
 
-void FED4::logEvent(Event e) {
+void FED4::log_event(const Event &e) {
     char row[ROW_MAX_LEN] = "";
     DateTime now = getDateTime();
+
+    // Numbered as they happen, so rows that reach the buffer out of order
+    // or not at all show up in the log
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t seq = _event_seq++;
+    __set_PRIMASK(primask);
+    snprintf(row, sizeof(row), "%lu,", (unsigned long)seq);
     
     char date[20];
     sprintf(date, "%d/%d/%d ", now.day(), now.month(), now.year() % 1000);
@@ -486,61 +1088,53 @@ void FED4::logEvent(Event e) {
         strcat(row, "null,null,null,");
     }
 
-    strcat(row, e.message);
+    // The Event column, written out from the code and payload here
+    const char* subject = nullptr;
+    if (e.code == EventCode::POKE && e.data.sensor < sensorCount) {
+        subject = sensors[e.data.sensor].message;
+    }
+    else if (e.code == EventCode::SYNC) {
+        subject = e.data.sync.event < sensorCount ? sensors[e.data.sync.event].message
+            : e.data.sync.event == SyncEvent::REWARD ? "Reward"
+            : "Pellet";
+    }
+    char text[96];
+    eventText(e.code, e.data, subject, text, sizeof(text));
+    strcat(row, text);
     strcat(row, ",");
 
-    char activeSensor_str[10];
-    switch (activeSensor) {
-    case ActiveSensor::BOTH:
-        sprintf(activeSensor_str, "Both");
-        break;
-    
-    case ActiveSensor::LEFT:
-        sprintf(activeSensor_str, "Left");
-        break;
-    
-    case ActiveSensor::RIGHT:
-        sprintf(activeSensor_str, "Right");
-        break;
-    }
+    char activeSensor_str[4 * sizeof(Sensor::name)];
+    sensor_mask_str(activeSensor, activeSensor_str, sizeof(activeSensor_str));
     strcat(row, activeSensor_str);
     strcat(row, ",");
 
-    char leftReward_str[5];
-    char rightReward_str[5];
-    switch (activeSensor) {
-    case ActiveSensor::LEFT:
-        snprintf(leftReward_str, sizeof(leftReward_str), "%d", leftReward);
-        snprintf(rightReward_str, sizeof(rightReward_str), "null");
-        break;
-        
-    case ActiveSensor::RIGHT:
-        snprintf(leftReward_str, sizeof(leftReward_str), "null");
-        snprintf(rightReward_str, sizeof(rightReward_str), "%d", rightReward);
-        break;
-        
-    case ActiveSensor::BOTH:
-        snprintf(leftReward_str, sizeof(leftReward_str), "%d", leftReward);
-        snprintf(rightReward_str, sizeof(rightReward_str), "%d", rightReward);
-        break;    
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char reward_str[5];
+        if (isActive(i)) {
+            snprintf(reward_str, sizeof(reward_str), "%d", sensors[i].reward);
+        }
+        else {
+            snprintf(reward_str, sizeof(reward_str), "null");
+        }
+        strcat(row, reward_str);
+        strcat(row, ",");
     }
-    strcat(row, leftReward_str);
-    strcat(row, ",");
-    strcat(row, rightReward_str);
-    strcat(row, ",");
     
-    char leftPokeCount_str[8];
-    snprintf(leftPokeCount_str, sizeof(leftPokeCount_str), "%d", leftPokeCount);
-    char rightPokeCount_str[8];
-    snprintf(rightPokeCount_str, sizeof(rightPokeCount_str), "%d", rightPokeCount);
-    strcat(row, leftPokeCount_str);
-    strcat(row, ",");
-    strcat(row, rightPokeCount_str);
-    strcat(row, ",");
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char count_str[8];
+        snprintf(count_str, sizeof(count_str), "%d", sensors[i].count);
+        strcat(row, count_str);
+        strcat(row, ",");
+    }
     
     char pelletsDispensed_str[8];
     snprintf(pelletsDispensed_str, sizeof(pelletsDispensed_str), "%d", pelletsDispensed);
     strcat(row, pelletsDispensed_str);
+    strcat(row, ",");
+
+    char battery_str[8];
+    snprintf(battery_str, sizeof(battery_str), "%u", getBatteryMillivolts());
+    strcat(row, battery_str);
     
     switch (mode) {
     case Mode::VI:
@@ -568,19 +1162,21 @@ void FED4::logEvent(Event e) {
         break;
     }
     
+    send_telemetry(TelemType::EVENT, row, strlen(row));
     strcat(row, "\n");
     
-    write_to_log(row);
+    write_to_log(row, seq, now.unixtime());
 }
 
-void FED4::logError(String str) {
-    char errorMsg[100] = "";
-    snprintf(errorMsg, sizeof(errorMsg), "Error: %s", str.c_str());
+void FED4::logError(const char* str) {
     Event event = {
         .time = getDateTime(),
-        .message = (const char *)errorMsg
+        .code = EventCode::ERROR,
+        .data = {}
     };
+    event.data.text = str;
     logEvent(event);
+    playSound(SoundCue::ERROR);
 }
 
 void FED4::updateDisplay(bool statusOnly) {
@@ -598,6 +1194,12 @@ void FED4::updateDisplay(bool statusOnly) {
     if (_jam_error) {
         print("ERROR: JAM OR NO PELLETS");
     }
+    else if (memStats.largestFree != 0 && memStats.largestFree < MEM_LOW_BYTES) {
+        print("LOW MEMORY");
+    }
+    else if (sdStats.degraded) {
+        print("SLOW SD CARD");
+    }
 
     display.refresh();
 
@@ -613,15 +1215,22 @@ void FED4::displayLayout() {
     display.setTextSize(2);
     display.setTextColor(BLACK);
 
-    display.setCursor(4, 26);
-    display.print("Left: ");
-    display.setCursor(4, 46);
-    display.print("Right: ");
-    display.setCursor(4, 66);
+    // Up to two sensors get full size rows, more are drawn at half height
+    uint8_t sensorRow = sensorCount <= 2 ? 20 : 10;
+    display.setTextSize(sensorCount <= 2 ? 2 : 1);
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        display.setCursor(4, 26 + i * sensorRow);
+        display.print(sensors[i].name);
+        display.print(": ");
+    }
+
+    uint8_t y = 26 + sensorCount * sensorRow;
+    display.setTextSize(2);
+    display.setCursor(4, y);
     display.print("Pellets: ");
     if (mode == Mode::VI)
     {
-        display.setCursor(4, 86);
+        display.setCursor(4, y + 20);
         display.print("VI CD: ");
     }
 
@@ -720,60 +1329,804 @@ void FED4::drawStats() {
 
     display.setTextSize(2);
 
-    display.setCursor(100, 26);
-    display.print(leftPokeCount);
-    display.setCursor(100, 46);
-    display.print(rightPokeCount);
-    display.setCursor(100, 66);
+    uint8_t sensorRow = sensorCount <= 2 ? 20 : 10;
+    display.setTextSize(sensorCount <= 2 ? 2 : 1);
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        display.setCursor(100, 26 + i * sensorRow);
+        display.print(sensors[i].count);
+    }
+
+    uint8_t y = 26 + sensorCount * sensorRow;
+    display.setTextSize(2);
+    display.setCursor(100, y);
     display.print(pelletsDispensed);
 
     if (mode == Mode::VI) {
-        display.setCursor(100, 86);
+        display.setCursor(100, y + 20);
         if (viCountDown >= 0) {
             display.print(viCountDown);
         }
     }
 }
 
-void FED4::makeNoise(int duration) {
-    for (int i = 0; i < duration / 50; i++)
-    {
-        tone(FED4Pins::BUZZER, random(50, 250), 50);
-        __delay((uint32_t)(duration / 50));
-    }
+// Static RAM by subsystem: the big buffers in FED4, the rest of FED4, the
+// trace ring, and what is left of .data and .bss for the libraries
+uint8_t FED4::ramUsers(RamUser users[RAM_USERS_MAX]) {
+    uint8_t n = 0;
+    uint32_t listed = 0;
+    auto add = [&](const char* name, uint32_t bytes) {
+        users[n++] = {name, bytes};
+        listed += bytes;
+    };
+    add("Log", sizeof(_log_buffer) + sizeof(_index_queue));
+    add("Telem", sizeof(_telem_ring) + sizeof(_telem_rx));
+    add("Sounds", sizeof(_sounds) + sizeof(_noise));
+    add("Sensors", sizeof(sensors));
+    add("FED4", sizeof(FED4) - listed);
+    add("Trace", sizeof(TraceRing));
+    uint32_t total = getMemStats().staticRam;
+    if (total > listed) add("Other", total - listed);
+    return n;
 }
 
-void FED4::runConfigMenu() {
-    ignorePokes = true;
-
-    Menu configMenu = Menu();
+void FED4::sampleMemory(bool log) {
+    memStats = getMemStats();
+    _last_mem_sample = millis();
 
-    configMenu.add("Time", new ClockMenu());
-    configMenu.add("Animal", &animal, 0, 99, 1);
+    if (!log) return;
 
-    const char* modes[] = {"FR", "VI", "%"};
-    configMenu.add("Mode", &mode, modes, 3);
+    Event event = {
+        .time = getDateTime(),
+        .code = EventCode::MEM,
+        .data = {}
+    };
+    event.data.mem.stack = memStats.stackUsed;
+    event.data.mem.free = memStats.heapFree;
+    event.data.mem.block = memStats.largestFree;
+    event.data.mem.frags = memStats.freeBlocks;
+    logEvent(event);
+}
 
-    const char* sensors[] = {"L", "R", "L&R"};
-    configMenu.add("Sensor", &activeSensor, sensors, 3);
+void FED4::logBattery() {
+    _last_battery_log = millis();
 
-    configMenu.add("L Rew", &leftReward, 0, 255, 1);
-    configMenu.add("R Rew", &rightReward, 0, 255, 1);
+    Event event = {
+        .time = getDateTime(),
+        .code = EventCode::BATTERY,
+        .data = {}
+    };
+    logEvent(event);
+}
 
-    configMenu.add("Rew Win", &feedWindow);
-    configMenu.add("Rew Beg", &windowStart, 0, 23, 1);
-    configMenu.add("Rew End", &windowEnd, 0, 23, 1);
-    
-    int batteryLevel = getBatteryPercentage();
-    configMenu.run(batteryLevel); 
+// One row per sync train, with the micros() of its first edge
+void FED4::log_sync() {
+    SyncMark mark;
+    while (syncNext(mark)) {
+        Event event = {
+            .time = getDateTime(),
+            .code = EventCode::SYNC,
+            .data = {}
+        };
+        event.data.sync.event = mark.event;
+        event.data.sync.pulses = mark.pulses;
+        event.data.sync.us = mark.us;
+        logEvent(event);
+    }
+}
 
-    ignorePokes = false;
+// Queues one frame, or drops it when the ring is full or, unless it is
+// not limited, the rate budget is spent. Safe from the alarm handler;
+// never touches the port.
+void FED4::send_telemetry(uint8_t type, const void* payload, size_t len, bool limited) {
+    if (!_telem_enabled) return;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint16_t seq = _telem_seq++;
+    __set_PRIMASK(primask);
+
+    // The handlers share a priority, so only the loop can be cut into
+    uint8_t* frame = _telem_frame[__get_IPSR() != 0];
+    size_t n = telemEncode(frame, type, deviceNumber, seq, payload, len);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    // The wait is cut to what fills the bucket before it is multiplied, so
+    // a long quiet spell cannot wrap the credit
+    unsigned long now = millis();
+    const uint32_t bucket = TELEM_RING_SIZE * 1000UL;
+    uint32_t elapsed = min((uint32_t)(now - _telem_refill), bucket / _telem_rate);
+    _telem_credit = min(_telem_credit + elapsed * _telem_rate, bucket);
+    _telem_refill = now;
+
+    uint16_t used = (_telem_head - _telem_tail + TELEM_RING_SIZE) % TELEM_RING_SIZE;
+    if (n == 0 || n >= (size_t)(TELEM_RING_SIZE - used) || (limited && n * 1000UL > _telem_credit)) {
+        _telem_dropped++;
+    }
+    else {
+        if (limited) _telem_credit -= n * 1000UL;
+        uint16_t head = _telem_head;
+        for (size_t i = 0; i < n; i++) {
+            _telem_ring[head] = frame[i];
+            head = (head + 1) % TELEM_RING_SIZE;
+        }
+        _telem_head = head;
+    }
+    __set_PRIMASK(primask);
 }
 
-void FED4::runFRMenu() {
-    ignorePokes = true;
+void FED4::send_hello() {
+    _last_telem_hello = millis();
 
-    Menu frMenu = Menu();
+    uint8_t payload[sizeof(TelemHello) + ROW_MAX_LEN];
+    TelemHello hello = {};
+    hello.session = traceRing.bootUnix;
+    hello.version = TELEM_VERSION;
+    hello.sensorCount = sensorCount;
+    memcpy(payload, &hello, sizeof(hello));
+
+    char* header = (char*)payload + sizeof(hello);
+    log_columns(header);
+    size_t len = strlen(header) - 1;    // no '\n'
+    send_telemetry(TelemType::HELLO, payload, min(sizeof(hello) + len, TELEM_MAX_PAYLOAD));
+}
+
+void FED4::send_counters() {
+    _last_telem_counters = millis();
+
+    TelemCounters c = {};
+    c.millis = millis();
+    c.unixTime = getDateTime().unixtime();
+    c.eventSeq = _event_seq;
+    c.dropped = _telem_dropped;
+    c.pellets = pelletsDispensed;
+    c.batteryMv = getBatteryMillivolts();
+    c.sensorCount = min(sensorCount, TELEM_MAX_SENSORS);
+    for (uint8_t i = 0; i < c.sensorCount; i++) {
+        c.counts[i] = sensors[i].count;
+    }
+    c.jammed = _jam_error;
+    send_telemetry(TelemType::COUNTERS, &c, sizeof(c));
+}
+
+// At most one write per call, no larger than the port can take without
+// waiting, and nothing while no host has the port open
+void FED4::service_telemetry() {
+    uint16_t head = _telem_head;
+    uint16_t tail = _telem_tail;
+    if (head == tail || !Serial) return;
+
+    int room = Serial.availableForWrite();
+    if (room <= 0) return;
+    size_t n = head > tail ? head - tail : TELEM_RING_SIZE - tail;
+    n = min(n, (size_t)room);
+    Serial.write(&_telem_ring[tail], n);
+    _telem_tail = (tail + n) % TELEM_RING_SIZE;
+}
+
+// Requests are short, so they are collected a byte at a time as they come
+void FED4::service_requests() {
+    while (Serial.available() > 0) {
+        int c = Serial.read();
+        if (c < 0) break;
+        if (c != 0) {
+            if (_telem_rx_len < TELEM_RX_SIZE) _telem_rx[_telem_rx_len++] = c;
+            else _telem_rx_skip = true;
+            continue;
+        }
+
+        TelemFrame frame;
+        if (!_telem_rx_skip && _telem_rx_len > 0 && telemDecode(_telem_rx, _telem_rx_len, frame)) {
+            if (frame.device == TELEM_ANY_DEVICE || frame.device == deviceNumber) {
+                handle_request(frame);
+            }
+        }
+        _telem_rx_len = 0;
+        _telem_rx_skip = false;
+    }
+}
+
+void FED4::handle_request(const TelemFrame &frame) {
+    switch (frame.type) {
+    case TelemType::FETCH: {
+        if (frame.len < sizeof(TelemFetch)) break;
+        TelemFetch fetch;
+        memcpy(&fetch, frame.payload, sizeof(fetch));
+        char name[TELEM_MAX_NAME + 1];
+        size_t nameLen = min(frame.len - sizeof(fetch), (size_t)TELEM_MAX_NAME);
+        memcpy(name, frame.payload + sizeof(fetch), nameLen);
+        name[nameLen] = '\0';
+        start_download(fetch, name);
+        break;
+    }
+    case TelemType::COMMAND: {
+        char line[TELEM_RX_SIZE + 1];
+        size_t len = min(frame.len, (size_t)TELEM_RX_SIZE);
+        memcpy(line, frame.payload, len);
+        line[len] = '\0';
+        run_command(line, frame.seq);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// The settings the menus edit, except the mode, which sets the log columns
+void FED4::init_shell() {
+    _shell.count = 0;
+    shellAdd(_shell, "animal", &animal, 0, 99);
+    shellAdd(_shell, "ratio", &ratio, 1, 10);
+    shellAdd(_shell, "viAvg", &viAvg, 1, 120);
+    shellAdd(_shell, "viSpread", &viSpread, 0.0, 1.0);
+    shellAdd(_shell, "chance", &chance, 0.0, 1.0);
+    shellAdd(_shell, "window", &feedWindow);
+    shellAdd(_shell, "windowStart", &windowStart, 0, 23);
+    shellAdd(_shell, "windowEnd", &windowEnd, 0, 23);
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        char key[sizeof(Sensor::name)];
+        sensor_key(i, key);
+        char name[SHELL_NAME_LEN];
+        snprintf(name, sizeof(name), "reward.%s", key);
+        shellAdd(_shell, name, &sensors[i].reward, 0, 255);
+    }
+}
+
+// Sets a shell setting and logs the change as a Param row. out gets
+// "name=value", or why the value was refused.
+bool FED4::setParam(const char* name, const char* value, char* out, size_t len, bool log) {
+    ShellVar* var = shellFind(_shell, name);
+    if (var == nullptr) {
+        snprintf(out, len, "no setting %s", name);
+        return false;
+    }
+    EventData data = {};
+    data.param.name = var->name;
+    shellFormat(*var, data.param.was, sizeof(data.param.was));
+    if (!shellSet(*var, value, out, len)) return false;
+
+    shellFormat(*var, data.param.now, sizeof(data.param.now));
+    snprintf(out, len, "%s=%s", var->name, data.param.now);
+    if (!log) return true;
+
+    Event event = {
+        .time = getDateTime(),
+        .code = EventCode::PARAM,
+        .data = data
+    };
+    logEvent(event);
+    return true;
+}
+
+// One line in, one reply frame out. Changes are logged like any event.
+void FED4::run_command(char* line, uint16_t seq) {
+    char (&reply)[TELEM_MAX_PAYLOAD] = _telem_reply;
+    reply[0] = seq;
+    reply[1] = seq >> 8;
+    char* text = reply + 2;
+    size_t size = sizeof(reply) - 2;
+    int len = 0;
+    auto add = [&](const char* fmt, auto... args) {
+        if (len < (int)size) len += snprintf(text + len, size - len, fmt, args...);
+    };
+
+    char* argv[SHELL_MAX_ARGS];
+    uint8_t argc = shellSplit(line, argv);
+    const char* cmd = argc > 0 ? argv[0] : "";
+
+    if (strcmp(cmd, "get") == 0) {
+        for (uint8_t i = 0; i < _shell.count; i++) {
+            ShellVar &var = _shell.vars[i];
+            if (argc > 1 && strcasecmp(var.name, argv[1]) != 0) continue;
+            char value[16];
+            shellFormat(var, value, sizeof(value));
+            add("%s=%s\n", var.name, value);
+        }
+        if (len == 0) add("no setting %s\n", argv[1]);
+    }
+    else if (strcmp(cmd, "set") == 0 && argc == 3) {
+        setParam(argv[1], argv[2], text, size);
+        len = strlen(text);
+        add("\n");
+    }
+    else if (strcmp(cmd, "counters") == 0) {
+        for (uint8_t i = 0; i < sensorCount; i++) {
+            add("%s=%u\n", sensors[i].message, sensors[i].count);
+        }
+        add("pellets=%u\njammed=%d\nseq=%lu\nblocks=%lu\n",
+            pelletsDispensed, _jam_error ? 1 : 0,
+            (unsigned long)_event_seq, (unsigned long)_block_seq);
+        add("telemetry dropped=%lu\nsync overruns=%lu\n",
+            (unsigned long)_telem_dropped, (unsigned long)syncOverruns());
+    }
+    else if (strcmp(cmd, "mem") == 0) {
+        sampleMemory(false);
+        add("stack=%lu\nfree=%lu\nblock=%lu\nfrags=%u\nstatic=%lu\n",
+            (unsigned long)memStats.stackUsed, (unsigned long)memStats.heapFree,
+            (unsigned long)memStats.largestFree, memStats.freeBlocks,
+            (unsigned long)memStats.staticRam);
+        RamUser users[RAM_USERS_MAX];
+        uint8_t count = ramUsers(users);
+        for (uint8_t i = 0; i < count; i++) {
+            add("static.%s=%lu\n", users[i].name, (unsigned long)users[i].bytes);
+        }
+    }
+    else if (strcmp(cmd, "latency") == 0) {
+        add("sd ops=%lu stalls=%lu worst=%luus (%s)%s\n",
+            (unsigned long)sdStats.ops, (unsigned long)sdStats.stalls,
+            (unsigned long)sdStats.worstUs, SdOp::NAMES[sdStats.worstOp],
+            sdStats.degraded ? " degraded" : "");
+        add("sd p50<%luus p95<%luus p99<%luus\n",
+            (unsigned long)sdPercentile(sdStats.total, 50),
+            (unsigned long)sdPercentile(sdStats.total, 95),
+            (unsigned long)sdPercentile(sdStats.total, 99));
+        const FlushStats &flush = flushPolicy.stats;
+        add("flush n=%lu max=%ums avg=%lums\n",
+            (unsigned long)flush.flushes, flush.maxBusyMs,
+            (unsigned long)(flush.flushes ? flush.busyMs / flush.flushes : 0));
+        add("dispense p50=%lums max=%lums\nipi p50=%lums p90=%lums\n",
+            (unsigned long)p2Value(summary.dispense50), (unsigned long)summary.dispenseMaxMs,
+            (unsigned long)p2Value(summary.ipi50), (unsigned long)p2Value(summary.ipi90));
+    }
+    else if (strcmp(cmd, "flush") == 0) {
+        flush_to_sd();
+        add("flushed, block %lu\n", (unsigned long)_block_seq);
+    }
+    else if (strcmp(cmd, "checkpoint") == 0) {
+        flush_to_sd();
+        saveConfig();
+        add("flushed, block %lu, settings saved\n", (unsigned long)_block_seq);
+    }
+    else {
+        add("get [name] | set name value | counters | mem | latency | flush | checkpoint\n");
+    }
+
+    send_telemetry(TelemType::REPLY, reply, 2 + min(len, (int)size - 1), false);
+}
+
+// Replaces any download in progress. Log segments are preallocated, so
+// .csv files end where their rows do, and the open one at the last flush.
+void FED4::start_download(const TelemFetch &fetch, const char* name) {
+    if (_dl_file.isOpen()) _dl_file.close();
+
+    char current[TELEM_MAX_NAME + 1] = "";
+    logFile.getName(current, sizeof(current));
+    _dl_live = name[0] == '\0' || strcmp(name, current) == 0;
+
+    pause_interrupts();
+    digitalWrite(FED4Pins::CARD_SEL, LOW);
+    digitalWrite(FED4Pins::SHRP_CS, HIGH);
+    if (!_dl_file.open(_dl_live ? current : name, O_RDONLY)) {
+        start_interrupts();
+        TelemChunk chunk = {};
+        chunk.offset = fetch.offset;
+        chunk.flags = TelemChunkFlag::MISSING | TelemChunkFlag::LAST;
+        send_telemetry(TelemType::CHUNK, &chunk, sizeof(chunk), false);
+        return;
+    }
+
+    uint32_t end = _dl_file.fileSize();
+    if (_dl_live) {
+        end = log_position();
+    }
+    else if (strstr(name, ".csv") != nullptr) {
+        end = log_data_end(_dl_file);
+    }
+    if (fetch.length > 0 && fetch.length < end - min(fetch.offset, end)) {
+        end = fetch.offset + fetch.length;
+    }
+    _dl_pos = min(fetch.offset, end);
+    _dl_end = end;
+    start_interrupts();
+}
+
+// One chunk per call, only once the ring is empty and no poke is waiting to
+// be handled. Chunks skip the rate limit: they only use what the port has
+// left once the telemetry has gone.
+void FED4::send_chunk() {
+    if (!Serial) {
+        _dl_file.close();
+        return;
+    }
+    if (_telem_head != _telem_tail) return;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (sensors[i].poked) return;
+    }
+
+    uint8_t raw[DOWNLOAD_CHUNK];
+    uint8_t payload[sizeof(TelemChunk) + DOWNLOAD_CHUNK];
+    uint16_t len = min((uint32_t)DOWNLOAD_CHUNK, _dl_end - _dl_pos);
+
+    // Masked like a flush, so no row is written mid-read. A raw segment is
+    // written past SdFat, whose cache may still hold an old copy of the
+    // sector the rows went to.
+    pause_interrupts();
+    digitalWrite(FED4Pins::CARD_SEL, LOW);
+    digitalWrite(FED4Pins::SHRP_CS, HIGH);
+    int got = -1;
+    if (!(_dl_live && _raw_log) || sd.cacheClear() != nullptr) {
+        _dl_file.seekSet(_dl_pos);
+        got = len > 0 ? _dl_file.read(raw, len) : 0;
+    }
+    start_interrupts();
+    if (got < 0) {
+        _dl_file.close();
+        return;
+    }
+
+    TelemChunk chunk = {};
+    chunk.offset = _dl_pos;
+    chunk.end = _dl_end;
+    chunk.crc = crc32Update(0, raw, got);
+    chunk.len = got;
+
+    uint8_t* data = payload + sizeof(chunk);
+    size_t dataLen = got > 1 ? lzssCompress(raw, got, data, got - 1) : 0;
+    if (dataLen > 0) {
+        chunk.flags |= TelemChunkFlag::LZSS;
+    }
+    else {
+        memcpy(data, raw, got);
+        dataLen = got;
+    }
+    _dl_pos += got;
+    if (_dl_pos >= _dl_end || got < len) {
+        chunk.flags |= TelemChunkFlag::LAST;
+        _dl_file.close();
+    }
+    memcpy(payload, &chunk, sizeof(chunk));
+    send_telemetry(TelemType::CHUNK, payload, sizeof(chunk) + dataLen, false);
+}
+
+// Reads the conversion started on an earlier call, and starts the next one
+// on the period boundary, so readings line up with the RTC wake-ups
+void FED4::sample_env() {
+    _last_env_check = millis();
+    if (!env.present || _env_period == 0) return;
+
+    uint32_t nowUnix = rtcZero.getEpoch();
+    if (envPoll(env, millis(), nowUnix) && env.batch.count >= _env_batch) {
+        const EnvBatch &batch = env.batch;
+        Event event = {
+            .time = getDateTime(),
+            .code = EventCode::ENV,
+            .data = {}
+        };
+        event.data.env.count = batch.count;
+        event.data.env.tempSum = batch.tempSum;
+        event.data.env.tempMin = batch.tempMin;
+        event.data.env.tempMax = batch.tempMax;
+        event.data.env.rhSum = batch.rhSum;
+        envClearBatch(env);
+        logEvent(event);
+    }
+
+    if (!env.measuring && nowUnix / _env_period != _last_env_unix / _env_period) {
+        _last_env_unix = nowUnix;
+        envStart(env, millis(), nowUnix);
+    }
+}
+
+// Brings the window time up to date and closes the row on the hour and
+// when the feeding window opens or closes
+void FED4::update_summary() {
+    _last_summary_check = millis();
+
+    uint32_t nowUnix = getDateTime().unixtime();
+    bool open = checkFeedingWindow();
+    bool edge = open != summary.windowOpen;
+    bool hour = nowUnix / SUMMARY_PERIOD != summary.startUnix / SUMMARY_PERIOD;
+    summaryWindow(summary, open, nowUnix);
+
+    if ((edge || hour) && nowUnix > summary.startUnix) {
+        // Pokes update the row from the sensor interrupt
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        Summary row = summary;
+        summaryReset(summary, nowUnix);
+        __set_PRIMASK(primask);
+
+        save_summary(row, nowUnix);
+    }
+}
+
+void FED4::save_summary(const Summary &row, uint32_t endUnix) {
+    auto dateTime = [](uint32_t unixT, char* out, size_t len) {
+        DateTime t(unixT);
+        snprintf(
+            out, len, "%d/%d/%d %d:%d:%d",
+            t.day(), t.month(), t.year() % 1000, t.hour(), t.minute(), t.second()
+        );
+    };
+
+    uint32_t totalPokes = 0;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        totalPokes += row.pokes[i];
+    }
+
+    const char* modeName = mode == Mode::FR ? "FR"
+        : mode == Mode::VI ? "VI"
+        : mode == Mode::CHANCE ? "CHANCE"
+        : "OTHER";
+
+    char line[300];
+    char start[24], end[24];
+    dateTime(row.startUnix, start, sizeof(start));
+    dateTime(endUnix, end, sizeof(end));
+    int len = snprintf(
+        line, sizeof(line), "%s,%s,%d,%d,%s,%lu,",
+        start, end, deviceNumber % 100, animal, modeName,
+        (unsigned long)row.windowS
+    );
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%lu,", (unsigned long)row.pokes[i]);
+    }
+    // Preference, percent of all pokes
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        len += snprintf(
+            line + len, sizeof(line) - len, "%lu,",
+            totalPokes ? (unsigned long)(row.pokes[i] * 100 / totalPokes) : 0UL
+        );
+    }
+    snprintf(
+        line + len, sizeof(line) - len, "%lu,%lu,%lu,%lu,%lu,%lu\n",
+        (unsigned long)row.pellets, (unsigned long)row.jams,
+        (unsigned long)p2Value(row.ipi50), (unsigned long)p2Value(row.ipi90),
+        (unsigned long)p2Value(row.dispense50), (unsigned long)row.dispenseMaxMs
+    );
+
+    char fileName[16];
+    snprintf(fileName, sizeof(fileName), "SUM%02u.csv", deviceNumber % 100);
+
+    pause_interrupts();
+    digitalWrite(FED4Pins::CARD_SEL, LOW);
+    digitalWrite(FED4Pins::SHRP_CS, HIGH);
+
+    File sumFile = sd.open(fileName, FILE_WRITE);
+    if (sumFile.fileSize() == 0) {
+        char header[300] = "Start,End,Device Number,Animal,Mode,Window s,";
+        for (uint8_t i = 0; i < sensorCount; i++) {
+            strcat(header, sensors[i].name);
+            strcat(header, " ");
+            strcat(header, sensors[i].action);
+            strcat(header, "s,");
+        }
+        for (uint8_t i = 0; i < sensorCount; i++) {
+            strcat(header, sensors[i].name);
+            strcat(header, " %,");
+        }
+        strcat(header, "Pellets,Jams,IPI p50 ms,IPI p90 ms,Dispense p50 ms,Dispense max ms\n");
+        sumFile.write(header, strlen(header));
+    }
+    sumFile.write(line, strlen(line));
+    sumFile.close();
+
+    start_interrupts();
+}
+
+void FED4::saveCardHealth() {
+    _last_card_report = millis();
+
+    uint32_t p95 = sdPercentile(sdStats.rolling, 95);
+    if (sdStats.degraded && !_card_degraded_logged) {
+        _card_degraded_logged = true;
+
+        Event event = {
+            .time = getDateTime(),
+            .code = EventCode::SD_SLOW,
+            .data = {}
+        };
+        event.data.sd.p95Us = p95;
+        event.data.sd.worstUs = sdStats.worstUs;
+        logEvent(event);
+    }
+
+    pause_interrupts();
+    digitalWrite(FED4Pins::CARD_SEL, LOW);
+    digitalWrite(FED4Pins::SHRP_CS, HIGH);
+
+    sd.remove("CARD.json");
+    File cardFile = sd.open("CARD.json", FILE_WRITE);
+
+    // Also runs from alarm_handler(), so nothing here may allocate
+    JsonOut card(cardFile);
+    card.beginObject();
+    card.key("boot").value(traceRing.bootUnix);
+    card.key("uptime s").value(millis() / 1000);
+    card.key("sectors").value(sd.card()->sectorCount());
+    card.key("degraded").value(sdStats.degraded);
+    card.key("ops").value(sdStats.ops);
+    card.key("stalls").value(sdStats.stalls);
+    card.key("worst us").value(sdStats.worstUs);
+    card.key("worst op").value(SdOp::NAMES[sdStats.worstOp]);
+    card.key("worst at s").value(sdStats.worstT / 1000);
+    card.key("p50 us").value(sdPercentile(sdStats.total, 50));
+    card.key("p95 us").value(sdPercentile(sdStats.total, 95));
+    card.key("p99 us").value(sdPercentile(sdStats.total, 99));
+    card.key("recent p95 us").value(p95);
+    card.key("bucket us").value(SD_BUCKET_US);
+    card.key("histogram").beginArray();
+    for (uint8_t i = 0; i < SD_BUCKETS; i++) {
+        card.value(sdStats.total[i]);
+    }
+    card.end();
+    card.key("recent").beginArray();
+    for (uint8_t i = 0; i < SD_BUCKETS; i++) {
+        card.value(sdStats.rolling[i]);
+    }
+    card.end();
+    card.end();
+
+    cardFile.close();
+
+    start_interrupts();
+}
+
+// Writes the same rows through SdFat, with a sync per flush, and through
+// RawLog into a scratch segment, and saves throughput and flush latency
+// to BENCH.json
+void FED4::benchmarkLog(uint16_t flushes) {
+    const char* benchName = "BENCH.BIN";
+
+    char rows[FILE_RAM_BUFF_SIZE];
+    const char* row = "1/1/25 9:0:0,1,1,FR,0,24,1,Left Poke,Both,1,1,100,20,20,3899,1\n";
+    for (size_t i = 0; i < sizeof(rows); i++) {
+        rows[i] = row[i % strlen(row)];
+    }
+
+    JsonDocument bench;
+    bench["flushes"] = flushes;
+    bench["bytes"] = sizeof(rows);
+
+    for (uint8_t raw = 0; raw < 2; raw++) {
+        uint32_t size = (uint32_t)flushes * sizeof(rows) + RAW_BLOCK;
+        sd.remove(benchName);
+        if (!create_segment(benchName, size)) break;
+
+        File file;
+        file.open(benchName, O_RDWR);
+        RawLog rawLog;
+        uint32_t firstSector, lastSector;
+        if (raw && (
+            !file.contiguousRange(&firstSector, &lastSector)
+            || !rawOpen(rawLog, sd.card(), firstSector, size / RAW_BLOCK, 0)
+        )) {
+            file.close();
+            break;
+        }
+
+        SdStats stats = {};
+        uint32_t benchStart = micros();
+        for (uint16_t i = 0; i < flushes; i++) {
+            uint32_t opStart = micros();
+            if (raw) {
+                rawWrite(rawLog, sd.card(), rows, sizeof(rows));
+            }
+            else {
+                file.write(rows, sizeof(rows));
+                file.sync();
+            }
+            sdRecord(stats, SdOp::WRITE, micros() - opStart, millis());
+            watch_dog.clear();
+        }
+        uint32_t elapsed = micros() - benchStart;
+        file.close();
+
+        JsonVariant result = bench[raw ? "raw" : "fat"];
+        result["kB/s"] = (float)flushes * sizeof(rows) * 1000000.0f / 1024.0f / max(elapsed, (uint32_t)1);
+        result["worst us"] = stats.worstUs;
+        result["p50 us"] = sdPercentile(stats.total, 50);
+        result["p95 us"] = sdPercentile(stats.total, 95);
+        result["p99 us"] = sdPercentile(stats.total, 99);
+        result["stalls"] = stats.stalls;
+    }
+    sd.remove(benchName);
+
+    sd.remove("BENCH.json");
+    File benchFile = sd.open("BENCH.json", FILE_WRITE);
+    serializeJson(bench, benchFile);
+    benchFile.close();
+}
+
+void FED4::makeNoise(int duration) {
+    uint8_t notes = constrain(duration / 50, 1, (int)SOUND_MAX_NOTES);
+
+    soundStop();
+    for (uint8_t i = 0; i < notes; i++) {
+        _noise[i] = {(uint16_t)random(50, 250), (uint16_t)(duration / notes), 100, 100};
+    }
+    soundPlay(_noise, notes);
+}
+
+void FED4::playSound(uint8_t cue) {
+    if (cue >= SoundCue::COUNT || _sound_len[cue] == 0) return;
+    soundPlay(_sounds[cue], _sound_len[cue]);
+}
+
+void FED4::runConfigMenu() {
+    ignorePokes = true;
+
+    Menu configMenu = Menu();
+
+    configMenu.add("Time", new ClockMenu());
+    configMenu.add("Animal", &animal, 0, 99, 1);
+
+    const char* modes[] = {"FR", "VI", "%"};
+    configMenu.add("Mode", &mode, modes, 3);
+
+    // One entry per sensor, then all of them, then a mixed set from the
+    // config file if there is one
+    uint8_t allSensors = (1 << sensorCount) - 1;
+    char sensorLabels[MAX_SENSORS + 2][2 * MAX_SENSORS];
+    const char* sensorList[MAX_SENSORS + 2];
+    uint8_t sensorListLen = 0;
+    uint8_t sensorIdx = sensorCount;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        snprintf(sensorLabels[i], sizeof(sensorLabels[i]), "%.1s", sensors[i].name);
+        sensorList[sensorListLen++] = sensorLabels[i];
+        if (activeSensor == (1 << i)) sensorIdx = i;
+    }
+    sensor_mask_str(allSensors, sensorLabels[sensorCount], sizeof(sensorLabels[0]));
+    sensorList[sensorListLen++] = sensorLabels[sensorCount];
+    if (sensorIdx == sensorCount && activeSensor != allSensors) {
+        sensor_mask_str(activeSensor, sensorLabels[sensorCount + 1], sizeof(sensorLabels[0]));
+        sensorList[sensorListLen++] = sensorLabels[sensorCount + 1];
+        sensorIdx = sensorCount + 1;
+    }
+    configMenu.add("Sensor", &sensorIdx, sensorList, sensorListLen);
+
+    char rewardLabels[MAX_SENSORS][8];
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        snprintf(rewardLabels[i], sizeof(rewardLabels[i]), "%.1s Rew", sensors[i].name);
+        configMenu.add(rewardLabels[i], &sensors[i].reward, 0, 255, 1);
+    }
+
+    configMenu.add("Rew Win", &feedWindow);
+    configMenu.add("Rew Beg", &windowStart, 0, 23, 1);
+    configMenu.add("Rew End", &windowEnd, 0, 23, 1);
+
+    sampleMemory(false);
+    char stackStr[12], freeStr[12], blockStr[12], fragsStr[12], staticStr[12];
+    snprintf(stackStr, sizeof(stackStr), "%lu", (unsigned long)memStats.stackUsed);
+    snprintf(freeStr, sizeof(freeStr), "%lu", (unsigned long)memStats.heapFree);
+    snprintf(blockStr, sizeof(blockStr), "%lu", (unsigned long)memStats.largestFree);
+    snprintf(fragsStr, sizeof(fragsStr), "%u", memStats.freeBlocks);
+    snprintf(staticStr, sizeof(staticStr), "%lu", (unsigned long)memStats.staticRam);
+    RamUser users[RAM_USERS_MAX];
+    uint8_t userCount = ramUsers(users);
+    char userStr[RAM_USERS_MAX][12];
+    for (uint8_t i = 0; i < userCount; i++) {
+        snprintf(userStr[i], sizeof(userStr[i]), "%lu", (unsigned long)users[i].bytes);
+    }
+
+    Menu* diagMenu = new Menu();
+    diagMenu->add("Stack", stackStr);
+    diagMenu->add("Free", freeStr);
+    diagMenu->add("Block", blockStr);
+    diagMenu->add("Frags", fragsStr);
+    diagMenu->add("Static", staticStr);
+    for (uint8_t i = 0; i < userCount; i++) {
+        diagMenu->add(users[i].name, userStr[i]);
+    }
+    configMenu.add("Diag", diagMenu);
+    
+    int batteryLevel = getBatteryPercentage();
+    configMenu.run(batteryLevel); 
+
+    if (sensorIdx < sensorCount) {
+        activeSensor = 1 << sensorIdx;
+    }
+    else if (sensorIdx == sensorCount) {
+        activeSensor = allSensors;
+    }
+
+    ignorePokes = false;
+}
+
+void FED4::runFRMenu() {
+    ignorePokes = true;
+
+    Menu frMenu = Menu();
     frMenu.add("Ratio", &ratio, 1, 10, 1);
     frMenu.run();
     
@@ -834,34 +2187,17 @@ bool FED4::checkCondition() {
 }
 
 bool FED4::checkFRCondition() {
-    bool conditionMet = false;
-    switch (activeSensor) {
-    case ActiveSensor::BOTH:
-        if ( (leftPokeCount + rightPokeCount) % ratio == 0 ) {
-            if (getLeftPoke()) {
-                _reward = leftReward;
-                conditionMet = true;
-            }
-            if (getRightPoke()) {
-                _reward = rightReward;
-                conditionMet = true;
-            }
-        }
-        break;
-
-    case ActiveSensor::LEFT:
-        if (getLeftPoke() && leftPokeCount % ratio == 0) {
-            _reward = leftReward;
-            conditionMet = true;
-        }
-        break;
+    uint16_t activePokes = 0;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (isActive(i)) activePokes += sensors[i].count;
+    }
 
-    case ActiveSensor::RIGHT:
-        if(getRightPoke() && rightPokeCount %ratio == 0) {
-            _reward = rightReward;
+    bool conditionMet = false;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (isActive(i) && getPoke(i) && activePokes % ratio == 0) {
+            _reward = sensors[i].reward;
             conditionMet = true;
         }
-        break;
     }
     
     return conditionMet;
@@ -879,43 +2215,22 @@ bool FED4::checkVICondition() {
         }
     }
     else {
-        bool pokedLeft = getLeftPoke();
-        bool pokedRight = getRightPoke();
-
-        bool conditionMet = false;
-        switch (activeSensor) {
-        case ActiveSensor::BOTH:
-            if (pokedLeft || pokedRight) {
-                conditionMet = true;
-            }
-            break;
-        
-        case ActiveSensor::LEFT:
-            if (pokedLeft) {
-                conditionMet = true;
-            }
-            break;
-
-        case ActiveSensor::RIGHT:
-            if (pokedRight) {
-                conditionMet = true;
+        int8_t poked = -1;
+        for (uint8_t i = 0; i < sensorCount; i++) {
+            if (getPoke(i) && isActive(i) && poked < 0) {
+                poked = i;
             }
         }
 
-        if (conditionMet) {
+        if (poked >= 0) {
             viCountDown = getViCountDown();
             viSet = true;
-
-            if (pokedLeft) {
-                _reward = leftReward;
-            }
-            else if (pokedRight) {
-                _reward = rightReward;
-            }
+            _reward = sensors[poked].reward;
 
             Event e = Event {
                 .time = getDateTime(),
-                .message = EventMsg::SET_VI
+                .code = EventCode::SET_VI,
+                .data = {}
             };
             logEvent(e);
 
@@ -926,23 +2241,17 @@ bool FED4::checkVICondition() {
     return false;
 }
 
+// Draws only for a poke, so the draws follow the logged pokes
 bool FED4::checkChanceCondition() {
-    int r = random(0, 100);
-    if (
-        getLeftPoke()
-        && ( activeSensor == ActiveSensor::LEFT || activeSensor == ActiveSensor::BOTH )
-        && r <= int(chance * 100)
-    ) {
-        _reward = leftReward;
-        return true;
-    }
-    else if (
-        getRightPoke() 
-        && ( activeSensor == ActiveSensor::RIGHT || activeSensor == ActiveSensor::BOTH ) 
-        && r <= int(chance * 100)
-    ) {
-        _reward = rightReward;
-        return true;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (
+            getPoke(i)
+            && isActive(i)
+            && schedule_random(0, 100) <= int(chance * 100)
+        ) {
+            _reward = sensors[i].reward;
+            return true;
+        }
     }
 
     return false;
@@ -975,143 +2284,81 @@ bool FED4::checkFeedingWindow() {
 }
 
 
+// Only updates the wanted colours; cueService composes them when they
+// change and run() sends them
 void FED4::setLightCue() {
-    pause_interrupts();
-    if (checkFeedingWindow()) {
-        digitalWrite(FED4Pins::MTR_EN, HIGH);
-        __delay(2);
-
-        switch (activeSensor) {
-        case ActiveSensor::BOTH:
-            strip.setPixelColor(8, 5, 2, 0, 0);
-            break;
-        
-        case ActiveSensor::LEFT:
-            strip.setPixelColor(9, 5, 2, 0, 0);
-            break;
+    bool open = checkFeedingWindow();
+    if (!open && _cue_window_open) {
+        cuePlay(WINDOW_CLOSE_CUE, sizeof(WINDOW_CLOSE_CUE) / sizeof(WINDOW_CLOSE_CUE[0]));
+        playSound(SoundCue::WINDOW_CLOSE);
+    }
+    else if (open && !_cue_window_open) {
+        playSound(SoundCue::WINDOW_OPEN);
+    }
+    _cue_window_open = open;
 
-        case ActiveSensor::RIGHT:
-            strip.setPixelColor(8, 5, 2, 0, 0);
-            break;
+    uint32_t colors[CUE_PIXELS] = {0};
+    for (uint8_t i = 0; open && i < sensorCount; i++) {
+        if (isActive(i) && sensors[i].pixel < CUE_PIXELS) {
+            colors[sensors[i].pixel] = Adafruit_NeoPixel::Color(5, 2, 0, 0);
         }
-
-        strip.setPixelColor(0, 0, 0, 0, 0);
-
-        strip.show();
-    } else {
-        digitalWrite(FED4Pins::MTR_EN, HIGH);
-        __delay(2);
-        strip.clear();
-        strip.show();
-        digitalWrite(FED4Pins::MTR_EN, LOW);
     }
 
-    start_interrupts();
+    for (uint8_t p = 0; p < CUE_PIXELS; p++) {
+        cueSet(p, colors[p]);
+    }
 }
 
 int FED4::getViCountDown() {
     int offset = (float)viAvg * viSpread;
     int lowerBound = viAvg - offset;
     int upperBound = viAvg + offset;
-    return random(lowerBound, upperBound);
+    return schedule_random(lowerBound, upperBound);
 }
 
+// xorshift32 from the boot seed. The schedule has its own generator so
+// the sound's draws do not move it.
+long FED4::schedule_random(long min, long max) {
+    if (min >= max) return min;
+    _rng_state ^= _rng_state << 13;
+    _rng_state ^= _rng_state >> 17;
+    _rng_state ^= _rng_state << 5;
+    return min + (long)(_rng_state % (uint32_t)(max - min));
+}
+
+// A session's draws follow from this row, see tools/replay
+void FED4::log_seed() {
+    Event event = {
+        .time = getDateTime(),
+        .code = EventCode::SEED,
+        .data = {}
+    };
+    event.data.seed = _seed;
+    logEvent(event);
+}
+
+// Cell voltage (mV) at which each 5% step from 5% to 100% is reached
+static const uint16_t BATTERY_MV[] = {
+    3610, 3690, 3710, 3730, 3750, 3770, 3790, 3800, 3820, 3840,
+    3850, 3870, 3910, 3950, 3980, 4020, 4080, 4110, 4150, 4200
+};
+constexpr uint8_t BATTERY_STEPS = sizeof(BATTERY_MV) / sizeof(BATTERY_MV[0]);
+
 int FED4::getBatteryPercentage() {
-    pause_interrupts();
-    float batteryVoltage = analogRead(FED4Pins::VBAT);
-    start_interrupts();
+    uint16_t mv = getBatteryMillivolts();
+    if (mv < BATTERY_MV[0]) return 0;
+    if (mv >= BATTERY_MV[BATTERY_STEPS - 1]) return 100;
 
-    batteryVoltage *= 2;
-    batteryVoltage *= 3.3;
-    batteryVoltage /= 1024;
+    uint8_t i = 0;
+    while (mv >= BATTERY_MV[i + 1]) i++;
+    return 5 * (i + 1) + 5 * (mv - BATTERY_MV[i]) / (BATTERY_MV[i + 1] - BATTERY_MV[i]);
+}
 
-    int batteryPercentage = 0;
-    if (batteryVoltage >= 4.2)
-    {
-        batteryPercentage = 100;
-    }
-    else if (batteryVoltage >= 4.15)
-    {
-        batteryPercentage = 95;
-    }
-    else if (batteryVoltage >= 4.11)
-    {
-        batteryPercentage = 90;
-    }
-    else if (batteryVoltage >= 4.08)
-    {
-        batteryPercentage = 85;
-    }
-    else if (batteryVoltage >= 4.02)
-    {
-        batteryPercentage = 80;
-    }
-    else if (batteryVoltage >= 3.98)
-    {
-        batteryPercentage = 75;
-    }
-    else if (batteryVoltage >= 3.95)
-    {
-        batteryPercentage = 70;
-    }
-    else if (batteryVoltage >= 3.91)
-    {
-        batteryPercentage = 65;
-    }
-    else if (batteryVoltage >= 3.87)
-    {
-        batteryPercentage = 60;
-    }
-    else if (batteryVoltage >= 3.85)
-    {
-        batteryPercentage = 55;
-    }
-    else if (batteryVoltage >= 3.84)
-    {
-        batteryPercentage = 50;
-    }
-    else if (batteryVoltage >= 3.82)
-    {
-        batteryPercentage = 45;
-    }
-    else if (batteryVoltage >= 3.8)
-    {
-        batteryPercentage = 40;
-    }
-    else if (batteryVoltage >= 3.79)
-    {
-        batteryPercentage = 35;
-    }
-    else if (batteryVoltage >= 3.77)
-    {
-        batteryPercentage = 30;
-    }
-    else if (batteryVoltage >= 3.75)
-    {
-        batteryPercentage = 25;
-    }
-    else if (batteryVoltage >= 3.73)
-    {
-        batteryPercentage = 20;
-    }
-    else if (batteryVoltage >= 3.71)
-    {
-        batteryPercentage = 15;
-    }
-    else if (batteryVoltage >= 3.69)
-    {
-        batteryPercentage = 10;
-    }
-    else if (batteryVoltage >= 3.61)
-    {
-        batteryPercentage = 5;
-    }
-    else
-    {
-        batteryPercentage = 0;
-    }
+uint16_t FED4::getBatteryMillivolts() {
+    if (_battery_channel < 0) return 0;
 
-    return batteryPercentage;
+    // VBAT is halved by a divider before the ADC
+    return (uint32_t)adcRead(_battery_channel) * 2 * 3300 / ADC_FULL_SCALE;
 }
 
 DateTime FED4::getDateTime() {
@@ -1123,122 +2370,314 @@ DateTime FED4::getDateTime() {
     return now;
 }
 
+void FED4::sd_timed(uint8_t op, uint32_t startUs) {
+    sdRecord(sdStats, op, micros() - startUs, millis());
+}
+
+bool FED4::flush_due() {
+    bool lowBattery = _battery_channel >= 0 && getBatteryPercentage() < FLUSH_LOW_BATTERY;
+    return flushDue(flushPolicy, millis(), lowBattery);
+}
+
 void FED4::flush_to_sd() {
     pause_interrupts();
 
-    if (_log_buffer_pos == 0) {
+    // A handler that cuts into prepare_segment() leaves its rows buffered
+    if (_log_buffer_pos == 0 || _card_busy) {
+        start_interrupts();
         return;
     }
 
+    trace(TraceEv::SD_FLUSH, 0, _log_buffer_pos);
+    uint32_t flushStart = micros();
     digitalWrite(FED4Pins::CARD_SEL, LOW);
     digitalWrite(FED4Pins::SHRP_CS, HIGH);
 
-    logFile.write(_log_buffer, _log_buffer_pos);
+    // A handler only rolls a full segment; one that is only due by the
+    // clock is left to run()
+    bool full = log_position() + _log_buffer_pos + LOG_TRAILER_LEN > _segment_size;
+    if ((full || (_roll_due && __get_IPSR() == 0)) && _next_segment_ready) {
+        roll_segment();
+    }
+    uint32_t blockStart = log_position();
+
+    // Seal the rows, see LogBlock.h; write_to_log() leaves room for it
+    uint32_t crc = crc32Update(0, _log_buffer, _log_buffer_pos);
+    _log_buffer_pos += logTrailer(
+        &_log_buffer[_log_buffer_pos], FILE_RAM_BUFF_SIZE - _log_buffer_pos,
+        _block_seq++, _log_buffer_pos, crc
+    );
+
+    size_t bytes = _log_buffer_pos;
+    uint32_t opStart = micros();
+    log_write(_log_buffer, _log_buffer_pos);
     _log_buffer_pos = 0;
+    sd_timed(SdOp::WRITE, opStart);
 
-    logFile.truncate();
-    char logFileName[30];
-    logFile.getName(logFileName, 30);
-    logFile.close();
-    logFile.open(logFileName, FILE_WRITE);
+    // Raw writes are on the card once writeStop() returns
+    if (!_raw_log) {
+        opStart = micros();
+        logFile.sync();
+        sd_timed(SdOp::SYNC, opStart);
+    }
+    index_block(blockStart);
+    flushDone(flushPolicy, bytes, (micros() - flushStart) / 1000);
+    trace(TraceEv::SD_FLUSH_END);
 
     start_interrupts();
 }
 
-void FED4::write_to_log(char row[ROW_MAX_LEN], bool forceFlush) {
+void FED4::write_to_log(char row[ROW_MAX_LEN], uint32_t seq, uint32_t unixTime, bool forceFlush) {
     pause_interrupts();
 
     int rowLen = strlen(row);
-    if(_log_buffer_pos + rowLen >= FILE_RAM_BUFF_SIZE) {
+    if(_log_buffer_pos + rowLen >= FILE_RAM_BUFF_SIZE - LOG_TRAILER_LEN) {
         flush_to_sd();
-        _last_flush = millis();
+    }
+    // Still full: the card is busy, see prepare_segment(). The Seq gap
+    // and run()'s error row mark the loss.
+    if(_log_buffer_pos + rowLen >= FILE_RAM_BUFF_SIZE - LOG_TRAILER_LEN) {
+        _rows_lost++;
+        start_interrupts();
         return;
     }
+    if (_log_buffer_pos == 0) {
+        _buffer_seq = seq;
+        _buffer_unix = unixTime;
+    }
     memcpy(&_log_buffer[_log_buffer_pos], row, rowLen);
     _log_buffer_pos += rowLen;
+    _index_count++;
+    flushAdded(flushPolicy, millis());
 
-    if ( (millis() - _last_flush > 50 * 1000) || forceFlush) {
+    // A handler only writes a full buffer; run() writes the rest, so the
+    // other sensor lines are not held off for a whole card write
+    if (forceFlush || (flush_due() && __get_IPSR() == 0)) {
         flush_to_sd();
     }
 
     start_interrupts();
 }
 
+// Queues an entry for the block just written once enough rows or minutes
+// have passed; run() appends the queue to the sidecar
+void FED4::index_block(uint32_t offset) {
+    if (_index_rows == 0 && _index_period == 0) return;
+
+    bool due = _index_due
+        || (_index_rows > 0 && _index_count >= _index_rows)
+        || (_index_period > 0 && _buffer_unix - _last_index_unix >= _index_period * 60UL);
+    if (!due) return;
+
+    if (_index_pending < INDEX_QUEUE) {
+        _index_queue[_index_pending++] = {offset, _buffer_unix, _buffer_seq};
+    }
+    _index_due = false;
+    _index_count = 0;
+    _last_index_unix = _buffer_unix;
+}
+
+// Callers pause interrupts and select the card
+void FED4::write_index() {
+    char logName[30], indexName[30];
+    logFile.getName(logName, sizeof(logName));
+    logIndexName(logName, indexName, sizeof(indexName));
+
+    File indexFile = sd.open(indexName, FILE_WRITE);
+    if (indexFile) {
+        if (indexFile.fileSize() == 0) {
+            indexFile.write(LOG_INDEX_HEADER, strlen(LOG_INDEX_HEADER));
+        }
+        for (uint8_t i = 0; i < _index_pending; i++) {
+            char line[LOG_INDEX_LEN];
+            int len = logIndexLine(line, sizeof(line), _index_queue[i]);
+            indexFile.write(line, len);
+        }
+        indexFile.close();
+    }
+    _index_pending = 0;
+}
+
+// Pauses nest: the lines only come back with the outermost
+// start_interrupts(), so a getDateTime() or an SdFat date callback inside a
+// card section leaves them masked
 void FED4::start_interrupts() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool outer = _pause_depth <= 1;
+    if (_pause_depth > 0) _pause_depth--;
+    __set_PRIMASK(primask);
+    if (!outer) return;
+
     NVIC_DisableIRQ(EIC_IRQn);
     
-    EIC->INTFLAG.reg = (1 << digitalPinToInterrupt(FED4Pins::LFT_POKE));
-    EIC->INTFLAG.reg = (1 << digitalPinToInterrupt(FED4Pins::RGT_POKE));
-    EIC->INTFLAG.reg = (1 << digitalPinToInterrupt(FED4Pins::WELL));
+    // Flags raised while masked are left set, so an edge from the pause is
+    // handled now rather than lost
+    uint32_t paused = _sensor_eic_mask & ~_sync_eic_mask;
+    EIC->INTENSET.reg = paused;
+    _paused = false;
     rtcZero.attachInterrupt(alarm_ISR);
     __DSB();
     NVIC_EnableIRQ(EIC_IRQn);
 }
 
+// Masks the lines whose handlers write the log. The well and the sensors
+// that send a sync train stay live, so a train starts on its edge even
+// while the card is busy; see sensor_handler().
 void FED4::pause_interrupts() {
-    NVIC_DisableIRQ(EIC_IRQn);
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool outer = _pause_depth++ == 0;
+    __set_PRIMASK(primask);
+    if (!outer) return;
+
+    EIC->INTENCLR.reg = _sensor_eic_mask & ~_sync_eic_mask;
+    _paused = true;
     rtcZero.detachInterrupt();
 }
 
-void FED4::left_poke_handler() {
-    _sleep_mode = false;
+void FED4::init_sensors() {
+    _sensor_eic_mask = 0;
+    _sync_eic_mask = 0;
+    _analog_sensors = false;
+
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        Sensor &sensor = sensors[i];
+        if (sensor.type == SensorType::ANALOG) {
+            int8_t channel = adcAddChannel(sensor.pin, 2);
+            sensor.channel = channel < 0 ? 0xFF : channel;
+            _analog_sensors = true;
+            continue;
+        }
 
-    if (ignorePokes)
+        pinMode(sensor.pin, INPUT_PULLUP);
+        uint32_t line = digitalPinToInterrupt(sensor.pin);
+        attachInterrupt(line, _sensor_ISRs[i], CHANGE);
+        EIC->WAKEUP.reg |= (1 << line);
+        _sensor_eic_mask |= (1 << line);
+        if (_sync_pulses[i] > 0) {
+            _sync_eic_mask |= (1 << line);
+        }
+    }
+}
+
+void FED4::poll_sensors() {
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (_sync_released & (1 << i)) {
+            sensor_event(i, false);
+            _sync_released &= ~(1 << i);
+        }
+    }
+    if (!_analog_sensors) return;
+
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        Sensor &sensor = sensors[i];
+        if (sensor.type != SensorType::ANALOG || sensor.channel == 0xFF) continue;
+
+        bool active = adcRead(sensor.channel) >= sensor.threshold;
+        if (active != sensor.level) {
+            sensor_event(i, active);
+        }
+    }
+}
+
+uint8_t FED4::sensor_mask(const char* name) {
+    if (name == nullptr) return 0;
+
+    if (strcasecmp(name, "both") == 0 || strcasecmp(name, "all") == 0) {
+        return (1 << sensorCount) - 1;
+    }
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (strcasecmp(name, sensors[i].name) == 0) {
+            return 1 << i;
+        }
+    }
+    return 0;
+}
+
+// "Left", "Both" or "Left&Lever", or initials ("L&R") when the buffer
+// is too small for full names
+void FED4::sensor_mask_str(uint8_t mask, char* out, size_t len) {
+    out[0] = '\0';
+    bool letters = len < 2 * sizeof(Sensor::name);
+    if (!letters && sensorCount == 2 && mask == ActiveSensor::BOTH) {
+        strcpy(out, "Both");
         return;
+    }
 
-    if (digitalRead(FED4Pins::LFT_POKE) == LOW)
-    {
-        long millis_now = millis();
-        if (millis_now - _startT_left_poke < 50)
-            return;
-        _startT_left_poke = millis_now;
-        _left_poke_started = true;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        if (!(mask & (1 << i))) continue;
+
+        size_t pos = strlen(out);
+        if (pos > 0 && pos + 1 < len) out[pos++] = '&';
+        size_t n = letters ? 1 : strlen(sensors[i].name);
+        for (size_t c = 0; c < n && pos + 1 < len; c++) {
+            out[pos++] = sensors[i].name[c];
+        }
+        out[pos] = '\0';
     }
-    
-    else
-    {
-        if (!_left_poke_started)
-            return;
-        leftPokeCount++;
-        Event event = {
-            .time = getDateTime(),
-            .message = EventMsg::LEFT
-        };
-        logEvent(event);
-        _left_poke_started = false;
-        _left_poke = true;
-        _dT_left_poke = 0;
+}
+
+// Lower case name, used as the sensor's key in CONFIG.json
+void FED4::sensor_key(uint8_t idx, char key[sizeof(Sensor::name)]) {
+    for (size_t c = 0; c < sizeof(Sensor::name); c++) {
+        key[c] = tolower(sensors[idx].name[c]);
     }
 }
 
-void FED4::right_poke_handler() {
+void FED4::sensor_handler(uint8_t idx) {
     _sleep_mode = false;
 
+    Sensor &sensor = sensors[idx];
+    bool active = digitalRead(sensor.pin) == LOW;
+
+    // Only sync lines are live while the log is paused. A release sends
+    // its train now and is counted and logged by poll_sensors(); a press
+    // is lost as on the masked lines.
+    if (_paused) {
+        if (!active && sensor.started && !ignorePokes && !(_sync_released & (1 << idx))) {
+            syncPulse(idx, _sync_pulses[idx]);
+            _sync_released |= 1 << idx;
+        }
+        return;
+    }
+    sensor_event(idx, active);
+}
+
+void FED4::sensor_event(uint8_t idx, bool active) {
+    Sensor &sensor = sensors[idx];
+    sensor.level = active;
+
     if (ignorePokes)
         return;
 
-    if (digitalRead(FED4Pins::RGT_POKE) == LOW)
+    if (active)
     {
-        long millis_now = millis();
-        if (millis_now - _startT_right_poke < 50)
+        unsigned long millis_now = millis();
+        if (millis_now - sensor.startT < sensor.debounce)
             return;
-        _startT_right_poke = millis_now;
-        _right_poke_started = true;
+        sensor.startT = millis_now;
+        sensor.started = true;
     }
     
     else
     {
-        if (!_right_poke_started)
+        if (!sensor.started)
             return;
-        rightPokeCount++;
+        sensor.started = false;
+        if (!(_sync_released & (1 << idx))) {
+            syncPulse(idx, _sync_pulses[idx]);
+        }
+        sensor.count++;
+        summaryPoke(summary, idx, millis());
         Event event = {
             .time = getDateTime(),
-            .message = EventMsg::RIGHT
+            .code = EventCode::POKE,
+            .data = {}
         };
+        event.data.sensor = idx;
         logEvent(event);
-        _right_poke_started = false;
-        _right_poke = true;
-        _dT_right_poke = 0;
+        sensor.poked = true;
     }
 }
 
@@ -1248,9 +2687,27 @@ void FED4::alarm_handler() {
             _sleep_mode = false;
         }
         
+        // The service tick is stopped in standby
+        if (_battery_channel >= 0) {
+            adcConvertNow(_battery_channel);
+        }
+
         updateDisplay(true);
         setLightCue();
-        flush_to_sd();
+        if (millis() - _last_mem_sample > MEM_SAMPLE_PERIOD * 1000UL) {
+            sampleMemory();
+        }
+        if (millis() - _last_battery_log > BATTERY_LOG_PERIOD * 1000UL) {
+            logBattery();
+        }
+        if (millis() - _last_card_report > CARD_REPORT_PERIOD * 1000UL) {
+            saveCardHealth();
+        }
+        update_summary();
+        sample_env();
+        if (flush_due()) {
+            flush_to_sd();
+        }
 
         pause_interrupts();
         
@@ -1278,28 +2735,21 @@ void FED4::well_handler() {
     }
 #else 
     _pellet_dropped = true;
-#endif
-}
-
-void FED4::left_poke_IRS() {
-    if (instance) {
-        instance->left_poke_handler();
-    }
-}
-
-void FED4::right_poke_IRS() {
-    if (instance) {
-        instance->right_poke_handler();
+    if (digitalRead(FED4Pins::WELL) == LOW) {
+        syncPulse(SyncEvent::PELLET, _sync_pulses[SyncEvent::PELLET]);
     }
+#endif
 }
 
 void FED4::well_ISR() {
+    trace(TraceEv::ISR_WELL);
     if (instance) {
         instance->well_handler();
     }
 }
 
 void FED4::alarm_ISR() {
+    trace(TraceEv::ISR_ALARM);
     if (instance) {
         instance->alarm_handler();
     }
@@ -1312,11 +2762,59 @@ void FED4::dateTime(uint16_t *date, uint16_t *time) {
 }
 
 void FED4::wtd_shut_down() {
+    trace(TraceEv::WDT_WARN);
     if(instance) {
         // instance->flush_to_sd();
     }
 }
 
+void FED4::save_trace(uint32_t resetCause) {
+    // The first free name, or once all 99 are taken the oldest, rewritten:
+    // tools/tracedump reads one dump per file
+    char fileName[16] = "TRACE_01.BIN";
+    char oldest[16] = "TRACE_01.BIN";
+    uint32_t oldestStamp = UINT32_MAX;
+    for (int fileIndex = 1; fileIndex <= 99; fileIndex++) {
+        fileName[6] = '0' + fileIndex / 10;
+        fileName[7] = '0' + fileIndex % 10;
+        File file = sd.open(fileName, O_RDONLY);
+        if (!file) {
+            strcpy(oldest, fileName);
+            break;
+        }
+        uint16_t date = 0, time = 0;
+        file.getModifyDateTime(&date, &time);
+        file.close();
+        uint32_t stamp = (uint32_t)date << 16 | time;
+        if (stamp < oldestStamp) {
+            oldestStamp = stamp;
+            strcpy(oldest, fileName);
+        }
+    }
+
+    File traceFile = sd.open(oldest, O_WRONLY | O_CREAT | O_TRUNC);
+    if (!traceFile) return;
+
+    uint32_t head = traceRing.head;
+    uint32_t count = head < TRACE_LEN ? head : TRACE_LEN;
+    TraceFileHeader header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_FILE_VER,
+        .count = (uint16_t)count,
+        .resetCause = resetCause,
+        .bootUnix = traceRing.bootUnix,
+        .faultPc = traceRing.faultPc,
+        .faultLr = traceRing.faultLr,
+        .bootCount = traceRing.bootCount,
+        .entrySize = sizeof(TraceEntry)
+    };
+    traceFile.write(&header, sizeof(header));
+    for (uint32_t i = head - count; i != head; i++) {
+        traceFile.write(&traceRing.entries[i & (TRACE_LEN - 1)], sizeof(TraceEntry));
+    }
+    traceFile.close();
+}
+
 void  FED4::wtd_restart() {
     pause_interrupts();
 
@@ -1336,10 +2834,13 @@ void  FED4::wtd_restart() {
         char name[30] = "";
         file.getModifyDateTime(&date, &time);
         file.getName(name, 30);
+        // Segments rolled over within the same two seconds go by index
         if (
             ( date > latestDate 
-            || (date == latestDate && time > latestTime) )
+            || (date == latestDate && time > latestTime)
+            || (date == latestDate && time == latestTime && strcmp(name, latestName) > 0) )
             && strncmp(name, "FED", 3) == 0
+            && strstr(name, ".csv") != nullptr
         ) {
             latestDate = date;
             latestTime = time;
@@ -1348,11 +2849,17 @@ void  FED4::wtd_restart() {
         file.close();
     }
 
-    if (!logFile.open(latestName, O_RDWR | O_AT_END) || strlen(latestName) == 0) {
+    sd.remove(NEXT_SEGMENT);
+    _next_segment_ready = false;
+    _spare_sector = _spare_end = 0;
+    _segment_day = roll_day();
+
+    if (strlen(latestName) == 0 || !logFile.open(latestName, O_RDWR)) {
         initLogFile();
         Event event = {
-            time: getDateTime(),
-            message: EventMsg::WTD_RTS
+            .time = getDateTime(),
+            .code = EventCode::WTD_RTS,
+            .data = {}
         };
         logEvent(event);
         flush_to_sd();
@@ -1362,87 +2869,144 @@ void  FED4::wtd_restart() {
 
     char header[500] = "";
 
-    logFile.seekSet(0);
-    logFile.read(header, 500);
+    // Skip the segment chain line and the preamble, whose config line can
+    // be longer than the buffer
+    _segment_index = 1;
+    uint32_t headerPos = 0;
+    bool inLine = false;
+    while (true) {
+        memset(header, 0, sizeof(header));
+        logFile.seekSet(headerPos);
+        int n = logFile.read(header, sizeof(header) - 1);
+        if (n <= 0 || (!inLine && header[0] != '#')) break;
+        if (!inLine && strncmp(header, "#segment=", 9) == 0) {
+            _segment_index = atoi(header + 9);
+        }
+        char* next = strchr(header, '\n');
+        if (next == nullptr && strlen(header) < (size_t)n) break;
+        inLine = next == nullptr;
+        headerPos += next ? next + 1 - header : n;
+    }
     
-    uint8_t leftPoke_idx = 0;
-    uint8_t rightPoke_idx = 0;
-    uint8_t pellets_idx = 0;
+    uint8_t count_idx[MAX_SENSORS];
+    memset(count_idx, 0xFF, sizeof(count_idx));
+    uint8_t pellets_idx = 0xFF;
+    uint8_t seq_idx = 0xFF;
+    bool sealed = strstr(header, "\n#B,") != nullptr;
     
     char* headerPtr = strtok(header, "\n"); 
     char *column = strtok(headerPtr, ",");
     uint8_t columnIdx = 0;
     while (column != nullptr) {
-        if (strcmp(column, "Left Poke Count") == 0) {
-            leftPoke_idx = columnIdx;
-        }
-        else if (strcmp(column, "Right Poke Count") == 0) {
-            rightPoke_idx = columnIdx;
+        for (uint8_t i = 0; i < sensorCount; i++) {
+            char countColumn[24];
+            snprintf(countColumn, sizeof(countColumn), "%s %s Count", sensors[i].name, sensors[i].action);
+            if (strcmp(column, countColumn) == 0) {
+                count_idx[i] = columnIdx;
+            }
         }
-        else if (strcmp(column, "Pellet Count") == 0) {
+        if (strcmp(column, "Pellet Count") == 0) {
             pellets_idx = columnIdx;
         }
+        if (strcmp(column, "Seq") == 0) {
+            seq_idx = columnIdx;
+        }
         columnIdx++;
         column = strtok(nullptr, ",");
     }
     
     char lastRow[500] = "";
 
-    logFile.seekEnd(-1);
-    char c = logFile.read();
-    while (c == '\n') {
-        logFile.seekCur(-2);
-        c = logFile.read();
-    }
-    logFile.truncate(logFile.curPosition());
-    
-    if ((int)logFile.fileSize() - 1000 < 0) {
-        logFile.seekSet(0);
-    } else {
-        logFile.seekEnd(-1000);
-    }
+    // The rows end before the erased rest of the segment
+    uint32_t end = log_data_end(logFile);
     char endRows[1001];
-    memset(endRows, 0, 1001);
-    
-    logFile.read(endRows, 1000);
-    int pos = strlen(endRows) - 1;
-    while(endRows[pos] != '\n') {
-        pos --;
+    bool endsLine = true;
+    if (end > 0) {
+        logFile.seekSet(end - 1);
+        endsLine = logFile.read() == '\n';
+    }
+
+    // Walk back to the last row of the last sealed block. Rows after the
+    // last trailer were cut off by the reset and are not trusted; they can
+    // be longer than the window, which then steps back to the line cut in
+    // half at its start, until the header.
+    bool trailerSeen = false;
+    uint32_t windowEnd = end;
+    while (windowEnd > headerPos && lastRow[0] == '\0') {
+        uint32_t start = windowEnd - headerPos > 1000 ? windowEnd - 1000 : headerPos;
+        memset(endRows, 0, sizeof(endRows));
+        logFile.seekSet(start);
+        logFile.read(endRows, windowEnd - start);
+
+        int pos = windowEnd - start;
+        uint32_t nextEnd = start;
+        while (pos > 0 && lastRow[0] == '\0') {
+            int lineEnd = endRows[pos - 1] == '\n' ? pos - 1 : pos;
+            int lineStart = lineEnd;
+            while (lineStart > 0 && endRows[lineStart - 1] != '\n') {
+                lineStart--;
+            }
+            pos = lineStart;
+            if (lineStart == 0 && start > headerPos) {
+                // A line longer than the window is no row
+                if (start + lineEnd < windowEnd) nextEnd = start + lineEnd;
+                break;
+            }
+
+            const char* line = endRows + lineStart;
+            size_t lineLen = lineEnd - lineStart;
+            uint32_t blockSeq, blockLen, blockCrc;
+            if (logParseTrailer(line, lineLen, &blockSeq, &blockLen, &blockCrc)) {
+                if (!trailerSeen) _block_seq = blockSeq + 1;
+                trailerSeen = true;
+                continue;
+            }
+            if (lineLen == 0 || line[0] == '#' || (sealed && !trailerSeen)) continue;
+            memcpy(lastRow, line, min(lineLen, sizeof(lastRow) - 1));
+        }
+        windowEnd = nextEnd;
+        watch_dog.clear();
     }
-    strncpy(lastRow, endRows + pos + 1, 500);
 
-    uint16_t leftPokes = 0;
-    uint16_t rightPokes = 0;
+    uint16_t counts[MAX_SENSORS] = {};
     uint16_t pellets = 0;
 
-    if (strncmp(lastRow, header, strlen(lastRow)) != 0) {
+    if (lastRow[0] != '\0' && strncmp(lastRow, headerPtr, strlen(lastRow)) != 0) {
         int8_t idx = 0;
         char *token = strtok(lastRow, ",");
         while (token != nullptr) {
-            if (idx == leftPoke_idx) {
-                leftPokes = atoi(token);
-            }
-            else if (idx == rightPoke_idx) {
-                rightPokes = atoi(token);
+            for (uint8_t i = 0; i < sensorCount; i++) {
+                if (idx == count_idx[i]) {
+                    counts[i] = atoi(token);
+                }
             }
-            else if (idx == pellets_idx) {
+            if (idx == pellets_idx) {
                 pellets = atoi(token);
             }
+            if (idx == seq_idx) {
+                _event_seq = strtoul(token, nullptr, 10) + 1;
+            }
             idx++;
             token = strtok(nullptr, ",");
         }
     }
 
-    logFile.seekEnd();
-    logFile.print("\n");
+    // End a row cut off by the reset so the next one starts on its own line
+    logFile.seekSet(end);
+    log_open_raw(end);
+    if (!endsLine) {
+        log_write("\n", 1);
+    }
     
-    leftPokeCount = leftPokes;
-    rightPokeCount = rightPokes;
+    for (uint8_t i = 0; i < sensorCount; i++) {
+        sensors[i].count = counts[i];
+    }
     pelletsDispensed = pellets;
 
     Event event = {
-        time: getDateTime(),
-        message: EventMsg::WTD_RTS
+        .time = getDateTime(),
+        .code = EventCode::WTD_RTS,
+        .data = {}
     };
     logEvent(event);
     flush_to_sd();
@@ -14,7 +14,28 @@
 #include <Stepper.h>
 #include <WDTZero.h>
 
+#include "Adc.h"
+#include "Cue.h"
+#include "Env.h"
+#include "EventCode.h"
+#include "JsonOut.h"
+#include "Flush.h"
+#include "LogBlock.h"
+#include "LogIndex.h"
+#include "LogSchema.h"
+#include "Lzss.h"
+#include "MemStats.h"
 #include "Menu.h"
+#include "PerDevice.h"
+#include "RawLog.h"
+#include "SdStats.h"
+#include "Shell.h"
+#include "Sound.h"
+#include "Summary.h"
+#include "Sync.h"
+#include "Telemetry.h"
+#include "Ticker.h"
+#include "Trace.h"
 
 #define OLD_WELL false
 
@@ -26,9 +47,37 @@ constexpr uint16_t DISPLAY_W = 168; // pxls
 constexpr size_t ROW_MAX_LEN        = 500;
 constexpr size_t FILE_RAM_BUFF_SIZE = 1024; // BYTES
 constexpr size_t FILE_PREALLOC_SIZE = 25 * 1024UL * 1024UL; // 25MB 
+constexpr size_t SEGMENT_MIN_SIZE   = 64 * 1024UL;
+constexpr uint16_t SEGMENT_RETRY    = 60; // seconds between failed preallocations
+constexpr uint16_t SEGMENT_ERASE_STEP = 2048; // sectors of the spare erased per run()
+constexpr const char* NEXT_SEGMENT  = "NEXTLOG.TMP";
+constexpr uint16_t INDEX_ROWS       = 500; // log rows between time index entries
+constexpr uint16_t INDEX_PERIOD     = 10;  // minutes between time index entries
+constexpr uint8_t INDEX_QUEUE       = 4;   // entries waiting for the sidecar
 
 constexpr uint16_t STEPS = 2048;
 
+constexpr uint8_t MAX_SENSORS       = 4;
+constexpr uint16_t SENSOR_DEBOUNCE  = 50;  // ms
+constexpr uint16_t SENSOR_THRESHOLD = 2048; // analog, of 4095
+
+constexpr uint16_t MEM_SAMPLE_PERIOD = 600;  // seconds
+constexpr uint32_t MEM_LOW_BYTES     = 2048; // largest free block
+
+constexpr uint16_t BATTERY_LOG_PERIOD = 600; // seconds
+
+constexpr uint16_t CARD_REPORT_PERIOD = 3600; // seconds
+
+constexpr uint16_t SUMMARY_PERIOD = 3600; // seconds per SUMnn.csv row
+
+constexpr uint32_t TELEM_BAUD         = 115200;
+constexpr uint16_t TELEM_RING_SIZE    = 768;  // bytes of encoded frames
+constexpr uint16_t TELEM_PERIOD       = 10;   // seconds between counters
+constexpr uint16_t TELEM_HELLO_PERIOD = 60;   // seconds
+constexpr uint16_t TELEM_RATE         = 2000; // bytes per second, on average
+constexpr uint8_t TELEM_RX_SIZE       = 64;   // longest request, encoded
+constexpr uint16_t DOWNLOAD_CHUNK     = 384;  // file bytes per chunk frame
+
 namespace FED4Pins {
     constexpr uint8_t NEOPXL    = A1;
     constexpr uint8_t GRN_LED   = 8;
@@ -56,37 +105,73 @@ namespace Mode {
     constexpr int8_t OTHER   = -1;
 };
 
+// Bit masks over FED4::sensors, for the default left/right pair
 namespace ActiveSensor {
-    constexpr uint8_t LEFT    = 0;
-    constexpr uint8_t RIGHT   = 1;
-    constexpr uint8_t BOTH    = 2;
+    constexpr uint8_t LEFT    = 1 << 0;
+    constexpr uint8_t RIGHT   = 1 << 1;
+    constexpr uint8_t BOTH    = LEFT | RIGHT;
+};
+
+namespace SensorType {
+    constexpr uint8_t DIGITAL = 0; // active low, interrupt driven
+    constexpr uint8_t ANALOG  = 1; // active at or above threshold, polled
+};
+
+// Schedule events a sound can be attached to, keyed by name under "sounds"
+// in CONFIG.json
+namespace SoundCue {
+    constexpr uint8_t REWARD       = 0;
+    constexpr uint8_t ERROR        = 1;
+    constexpr uint8_t WINDOW_OPEN  = 2;
+    constexpr uint8_t WINDOW_CLOSE = 3;
+    constexpr uint8_t COUNT        = 4;
+    constexpr const char* NAMES[COUNT] = {"reward", "error", "window open", "window close"};
+};
+
+// Sync pulse events: the sensors by index, then these
+namespace SyncEvent {
+    constexpr uint8_t REWARD       = MAX_SENSORS;
+    constexpr uint8_t PELLET       = MAX_SENSORS + 1;
+    constexpr uint8_t COUNT        = MAX_SENSORS + 2;
 };
- 
-
-namespace EventMsg {
-    constexpr const char* LEFT     = "Left Poke";
-    constexpr const char* RIGHT    = "Right Poke";
-    constexpr const char* PEL      = "Dropped Pellet";
-    constexpr const char* WELL     = "Well Cleared";
-    constexpr const char* SET_VI   = "Set VI";
-    constexpr const char* RESET    = "Reset Device";
-    constexpr const char* WTD_RTS  = "WatchDog Reset Device";
-    constexpr const char* NONE     = "";
-}
 
 struct Event {
     DateTime time;
-    const char* message;
+    uint8_t code;           // EventCode
+    EventData data;         // as the code says, see EventCode.h
 };
 
+// One input (nose poke, lever, ...). The log columns "<name> Reward" and
+// "<name> <action> Count" and the event "<name> <action>" are generated
+// from it.
+typedef struct Sensor {
+    char name[8];
+    char action[8];
+    char message[16];           // "<name> <action>"
+    uint8_t pin;
+    uint8_t type;
+    uint8_t pixel;              // NeoPixel lit as cue, 0xFF for none
+    uint8_t channel;            // background ADC channel, analog only
+    uint8_t reward;
+    uint16_t threshold;
+    uint16_t debounce;          // ms
+    uint16_t count;
+
+    volatile bool level;        // last state seen, true = active
+    volatile bool started;
+    volatile bool poked;
+    volatile unsigned long startT;
+} Sensor;
+
 namespace ErrorMsg {
     constexpr const char* JAM = "JAM OR NO PELLETS"; 
+    constexpr const char* LOG_FULL = "LOG BUFFER FULL";
 }
 
 
 class FED4 {
     public:
-    static FED4* instance;  
+    static PER_DEVICE FED4* instance;
     
     FED4() :
         display(
@@ -97,7 +182,7 @@ class FED4 {
             STEPS, FED4Pins::MTR_1, FED4Pins::MTR_2, 
             FED4Pins::MTR_3, FED4Pins::MTR_4
         ),
-        strip(10, FED4Pins::NEOPXL, NEO_GRBW + NEO_KHZ800) 
+        strip(CUE_PIXELS, FED4Pins::NEOPXL, NEO_GRBW + NEO_KHZ800) 
     {
         watch_dog.attachShutdown(wtd_shut_down);
 
@@ -106,6 +191,7 @@ class FED4 {
             rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
         }
         stepper.setSpeed(7);
+        setDefaultSensors();
         
         display.begin();
         display.clearDisplay();
@@ -128,15 +214,19 @@ class FED4 {
     
     
     // ==== Device State ====
-    uint16_t leftPokeCount = 0;
-    uint16_t rightPokeCount = 0;
+    Sensor sensors[MAX_SENSORS];
+    uint8_t sensorCount = 0;
     uint16_t pelletsDispensed = 0;
     
+    MemStats memStats = {};
+    FlushPolicy flushPolicy = {};
+    SdStats sdStats = {};
+    Summary summary = {};               // the SUMnn.csv row in progress
+    EnvSensor env = {};
+    
     uint8_t deviceNumber = 0;
     uint8_t animal = 0;
     uint8_t activeSensor = ActiveSensor::BOTH;
-    uint8_t leftReward = 1;
-    uint8_t rightReward = 1;
     bool feedWindow = true;
     uint8_t windowStart = 9;
     uint8_t windowEnd = 12;
@@ -164,7 +254,16 @@ class FED4 {
     
     void loadConfig();
     void saveConfig();
-    
+    void configJson(Print &out);
+    bool setParam(const char* name, const char* value, char* out, size_t len, bool log = true);
+    
+    void setDefaultSensors();
+    int8_t addSensor(
+        const char* name, uint8_t pin,
+        uint8_t type = SensorType::DIGITAL, const char* action = "Poke"
+    );
+    bool isActive(uint8_t sensor);
+    bool getPoke(uint8_t sensor);
     bool getLeftPoke();
     bool getRightPoke(); 
     bool getWellStatus();
@@ -172,8 +271,11 @@ class FED4 {
     void initSD();
     void showSdError();
     void initLogFile();
-    void logEvent(Event e);
-    void logError(String str);
+    // Events of a class left out of the build (FED4_EVENTS) compile away
+    void logEvent(const Event &e) {
+        if (eventEnabled(e.code)) log_event(e);
+    }
+    void logError(const char* str);
     
     void updateDisplay(bool timeOnly = false);
     void displayLayout();
@@ -183,6 +285,10 @@ class FED4 {
     void drawStats();
     
     void makeNoise(int duration = 300);
+    void playSound(uint8_t cue);
+    
+    void sampleMemory(bool log = true);
+    uint8_t ramUsers(RamUser users[RAM_USERS_MAX]);
     
     void runConfigMenu();
     void runFRMenu();
@@ -203,35 +309,182 @@ class FED4 {
     
     DateTime getDateTime();
     int getBatteryPercentage();
+    uint16_t getBatteryMillivolts();
+    void logBattery();
+    void saveCardHealth();
+    void benchmarkLog(uint16_t flushes = 500);
     
     private:
     // ==== InternalFlags ====
     volatile bool _sleep_mode     = false;
     
-    volatile bool _left_poke      = false;
-    volatile bool _right_poke     = false;
     volatile bool _pellet_dropped = false;
     volatile bool _pellet_in_well = false;
     
     volatile bool _jam_error      = false;
     
-    // Timing
-    volatile bool _left_poke_started      = false;
-    volatile bool _right_poke_started     = false;
-    volatile unsigned long _startT_left_poke     = 0;
-    volatile unsigned long _startT_right_poke    = 0;
-    volatile unsigned long _dT_left_poke         = 0;
-    volatile unsigned long _dT_right_poke        = 0;
-    
     
     // ==== Internal State ====
     int _reward;
     
+    // Schedule draws, seeded at boot and logged
+    uint32_t _seed = 0;
+    uint32_t _rng_state = 1;
+    long schedule_random(long min, long max);
+    void log_seed();
+    
+    // Sensors
+    uint32_t _sensor_eic_mask = 0;
+    uint32_t _sync_eic_mask = 0;        // sensor lines left live while paused
+    volatile bool _paused = false;
+    volatile uint8_t _pause_depth = 0;  // pause_interrupts() calls not yet undone
+    volatile bool _card_busy = false;   // prepare_segment() has the card, lines live
+    volatile uint16_t _rows_lost = 0;   // rows with no room while the card was busy
+    volatile uint8_t _sync_released = 0; // releases synced while paused, by sensor
+    bool _analog_sensors = false;
+    void init_sensors();
+    void poll_sensors();
+    uint8_t sensor_mask(const char* name);
+    void sensor_mask_str(uint8_t mask, char* out, size_t len);
+    void sensor_key(uint8_t idx, char key[sizeof(Sensor::name)]);
+    
+    // Memory Telemetry
+    unsigned long _last_mem_sample = 0;
+    
+    // Light Cue
+    bool _cue_window_open = false;
+    
+    // Sound
+    SoundNote _sounds[SoundCue::COUNT][SOUND_MAX_NOTES];
+    uint8_t _sound_len[SoundCue::COUNT] = {0};
+    SoundNote _noise[SOUND_MAX_NOTES];
+    
+    // Battery
+    int8_t _battery_channel = -1;
+    unsigned long _last_battery_log = 0;
+    
+    // Sync Output
+    uint8_t _sync_pulses[SyncEvent::COUNT] = {0}; // pulses per event, 0 = none
+    uint16_t _sync_width = SYNC_WIDTH_US;
+    uint16_t _sync_gap = SYNC_GAP_US;
+    void log_sync();
+    
+    // Telemetry, see Telemetry.h. Frames are queued under PRIMASK by
+    // whoever logs and drained by run() as the port takes them.
+    bool _telem_enabled = true;
+    uint16_t _telem_period = TELEM_PERIOD;
+    uint16_t _telem_rate = TELEM_RATE;
+    uint16_t _telem_seq = 0;
+    uint32_t _telem_dropped = 0;
+    uint32_t _telem_credit = 0;         // rate limit, in bytes x 1000
+    unsigned long _telem_refill = 0;
+    unsigned long _last_telem_counters = 0;
+    unsigned long _last_telem_hello = 0;
+    volatile uint16_t _telem_head = 0;
+    volatile uint16_t _telem_tail = 0;
+    uint8_t _telem_ring[TELEM_RING_SIZE];
+    uint8_t _telem_frame[2][TELEM_MAX_ENCODED]; // the loop's, the handlers'
+    void send_telemetry(uint8_t type, const void* payload, size_t len, bool limited = true);
+    void send_hello();
+    void send_counters();
+    void service_telemetry();
+    
+    // Requests and Log Download, see Telemetry.h
+    uint8_t _telem_rx[TELEM_RX_SIZE];
+    char _telem_reply[TELEM_MAX_PAYLOAD];
+    uint8_t _telem_rx_len = 0;
+    bool _telem_rx_skip = false;        // request too long, wait for a delimiter
+    SdFile _dl_file;
+    uint32_t _dl_pos = 0;
+    uint32_t _dl_end = 0;
+    bool _dl_live = false;              // the open segment, read up to the last flush
+    void service_requests();
+    void handle_request(const TelemFrame &frame);
+    void start_download(const TelemFetch &fetch, const char* name);
+    void send_chunk();
+    
+    // Shell, commands come in as telemetry requests
+    Shell _shell = {};
+    void init_shell();
+    void run_command(char* line, uint16_t seq);
+    
+    // Environment
+    uint16_t _env_period = ENV_PERIOD;  // seconds, 0 = off
+    uint8_t _env_batch = ENV_BATCH;
+    uint32_t _last_env_unix = 0;
+    unsigned long _last_env_check = 0;
+    void sample_env();
+    
+    // Summary
+    unsigned long _last_summary_check = 0;
+    void update_summary();
+    void save_summary(const Summary &row, uint32_t endUnix);
+    
+    // SD Health
+    bool _card_degraded_logged = false;
+    unsigned long _last_card_report = 0;
+    void sd_timed(uint8_t op, uint32_t startUs);
+    
+    // Log Segments
+    uint32_t _segment_size = FILE_PREALLOC_SIZE;
+    int8_t _roll_hour = -1;             // daily rollover, -1 = off
+    uint16_t _segment_index = 0;        // within this session
+    uint32_t _segment_day = 0;
+    bool _next_segment_ready = false;
+    uint32_t _spare_sector = 0;         // next to erase, while < _spare_end
+    uint32_t _spare_end = 0;
+    bool _roll_due = false;
+    unsigned long _last_segment_try = 0;
+    bool _raw_log_enabled = false;      // config, see RawLog.h
+    bool _raw_log = false;              // in use for the open segment
+    RawLog _raw;
+    void log_open_raw(uint32_t position);
+    void log_write(const char* data, size_t len);
+    // log_write() for ArduinoJson and friends, keeping the length and CRC
+    // of what went by for the block trailer
+    class LogPrint : public Print {
+        public:
+        LogPrint(FED4* fed) : _fed(fed) {}
+        using Print::write;
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t* buf, size_t n) override;
+        uint32_t len = 0;
+        uint32_t crc = 0;
+        private:
+        FED4* _fed;
+    };
+    uint32_t log_position();
+    void log_file_name(char* name, size_t len);
+    bool create_segment(const char* name, uint32_t size);
+    void prepare_segment();
+    void roll_segment();
+    void write_log_header(const char* prevName, uint32_t prevBytes);
+    void log_columns(char header[ROW_MAX_LEN]);
+    void log_types(char types[ROW_MAX_LEN]);
+    uint32_t log_data_end(SdFile &file);
+    uint32_t roll_day();
+    uint32_t _block_seq = 0;            // see LogBlock.h
+    uint32_t _event_seq = 0;            // "Seq" column
+    
+    // Time Index, see LogIndex.h
+    uint16_t _index_rows = INDEX_ROWS;      // 0 = by time only
+    uint16_t _index_period = INDEX_PERIOD;  // minutes, 0 = by rows only
+    uint32_t _index_count = 0;          // rows since the last entry
+    uint32_t _last_index_unix = 0;
+    bool _index_due = true;             // the first block of a segment
+    LogIndexEntry _index_queue[INDEX_QUEUE];
+    uint8_t _index_pending = 0;
+    void index_block(uint32_t offset);
+    void write_index();
+    
     // Log Memory
     size_t _log_buffer_pos = 0;
     char _log_buffer[FILE_RAM_BUFF_SIZE];
-    unsigned long _last_flush = 0;
-    void write_to_log(char row[ROW_MAX_LEN], bool forceFlush=false);
+    uint32_t _buffer_seq = 0;           // first row in the buffer
+    uint32_t _buffer_unix = 0;
+    void log_event(const Event &e);
+    void write_to_log(char row[ROW_MAX_LEN], uint32_t seq, uint32_t unixTime, bool forceFlush=false);
+    bool flush_due();
     void flush_to_sd();
     
     
@@ -240,14 +493,19 @@ class FED4 {
     void start_interrupts();
     void pause_interrupts();
     
-    void left_poke_handler();
-    void right_poke_handler();
+    void sensor_handler(uint8_t idx);
+    void sensor_event(uint8_t idx, bool active);
     void alarm_handler();
     void well_handler();
     
     // Static Interrupt Service Routinesd
-    static void left_poke_IRS();
-    static void right_poke_IRS();
+    template <uint8_t N> static void sensor_ISR() {
+        trace(TraceEv::ISR_SENSOR, N);
+        if (instance) {
+            instance->sensor_handler(N);
+        }
+    }
+    static void (* const _sensor_ISRs[MAX_SENSORS])();
     static void well_ISR();
     static void alarm_ISR();
     
@@ -260,6 +518,7 @@ class FED4 {
     uint32_t _wtd_timeout = WDT_SOFTCYCLE4M;
     static void wtd_shut_down();
     void wtd_restart();
+    void save_trace(uint32_t resetCause);
 };
 
 #endif
\ No newline at end of file
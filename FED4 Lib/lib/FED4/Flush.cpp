@@ -0,0 +1,52 @@
+#include "Flush.h"
+
+void flushInit(FlushPolicy &policy, uint16_t maxAge, uint16_t maxEvents) {
+    memset(&policy, 0, sizeof(policy));
+    policy.maxAge = maxAge;
+    policy.maxEvents = maxEvents;
+    policy.gapAvg = UINT32_MAX / 2;
+}
+
+void flushAdded(FlushPolicy &policy, uint32_t now) {
+    if (policy.events == 0) {
+        policy.oldestT = now;
+    }
+    if (policy.lastRowT != 0) {
+        uint32_t gap = min(now - policy.lastRowT, UINT32_MAX / 2);
+        policy.gapAvg -= policy.gapAvg / 4;
+        policy.gapAvg += gap / 4;
+    }
+    policy.lastRowT = now;
+    policy.events++;
+}
+
+bool flushDue(const FlushPolicy &policy, uint32_t now, bool lowBattery) {
+    if (policy.events == 0) return false;
+
+    uint32_t scale = 1;
+    if (policy.gapAvg < FLUSH_BURST_GAP && now - policy.lastRowT < FLUSH_BURST_GAP) {
+        scale *= FLUSH_BATCH_SCALE;
+    }
+    if (lowBattery) {
+        scale *= FLUSH_BATCH_SCALE;
+    }
+
+    if (policy.maxEvents != 0 && policy.events >= policy.maxEvents * scale) {
+        return true;
+    }
+    if (policy.maxAge != 0 && now - policy.oldestT >= policy.maxAge * 1000UL * scale) {
+        return true;
+    }
+    return false;
+}
+
+void flushDone(FlushPolicy &policy, uint16_t bytes, uint32_t busyMs) {
+    policy.events = 0;
+
+    FlushStats &stats = policy.stats;
+    stats.flushes++;
+    stats.bytes += bytes;
+    stats.busyMs += busyMs;
+    stats.maxBytes = max(stats.maxBytes, bytes);
+    stats.maxBusyMs = max(stats.maxBusyMs, (uint16_t)min(busyMs, (uint32_t)UINT16_MAX));
+}
@@ -0,0 +1,42 @@
+#ifndef FLUSH_H
+#define FLUSH_H
+
+// Decides when the RAM log buffer is written to the SD card. The targets
+// bound how much data a power loss or reset can take with it: the age of
+// the oldest unwritten row and the number of unwritten rows. Both are
+// stretched while events arrive in a burst, so a run of pokes is written
+// once the animal pauses, and while the battery is low, where SD writes
+// cost the most. The buffer filling up always forces a flush.
+
+#include <Arduino.h>
+
+constexpr uint16_t FLUSH_MAX_AGE      = 50;   // seconds
+constexpr uint16_t FLUSH_MAX_EVENTS   = 20;
+constexpr uint16_t FLUSH_BURST_GAP    = 2000; // ms between rows in a burst
+constexpr uint8_t FLUSH_BATCH_SCALE   = 4;    // target stretch per condition
+constexpr uint8_t FLUSH_LOW_BATTERY   = 20;   // percent
+
+typedef struct FlushStats {
+    uint32_t flushes;
+    uint32_t bytes;         // total written
+    uint16_t maxBytes;      // largest single flush
+    uint32_t busyMs;        // total time spent writing
+    uint16_t maxBusyMs;     // slowest single flush
+} FlushStats;
+
+typedef struct FlushPolicy {
+    uint16_t maxAge;        // seconds, 0 = no limit
+    uint16_t maxEvents;     // 0 = no limit
+    uint16_t events;        // rows waiting in the buffer
+    uint32_t oldestT;       // millis() of the first waiting row
+    uint32_t lastRowT;
+    uint32_t gapAvg;        // ms, running average between rows
+    FlushStats stats;
+} FlushPolicy;
+
+void flushInit(FlushPolicy &policy, uint16_t maxAge, uint16_t maxEvents);
+void flushAdded(FlushPolicy &policy, uint32_t now);
+bool flushDue(const FlushPolicy &policy, uint32_t now, bool lowBattery);
+void flushDone(FlushPolicy &policy, uint16_t bytes, uint32_t busyMs);
+
+#endif
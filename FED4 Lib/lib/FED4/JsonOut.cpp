@@ -0,0 +1,106 @@
+#include "JsonOut.h"
+
+#include <math.h>
+
+void JsonOut::separate() {
+    if (_keyed) {
+        _keyed = false;
+        return;
+    }
+    if (_depth == 0) return;
+    uint8_t bit = 1 << (_depth - 1);
+    if (_members & bit) _out.write(',');
+    _members |= bit;
+}
+
+void JsonOut::open(char c, bool array) {
+    separate();
+    _out.write(c);
+    if (_depth >= JSON_OUT_DEPTH) return;
+    uint8_t bit = 1 << _depth;
+    _members &= ~bit;
+    _arrays = array ? _arrays | bit : _arrays & ~bit;
+    _depth++;
+}
+
+JsonOut& JsonOut::beginObject() {
+    open('{', false);
+    return *this;
+}
+
+JsonOut& JsonOut::beginArray() {
+    open('[', true);
+    return *this;
+}
+
+JsonOut& JsonOut::end() {
+    if (_depth == 0) return *this;
+    _depth--;
+    _out.write(_arrays & (1 << _depth) ? ']' : '}');
+    return *this;
+}
+
+JsonOut& JsonOut::key(const char* key) {
+    separate();
+    string(key);
+    _out.write(':');
+    _keyed = true;
+    return *this;
+}
+
+void JsonOut::string(const char* s) {
+    _out.write('"');
+    for (; *s != '\0'; s++) {
+        uint8_t c = *s;
+        if (c == '"' || c == '\\') {
+            _out.write('\\');
+            _out.write(c);
+        }
+        else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            _out.write(escaped);
+        }
+        else {
+            _out.write(c);
+        }
+    }
+    _out.write('"');
+}
+
+JsonOut& JsonOut::value(const char* s) {
+    separate();
+    string(s ? s : "");
+    return *this;
+}
+
+JsonOut& JsonOut::value(bool b) {
+    separate();
+    _out.write(b ? "true" : "false");
+    return *this;
+}
+
+JsonOut& JsonOut::value(long n) {
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", n);
+    separate();
+    _out.write(text);
+    return *this;
+}
+
+JsonOut& JsonOut::value(unsigned long n) {
+    char text[24];
+    snprintf(text, sizeof(text), "%lu", n);
+    separate();
+    _out.write(text);
+    return *this;
+}
+
+JsonOut& JsonOut::value(double f) {
+    char text[16];
+    if (isfinite(f)) snprintf(text, sizeof(text), "%.7g", f);
+    else snprintf(text, sizeof(text), "null");
+    separate();
+    _out.write(text);
+    return *this;
+}
@@ -0,0 +1,52 @@
+#ifndef JSONOUT_H
+#define JSONOUT_H
+
+// Writes JSON straight to a Print, a token at a time, for the files the
+// feeder writes from interrupt context or on a full heap: CARD.json,
+// CONFIG.json and the #config line of the log preamble. Nothing is
+// allocated; the writer only keeps which of its open containers are
+// arrays and which have had a member yet.
+//
+//   JsonOut json(file);
+//   json.beginObject();
+//   json.key("ops").value(ops);
+//   json.key("recent").beginArray();
+//   for (...) json.value(n);
+//   json.end();
+//   json.end();
+//
+// ArduinoJson still reads the files back.
+
+#include <Arduino.h>
+
+constexpr uint8_t JSON_OUT_DEPTH = 8;  // nested objects and arrays
+
+class JsonOut {
+    public:
+    JsonOut(Print &out) : _out(out) {}
+
+    JsonOut& beginObject();
+    JsonOut& beginArray();
+    JsonOut& end();                 // the innermost object or array
+    JsonOut& key(const char* key);
+
+    JsonOut& value(const char* s);
+    JsonOut& value(bool b);
+    JsonOut& value(int n) { return value((long)n); }
+    JsonOut& value(unsigned int n) { return value((unsigned long)n); }
+    JsonOut& value(long n);
+    JsonOut& value(unsigned long n);
+    JsonOut& value(double f);       // null when not finite
+
+    private:
+    Print &_out;
+    uint8_t _depth = 0;
+    uint8_t _arrays = 0;            // bit per depth
+    uint8_t _members = 0;           // bit per depth, set after the first
+    bool _keyed = false;
+    void separate();
+    void open(char c, bool array);
+    void string(const char* s);
+};
+
+#endif
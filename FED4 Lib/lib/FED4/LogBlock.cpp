@@ -0,0 +1,49 @@
+#include "LogBlock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Half-byte table, 64 bytes of flash instead of 1 KB
+static const uint32_t CRC32_NIBBLES[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Chains like zlib's crc32(): start from 0 and pass the previous result
+uint32_t crc32Update(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ CRC32_NIBBLES[crc & 0x0F];
+        crc = (crc >> 4) ^ CRC32_NIBBLES[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+int logTrailer(char* out, size_t size, uint32_t seq, uint32_t len, uint32_t crc) {
+    return snprintf(
+        out, size, "#B,%lu,%lu,%08lx\n",
+        (unsigned long)seq, (unsigned long)len, (unsigned long)crc
+    );
+}
+
+bool logParseTrailer(const char* line, size_t lineLen, uint32_t* seq, uint32_t* len, uint32_t* crc) {
+    if (lineLen < 8 || lineLen >= LOG_TRAILER_LEN || line[0] != '#' || line[1] != 'B' || line[2] != ',') {
+        return false;
+    }
+    char buf[LOG_TRAILER_LEN];
+    for (size_t i = 0; i < lineLen; i++) buf[i] = line[i];
+    buf[lineLen] = '\0';
+
+    char* end;
+    *seq = strtoul(buf + 3, &end, 10);
+    if (*end != ',') return false;
+    *len = strtoul(end + 1, &end, 10);
+    if (*end != ',') return false;
+    const char* hex = end + 1;
+    *crc = strtoul(hex, &end, 16);
+    return end - hex == 8 && *end == '\0';
+}
@@ -0,0 +1,28 @@
+#ifndef LOGBLOCK_H
+#define LOGBLOCK_H
+
+// Log block trailers. Every flush ends with a line
+//
+//   #B,<seq>,<len>,<crc>\n
+//
+// sealing the <len> bytes just before it, with their CRC-32 (IEEE, as in
+// zlib) in hex. Block numbers run on across segments and resets, so a
+// missing or repeated block shows up as a jump. Bytes between the end of
+// one trailer and the start of the next block were never sealed, which is
+// what a reset in the middle of a flush leaves behind.
+//
+// Plain C++ so tools/logverify can share the format.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint8_t LOG_TRAILER_LEN   = 32; // longest trailer and its NUL
+
+uint32_t crc32Update(uint32_t crc, const void* data, size_t len);
+
+// Writes the trailer, returns its length
+int logTrailer(char* out, size_t size, uint32_t seq, uint32_t len, uint32_t crc);
+// Parses a trailer line without its '\n'
+bool logParseTrailer(const char* line, size_t lineLen, uint32_t* seq, uint32_t* len, uint32_t* crc);
+
+#endif
@@ -0,0 +1,43 @@
+#include "LogIndex.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void logIndexName(const char* logName, char* out, size_t size) {
+    snprintf(out, size, "%s", logName);
+    char* dot = strrchr(out, '.');
+    size_t base = dot ? dot - out : strlen(out);
+    if (base + 4 < size) strcpy(out + base, ".idx");
+}
+
+int logIndexLine(char* out, size_t size, const LogIndexEntry &entry) {
+    return snprintf(
+        out, size, "%lu,%lu,%lu\n",
+        (unsigned long)entry.offset, (unsigned long)entry.unixTime, (unsigned long)entry.seq
+    );
+}
+
+bool logIndexParse(const char* line, size_t lineLen, LogIndexEntry* entry) {
+    uint32_t values[3] = {0, 0, 0};
+    uint8_t n = 0;
+    bool digits = false;
+    for (size_t i = 0; i < lineLen; i++) {
+        char c = line[i];
+        if (c >= '0' && c <= '9') {
+            values[n] = values[n] * 10 + (c - '0');
+            digits = true;
+        }
+        else if (c == ',' && digits && n < 2) {
+            n++;
+            digits = false;
+        }
+        else if (c != '\r') {
+            return false;
+        }
+    }
+    if (n != 2 || !digits) return false;
+    entry->offset = values[0];
+    entry->unixTime = values[1];
+    entry->seq = values[2];
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef LOGINDEX_H
+#define LOGINDEX_H
+
+// Sparse time index of a log segment. Next to FED01_06-03-25_001.csv the
+// feeder keeps FED01_06-03-25_001.idx, a CSV with a line
+//
+//   <offset>,<unix time>,<seq>\n
+//
+// for a flushed block every so many rows or minutes: the byte offset of
+// the block in the segment, and the time and Seq of its first row. Lines
+// follow the log, so offsets increase and times do too unless the clock
+// was set back. The file starts with a header line. A reset can lose the
+// newest lines, never the log rows, so readers treat the index as a hint
+// and check each offset against the log.
+//
+// Plain C++ so the host tools can share the format.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint8_t LOG_INDEX_LEN = 36;   // longest line and its NUL
+constexpr const char* LOG_INDEX_HEADER = "Offset,Unix Time,Seq\n";
+
+typedef struct LogIndexEntry {
+    uint32_t offset;
+    uint32_t unixTime;
+    uint32_t seq;
+} LogIndexEntry;
+
+// FED01_06-03-25_001.idx for FED01_06-03-25_001.csv
+void logIndexName(const char* logName, char* out, size_t size);
+// Writes the line, returns its length
+int logIndexLine(char* out, size_t size, const LogIndexEntry &entry);
+// Parses a line without its '\n'; false for the header or a torn line
+bool logIndexParse(const char* line, size_t lineLen, LogIndexEntry* entry);
+
+#endif
@@ -0,0 +1,85 @@
+#include "LogSchema.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* const LogType::NAMES[LogType::COUNT] = {
+    "u8", "u16", "u32", "i16", "i32", "f32", "time", "text"
+};
+
+size_t logTypeName(char* out, size_t size, uint8_t type) {
+    size_t len = strlen(out);
+    uint8_t base = type & ~LogType::NULLABLE;
+    snprintf(
+        out + len, size - len, "%s%s",
+        base < LogType::COUNT ? LogType::NAMES[base] : "text",
+        type & LogType::NULLABLE ? "?" : ""
+    );
+    return strlen(out);
+}
+
+static bool startsWith(const char* line, size_t lineLen, const char* prefix) {
+    size_t n = strlen(prefix);
+    return lineLen >= n && memcmp(line, prefix, n) == 0;
+}
+
+// "key=value" pairs split by ',', as in the #schema line
+static void parseSchemaLine(const char* line, size_t lineLen, LogSchema* schema) {
+    const char* end = line + lineLen;
+    for (const char* p = line; p < end;) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        const char* e = comma ? comma : end;
+        const char* eq = (const char*)memchr(p, '=', e - p);
+        if (eq != nullptr) {
+            char value[sizeof(schema->build)];
+            size_t len = e - eq - 1;
+            if (len > sizeof(value) - 1) len = sizeof(value) - 1;
+            memcpy(value, eq + 1, len);
+            value[len] = '\0';
+            size_t keyLen = eq - p;
+            if (keyLen == 7 && memcmp(p, "#schema", 7) == 0) schema->version = atoi(value);
+            else if (keyLen == 5 && memcmp(p, "build", 5) == 0) strcpy(schema->build, value);
+            else if (keyLen == 8 && memcmp(p, "old_well", 8) == 0) schema->oldWell = atoi(value) != 0;
+            else if (keyLen == 5 && memcmp(p, "steps", 5) == 0) schema->steps = atoi(value);
+            else if (keyLen == 4 && memcmp(p, "seed", 4) == 0) schema->seed = strtoul(value, nullptr, 10);
+        }
+        p = e + 1;
+    }
+}
+
+static bool parseTypesLine(const char* line, size_t lineLen, LogSchema* schema) {
+    const char* end = line + lineLen;
+    uint8_t columns = 0;
+    for (const char* p = line + 7; p <= end; columns++) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        const char* e = comma ? comma : end;
+        if (columns >= LOG_MAX_COLUMNS) return false;
+
+        uint8_t type = LogType::NULLABLE;
+        size_t len = e - p;
+        if (len > 0 && e[-1] == '?') len--;
+        else type = 0;
+        uint8_t base = 0;
+        while (base < LogType::COUNT
+               && !(strlen(LogType::NAMES[base]) == len && memcmp(p, LogType::NAMES[base], len) == 0)) {
+            base++;
+        }
+        if (base == LogType::COUNT) return false;
+        schema->types[columns] = type | base;
+        p = e + 1;
+    }
+    schema->columns = columns;
+    return true;
+}
+
+bool logParseSchema(const char* line, size_t lineLen, LogSchema* schema) {
+    if (startsWith(line, lineLen, "#schema=")) {
+        parseSchemaLine(line, lineLen, schema);
+        return true;
+    }
+    if (startsWith(line, lineLen, "#types=")) {
+        return parseTypesLine(line, lineLen, schema);
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef LOGSCHEMA_H
+#define LOGSCHEMA_H
+
+// Log preamble. Between a segment's chain line and its column header the
+// feeder writes
+//
+//   #schema=<version>,build=<firmware>,old_well=<0|1>,steps=<n>,seed=<n>\n
+//   #config=<CONFIG.json as the session runs it, on one line>\n
+//   #types=<one type per column of the header>\n
+//
+// so a reader knows what produced the file before the first row. The
+// version goes up whenever the preamble, the header or the way a field
+// is written changes; a reader that does not know the version falls back
+// to the column names. The build is FED4_BUILD, set from git by
+// platformio.ini, and the seed is the one the session's RNG started from.
+//
+// Types are u8, u16, u32, i16, i32, f32 (two decimals), time ("d/m/yy
+// h:m:s", the year modulo 1000, local time) and text. A '?' after the
+// type means the field can also be "null".
+//
+// Plain C++ so the host tools can share the format.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint16_t LOG_SCHEMA_VERSION = 1;
+constexpr uint8_t LOG_MAX_COLUMNS    = 64;
+
+namespace LogType {
+    constexpr uint8_t U8    = 0;
+    constexpr uint8_t U16   = 1;
+    constexpr uint8_t U32   = 2;
+    constexpr uint8_t I16   = 3;
+    constexpr uint8_t I32   = 4;
+    constexpr uint8_t F32   = 5;
+    constexpr uint8_t TIME  = 6;
+    constexpr uint8_t TEXT  = 7;
+    constexpr uint8_t COUNT = 8;
+    constexpr uint8_t NULLABLE = 0x80;  // or'ed in
+    extern const char* const NAMES[COUNT];
+};
+
+typedef struct LogSchema {
+    uint16_t version;       // 0 for a segment without a preamble
+    char build[24];
+    bool oldWell;
+    uint16_t steps;
+    uint32_t seed;
+    uint8_t columns;        // types, 0 until the #types line
+    uint8_t types[LOG_MAX_COLUMNS];
+} LogSchema;
+
+#if !defined(FED4_BUILD)
+#define FED4_BUILD unknown
+#endif
+#define LOG_STR(x) #x
+#define LOG_XSTR(x) LOG_STR(x)
+constexpr const char* LOG_BUILD = LOG_XSTR(FED4_BUILD);
+
+// Appends the type to out, returns the new length
+size_t logTypeName(char* out, size_t size, uint8_t type);
+// Takes a #schema or #types line without its '\n' into schema; false for
+// any other line. Start from a zeroed LogSchema.
+bool logParseSchema(const char* line, size_t lineLen, LogSchema* schema);
+
+#endif
@@ -0,0 +1,80 @@
+#include "Lzss.h"
+
+constexpr uint16_t LZSS_HASH_SIZE = 256;
+
+static uint8_t lzss_hash(const uint8_t* p) {
+    return (uint8_t)((p[0] << 4) ^ (p[1] << 2) ^ p[2]);
+}
+
+// One candidate per hash, the most recent position: enough for rows that
+// repeat the row before, and cheap in time and stack
+size_t lzssCompress(const uint8_t* in, size_t len, uint8_t* out, size_t outSize) {
+    int16_t head[LZSS_HASH_SIZE];
+    for (uint16_t i = 0; i < LZSS_HASH_SIZE; i++) head[i] = -1;
+
+    size_t pos = 0;
+    size_t outPos = 0;
+    size_t flagPos = 0;
+    uint8_t items = 8;
+
+    while (pos < len) {
+        if (items == 8) {
+            if (outPos >= outSize) return 0;
+            flagPos = outPos++;
+            out[flagPos] = 0;
+            items = 0;
+        }
+
+        size_t best = 0;
+        size_t dist = 0;
+        if (pos + LZSS_MIN_MATCH <= len) {
+            uint8_t h = lzss_hash(&in[pos]);
+            int16_t cand = head[h];
+            if (cand >= 0 && pos - cand <= LZSS_WINDOW) {
+                size_t limit = len - pos < LZSS_MAX_MATCH ? len - pos : LZSS_MAX_MATCH;
+                while (best < limit && in[cand + best] == in[pos + best]) best++;
+                dist = pos - cand;
+            }
+            head[h] = pos;
+        }
+
+        if (best >= LZSS_MIN_MATCH) {
+            if (outPos + 2 > outSize) return 0;
+            out[outPos++] = dist - 1;
+            out[outPos++] = best - LZSS_MIN_MATCH;
+            for (size_t i = 1; i < best && pos + i + LZSS_MIN_MATCH <= len; i++) {
+                head[lzss_hash(&in[pos + i])] = pos + i;
+            }
+            pos += best;
+        }
+        else {
+            if (outPos >= outSize) return 0;
+            out[flagPos] |= 1 << items;
+            out[outPos++] = in[pos++];
+        }
+        items++;
+    }
+    return outPos;
+}
+
+int32_t lzssExpand(const uint8_t* in, size_t len, uint8_t* out, size_t outSize) {
+    size_t pos = 0;
+    size_t outPos = 0;
+    while (pos < len) {
+        uint8_t flags = in[pos++];
+        for (uint8_t i = 0; i < 8 && pos < len; i++) {
+            if (flags & (1 << i)) {
+                if (outPos >= outSize) return -1;
+                out[outPos++] = in[pos++];
+                continue;
+            }
+            if (pos + 2 > len) return -1;
+            size_t dist = in[pos] + 1;
+            size_t count = in[pos + 1] + LZSS_MIN_MATCH;
+            pos += 2;
+            if (dist > outPos || outPos + count > outSize) return -1;
+            for (size_t j = 0; j < count; j++, outPos++) out[outPos] = out[outPos - dist];
+        }
+    }
+    return (int32_t)outPos;
+}
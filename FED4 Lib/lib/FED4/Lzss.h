@@ -0,0 +1,26 @@
+#ifndef LZSS_H
+#define LZSS_H
+
+// Small-window LZSS for log downloads, in the spirit of heatshrink: each
+// buffer is compressed on its own, so any chunk can be expanded without
+// the ones before it. Items come in groups of up to eight behind a flag
+// byte, least significant bit first: a set bit is a literal byte, a clear
+// bit a match of two bytes, distance - 1 then length - LZSS_MIN_MATCH.
+// CSV rows repeat most of the previous row, so a 256 byte window is enough.
+//
+// Plain C++ so tools/fetchlog can share the format.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint16_t LZSS_WINDOW    = 256;
+constexpr uint8_t LZSS_MIN_MATCH  = 3;
+constexpr uint16_t LZSS_MAX_MATCH = LZSS_MIN_MATCH + 255;
+
+// Returns the compressed length, or 0 if it would not fit in outSize
+size_t lzssCompress(const uint8_t* in, size_t len, uint8_t* out, size_t outSize);
+// Returns the expanded length, or -1 if the input is malformed or the
+// output would not fit in outSize
+int32_t lzssExpand(const uint8_t* in, size_t len, uint8_t* out, size_t outSize);
+
+#endif
@@ -0,0 +1,93 @@
+#include "MemStats.h"
+
+#if defined(__arm__)
+#include <unistd.h>
+
+extern "C" char __data_start__;
+extern "C" char __bss_end__;
+extern "C" char __StackTop;
+
+// newlib-nano's free list, see nano-mallocr.c
+typedef struct malloc_chunk {
+    long size;
+    struct malloc_chunk *next;
+} malloc_chunk;
+extern "C" malloc_chunk *__malloc_free_list;
+
+static char *heapStart() {
+    return &__bss_end__;
+}
+
+static char *heapEnd() {
+    return (char*)sbrk(0);
+}
+
+static char *stackPointer() {
+    return (char*)__get_MSP();
+}
+
+static char *ramTop() {
+    return &__StackTop;
+}
+
+static uint32_t staticRam() {
+    return &__bss_end__ - &__data_start__;
+}
+
+void paintStack() {
+    uint32_t *p = (uint32_t*)(((uintptr_t)heapEnd() + 3) & ~3);
+    uint32_t *end = (uint32_t*)(stackPointer() - STACK_PAINT_MARGIN);
+    while (p < end) {
+        *p++ = STACK_PAINT;
+    }
+}
+
+MemStats getMemStats() {
+    MemStats stats;
+
+    // The paint scan only reads, and is an estimate anyway, so it runs with
+    // interrupts on: it can take hundreds of us and must not hold off the
+    // sync timer
+    char *heapTop = heapEnd();
+    uint32_t *p = (uint32_t*)(((uintptr_t)heapTop + 3) & ~3);
+    uint32_t *sp = (uint32_t*)stackPointer();
+    while (p < sp && *p == STACK_PAINT) {
+        p++;
+    }
+    char *stackLow = (char*)p;
+
+    // Also called from the alarm handler, which must not come out of here
+    // with interrupts enabled
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t listFree = 0;
+    uint32_t largest = 0;
+    uint16_t blocks = 0;
+    for (malloc_chunk *c = __malloc_free_list; c != nullptr; c = c->next) {
+        listFree += c->size;
+        if ((uint32_t)c->size > largest) largest = c->size;
+        blocks++;
+    }
+    __set_PRIMASK(primask);
+
+    uint32_t gap = stackLow > heapTop + STACK_PAINT_MARGIN ? stackLow - heapTop - STACK_PAINT_MARGIN : 0;
+    if (gap > largest) largest = gap;
+
+    stats.stackUsed = ramTop() - stackLow;
+    stats.stackUntouched = stackLow - heapTop;
+    stats.heapUsed = heapTop - heapStart() - listFree;
+    stats.heapFree = listFree + gap;
+    stats.largestFree = largest;
+    stats.freeBlocks = blocks;
+    stats.staticRam = staticRam();
+    return stats;
+}
+#else
+// Host builds have no single RAM image to inspect
+void paintStack() {}
+
+MemStats getMemStats() {
+    MemStats stats = {};
+    return stats;
+}
+#endif
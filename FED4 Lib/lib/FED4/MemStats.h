@@ -0,0 +1,30 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <Arduino.h>
+
+constexpr uint32_t STACK_PAINT = 0xA5A5A5A5;
+constexpr uint32_t STACK_PAINT_MARGIN = 64; // bytes left unpainted below SP
+
+typedef struct MemStats {
+    uint32_t stackUsed;     // deepest stack use since paintStack()
+    uint32_t stackUntouched; // painted bytes the stack has never reached
+    uint32_t heapUsed;      // bytes handed out by sbrk
+    uint32_t heapFree;      // free-list bytes plus the heap/stack gap
+    uint32_t largestFree;   // biggest single allocation that would succeed
+    uint16_t freeBlocks;    // free-list length, a fragmentation indicator
+    uint32_t staticRam;     // .data + .bss
+} MemStats;
+
+constexpr uint8_t RAM_USERS_MAX = 8;
+
+// One subsystem's share of static RAM, see FED4::ramUsers()
+typedef struct RamUser {
+    const char *name;
+    uint32_t bytes;
+} RamUser;
+
+void paintStack();
+MemStats getMemStats();
+
+#endif
@@ -1,7 +1,7 @@
 #include "Menu.h"
 
-Adafruit_SharpMem *menu_display;
-RTC_PCF8523 *menu_rtc;
+PER_DEVICE Adafruit_SharpMem *menu_display;
+PER_DEVICE RTC_PCF8523 *menu_rtc;
 
 void drawMenu(Menu *menu, int batteryLevel = -1);
 
@@ -101,6 +101,12 @@ MenuItem::MenuItem(const char *name, Menu *submenu) {
     this->submenu = submenu;
 }
 
+MenuItem::MenuItem(const char *name, const char *text) {
+    this->name = name;
+    this->type = ItemType::ITEM_T_INFO;
+    this->value = (void*)text;
+}
+
 MenuItem::~MenuItem() {
     switch (type) {
     case ITEM_T_INT:
@@ -123,7 +129,7 @@ MenuItem::~MenuItem() {
         delete[] list;
         break;
     
-    default: // ITEM_T_BOOL 
+    default: // ITEM_T_BOOL, ITEM_T_INFO
         break;
     }
 }
@@ -387,6 +393,10 @@ void printValue(MenuItem* item) {
         menu_display->print((char*)item->value);
         break;
     }
+    case ITEM_T_INFO: {
+        menu_display->print((const char*)item->value);
+        break;
+    }
     case ITEM_T_SUBMENU: {
         if(item->submenu->type == MENU_T_CLOCK) {
             DateTime now = menu_rtc->now();
@@ -559,11 +569,13 @@ void drawListSelection(Menu* menu) {
         y = START_Y + 4 * ROW_HEIGHT;
     }
     menu_display->setCursor(COL_2_X, y);
-    if (menu->selectedItem->type != ITEM_T_SUBMENU) {
+    bool editable = menu->selectedItem->type != ITEM_T_SUBMENU
+        && menu->selectedItem->type != ITEM_T_INFO;
+    if (editable) {
         menu_display->print("<");
     }
     printValue(menu->selectedItem);
-    if (menu->selectedItem->type != ITEM_T_SUBMENU) {
+    if (editable) {
         menu_display->print(">");
     }
 }
@@ -714,6 +726,11 @@ void Menu::add(const char *name, Menu *submenu) {
     add(newItem);
 }
 
+void Menu::add(const char *name, const char *text) {
+    MenuItem* newItem = new MenuItem(name, text);
+    add(newItem);
+}
+
 void Menu::add(MenuItem* item) {
     itemNo++;
     if (itemNo > capacity) {
@@ -735,7 +752,7 @@ void Menu::add(MenuItem* item) {
     items[itemNo-1] = item;
 }
 
-long lastInputMillis = 0;
+PER_DEVICE long lastInputMillis = 0;
 void Menu::run(int batteryLevel) {
     if (type == MENU_T_CLOCK) {
         setClock(this);
@@ -753,8 +770,6 @@ void Menu::run(int batteryLevel) {
     bool done = false;
     while (!done) {
         InputType input = getInput(sameLastInputs);
-        InputType* p = &input;
-        Serial.println(int(p));
         long dt = millis() - lastInputMillis;
         lastInputMillis = millis();
         if (input == lastInput && dt <= 700) {
@@ -5,8 +5,10 @@
 #include <RTClib.h>
 #include <Adafruit_SharpMem.h>
 
-extern Adafruit_SharpMem *menu_display;
-extern RTC_PCF8523 *menu_rtc;
+#include "PerDevice.h"
+
+extern PER_DEVICE Adafruit_SharpMem *menu_display;
+extern PER_DEVICE RTC_PCF8523 *menu_rtc;
 
 constexpr uint8_t BLACK = 0;
 constexpr uint8_t WHITE = 1;
@@ -27,7 +29,8 @@ typedef enum {
     ITEM_T_FLOAT,
     ITEM_T_BOOL,
     ITEM_T_LIST,
-    ITEM_T_SUBMENU
+    ITEM_T_SUBMENU,
+    ITEM_T_INFO
 } ItemType;
 
 typedef enum {
@@ -53,6 +56,7 @@ typedef struct MenuItem {
     MenuItem(const char *name, int8_t* idx, const char** list, int listLen);
     MenuItem(const char *name, uint8_t* idx, const char** list, int listLen);
     MenuItem(const char *name, Menu *submenu);
+    MenuItem(const char *name, const char *text);
     ~MenuItem();
 
     const char *name;
@@ -103,6 +107,7 @@ typedef struct Menu {
     void add(const char *name, uint8_t* idx, const char** list, int listLen);
     void add(const char *name, int8_t* idx, const char** list, int listLen);
     void add(const char *name, Menu *submenu);
+    void add(const char *name, const char *text);
     void add(MenuItem* item);
     void run(int batteryLevel = -1);
 } Menu;
@@ -0,0 +1,16 @@
+#ifndef PER_DEVICE_H
+#define PER_DEVICE_H
+
+// Marks state that belongs to the feeder rather than to the program: the
+// module variables the handlers share with the main loop. A feeder has
+// one copy in static RAM. Host builds keep one per thread, so a tool can
+// run several feeders in one process, each on its own thread (see
+// tools/native/sim.h).
+
+#if defined(__arm__)
+#define PER_DEVICE
+#else
+#define PER_DEVICE thread_local
+#endif
+
+#endif
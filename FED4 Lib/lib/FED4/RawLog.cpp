@@ -0,0 +1,50 @@
+#include "RawLog.h"
+
+// The extent must lie within the file's size so every byte written is
+// visible through FAT. Loads the block that position falls in.
+bool rawOpen(RawLog &raw, SdCard *card, uint32_t firstSector, uint32_t sectors, uint32_t position) {
+    if (sectors == 0) return false;
+    raw.firstSector = firstSector;
+    raw.lastSector = firstSector + sectors - 1;
+    if (position > rawCapacity(raw)) return false;
+
+    raw.sector = raw.firstSector + position / RAW_BLOCK;
+    raw.fill = position % RAW_BLOCK;
+    memset(raw.block, 0, sizeof(raw.block));
+    if (raw.fill > 0 && !card->readSector(raw.sector, raw.block)) return false;
+    memset(raw.block + raw.fill, 0, RAW_BLOCK - raw.fill);
+    return true;
+}
+
+uint32_t rawPosition(const RawLog &raw) {
+    return (raw.sector - raw.firstSector) * RAW_BLOCK + raw.fill;
+}
+
+uint32_t rawCapacity(const RawLog &raw) {
+    return (raw.lastSector - raw.firstSector + 1) * RAW_BLOCK;
+}
+
+bool rawWrite(RawLog &raw, SdCard *card, const void *data, size_t len) {
+    if (rawPosition(raw) + len > rawCapacity(raw)) return false;
+    if (!card->writeStart(raw.sector)) return false;
+
+    const uint8_t *src = (const uint8_t*)data;
+    while (len > 0) {
+        size_t n = min(len, (size_t)(RAW_BLOCK - raw.fill));
+        memcpy(raw.block + raw.fill, src, n);
+        raw.fill += n;
+        src += n;
+        len -= n;
+
+        if (!card->writeData(raw.block)) {
+            card->writeStop();
+            return false;
+        }
+        if (raw.fill == RAW_BLOCK) {
+            raw.sector++;
+            raw.fill = 0;
+            memset(raw.block, 0, sizeof(raw.block));
+        }
+    }
+    return card->writeStop();
+}
@@ -0,0 +1,32 @@
+#ifndef RAWLOG_H
+#define RAWLOG_H
+
+// Raw-block writer for a preallocated, erased log segment. The segment's
+// extent is resolved once, then rows go straight to its sectors with the
+// card's multi-block write, skipping SdFat's cluster and cache handling.
+// The last partial block is kept in RAM, zero padded, and rewritten until
+// it fills, so the file stays a normal FAT file whose rows end at the
+// first erased byte.
+//
+// Only the RawLog may write the segment's data while it is open: SdFat's
+// cache is not told about the raw writes.
+
+#include <Arduino.h>
+#include <SdFat.h>
+
+constexpr uint16_t RAW_BLOCK = 512;
+
+typedef struct RawLog {
+    uint32_t firstSector;
+    uint32_t lastSector;
+    uint32_t sector;            // where block[] goes
+    uint16_t fill;              // bytes of block[] in use
+    uint8_t block[RAW_BLOCK];
+} RawLog;
+
+bool rawOpen(RawLog &raw, SdCard *card, uint32_t firstSector, uint32_t sectors, uint32_t position);
+bool rawWrite(RawLog &raw, SdCard *card, const void *data, size_t len);
+uint32_t rawPosition(const RawLog &raw);
+uint32_t rawCapacity(const RawLog &raw);
+
+#endif
@@ -0,0 +1,72 @@
+#include "SdStats.h"
+
+uint8_t sdBucket(uint32_t us) {
+    uint8_t bucket = 0;
+    uint32_t limit = SD_BUCKET_US;
+    while (bucket < SD_BUCKETS - 1 && us >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    return bucket;
+}
+
+// Upper bound of a bucket, UINT32_MAX for the last one
+uint32_t sdBucketLimit(uint8_t bucket) {
+    if (bucket >= SD_BUCKETS - 1) return UINT32_MAX;
+    return SD_BUCKET_US << bucket;
+}
+
+// Upper bound of the bucket the pct-th percentile falls in, or the lower
+// bound of the last bucket, which has none
+uint32_t sdPercentile(const uint32_t hist[SD_BUCKETS], uint8_t pct) {
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < SD_BUCKETS; i++) {
+        count += hist[i];
+    }
+    if (count == 0) return 0;
+
+    uint32_t rank = (count * pct + 99) / 100;
+    uint32_t seen = 0;
+    uint8_t i = 0;
+    for (; i < SD_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= rank) break;
+    }
+    return i < SD_BUCKETS - 1 ? sdBucketLimit(i) : sdBucketLimit(SD_BUCKETS - 2);
+}
+
+bool sdRecord(SdStats &stats, uint8_t op, uint32_t us, uint32_t now) {
+    uint8_t bucket = sdBucket(us);
+    stats.ops++;
+    stats.total[bucket]++;
+    stats.rolling[bucket]++;
+    stats.rollingOps++;
+
+    if (us > stats.worstUs) {
+        stats.worstUs = us;
+        stats.worstOp = op;
+        stats.worstT = now;
+    }
+    if (us >= SD_STALL_US) {
+        stats.stalls++;
+        stats.rollingStalls++;
+    }
+
+    if (stats.rollingOps >= SD_ROLL_OPS) {
+        for (uint8_t i = 0; i < SD_BUCKETS; i++) {
+            stats.rolling[i] /= 2;
+        }
+        stats.rollingOps /= 2;
+        stats.rollingStalls /= 2;
+    }
+
+    if (stats.degraded) return false;
+    if (
+        stats.rollingStalls >= SD_STALL_LIMIT
+        || (stats.rollingOps >= SD_MIN_OPS && sdPercentile(stats.rolling, 95) > SD_SLOW_US)
+    ) {
+        stats.degraded = true;
+        return true;
+    }
+    return false;
+}
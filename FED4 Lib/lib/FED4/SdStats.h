@@ -0,0 +1,51 @@
+#ifndef SDSTATS_H
+#define SDSTATS_H
+
+// SD card latency monitor. Every timed card operation lands in a session
+// histogram and in a rolling one that halves every SD_ROLL_OPS operations,
+// so it follows the card's recent behaviour. A card whose recent 95th
+// percentile is slow, or that stalls repeatedly, is flagged as degraded
+// for the rest of the session.
+//
+// Plain C++ so tools/sdbench can share the buckets and thresholds.
+
+#include <stdint.h>
+
+// Bucket 0 holds operations under SD_BUCKET_US, bucket i under
+// SD_BUCKET_US << i, the last one everything slower
+constexpr uint8_t SD_BUCKETS        = 13;
+constexpr uint32_t SD_BUCKET_US     = 256;
+constexpr uint32_t SD_SLOW_US       = 100000; // rolling p95 above this degrades
+constexpr uint32_t SD_STALL_US      = 500000;
+constexpr uint8_t SD_STALL_LIMIT    = 3;      // stalls in the rolling window
+constexpr uint16_t SD_ROLL_OPS      = 256;
+constexpr uint16_t SD_MIN_OPS       = 32;     // before the rolling p95 counts
+
+namespace SdOp {
+    constexpr uint8_t WRITE = 0;  // buffer to the card
+    constexpr uint8_t SYNC  = 1;  // truncate, close and reopen
+    constexpr uint8_t OPEN  = 2;
+    constexpr uint8_t COUNT = 3;
+    constexpr const char* NAMES[COUNT] = {"write", "sync", "open"};
+};
+
+typedef struct SdStats {
+    uint32_t ops;
+    uint32_t stalls;
+    uint32_t worstUs;
+    uint8_t worstOp;
+    uint32_t worstT;            // millis() of the worst operation
+    uint32_t total[SD_BUCKETS];
+    uint32_t rolling[SD_BUCKETS];
+    uint16_t rollingOps;
+    uint8_t rollingStalls;
+    bool degraded;
+} SdStats;
+
+// Returns true when this operation marked the card as degraded
+bool sdRecord(SdStats &stats, uint8_t op, uint32_t us, uint32_t now);
+uint8_t sdBucket(uint32_t us);
+uint32_t sdBucketLimit(uint8_t bucket);
+uint32_t sdPercentile(const uint32_t hist[SD_BUCKETS], uint8_t pct);
+
+#endif
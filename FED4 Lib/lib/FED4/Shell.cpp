@@ -0,0 +1,95 @@
+#include "Shell.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static void shell_add(Shell &shell, const char* name, ShellVarType type, void* value, float min, float max) {
+    if (shell.count >= SHELL_MAX_VARS) return;
+
+    ShellVar &var = shell.vars[shell.count++];
+    strncpy(var.name, name, SHELL_NAME_LEN - 1);
+    var.name[SHELL_NAME_LEN - 1] = '\0';
+    var.type = type;
+    var.value = value;
+    var.minValue = min;
+    var.maxValue = max;
+}
+
+void shellAdd(Shell &shell, const char* name, uint8_t* value, uint8_t min, uint8_t max) {
+    shell_add(shell, name, SHELL_T_UINT8, value, min, max);
+}
+
+void shellAdd(Shell &shell, const char* name, float* value, float min, float max) {
+    shell_add(shell, name, SHELL_T_FLOAT, value, min, max);
+}
+
+void shellAdd(Shell &shell, const char* name, bool* value) {
+    shell_add(shell, name, SHELL_T_BOOL, value, 0, 1);
+}
+
+uint8_t shellSplit(char* line, char* argv[SHELL_MAX_ARGS]) {
+    uint8_t argc = 0;
+    char* p = line;
+    while (*p != '\0' && argc < SHELL_MAX_ARGS) {
+        while (isspace((unsigned char)*p)) *p++ = '\0';
+        if (*p == '\0') break;
+        argv[argc++] = p;
+        while (*p != '\0' && !isspace((unsigned char)*p)) p++;
+    }
+    return argc;
+}
+
+ShellVar* shellFind(Shell &shell, const char* name) {
+    for (uint8_t i = 0; i < shell.count; i++) {
+        if (strcasecmp(shell.vars[i].name, name) == 0) return &shell.vars[i];
+    }
+    return nullptr;
+}
+
+int shellFormat(const ShellVar &var, char* out, size_t len) {
+    switch (var.type) {
+    case SHELL_T_UINT8:
+        return snprintf(out, len, "%u", *(uint8_t*)var.value);
+    case SHELL_T_FLOAT:
+        return snprintf(out, len, "%.2f", *(float*)var.value);
+    case SHELL_T_BOOL:
+        return snprintf(out, len, "%s", *(bool*)var.value ? "on" : "off");
+    }
+    return 0;
+}
+
+bool shellSet(ShellVar &var, const char* text, char* err, size_t len) {
+    if (var.type == SHELL_T_BOOL) {
+        bool on = strcasecmp(text, "on") == 0 || strcasecmp(text, "true") == 0 || strcmp(text, "1") == 0;
+        bool off = strcasecmp(text, "off") == 0 || strcasecmp(text, "false") == 0 || strcmp(text, "0") == 0;
+        if (!on && !off) {
+            snprintf(err, len, "%s takes on or off", var.name);
+            return false;
+        }
+        *(bool*)var.value = on;
+        return true;
+    }
+
+    char* end;
+    float x = strtof(text, &end);
+    if (end == text || *end != '\0') {
+        snprintf(err, len, "%s: not a number", text);
+        return false;
+    }
+    if (x < var.minValue || x > var.maxValue || (var.type == SHELL_T_UINT8 && x != (float)(int)x)) {
+        if (var.type == SHELL_T_UINT8) {
+            snprintf(err, len, "%s takes a whole number from %d to %d", var.name, (int)var.minValue, (int)var.maxValue);
+        }
+        else {
+            snprintf(err, len, "%s takes %.2f to %.2f", var.name, var.minValue, var.maxValue);
+        }
+        return false;
+    }
+
+    if (var.type == SHELL_T_UINT8) *(uint8_t*)var.value = (uint8_t)x;
+    else *(float*)var.value = x;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+// Settings for the serial command shell. Like the menus, each entry points
+// at the variable it edits, with its bounds, so get and set work on the
+// live value while the session runs. Entries are kept in a fixed table
+// and parsed in place: nothing here allocates.
+//
+// Plain C++; FED4 feeds it the command lines that come in as telemetry
+// frames, see Telemetry.h.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint8_t SHELL_MAX_VARS = 16;
+constexpr uint8_t SHELL_MAX_ARGS = 4;
+constexpr uint8_t SHELL_NAME_LEN = 24;
+
+typedef enum {
+    SHELL_T_UINT8,
+    SHELL_T_FLOAT,
+    SHELL_T_BOOL
+} ShellVarType;
+
+typedef struct ShellVar {
+    char name[SHELL_NAME_LEN];
+    ShellVarType type;
+    void* value;
+    float minValue;
+    float maxValue;
+} ShellVar;
+
+typedef struct Shell {
+    ShellVar vars[SHELL_MAX_VARS];
+    uint8_t count;
+} Shell;
+
+void shellAdd(Shell &shell, const char* name, uint8_t* value, uint8_t min, uint8_t max);
+void shellAdd(Shell &shell, const char* name, float* value, float min, float max);
+void shellAdd(Shell &shell, const char* name, bool* value);
+
+// Splits a line on spaces, in place. Returns the number of words.
+uint8_t shellSplit(char* line, char* argv[SHELL_MAX_ARGS]);
+// Names match without regard to case
+ShellVar* shellFind(Shell &shell, const char* name);
+int shellFormat(const ShellVar &var, char* out, size_t len);
+// Checks the text against the type and bounds before writing the value.
+// On failure the reason is left in err.
+bool shellSet(ShellVar &var, const char* text, char* err, size_t len);
+
+#endif
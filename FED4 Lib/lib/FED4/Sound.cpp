@@ -0,0 +1,106 @@
+#include "Sound.h"
+#include "PerDevice.h"
+#include <wiring_private.h>
+
+constexpr uint32_t SOUND_CLOCK = F_CPU / 8;
+
+static PER_DEVICE const SoundNote *volatile notes = nullptr;
+static PER_DEVICE volatile uint8_t noteCount = 0;
+static PER_DEVICE volatile uint8_t noteIdx = 0;
+static PER_DEVICE volatile uint16_t noteT = 0;     // ms into the current note
+static PER_DEVICE volatile bool noteStart = false;
+static PER_DEVICE uint32_t period = 0;
+
+static void sound_sync() {
+    while (TCC1->SYNCBUSY.reg);
+}
+
+static void sound_enable(bool on) {
+    if (on) TCC1->CTRLA.reg |= TCC_CTRLA_ENABLE;
+    else TCC1->CTRLA.reg &= ~TCC_CTRLA_ENABLE;
+    sound_sync();
+}
+
+void soundBegin(uint8_t pin) {
+    notes = nullptr;
+    noteCount = 0;
+    noteStart = false;
+
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC0_TCC1;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+    TCC1->CTRLA.reg = TCC_CTRLA_SWRST;
+    while (TCC1->SYNCBUSY.bit.SWRST);
+
+    TCC1->CTRLA.reg = TCC_CTRLA_PRESCALER_DIV8;
+    TCC1->WAVE.reg = TCC_WAVE_WAVEGEN_NPWM;
+    sound_sync();
+
+    // Buzzer on PA11, TCC1/WO[1]
+    pinPeripheral(pin, PIO_TIMER);
+}
+
+void soundPlay(const SoundNote *seq, uint8_t len) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    notes = len > 0 ? seq : nullptr;
+    noteCount = len;
+    noteIdx = 0;
+    noteT = 0;
+    noteStart = true;
+    __set_PRIMASK(primask);
+}
+
+void soundStop() {
+    soundPlay(nullptr, 0);
+}
+
+bool soundPlaying() {
+    return notes != nullptr;
+}
+
+void soundService() {
+    if (notes == nullptr) {
+        if (noteStart) {
+            noteStart = false;
+            sound_enable(false);
+        }
+        return;
+    }
+
+    if (noteStart) {
+        noteStart = false;
+        period = 0;
+    }
+    else {
+        noteT += SOUND_PERIOD;
+    }
+    while (noteT >= notes[noteIdx].ms) {
+        noteT -= notes[noteIdx].ms;
+        period = 0;
+        if (++noteIdx >= noteCount) {
+            notes = nullptr;
+            sound_enable(false);
+            return;
+        }
+    }
+
+    const SoundNote &note = notes[noteIdx];
+    if (note.hz == 0) {
+        TCC1->CCB[1].reg = 0;
+        return;
+    }
+
+    if (period == 0) {
+        period = SOUND_CLOCK / note.hz - 1;
+        TCC1->PERB.reg = period;
+        if (!(TCC1->CTRLA.reg & TCC_CTRLA_ENABLE)) {
+            TCC1->PER.reg = period;
+            sound_enable(true);
+        }
+    }
+
+    // Volume is the duty cycle, up to a square wave at 100
+    int32_t vol = note.vol + ((int32_t)note.end - note.vol) * noteT / note.ms;
+    TCC1->CCB[1].reg = period * vol / 200;
+}
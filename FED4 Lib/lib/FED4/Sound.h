@@ -0,0 +1,27 @@
+#ifndef SOUND_H
+#define SOUND_H
+
+// Buzzer sequencer. TCC1 drives the buzzer pin with PWM: the period sets
+// the pitch and the duty cycle the volume. A service tick job steps
+// through the notes and ramps the volume within each note, so playing a
+// sequence costs the main loop nothing.
+
+#include <Arduino.h>
+
+constexpr uint8_t SOUND_MAX_NOTES = 8;
+constexpr uint16_t SOUND_PERIOD   = 2;  // ms between envelope steps
+
+typedef struct SoundNote {
+    uint16_t hz;        // 0 for a rest
+    uint16_t ms;
+    uint8_t vol;        // 0-100 at the start of the note
+    uint8_t end;        // 0-100 at the end, linear in between
+} SoundNote;
+
+void soundBegin(uint8_t pin);
+void soundPlay(const SoundNote *notes, uint8_t len);
+void soundStop();
+bool soundPlaying();
+void soundService();
+
+#endif
@@ -0,0 +1,118 @@
+#include "Summary.h"
+
+#include <string.h>
+
+void p2Init(P2Quantile &est, float p) {
+    memset(&est, 0, sizeof(est));
+    est.p = p;
+}
+
+void p2Add(P2Quantile &est, float x) {
+    if (est.count < 5) {
+        // Insertion sort of the first samples, which become the markers
+        uint8_t i = est.count++;
+        while (i > 0 && est.q[i - 1] > x) {
+            est.q[i] = est.q[i - 1];
+            i--;
+        }
+        est.q[i] = x;
+        if (est.count == 5) {
+            float p = est.p;
+            for (uint8_t m = 0; m < 5; m++) est.n[m] = m;
+            est.np[0] = 0;
+            est.np[1] = 2 * p;
+            est.np[2] = 4 * p;
+            est.np[3] = 2 + 2 * p;
+            est.np[4] = 4;
+        }
+        return;
+    }
+
+    uint8_t k;
+    if (x < est.q[0]) {
+        est.q[0] = x;
+        k = 0;
+    }
+    else if (x >= est.q[4]) {
+        est.q[4] = x;
+        k = 3;
+    }
+    else {
+        k = 0;
+        while (k < 3 && x >= est.q[k + 1]) k++;
+    }
+    for (uint8_t m = k + 1; m < 5; m++) est.n[m] += 1;
+
+    const float dn[5] = {0, est.p / 2, est.p, (1 + est.p) / 2, 1};
+    for (uint8_t m = 0; m < 5; m++) est.np[m] += dn[m];
+
+    for (uint8_t m = 1; m < 4; m++) {
+        float d = est.np[m] - est.n[m];
+        if (
+            (d >= 1 && est.n[m + 1] - est.n[m] > 1)
+            || (d <= -1 && est.n[m - 1] - est.n[m] < -1)
+        ) {
+            float s = d > 0 ? 1 : -1;
+            float *q = est.q;
+            float *n = est.n;
+            float parabolic = q[m] + s / (n[m + 1] - n[m - 1]) * (
+                (n[m] - n[m - 1] + s) * (q[m + 1] - q[m]) / (n[m + 1] - n[m])
+                + (n[m + 1] - n[m] - s) * (q[m] - q[m - 1]) / (n[m] - n[m - 1])
+            );
+            if (q[m - 1] < parabolic && parabolic < q[m + 1]) {
+                q[m] = parabolic;
+            }
+            else {
+                uint8_t j = s > 0 ? m + 1 : m - 1;
+                q[m] += s * (q[j] - q[m]) / (n[j] - n[m]);
+            }
+            n[m] += s;
+        }
+    }
+    est.count++;
+}
+
+// The middle marker, or the nearest sample while there are fewer than five
+float p2Value(const P2Quantile &est) {
+    if (est.count == 0) return 0;
+    if (est.count < 5) return est.q[(uint8_t)(est.p * (est.count - 1) + 0.5f)];
+    return est.q[2];
+}
+
+void summaryReset(Summary &summary, uint32_t nowUnix) {
+    bool windowOpen = summary.windowOpen;
+    uint32_t lastPokeMs = summary.lastPokeMs;
+
+    memset(&summary, 0, sizeof(summary));
+    summary.startUnix = nowUnix;
+    summary.windowOpen = windowOpen;
+    summary.windowMarkUnix = nowUnix;
+    summary.lastPokeMs = lastPokeMs;
+    p2Init(summary.ipi50, 0.5f);
+    p2Init(summary.ipi90, 0.9f);
+    p2Init(summary.dispense50, 0.5f);
+}
+
+void summaryPoke(Summary &summary, uint8_t sensor, uint32_t nowMs) {
+    if (sensor < SUMMARY_MAX_SENSORS) summary.pokes[sensor]++;
+    if (summary.lastPokeMs != 0) {
+        float interval = nowMs - summary.lastPokeMs;
+        p2Add(summary.ipi50, interval);
+        p2Add(summary.ipi90, interval);
+    }
+    summary.lastPokeMs = nowMs != 0 ? nowMs : 1;
+}
+
+void summaryPellet(Summary &summary, uint32_t dispenseMs) {
+    summary.pellets++;
+    p2Add(summary.dispense50, dispenseMs);
+    if (dispenseMs > summary.dispenseMaxMs) summary.dispenseMaxMs = dispenseMs;
+}
+
+void summaryWindow(Summary &summary, bool open, uint32_t nowUnix) {
+    if (summary.windowOpen && nowUnix > summary.windowMarkUnix) {
+        summary.windowS += nowUnix - summary.windowMarkUnix;
+    }
+    summary.windowMarkUnix = nowUnix;
+    summary.windowOpen = open;
+}
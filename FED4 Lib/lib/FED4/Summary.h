@@ -0,0 +1,51 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+// Running session summary kept alongside the event log: pokes per sensor,
+// pellets, jams, how long the feeding window was open, and quantiles of
+// the inter-poke interval and of the dispense time. FED4 closes a row every
+// hour and whenever the window opens or closes, and appends it to
+// SUMnn.csv, so hourly bins do not need the full event log.
+//
+// Quantiles use the P² estimator (Jain and Chlamtac, 1985): five markers
+// per quantile, whatever the number of samples.
+
+#include <stdint.h>
+
+constexpr uint8_t SUMMARY_MAX_SENSORS = 4;
+
+typedef struct P2Quantile {
+    float p;
+    float q[5];         // marker heights, the first samples until count = 5
+    float n[5];         // marker positions
+    float np[5];        // desired positions
+    uint32_t count;
+} P2Quantile;
+
+typedef struct Summary {
+    uint32_t startUnix;
+    uint32_t pokes[SUMMARY_MAX_SENSORS];
+    uint32_t pellets;
+    uint32_t jams;
+    uint32_t windowS;           // seconds the feeding window was open
+    bool windowOpen;
+    uint32_t windowMarkUnix;    // last time windowS was brought up to date
+    uint32_t lastPokeMs;        // carried over between rows, 0 = none yet
+    P2Quantile ipi50;           // inter-poke interval, ms
+    P2Quantile ipi90;
+    P2Quantile dispense50;      // motor start to pellet in the well, ms
+    uint32_t dispenseMaxMs;
+} Summary;
+
+void p2Init(P2Quantile &est, float p);
+void p2Add(P2Quantile &est, float x);
+float p2Value(const P2Quantile &est);
+
+// Starts a new row; the window state and the last poke carry over
+void summaryReset(Summary &summary, uint32_t nowUnix);
+void summaryPoke(Summary &summary, uint8_t sensor, uint32_t nowMs);
+void summaryPellet(Summary &summary, uint32_t dispenseMs);
+// Counts the time since the last call against the old window state
+void summaryWindow(Summary &summary, bool open, uint32_t nowUnix);
+
+#endif
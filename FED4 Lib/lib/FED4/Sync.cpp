@@ -0,0 +1,149 @@
+#include "Sync.h"
+#include "PerDevice.h"
+
+constexpr uint32_t SYNC_TICKS_PER_US = F_CPU / 16 / 1000000;
+
+static PER_DEVICE uint8_t pin = 0xFF;
+static PER_DEVICE uint16_t widthTicks = 0;
+static PER_DEVICE uint16_t gapTicks = 0;
+static PER_DEVICE uint16_t sepTicks = 0;
+static PER_DEVICE volatile uint8_t edgesLeft = 0;
+static PER_DEVICE volatile bool level = false;
+static PER_DEVICE volatile bool separating = false;
+static PER_DEVICE volatile uint32_t overruns = 0;
+
+// Trains started while another is running, sent after it
+static PER_DEVICE SyncMark waiting[SYNC_QUEUE];
+static PER_DEVICE volatile uint8_t waitHead = 0;
+static PER_DEVICE volatile uint8_t waitTail = 0;
+
+static PER_DEVICE SyncMark queue[SYNC_QUEUE];
+static PER_DEVICE volatile uint8_t queueHead = 0;  // written by the handlers
+static PER_DEVICE volatile uint8_t queueTail = 0;  // read by the main loop
+
+static uint16_t sync_ticks(uint16_t us) {
+    us = constrain(us, (uint16_t)1, SYNC_MAX_US);
+    return us * SYNC_TICKS_PER_US - 1;
+}
+
+static void sync_wait() {
+    while (TC4->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+void syncBegin(uint8_t outPin, uint16_t widthUs, uint16_t gapUs) {
+    pin = outPin;
+    edgesLeft = 0;
+    level = false;
+    separating = false;
+    waitHead = waitTail = 0;
+    queueHead = queueTail = 0;
+    widthTicks = sync_ticks(widthUs);
+    gapTicks = sync_ticks(gapUs);
+    uint32_t sepUs = (uint32_t)gapUs * SYNC_SEPARATION;
+    sepTicks = sync_ticks(sepUs > SYNC_MAX_US ? SYNC_MAX_US : sepUs);
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TC4_TC5;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+    TC4->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC4->COUNT16.CTRLA.bit.SWRST);
+
+    TC4->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV16;
+    sync_wait();
+    TC4->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+
+    NVIC_SetPriority(TC4_IRQn, 0);
+    NVIC_SetPriority(EIC_IRQn, 1);
+    NVIC_SetPriority(RTC_IRQn, 1);
+    NVIC_SetPriority(TC3_IRQn, 1);
+    NVIC_EnableIRQ(TC4_IRQn);
+}
+
+// Sets the first edge and hands the rest of the train to TC4. Interrupts
+// are masked by the caller.
+static void sync_start(uint8_t event, uint8_t pulses) {
+    digitalWrite(pin, HIGH);
+    uint32_t now = micros();
+    level = true;
+    separating = false;
+    edgesLeft = pulses * 2 - 1;
+    TC4->COUNT16.COUNT.reg = 0;
+    TC4->COUNT16.CC[0].reg = widthTicks;
+    TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+    TC4->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+
+    uint8_t next = (queueHead + 1) % SYNC_QUEUE;
+    if (next != queueTail) {
+        queue[queueHead] = {now, event, pulses};
+        queueHead = next;
+    }
+}
+
+bool syncPulse(uint8_t event, uint8_t pulses) {
+    if (pin == 0xFF || pulses == 0) return false;
+    pulses = min(pulses, SYNC_MAX_PULSES);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool ok = true;
+    if (edgesLeft > 0 || separating) {
+        uint8_t next = (waitHead + 1) % SYNC_QUEUE;
+        if (next == waitTail) {
+            overruns++;
+            ok = false;
+        }
+        else {
+            waiting[waitHead] = {0, event, pulses};
+            waitHead = next;
+        }
+    }
+    else {
+        sync_start(event, pulses);
+    }
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+bool syncBusy() {
+    return edgesLeft > 0 || separating || waitHead != waitTail;
+}
+
+bool syncNext(SyncMark &mark) {
+    if (queueTail == queueHead) return false;
+    mark = queue[queueTail];
+    queueTail = (queueTail + 1) % SYNC_QUEUE;
+    return true;
+}
+
+uint32_t syncOverruns() {
+    return overruns;
+}
+
+extern "C" void TC4_Handler() {
+    TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+    if (separating) {
+        SyncMark next = waiting[waitTail];
+        waitTail = (waitTail + 1) % SYNC_QUEUE;
+        sync_start(next.event, next.pulses);
+        return;
+    }
+    if (edgesLeft == 0) return;
+
+    level = !level;
+    digitalWrite(pin, level ? HIGH : LOW);
+    if (--edgesLeft == 0) {
+        if (waitHead == waitTail) {
+            TC4->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+            return;
+        }
+        // Hold low for SYNC_SEPARATION gaps so the next train reads as a
+        // train of its own
+        separating = true;
+        TC4->COUNT16.CC[0].reg = sepTicks;
+        return;
+    }
+    // The count restarts at the match, so the next edge is one CC[0] away
+    TC4->COUNT16.CC[0].reg = level ? widthTicks : gapTicks;
+}
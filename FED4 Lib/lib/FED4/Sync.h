@@ -0,0 +1,37 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+// TTL sync output for aligning feeder events with recordings. A train of
+// one or more pulses is started from the handler of the event it marks:
+// the first edge is set there, and TC4 times every edge after it. TC4 runs
+// at the highest interrupt priority, with the pin, alarm and service tick
+// interrupts lowered below it, so pulse widths and gaps do not depend on
+// what those handlers or the main loop do next. FED4 leaves the pin lines
+// of sensors that send trains unmasked while it writes the log, so the
+// first edge does not wait for the card either. A train asked for while
+// another is running follows it after a longer low gap. The start of every
+// train, in micros(), is queued for the log.
+
+#include <Arduino.h>
+
+constexpr uint8_t SYNC_MAX_PULSES   = 8;
+constexpr uint16_t SYNC_WIDTH_US    = 1000;
+constexpr uint16_t SYNC_GAP_US      = 1000;
+constexpr uint16_t SYNC_MAX_US      = 20000; // longest width or gap, TC4 at 3 MHz
+constexpr uint8_t SYNC_SEPARATION   = 5;     // gaps between back-to-back trains
+constexpr uint8_t SYNC_QUEUE        = 8;     // trains waiting to be sent or logged
+
+typedef struct SyncMark {
+    uint32_t us;        // micros() at the first rising edge
+    uint8_t event;
+    uint8_t pulses;
+} SyncMark;
+
+void syncBegin(uint8_t pin, uint16_t widthUs, uint16_t gapUs);
+// Returns false, and counts an overrun, when SYNC_QUEUE trains are waiting
+bool syncPulse(uint8_t event, uint8_t pulses);
+bool syncBusy();
+bool syncNext(SyncMark &mark);
+uint32_t syncOverruns();
+
+#endif
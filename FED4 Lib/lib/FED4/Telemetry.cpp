@@ -0,0 +1,86 @@
+#include "Telemetry.h"
+
+#include "LogBlock.h"
+
+// COBS encoder fed one byte at a time, so the frame never needs a second,
+// unencoded copy
+typedef struct CobsWriter {
+    uint8_t* out;
+    size_t pos;
+    size_t codePos;
+    uint8_t code;
+} CobsWriter;
+
+static void cobs_begin(CobsWriter &w, uint8_t* out) {
+    w.out = out;
+    w.codePos = 0;
+    w.pos = 1;
+    w.code = 1;
+}
+
+static void cobs_put(CobsWriter &w, uint8_t b) {
+    if (b != 0) {
+        w.out[w.pos++] = b;
+        w.code++;
+    }
+    if (b == 0 || w.code == 0xFF) {
+        w.out[w.codePos] = w.code;
+        w.codePos = w.pos++;
+        w.code = 1;
+    }
+}
+
+static void cobs_write(CobsWriter &w, uint32_t &crc, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    crc = crc32Update(crc, p, len);
+    for (size_t i = 0; i < len; i++) cobs_put(w, p[i]);
+}
+
+static size_t cobs_end(CobsWriter &w) {
+    w.out[w.codePos] = w.code;
+    w.out[w.pos++] = 0;
+    return w.pos;
+}
+
+size_t telemEncode(
+    uint8_t* out, uint8_t type, uint8_t device, uint16_t seq,
+    const void* payload, size_t len
+) {
+    if (len > TELEM_MAX_PAYLOAD) return 0;
+
+    uint8_t header[4] = {type, device, (uint8_t)seq, (uint8_t)(seq >> 8)};
+    uint32_t crc = 0;
+    CobsWriter w;
+    cobs_begin(w, out);
+    cobs_write(w, crc, header, sizeof(header));
+    cobs_write(w, crc, payload, len);
+
+    uint8_t trailer[4] = {(uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24)};
+    uint32_t unused = 0;
+    cobs_write(w, unused, trailer, sizeof(trailer));
+    return cobs_end(w);
+}
+
+bool telemDecode(uint8_t* buf, size_t len, TelemFrame &frame) {
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        uint8_t code = buf[in++];
+        if (code == 0 || in + code - 1 > len) return false;
+        for (uint8_t i = 1; i < code; i++) buf[out++] = buf[in++];
+        if (code != 0xFF && in < len) buf[out++] = 0;
+    }
+    if (out < TELEM_FRAME_OVERHEAD) return false;
+
+    size_t body = out - 4;
+    uint32_t crc = (uint32_t)buf[body] | (uint32_t)buf[body + 1] << 8
+        | (uint32_t)buf[body + 2] << 16 | (uint32_t)buf[body + 3] << 24;
+    if (crc32Update(0, buf, body) != crc) return false;
+
+    frame.type = buf[0];
+    frame.device = buf[1];
+    frame.seq = buf[2] | buf[3] << 8;
+    frame.payload = buf + 4;
+    frame.len = body - 4;
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Serial telemetry frames. Before encoding a frame is
+//
+//   type u8, device u8, seq u16, payload, crc u32
+//
+// little endian, with the CRC-32 of LogBlock.h over everything before it.
+// Frames are COBS encoded and each is followed by a 0x00 byte, so a
+// receiver that starts mid-stream or loses bytes picks up at the next
+// zero. Sequence numbers run per boot; a gap is frames the feeder dropped
+// because its ring was full or over the rate limit.
+//
+// The host sends requests the same way, with device TELEM_ANY_DEVICE or
+// the feeder's number. A fetch streams a file back as chunk frames, each
+// with the CRC-32 of its bytes before compression (Lzss.h). Chunks go out
+// only between events and when the ring has room, and a new fetch, or the
+// port closing, ends the one before, so a download resumes by fetching
+// again from the last offset written. A command is one line for the
+// feeder's shell (Shell.h); the reply holds the command's sequence number
+// and then the text.
+//
+// Plain C++ so tools/telemd can share the format.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint8_t TELEM_VERSION         = 1;
+constexpr uint8_t TELEM_MAX_SENSORS     = 4;
+constexpr uint8_t TELEM_ANY_DEVICE      = 0xFF;
+constexpr uint8_t TELEM_MAX_NAME        = 32;
+constexpr size_t TELEM_MAX_PAYLOAD      = 500; // a log row
+constexpr size_t TELEM_FRAME_OVERHEAD   = 8;   // header and CRC
+constexpr size_t TELEM_MAX_ENCODED      =
+    TELEM_MAX_PAYLOAD + TELEM_FRAME_OVERHEAD + (TELEM_MAX_PAYLOAD + TELEM_FRAME_OVERHEAD) / 254 + 2;
+
+namespace TelemType {
+    constexpr uint8_t HELLO    = 1; // TelemHello, then the log's column header
+    constexpr uint8_t EVENT    = 2; // a log row as logEvent() writes it, no '\n'
+    constexpr uint8_t COUNTERS = 3; // TelemCounters
+    constexpr uint8_t FETCH    = 4; // to the feeder: TelemFetch, then the file name
+    constexpr uint8_t CHUNK    = 5; // TelemChunk, then the bytes
+    constexpr uint8_t COMMAND  = 6; // to the feeder: a shell command, no '\n'
+    constexpr uint8_t REPLY    = 7; // seq u16 of the command, then text
+};
+
+namespace TelemChunkFlag {
+    constexpr uint8_t LZSS     = 1 << 0;
+    constexpr uint8_t LAST     = 1 << 1; // the end of the file as it was when sent
+    constexpr uint8_t MISSING  = 1 << 2; // the file could not be opened
+};
+
+typedef struct TelemHello {
+    uint32_t session;       // boot time, as in the log's chain line
+    uint8_t version;
+    uint8_t sensorCount;
+    uint16_t reserved;
+} TelemHello;
+
+typedef struct TelemCounters {
+    uint32_t millis;
+    uint32_t unixTime;
+    uint32_t eventSeq;      // next "Seq" to be logged
+    uint32_t dropped;       // frames not sent since boot
+    uint16_t pellets;
+    uint16_t batteryMv;
+    uint16_t counts[TELEM_MAX_SENSORS];
+    uint8_t sensorCount;
+    uint8_t jammed;
+    uint16_t reserved;
+} TelemCounters;
+
+// No name fetches the open log segment, which ends at the last flush
+typedef struct TelemFetch {
+    uint32_t offset;
+    uint32_t length;        // 0 for the rest of the file
+} TelemFetch;
+
+typedef struct TelemChunk {
+    uint32_t offset;
+    uint32_t end;           // where this fetch stops
+    uint32_t crc;           // of the bytes once expanded
+    uint16_t len;           // expanded
+    uint8_t flags;
+    uint8_t reserved;
+} TelemChunk;
+
+typedef struct TelemFrame {
+    uint8_t type;
+    uint8_t device;
+    uint16_t seq;
+    const uint8_t* payload;
+    size_t len;
+} TelemFrame;
+
+// Encodes a frame with its 0x00 delimiter into out, which must hold
+// TELEM_MAX_ENCODED bytes. Returns the encoded length, 0 if len is too long.
+size_t telemEncode(
+    uint8_t* out, uint8_t type, uint8_t device, uint16_t seq,
+    const void* payload, size_t len
+);
+
+// Decodes the bytes between two delimiters in place and checks the CRC.
+// The payload points into buf.
+bool telemDecode(uint8_t* buf, size_t len, TelemFrame &frame);
+
+#endif
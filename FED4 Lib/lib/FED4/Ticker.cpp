@@ -0,0 +1,61 @@
+#include "Ticker.h"
+#include "PerDevice.h"
+
+typedef struct TickSlot {
+    TickJob job;
+    uint16_t period;
+    uint16_t count;
+} TickSlot;
+
+static PER_DEVICE TickSlot slots[TICKER_MAX_JOBS];
+static PER_DEVICE volatile uint8_t slotCount = 0;
+static PER_DEVICE volatile uint32_t ticks = 0;
+
+void tickerBegin() {
+    slotCount = 0;
+    ticks = 0;
+
+    GCLK->CLKCTRL.reg = GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 | GCLK_CLKCTRL_ID_TCC2_TC3;
+    while (GCLK->STATUS.bit.SYNCBUSY);
+
+    TC3->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+    while (TC3->COUNT16.CTRLA.bit.SWRST);
+
+    TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ | TC_CTRLA_PRESCALER_DIV64;
+    TC3->COUNT16.CC[0].reg = F_CPU / 64 / TICK_HZ - 1;
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+
+    TC3->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+    NVIC_EnableIRQ(TC3_IRQn);
+
+    TC3->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+    while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+bool tickerAttach(TickJob job, uint16_t periodMs) {
+    if (slotCount >= TICKER_MAX_JOBS || periodMs == 0) return false;
+
+    TickSlot &slot = slots[slotCount];
+    slot.job = job;
+    slot.period = periodMs;
+    slot.count = 0;
+    slotCount++;
+    return true;
+}
+
+uint32_t tickerMillis() {
+    return ticks;
+}
+
+extern "C" void TC3_Handler() {
+    TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+    ticks++;
+
+    for (uint8_t i = 0; i < slotCount; i++) {
+        TickSlot &slot = slots[i];
+        if (++slot.count >= slot.period) {
+            slot.count = 0;
+            slot.job();
+        }
+    }
+}
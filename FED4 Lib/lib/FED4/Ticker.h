@@ -0,0 +1,20 @@
+#ifndef TICKER_H
+#define TICKER_H
+
+// Millisecond service tick on TC3. Background jobs (ADC sampling, LED and
+// tone sequences) attach a callback with a period and run from its
+// interrupt, so they cost nothing on the main loop. TC3 is clocked from
+// GCLK0 and stops while the device is in standby.
+
+#include <Arduino.h>
+
+constexpr uint16_t TICK_HZ        = 1000;
+constexpr uint8_t TICKER_MAX_JOBS = 4;
+
+typedef void (*TickJob)();
+
+void tickerBegin();
+bool tickerAttach(TickJob job, uint16_t periodMs);
+uint32_t tickerMillis();
+
+#endif
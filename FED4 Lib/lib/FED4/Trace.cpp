@@ -0,0 +1,77 @@
+#include <Arduino.h>
+
+#include "Trace.h"
+
+// Not zeroed by the startup code, so the ring survives a reset. Only a
+// power cycle (or a corrupted header) starts it afresh. Host builds have
+// no such section and start each thread's ring zeroed.
+#if defined(__arm__)
+TraceRing traceRing __attribute__((section(".noinit")));
+#else
+PER_DEVICE TraceRing traceRing;
+#endif
+
+void traceInit() {
+    if (
+        traceRing.magic != TRACE_MAGIC
+        || traceRing.check != ~TRACE_MAGIC
+    ) {
+        memset(&traceRing, 0, sizeof(traceRing));
+        traceRing.magic = TRACE_MAGIC;
+        traceRing.check = ~TRACE_MAGIC;
+    }
+    traceRing.bootCount++;
+}
+
+void trace(uint8_t type, uint8_t arg, uint16_t data) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t t = millis();
+    TraceEntry *last = &traceRing.entries[(traceRing.head - 1) & (TRACE_LEN - 1)];
+    if (
+        traceRing.head != 0
+        && (type == TraceEv::RUN || type == TraceEv::MOTOR)
+        && last->type == type
+        && last->data == data
+    ) {
+        last->t = t;
+        if (last->arg < 0xFF) last->arg++;
+    }
+    else {
+        TraceEntry *e = &traceRing.entries[traceRing.head & (TRACE_LEN - 1)];
+        e->t = t;
+        e->type = type;
+        e->arg = arg;
+        e->data = data;
+        traceRing.head++;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+#if defined(__arm__)
+// Called from HardFault_Handler with the exception stack frame: r0-r3,
+// r12, lr, pc, xpsr. Keeps the faulting PC/LR for the next boot and resets
+// instead of spinning until the watchdog bites.
+extern "C" void trace_hard_fault(uint32_t *frame) {
+    traceRing.faultLr = frame[5];
+    traceRing.faultPc = frame[6];
+    trace(TraceEv::HARDFAULT);
+    NVIC_SystemReset();
+}
+
+extern "C" __attribute__((naked)) void HardFault_Handler(void) {
+    __asm volatile(
+        "movs r0, #4        \n"
+        "mov  r1, lr        \n"
+        "tst  r0, r1        \n"
+        "beq  1f            \n"
+        "mrs  r0, psp       \n"
+        "b    trace_hard_fault \n"
+        "1:                 \n"
+        "mrs  r0, msp       \n"
+        "b    trace_hard_fault \n"
+    );
+}
+#endif
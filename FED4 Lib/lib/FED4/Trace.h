@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Flight recorder: a small ring of timestamped events kept in RAM that is
+// not cleared at reset, so the last moments before a watchdog or fault
+// reset can be written to the SD card on the next boot.
+//
+// The file layout (TraceFileHeader followed by the entries, oldest first)
+// is shared with tools/tracedump.
+
+#include <stdint.h>
+
+#include "PerDevice.h"
+
+constexpr uint16_t TRACE_LEN         = 128; // entries, power of two
+constexpr uint32_t TRACE_MAGIC       = 0x54444546; // "FEDT"
+constexpr uint16_t TRACE_FILE_VER    = 1;
+
+namespace TraceEv {
+    constexpr uint8_t BOOT         = 1;  // arg: PM->RCAUSE, data: boot count
+    constexpr uint8_t RUN          = 2;  // coalesced, arg: repeats
+    constexpr uint8_t SLEEP        = 3;
+    constexpr uint8_t WAKE         = 4;
+    constexpr uint8_t ISR_SENSOR   = 5;  // arg: sensor index
+    constexpr uint8_t ISR_WELL     = 6;
+    constexpr uint8_t ISR_ALARM    = 7;
+    constexpr uint8_t SD_FLUSH     = 8;  // data: bytes
+    constexpr uint8_t SD_FLUSH_END = 9;
+    constexpr uint8_t SD_OPEN      = 10;
+    constexpr uint8_t MOTOR        = 11; // coalesced, arg: repeats, data: degrees
+    constexpr uint8_t FEED         = 12; // data: pellets
+    constexpr uint8_t FEED_END     = 13; // arg: 1 if jammed
+    constexpr uint8_t WDT_WARN     = 14;
+    constexpr uint8_t HARDFAULT    = 15;
+    constexpr uint8_t COUNT        = 16;
+};
+
+typedef struct TraceEntry {
+    uint32_t t;     // millis()
+    uint8_t type;
+    uint8_t arg;
+    uint16_t data;
+} TraceEntry;
+
+typedef struct TraceRing {
+    uint32_t magic;
+    uint32_t head;      // total entries written, wraps modulo TRACE_LEN
+    uint16_t bootCount;
+    uint16_t reserved;
+    uint32_t bootUnix;  // RTC time of the most recent boot
+    uint32_t faultPc;   // stacked PC/LR of the last hard fault
+    uint32_t faultLr;
+    TraceEntry entries[TRACE_LEN];
+    uint32_t check;     // ~magic, guards against partially valid RAM
+} TraceRing;
+
+typedef struct TraceFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;     // entries that follow
+    uint32_t resetCause;
+    uint32_t bootUnix;  // boot that was traced
+    uint32_t faultPc;
+    uint32_t faultLr;
+    uint16_t bootCount;
+    uint16_t entrySize;
+} TraceFileHeader;
+
+extern PER_DEVICE TraceRing traceRing;
+
+void traceInit();
+void trace(uint8_t type, uint8_t arg = 0, uint16_t data = 0);
+
+#endif
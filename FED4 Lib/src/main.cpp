@@ -1,16 +1,18 @@
 #include <FED4.h>
 
-FED4 fed4;
+FED4* fed4;
 long lastLogTime = 0;
-int init_freeMem = 0;
 
 void setup() {
-    fed4 = FED4();
+    // Built here, in place and once: the constructor talks to the RTC and
+    // the display, so it has to run after the core has set them up
+    static FED4 device;
+    fed4 = &device;
 
-    fed4.begin();
+    fed4->begin();
 }
 
 
 void loop() {
-    fed4.run();
-}
\ No newline at end of file
+    fed4->run();
+}
@@ -0,0 +1,1076 @@
+// Fleet ingest: turns directories of FED4 logs into typed column files,
+// one per device and day.
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -pthread -Ilib/FED4 tools/fedingest/fedingest.cpp lib/FED4/LogBlock.cpp
+//       lib/FED4/LogSchema.cpp -o fedingest
+//
+// Usage:
+//   fedingest [-j threads] [-o dir] [-f] [-V] [-q] FILE|DIR [...]
+//
+// Takes log segments as the feeder writes them (FEDnn_dd-mm-yy_NNN.csv,
+// preallocated or not, with their block trailers), files pulled with
+// fetchlog and the events_<session>.csv files telemd writes. Directories
+// are searched recursively. Files are mapped and parsed in parallel, one
+// per thread; rows are split with SSE2 where the compiler has it. Lines
+// starting with '#' are skipped, columns are found by the header's names,
+// and a file ends at its first erased byte (0x00 or 0xFF). Segments with
+// a preamble of a known schema version (see lib/FED4/LogSchema.h) take
+// the column types from its #types line, older ones by the names.
+//
+// Each device and day goes to dir/FEDnn/yyyy-mm-dd.fcol, rows in the
+// order they were ingested. Sensors and the mode may differ between the
+// files of a day: a column missing from a file is null for its rows, so
+// the last column of the log becomes three, "VI Count Down", "Ratio" and
+// "Chance", of which each row fills the one for its mode. A last column,
+// Source, names the file each row came from.
+//
+// Runs are incremental. dir/ingest.state keeps a watermark per file, keyed
+// by its name: how far it was parsed, the CRC of those bytes and of the
+// last 4 KB of them, and the time and Seq of its last row. A file seen
+// before is parsed from its watermark, with the rows appended to the
+// partitions already written, as long as the 4 KB before the watermark
+// are unchanged (with -V, the whole prefix). A file that was cut short or
+// written again is parsed from the top and its earlier rows are taken out
+// of the partitions. Copies of the same file in one run are taken once.
+// Only rows ending in '\n' are taken, so a row still being written waits
+// for the next run. -f ignores the state and rebuilds the partitions the
+// files reach.
+//
+// An .fcol file is little endian:
+//
+//   "FEDCOL" u16 version (1) u32 columns u64 rows
+//   per column: u8 type, u8 0, u16 name length, name, u64 offset, u64 bytes
+//   column data, each at its offset, which is a multiple of 8
+//
+// Types:
+//   1 I32    int32 per row, null is INT32_MIN
+//   2 I64    int64 per row
+//   3 F32    float per row, null is NaN
+//   4 DICT   u32 code per row (null 0xFFFFFFFF), padded to 8 bytes, then
+//            u32 count, u32 end of each string, the strings back to back
+//   5 TIME   int64 seconds since 1970 on the feeder's clock, which keeps
+//            local time without a zone; null is INT64_MIN
+//
+// so with numpy a column is np.frombuffer(buf, dtype, rows, offset).
+
+#include <LogBlock.h>
+#include <LogSchema.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ColType {
+    constexpr uint8_t I32  = 1;
+    constexpr uint8_t I64  = 2;
+    constexpr uint8_t F32  = 3;
+    constexpr uint8_t DICT = 4;
+    constexpr uint8_t TIME = 5;
+};
+
+static const int MAX_FIELDS = 64;
+static const uint32_t NULL_CODE = 0xFFFFFFFF;
+
+// ==== Columns ====
+struct Column {
+    std::string name;
+    uint8_t type = ColType::DICT;
+    std::vector<int64_t> ints;          // I32, I64, TIME
+    std::vector<float> floats;          // F32
+    std::vector<uint32_t> codes;        // DICT
+    std::deque<std::string> dict;       // stable, so index can point into it
+    std::unordered_map<std::string_view, uint32_t> index;
+
+    uint32_t code(std::string_view s) {
+        auto it = index.find(s);
+        if (it != index.end()) return it->second;
+        dict.emplace_back(s);
+        uint32_t c = dict.size() - 1;
+        index.emplace(dict.back(), c);
+        return c;
+    }
+};
+
+static bool endsWith(const std::string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static uint8_t columnType(const std::string& name) {
+    static const char* ints[] = {
+        "Device Number", "Animal", "Window Start", "Window End", "In Window",
+        "Pellet Count", "Battery mV", "VI Count Down", "Ratio",
+    };
+    if (name == "Seq") return ColType::I64;
+    if (name == "TimeStamp") return ColType::TIME;
+    if (name == "Chance") return ColType::F32;
+    for (const char* n : ints) {
+        if (name == n) return ColType::I32;
+    }
+    if (endsWith(name, " Reward") || endsWith(name, " Count")) return ColType::I32;
+    return ColType::DICT;
+}
+
+// The same for a type of the #types line
+static uint8_t schemaType(uint8_t type) {
+    switch (type & ~LogType::NULLABLE) {
+    case LogType::U32:
+        return ColType::I64;
+    case LogType::U8:
+    case LogType::U16:
+    case LogType::I16:
+    case LogType::I32:
+        return ColType::I32;
+    case LogType::F32:
+        return ColType::F32;
+    case LogType::TIME:
+        return ColType::TIME;
+    default:
+        return ColType::DICT;
+    }
+}
+
+static bool parseInt(const char* p, const char* end, int64_t& out) {
+    bool neg = p < end && *p == '-';
+    if (neg) p++;
+    if (p == end) return false;
+    int64_t v = 0;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') return false;
+        v = v * 10 + (*p - '0');
+    }
+    out = neg ? -v : v;
+    return true;
+}
+
+// Days from 1970-01-01 to a date in the proleptic Gregorian calendar
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+// "d/m/yy H:M:S" as logEvent writes it, the year modulo 1000
+static bool parseTime(const char* p, const char* end, int64_t& out) {
+    int v[6] = {0};
+    int n = 0;
+    bool digits = false;
+    for (; p < end && n < 6; p++) {
+        if (*p >= '0' && *p <= '9') {
+            v[n] = v[n] * 10 + (*p - '0');
+            digits = true;
+        }
+        else if (digits && (*p == '/' || *p == ' ' || *p == ':')) {
+            n++;
+            digits = false;
+        }
+        else {
+            return false;
+        }
+    }
+    if (digits) n++;
+    if (n != 6 || v[1] < 1 || v[1] > 12 || v[0] < 1 || v[0] > 31) return false;
+    out = daysFromCivil(2000 + v[2], v[1], v[0]) * 86400 + v[3] * 3600 + v[4] * 60 + v[5];
+    return true;
+}
+
+// ==== CRC-32, eight bytes at a time ====
+// Chains like crc32Update(), which it is checked against at startup
+static uint32_t crcTable[8][256];
+
+static void crcInit() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+        crcTable[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            crcTable[t][i] = (crcTable[t - 1][i] >> 8) ^ crcTable[0][crcTable[t - 1][i] & 0xFF];
+        }
+    }
+}
+
+static uint32_t crcFast(uint32_t crc, const uint8_t* p, size_t len) {
+    crc = ~crc;
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF]
+            ^ crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24]
+            ^ crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF]
+            ^ crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ crcTable[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+// ==== Row splitting ====
+// Fills the start of each field and returns the '\n' ending the row, or
+// end. count can run past MAX_FIELDS, which marks the row as malformed.
+static const char* splitRow(const char* p, const char* end, const char* fields[MAX_FIELDS + 1], int& count) {
+    count = 0;
+    fields[count++] = p;
+    const char* s = p;
+#if defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - s >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)s);
+        unsigned commas = _mm_movemask_epi8(_mm_cmpeq_epi8(v, comma));
+        unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (newlines) commas &= (newlines & -newlines) - 1;
+        while (commas) {
+            if (count <= MAX_FIELDS) fields[count] = s + __builtin_ctz(commas) + 1;
+            count++;
+            commas &= commas - 1;
+        }
+        if (newlines) return s + __builtin_ctz(newlines);
+        s += 16;
+    }
+#endif
+    for (; s < end; s++) {
+        if (*s == '\n') return s;
+        if (*s == ',') {
+            if (count <= MAX_FIELDS) fields[count] = s + 1;
+            count++;
+        }
+    }
+    return end;
+}
+
+// ==== Files ====
+struct Run {
+    int device;
+    int64_t day;
+    size_t begin, end;      // rows
+};
+
+// The rows under one header. A file has one part unless the feeder wrote
+// a different header into it. After the header's columns comes Source,
+// the file's key, so a later run can take the file's rows out again.
+struct Part {
+    std::vector<Column> columns;
+    size_t fields = 0;      // columns from the header
+    std::vector<Run> runs;
+    size_t rows = 0;
+};
+
+// How far a file was taken last time. The CRCs tell a file that only grew
+// from one that was cut short or written again.
+struct Watermark {
+    uint64_t offset = 0;        // end of the last row taken, after its '\n'
+    uint32_t crc = 0;           // of the bytes before offset
+    uint32_t tailLen = 0;
+    uint32_t tailCrc = 0;       // of the last tailLen bytes before offset
+    int64_t lastTime = INT64_MIN;
+    int64_t lastSeq = -1;
+    uint64_t rows = 0;
+    std::vector<std::string> partitions;
+    std::string header;         // for rows appended without one
+    std::string types;          // the #types line over it, if any
+};
+
+static const uint32_t WATERMARK_TAIL = 4096;
+
+enum class Status { NEW, APPENDED, UNCHANGED, REWRITTEN, DUPLICATE };
+
+struct Source {
+    std::string path;
+    std::string key;        // the name, with its directory unless it is FEDnn_...
+    bool readable = false;
+    bool known = false;     // has a watermark
+    Status status = Status::NEW;
+    Watermark mark;         // from the last run, then as of this one
+    uint64_t bytes = 0;     // parsed this run
+    uint64_t rows = 0;
+    uint64_t badRows = 0;
+    int fileDevice = -1;    // from the name, for rows without one
+    std::vector<Part> parts;
+};
+
+// The first erased byte, found as the firmware finds it: the first
+// erased 512 byte block, then the first erased byte before it
+static size_t dataEnd(const uint8_t* data, size_t size) {
+    auto erased = [](uint8_t c) { return c == 0x00 || c == 0xFF; };
+    size_t lo = 0;
+    size_t hi = (size + 511) / 512;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (erased(data[mid * 512])) hi = mid;
+        else lo = mid + 1;
+    }
+    if (lo == 0) return 0;
+    size_t end = (lo - 1) * 512;
+    while (end < size && end < lo * 512 && !erased(data[end])) end++;
+    return end;
+}
+
+static std::string partitionName(int device, int64_t day) {
+    int64_t z = day + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    int64_t y = yoe + era * 400 + (m <= 2);
+    char name[64];
+    snprintf(name, sizeof(name), "FED%02d/%04lld-%02u-%02u", device, (long long)y, m, d);
+    return name;
+}
+
+static void startPart(Source& src, const char* line, const char* lineEnd, const std::string& types) {
+    Part part;
+    const char* p = line;
+    while (p <= lineEnd) {
+        const char* comma = (const char*)memchr(p, ',', lineEnd - p);
+        const char* e = comma ? comma : lineEnd;
+        Column col;
+        col.name.assign(p, e);
+        col.type = columnType(col.name);
+        part.columns.push_back(std::move(col));
+        p = e + 1;
+    }
+    part.fields = part.columns.size();
+
+    LogSchema schema = {};
+    if (logParseSchema(types.data(), types.size(), &schema) && schema.columns == part.fields) {
+        for (size_t i = 0; i < part.fields; i++) part.columns[i].type = schemaType(schema.types[i]);
+    }
+    Column source;
+    source.name = "Source";
+    source.code(src.key);
+    part.columns.push_back(std::move(source));
+    src.parts.push_back(std::move(part));
+}
+
+// Rows from p to stop, which ends after a '\n'. header and types are the
+// ones in force at p, and are left as the ones in force at stop.
+static void parse(Source& src, const char* p, const char* stop, std::string& header, std::string& types) {
+    int seqCol = -1, timeCol = -1, deviceCol = -1;
+    const char* fields[MAX_FIELDS + 1];
+    std::string nextTypes = types;
+    bool knownSchema = true;
+
+    auto useHeader = [&](const char* line, const char* lineEnd) {
+        startPart(src, line, lineEnd, types);
+        seqCol = timeCol = deviceCol = -1;
+        const auto& cols = src.parts.back().columns;
+        for (size_t i = 0; i < src.parts.back().fields; i++) {
+            if (cols[i].name == "Seq") seqCol = i;
+            else if (cols[i].name == "TimeStamp") timeCol = i;
+            else if (cols[i].name == "Device Number") deviceCol = i;
+        }
+    };
+    if (!header.empty()) useHeader(header.data(), header.data() + header.size());
+
+    while (p < stop) {
+        int count;
+        const char* nl = splitRow(p, stop, fields, count);
+        const char* lineEnd = nl;
+        if (lineEnd > p && lineEnd[-1] == '\r') lineEnd--;
+        const char* next = nl < stop ? nl + 1 : stop;
+
+        if (lineEnd == p || *p == '#') {
+            // A segment's preamble comes before its header
+            LogSchema schema = {};
+            if (logParseSchema(p, lineEnd - p, &schema)) {
+                if (schema.columns > 0) {
+                    if (knownSchema) nextTypes.assign(p, lineEnd);
+                }
+                else {
+                    knownSchema = schema.version <= LOG_SCHEMA_VERSION;
+                    nextTypes.clear();
+                }
+            }
+            p = next;
+            continue;
+        }
+        if (lineEnd - p >= 4 && memcmp(p, "Seq,", 4) == 0) {
+            if (header.compare(0, std::string::npos, p, lineEnd - p) != 0 || types != nextTypes) {
+                header.assign(p, lineEnd);
+                types = nextTypes;
+                useHeader(p, lineEnd);
+            }
+            nextTypes.clear();
+            p = next;
+            continue;
+        }
+        if (src.parts.empty() || seqCol < 0 || timeCol < 0 || src.parts.back().fields > MAX_FIELDS) {
+            src.badRows++;
+            p = next;
+            continue;
+        }
+
+        Part& part = src.parts.back();
+        size_t n = part.fields;
+        int64_t seq, time, device = src.fileDevice;
+        auto fieldEnd = [&](int i) { return i + 1 < count ? fields[i + 1] - 1 : lineEnd; };
+        if ((size_t)count != n
+            || !parseInt(fields[seqCol], fieldEnd(seqCol), seq)
+            || !parseTime(fields[timeCol], fieldEnd(timeCol), time)
+            || (deviceCol >= 0 && !parseInt(fields[deviceCol], fieldEnd(deviceCol), device))) {
+            src.badRows++;
+            p = next;
+            continue;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            Column& col = part.columns[i];
+            const char* f = fields[i];
+            const char* fe = fieldEnd(i);
+            switch (col.type) {
+            case ColType::I32: {
+                int64_t v;
+                col.ints.push_back(parseInt(f, fe, v) ? v : INT32_MIN);
+                break;
+            }
+            case ColType::I64: {
+                int64_t v;
+                col.ints.push_back(parseInt(f, fe, v) ? v : INT64_MIN);
+                break;
+            }
+            case ColType::TIME:
+                col.ints.push_back(time);
+                break;
+            case ColType::F32: {
+                char buf[32];
+                size_t len = std::min<size_t>(fe - f, sizeof(buf) - 1);
+                memcpy(buf, f, len);
+                buf[len] = '\0';
+                char* e;
+                float v = strtof(buf, &e);
+                col.floats.push_back(len > 0 && *e == '\0' ? v : NAN);
+                break;
+            }
+            default:
+                col.codes.push_back(fe - f == 4 && memcmp(f, "null", 4) == 0
+                                    ? NULL_CODE : col.code(std::string_view(f, fe - f)));
+                break;
+            }
+        }
+        part.columns[n].codes.push_back(0);
+
+        int64_t day = time >= 0 ? time / 86400 : (time - 86399) / 86400;
+        if (part.runs.empty() || part.runs.back().device != device || part.runs.back().day != day) {
+            part.runs.push_back({(int)device, day, part.rows, part.rows});
+        }
+        part.rows++;
+        part.runs.back().end = part.rows;
+        src.rows++;
+        src.mark.lastTime = time;
+        src.mark.lastSeq = seq;
+        p = next;
+    }
+}
+
+// Carries on from the file's watermark if the bytes under it are the ones
+// seen last time, otherwise starts again from the top. Only whole rows
+// are taken: a row still being written is left for the next run.
+static void ingest(Source& src, bool verifyAll) {
+    int fd = open(src.path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return;
+    }
+    src.readable = true;
+    const uint8_t* data = nullptr;
+    if (st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            src.readable = false;
+            close(fd);
+            return;
+        }
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        data = (const uint8_t*)map;
+    }
+
+    size_t end = data ? dataEnd(data, st.st_size) : 0;
+    const void* nl = end ? memrchr(data, '\n', end) : nullptr;
+    size_t cut = nl ? (const uint8_t*)nl - data + 1 : 0;
+
+    Watermark& m = src.mark;
+    size_t from = 0;
+    if (src.known) {
+        bool same = m.offset <= cut && m.tailLen <= m.offset
+            && crcFast(0, data + m.offset - m.tailLen, m.tailLen) == m.tailCrc
+            && (!verifyAll || crcFast(0, data, m.offset) == m.crc);
+        if (same) {
+            from = m.offset;
+            src.status = from == cut ? Status::UNCHANGED : Status::APPENDED;
+        }
+        else {
+            src.status = Status::REWRITTEN;
+        }
+    }
+    if (from == 0) {
+        std::vector<std::string> partitions = std::move(m.partitions);
+        m = Watermark();
+        if (src.status == Status::REWRITTEN) m.partitions = std::move(partitions);
+    }
+
+    if (cut > from) {
+        parse(src, (const char*)data + from, (const char*)data + cut, m.header, m.types);
+        m.crc = crcFast(m.crc, data + from, cut - from);
+        m.offset = cut;
+        m.tailLen = std::min<size_t>(cut, WATERMARK_TAIL);
+        m.tailCrc = crcFast(0, data + cut - m.tailLen, m.tailLen);
+        m.rows += src.rows;
+        src.bytes = cut - from;
+    }
+    for (const Part& part : src.parts) {
+        for (const Run& run : part.runs) {
+            std::string name = partitionName(run.device, run.day);
+            if (std::find(m.partitions.begin(), m.partitions.end(), name) == m.partitions.end()) {
+                m.partitions.push_back(name);
+            }
+        }
+    }
+
+    if (data) munmap((void*)data, st.st_size);
+    close(fd);
+}
+
+static bool logName(const std::string& name) {
+    return endsWith(name, ".csv")
+        && (name.compare(0, 3, "FED") == 0 || name.compare(0, 7, "events_") == 0);
+}
+
+static void addPath(std::vector<Source>& sources, const std::string& path, bool named) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return;
+    if (S_ISDIR(st.st_mode)) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) return;
+        while (dirent* e = readdir(dir)) {
+            std::string name = e->d_name;
+            if (name == "." || name == "..") continue;
+            addPath(sources, path + "/" + name, false);
+        }
+        closedir(dir);
+        return;
+    }
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if (!named && !logName(name)) return;
+
+    Source src;
+    src.path = path;
+    src.key = name;
+    if (name.compare(0, 3, "FED") == 0 && name.size() > 5 && isdigit(name[3]) && isdigit(name[4])) {
+        src.fileDevice = (name[3] - '0') * 10 + (name[4] - '0');
+    }
+    else if (slash != std::string::npos) {
+        size_t dirStart = path.find_last_of('/', slash - 1);
+        src.key = path.substr(dirStart == std::string::npos ? 0 : dirStart + 1);
+    }
+    sources.push_back(src);
+}
+
+// ==== Watermarks ====
+// One line per file, tab separated:
+//   key offset crc tailLen tailCrc lastTime lastSeq rows partitions header types
+// State written before the #types lines has no types.
+static std::map<std::string, Watermark> loadState(const std::string& path) {
+    std::map<std::string, Watermark> state;
+    FILE* f = fopen(path.c_str(), "r");
+    if (f == nullptr) return state;
+    char* line = nullptr;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) > 0) {
+        if (line[0] == '#') continue;
+        if (line[len - 1] == '\n') line[--len] = '\0';
+        std::vector<std::string> field;
+        for (char* p = line;;) {
+            char* tab = strchr(p, '\t');
+            field.emplace_back(p, tab ? tab : line + len);
+            if (tab == nullptr) break;
+            p = tab + 1;
+        }
+        if (field.size() != 10 && field.size() != 11) continue;
+
+        Watermark& m = state[field[0]];
+        m.offset = strtoull(field[1].c_str(), nullptr, 10);
+        m.crc = strtoul(field[2].c_str(), nullptr, 16);
+        m.tailLen = strtoul(field[3].c_str(), nullptr, 10);
+        m.tailCrc = strtoul(field[4].c_str(), nullptr, 16);
+        m.lastTime = strtoll(field[5].c_str(), nullptr, 10);
+        m.lastSeq = strtoll(field[6].c_str(), nullptr, 10);
+        m.rows = strtoull(field[7].c_str(), nullptr, 10);
+        for (size_t p = 0; p < field[8].size();) {
+            size_t comma = field[8].find(',', p);
+            if (comma == std::string::npos) comma = field[8].size();
+            m.partitions.push_back(field[8].substr(p, comma - p));
+            p = comma + 1;
+        }
+        m.header = field[9];
+        if (field.size() > 10) m.types = field[10];
+    }
+    free(line);
+    fclose(f);
+    return state;
+}
+
+static bool saveState(const std::string& path, const std::map<std::string, Watermark>& state) {
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (f == nullptr) return false;
+    fprintf(f, "# key\toffset\tcrc\ttail\ttail crc\tlast time\tlast seq\trows\tpartitions\theader\ttypes\n");
+    for (const auto& kv : state) {
+        const Watermark& m = kv.second;
+        std::string partitions;
+        for (const std::string& p : m.partitions) {
+            if (!partitions.empty()) partitions += ',';
+            partitions += p;
+        }
+        fprintf(f, "%s\t%llu\t%08x\t%u\t%08x\t%lld\t%lld\t%llu\t%s\t%s\t%s\n",
+                kv.first.c_str(), (unsigned long long)m.offset, m.crc, m.tailLen, m.tailCrc,
+                (long long)m.lastTime, (long long)m.lastSeq, (unsigned long long)m.rows,
+                partitions.c_str(), m.header.c_str(), m.types.c_str());
+    }
+    bool ok = fclose(f) == 0;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// ==== Partitions ====
+struct Slice {
+    const Part* part;
+    size_t begin, end;
+};
+
+struct Partition {
+    std::string name;
+    std::vector<Slice> slices;
+    size_t rows = 0;
+    Part old;               // rows already in the file that stay
+};
+
+static void put(std::string& out, const void* p, size_t len) {
+    out.append((const char*)p, len);
+}
+
+static void pad8(std::string& out) {
+    while (out.size() % 8) out.push_back('\0');
+}
+
+// Reads an .fcol back, leaving out the rows of the files in drop
+static bool loadPartition(const std::string& path, const std::set<std::string>& drop, Part& part) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (f == nullptr) return false;
+    std::string buf;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf.append(chunk, n);
+    fclose(f);
+
+    const char* b = buf.data();
+    if (buf.size() < 20 || memcmp(b, "FEDCOL", 6) != 0) return false;
+    uint16_t version;
+    uint32_t columns;
+    uint64_t rows;
+    memcpy(&version, b + 6, 2);
+    memcpy(&columns, b + 8, 4);
+    memcpy(&rows, b + 12, 8);
+    if (version != 1) return false;
+
+    struct Entry { uint8_t type; std::string name; uint64_t offset, bytes; };
+    std::vector<Entry> entries;
+    size_t p = 20;
+    for (uint32_t k = 0; k < columns; k++) {
+        Entry e;
+        uint16_t len;
+        if (p + 4 > buf.size()) return false;
+        e.type = b[p];
+        memcpy(&len, b + p + 2, 2);
+        if (p + 4 + len + 16 > buf.size()) return false;
+        e.name.assign(b + p + 4, len);
+        memcpy(&e.offset, b + p + 4 + len, 8);
+        memcpy(&e.bytes, b + p + 12 + len, 8);
+        if (e.offset + e.bytes > buf.size()) return false;
+        entries.push_back(e);
+        p += 20 + len;
+    }
+
+    auto strings = [&](const Entry& e) {
+        std::vector<std::string_view> out;
+        size_t q = e.offset + (rows * 4 + 7) / 8 * 8;
+        uint32_t count;
+        memcpy(&count, b + q, 4);
+        const char* base = b + q + 4 + 4 * (size_t)count;
+        uint32_t start = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t stop;
+            memcpy(&stop, b + q + 4 + 4 * i, 4);
+            out.emplace_back(base + start, stop - start);
+            start = stop;
+        }
+        return out;
+    };
+
+    std::vector<bool> keep(rows, true);
+    for (const Entry& e : entries) {
+        if (e.name != "Source" || e.type != ColType::DICT) continue;
+        auto dict = strings(e);
+        for (uint64_t r = 0; r < rows; r++) {
+            uint32_t c;
+            memcpy(&c, b + e.offset + 4 * r, 4);
+            keep[r] = c >= dict.size() || drop.count(std::string(dict[c])) == 0;
+        }
+    }
+
+    for (const Entry& e : entries) {
+        Column col;
+        col.name = e.name;
+        col.type = e.type;
+        const char* d = b + e.offset;
+        for (uint64_t r = 0; r < rows; r++) {
+            if (!keep[r]) continue;
+            switch (e.type) {
+            case ColType::I32: {
+                int32_t v;
+                memcpy(&v, d + 4 * r, 4);
+                col.ints.push_back(v);
+                break;
+            }
+            case ColType::I64:
+            case ColType::TIME: {
+                int64_t v;
+                memcpy(&v, d + 8 * r, 8);
+                col.ints.push_back(v);
+                break;
+            }
+            case ColType::F32: {
+                float v;
+                memcpy(&v, d + 4 * r, 4);
+                col.floats.push_back(v);
+                break;
+            }
+            default: {
+                uint32_t c;
+                memcpy(&c, d + 4 * r, 4);
+                col.codes.push_back(c);
+                break;
+            }
+            }
+        }
+        if (e.type == ColType::DICT) {
+            for (std::string_view s : strings(e)) col.dict.emplace_back(s);
+        }
+        part.columns.push_back(std::move(col));
+    }
+    part.fields = part.columns.size();
+    part.rows = std::count(keep.begin(), keep.end(), true);
+    return true;
+}
+
+static bool writePartition(const std::string& dir, const Partition& pt) {
+    std::string path = dir + "/" + pt.name + ".fcol";
+    size_t total = pt.rows + pt.old.rows;
+    if (total == 0) return unlink(path.c_str()) == 0 || errno == ENOENT;
+
+    std::vector<Slice> slices;
+    if (pt.old.rows) slices.push_back({&pt.old, 0, pt.old.rows});
+    slices.insert(slices.end(), pt.slices.begin(), pt.slices.end());
+
+    // Columns by name, in the order first seen
+    std::vector<std::pair<std::string, uint8_t>> names;
+    for (const Slice& s : slices) {
+        for (const Column& c : s.part->columns) {
+            bool seen = false;
+            for (const auto& n : names) seen = seen || n.first == c.name;
+            if (!seen) names.emplace_back(c.name, c.type);
+        }
+    }
+
+    std::vector<std::string> data(names.size());
+    for (size_t k = 0; k < names.size(); k++) {
+        const std::string& name = names[k].first;
+        uint8_t type = names[k].second;
+        std::string& out = data[k];
+        std::vector<std::string_view> dict;
+        std::unordered_map<std::string_view, uint32_t> index;
+
+        for (const Slice& s : slices) {
+            const Column* col = nullptr;
+            for (const Column& c : s.part->columns) {
+                if (c.name == name) col = &c;
+            }
+            size_t n = s.end - s.begin;
+            switch (type) {
+            case ColType::I32:
+                for (size_t r = s.begin; r < s.end; r++) {
+                    int32_t v = col ? (int32_t)col->ints[r] : INT32_MIN;
+                    put(out, &v, 4);
+                }
+                break;
+            case ColType::I64:
+            case ColType::TIME:
+                if (col) {
+                    put(out, &col->ints[s.begin], n * 8);
+                }
+                else {
+                    int64_t v = INT64_MIN;
+                    for (size_t r = 0; r < n; r++) put(out, &v, 8);
+                }
+                break;
+            case ColType::F32:
+                if (col) {
+                    put(out, &col->floats[s.begin], n * 4);
+                }
+                else {
+                    float v = NAN;
+                    for (size_t r = 0; r < n; r++) put(out, &v, 4);
+                }
+                break;
+            default: {
+                std::vector<uint32_t> remap(col ? col->dict.size() : 0, NULL_CODE);
+                for (size_t r = s.begin; r < s.end; r++) {
+                    uint32_t c = col ? col->codes[r] : NULL_CODE;
+                    if (c != NULL_CODE) {
+                        if (remap[c] == NULL_CODE) {
+                            auto it = index.find(col->dict[c]);
+                            if (it == index.end()) {
+                                it = index.emplace(col->dict[c], dict.size()).first;
+                                dict.push_back(col->dict[c]);
+                            }
+                            remap[c] = it->second;
+                        }
+                        c = remap[c];
+                    }
+                    put(out, &c, 4);
+                }
+                break;
+            }
+            }
+        }
+
+        if (type == ColType::DICT) {
+            pad8(out);
+            uint32_t count = dict.size();
+            put(out, &count, 4);
+            uint32_t offset = 0;
+            for (const auto& s : dict) {
+                offset += s.size();
+                put(out, &offset, 4);
+            }
+            for (const auto& s : dict) put(out, s.data(), s.size());
+        }
+    }
+
+    std::string file = "FEDCOL";
+    uint16_t version = 1;
+    uint32_t columns = names.size();
+    uint64_t rows = total;
+    put(file, &version, 2);
+    put(file, &columns, 4);
+    put(file, &rows, 8);
+    size_t dirSize = 0;
+    for (const auto& n : names) dirSize += 4 + n.first.size() + 16;
+    uint64_t offset = (file.size() + dirSize + 7) / 8 * 8;
+    for (size_t k = 0; k < names.size(); k++) {
+        uint8_t type[2] = {names[k].second, 0};
+        uint16_t len = names[k].first.size();
+        uint64_t bytes = data[k].size();
+        put(file, type, 2);
+        put(file, &len, 2);
+        put(file, names[k].first.data(), len);
+        put(file, &offset, 8);
+        put(file, &bytes, 8);
+        offset = (offset + bytes + 7) / 8 * 8;
+    }
+    for (const std::string& d : data) {
+        pad8(file);
+        file += d;
+    }
+
+    mkdir(path.substr(0, path.find_last_of('/')).c_str(), 0755);
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) return false;
+    bool ok = fwrite(file.data(), 1, file.size(), f) == file.size();
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+template <typename F>
+static void parallel(unsigned threads, size_t count, F work) {
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < std::min<size_t>(threads, count); t++) {
+        pool.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) work(i);
+        });
+    }
+    for (auto& t : pool) t.join();
+}
+
+static const char* USAGE = "usage: %s [-j threads] [-o dir] [-f] [-V] [-q] FILE|DIR [...]\n";
+
+int main(int argc, char** argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string outDir = ".";
+    bool full = false;
+    bool verifyAll = false;
+    bool quiet = false;
+    int c;
+    while ((c = getopt(argc, argv, "j:o:fVq")) != -1) {
+        switch (c) {
+        case 'j': threads = std::max(1, atoi(optarg)); break;
+        case 'o': outDir = optarg; break;
+        case 'f': full = true; break;
+        case 'V': verifyAll = true; break;
+        case 'q': quiet = true; break;
+        default:
+            fprintf(stderr, USAGE, argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, USAGE, argv[0]);
+        return 2;
+    }
+
+    crcInit();
+    if (crcFast(0, (const uint8_t*)"123456789", 9) != crc32Update(0, "123456789", 9)) {
+        fprintf(stderr, "CRC tables disagree with the firmware\n");
+        return 2;
+    }
+
+    std::string statePath = outDir + "/ingest.state";
+    std::map<std::string, Watermark> state;
+    if (!full) state = loadState(statePath);
+
+    std::vector<Source> sources;
+    for (int i = optind; i < argc; i++) addPath(sources, argv[i], true);
+    std::sort(sources.begin(), sources.end(),
+              [](const Source& a, const Source& b) { return a.path < b.path; });
+    std::set<std::string> keys;
+    for (Source& src : sources) {
+        if (!keys.insert(src.key).second) {
+            src.status = Status::DUPLICATE;
+            continue;
+        }
+        auto it = state.find(src.key);
+        if (it != state.end()) {
+            src.known = true;
+            src.mark = it->second;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    parallel(threads, sources.size(), [&](size_t i) {
+        if (sources[i].status != Status::DUPLICATE) ingest(sources[i], verifyAll);
+    });
+    double parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Partitions with new rows, and those holding rows of rewritten files
+    std::map<std::string, Partition> partitions;
+    std::set<std::string> drop;
+    for (const Source& src : sources) {
+        if (src.status == Status::REWRITTEN) {
+            drop.insert(src.key);
+            for (const std::string& name : state[src.key].partitions) partitions[name].name = name;
+        }
+        for (const Part& part : src.parts) {
+            for (const Run& run : part.runs) {
+                std::string name = partitionName(run.device, run.day);
+                Partition& pt = partitions[name];
+                pt.name = name;
+                pt.slices.push_back({&part, run.begin, run.end});
+                pt.rows += run.end - run.begin;
+            }
+        }
+    }
+    std::vector<Partition*> list;
+    for (auto& kv : partitions) list.push_back(&kv.second);
+
+    mkdir(outDir.c_str(), 0755);
+    std::atomic<size_t> failed{0};
+    parallel(threads, list.size(), [&](size_t i) {
+        Partition& pt = *list[i];
+        std::string path = outDir + "/" + pt.name + ".fcol";
+        if (!full && access(path.c_str(), F_OK) == 0 && !loadPartition(path, drop, pt.old)) {
+            fprintf(stderr, "%s: cannot read, run with -f to rebuild\n", path.c_str());
+            failed++;
+        }
+        else if (!writePartition(outDir, pt)) {
+            fprintf(stderr, "%s: cannot write\n", path.c_str());
+            failed++;
+        }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Without every partition written, the old watermarks stay, so the
+    // next run takes the same rows again
+    for (const Source& src : sources) {
+        if (src.readable && src.status != Status::DUPLICATE) state[src.key] = src.mark;
+    }
+    if (failed == 0 && !saveState(statePath, state)) {
+        fprintf(stderr, "%s: cannot write\n", statePath.c_str());
+        failed++;
+    }
+
+    static const char* STATUS[] = {"new", "appended", "unchanged", "rewritten", "duplicate"};
+    uint64_t bytes = 0, rows = 0, badRows = 0, unreadable = 0;
+    uint64_t counts[5] = {0};
+    for (const Source& src : sources) {
+        if (!src.readable && src.status != Status::DUPLICATE) {
+            fprintf(stderr, "%s: cannot read\n", src.path.c_str());
+            unreadable++;
+            continue;
+        }
+        counts[(int)src.status]++;
+        bool findings = src.badRows || src.status == Status::REWRITTEN || src.status == Status::DUPLICATE;
+        if (!quiet || findings) {
+            printf("%s: %s, %lu rows, %lu bad rows\n", src.path.c_str(), STATUS[(int)src.status],
+                   (unsigned long)src.rows, (unsigned long)src.badRows);
+        }
+        bytes += src.bytes;
+        rows += src.rows;
+        badRows += src.badRows;
+    }
+    printf("total: %zu files (%lu new, %lu appended, %lu unchanged, %lu rewritten, %lu duplicate), "
+           "%.1f MB, %lu rows, %lu bad rows, %zu partitions; parsed in %.2f s (%.0f MB/s), %.2f s in all\n",
+           sources.size(), (unsigned long)counts[0], (unsigned long)counts[1], (unsigned long)counts[2],
+           (unsigned long)counts[3], (unsigned long)counts[4], bytes / 1e6, (unsigned long)rows,
+           (unsigned long)badRows, list.size(), parseSeconds,
+           parseSeconds > 0 ? bytes / 1e6 / parseSeconds : 0, seconds);
+    return (unreadable || failed) ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+// Talks to the command shell of a running feeder over its serial port (see
+// the command frames in lib/FED4/Telemetry.h).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -Ilib/FED4 tools/fedsh/fedsh.cpp lib/FED4/Telemetry.cpp lib/FED4/LogBlock.cpp -o fedsh
+//
+// Usage:
+//   fedsh [-b baud] [-d device] TTY [COMMAND...]
+//
+// With a command, sends it, prints the reply and exits. Without one, reads
+// commands from stdin, one per line. Commands:
+//   get [name]          settings, or one of them
+//   set name value      changes a setting; the feeder logs the change
+//   counters            pokes, pellets and sequence numbers
+//   mem                 stack and heap use
+//   latency             SD and flush latency, dispense and inter-poke times
+//   flush               writes the log buffer to the card
+//   checkpoint          flush, then save the settings to CONFIG.json
+// The feeder answers between sessions of sleep, so a reply can take as long
+// as the wake interval.
+
+#include <LogBlock.h>
+#include <Telemetry.h>
+
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    speed_t baud = B115200;
+    uint8_t device = TELEM_ANY_DEVICE;
+    const char* tty = nullptr;
+};
+
+static const int REPLY_MS = 5000;
+
+static double nowS() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static speed_t baudFlag(long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+    }
+}
+
+static int openPort(const Options& opt) {
+    int fd = open(opt.tty, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, opt.baud);
+        cfsetospeed(&tio, opt.baud);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+// Sends one command and prints its reply. Other frames (events, counters)
+// are skipped.
+static bool runCommand(int fd, const Options& opt, uint16_t seq, const std::string& line) {
+    uint8_t frame[TELEM_MAX_ENCODED];
+    size_t n = telemEncode(frame, TelemType::COMMAND, opt.device, seq, line.data(), line.size());
+    if (write(fd, frame, n) != (ssize_t)n) return false;
+
+    std::vector<uint8_t> buf;
+    bool overflow = false;
+    double deadline = nowS() + REPLY_MS / 1000.0;
+    while (nowS() < deadline) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        uint8_t in[1024];
+        ssize_t got = read(fd, in, sizeof(in));
+        if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (got <= 0) return false;
+
+        for (ssize_t i = 0; i < got; i++) {
+            if (in[i] != 0) {
+                if (buf.size() < TELEM_MAX_ENCODED) buf.push_back(in[i]);
+                else overflow = true;
+                continue;
+            }
+            TelemFrame reply;
+            bool ok = !overflow && !buf.empty() && telemDecode(buf.data(), buf.size(), reply);
+            buf.clear();
+            overflow = false;
+            if (!ok || reply.type != TelemType::REPLY || reply.len < 2) continue;
+            if (opt.device != TELEM_ANY_DEVICE && reply.device != opt.device) continue;
+            if ((uint16_t)(reply.payload[0] | reply.payload[1] << 8) != seq) continue;
+
+            fwrite(reply.payload + 2, 1, reply.len - 2, stdout);
+            fflush(stdout);
+            return true;
+        }
+    }
+    fprintf(stderr, "no reply\n");
+    return false;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "+b:d:")) != -1) {
+        switch (c) {
+        case 'b': opt.baud = baudFlag(atol(optarg)); break;
+        case 'd': opt.device = atoi(optarg); break;
+        default: opt.baud = 0; break;
+        }
+    }
+    if (optind < argc) opt.tty = argv[optind++];
+    if (opt.tty == nullptr || opt.baud == 0) {
+        fprintf(stderr, "usage: %s [-b baud] [-d device] TTY [COMMAND...]\n", argv[0]);
+        return 2;
+    }
+
+    int fd = openPort(opt);
+    if (fd < 0) {
+        perror(opt.tty);
+        return 1;
+    }
+    uint16_t seq = (uint16_t)getpid();
+
+    if (optind < argc) {
+        std::string line;
+        for (int i = optind; i < argc; i++) {
+            if (!line.empty()) line += ' ';
+            line += argv[i];
+        }
+        bool ok = runCommand(fd, opt, seq, line);
+        close(fd);
+        return ok ? 0 : 1;
+    }
+
+    char text[256];
+    bool tty = isatty(STDIN_FILENO);
+    while (true) {
+        if (tty) {
+            fprintf(stderr, "fed> ");
+            fflush(stderr);
+        }
+        if (fgets(text, sizeof(text), stdin) == nullptr) break;
+        std::string line = text;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+        if (line.empty()) continue;
+        if (line == "quit" || line == "exit") break;
+        runCommand(fd, opt, ++seq, line);
+    }
+    close(fd);
+    return 0;
+}
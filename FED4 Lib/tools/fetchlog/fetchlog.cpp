@@ -0,0 +1,244 @@
+// Downloads a file from a running feeder over its serial port (see the
+// fetch request in lib/FED4/Telemetry.h).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -Ilib/FED4 tools/fetchlog/fetchlog.cpp lib/FED4/Telemetry.cpp lib/FED4/LogBlock.cpp lib/FED4/Lzss.cpp -o fetchlog
+//
+// Usage:
+//   fetchlog [-b baud] [-d device] [-o out] [-s offset] [-l length] [-r retries] TTY [NAME]
+//
+// Without NAME the feeder sends the log segment it is writing, up to its
+// last flush, and -o is needed. The file is written to out (NAME by
+// default) from offset; without -s the download carries on from the end of
+// an existing out file, so running the same command again resumes one that
+// was cut off. Every chunk is checked against its CRC before it is written.
+// When no chunk arrives for a few seconds the fetch is sent again from the
+// last good offset, and a port that goes away is reopened.
+
+#include <LogBlock.h>
+#include <Lzss.h>
+#include <Telemetry.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    speed_t baud = B115200;
+    uint8_t device = TELEM_ANY_DEVICE;
+    const char* out = nullptr;
+    long offset = -1;
+    uint32_t length = 0;
+    int retries = 20;
+    const char* tty = nullptr;
+    const char* name = "";
+};
+
+static const int STALL_MS = 3000;
+
+static double nowS() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static speed_t baudFlag(long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+    }
+}
+
+static int openPort(const Options& opt) {
+    int fd = open(opt.tty, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, opt.baud);
+        cfsetospeed(&tio, opt.baud);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static bool sendFetch(int fd, const Options& opt, uint32_t offset, uint32_t length) {
+    uint8_t payload[sizeof(TelemFetch) + TELEM_MAX_NAME];
+    TelemFetch fetch = {offset, length};
+    size_t nameLen = strnlen(opt.name, TELEM_MAX_NAME);
+    memcpy(payload, &fetch, sizeof(fetch));
+    memcpy(payload + sizeof(fetch), opt.name, nameLen);
+
+    uint8_t frame[TELEM_MAX_ENCODED];
+    size_t n = telemEncode(frame, TelemType::FETCH, opt.device, 0, payload, sizeof(fetch) + nameLen);
+    return write(fd, frame, n) == (ssize_t)n;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "b:d:o:s:l:r:")) != -1) {
+        switch (c) {
+        case 'b': opt.baud = baudFlag(atol(optarg)); break;
+        case 'd': opt.device = atoi(optarg); break;
+        case 'o': opt.out = optarg; break;
+        case 's': opt.offset = atol(optarg); break;
+        case 'l': opt.length = strtoul(optarg, nullptr, 10); break;
+        case 'r': opt.retries = atoi(optarg); break;
+        default: opt.baud = 0; break;
+        }
+    }
+    if (optind < argc) opt.tty = argv[optind++];
+    if (optind < argc) opt.name = argv[optind++];
+    if (opt.out == nullptr && opt.name[0] != '\0') opt.out = opt.name;
+    if (opt.tty == nullptr || opt.out == nullptr || opt.baud == 0) {
+        fprintf(stderr, "usage: %s [-b baud] [-d device] [-o out] [-s offset] [-l length] [-r retries] TTY [NAME]\n", argv[0]);
+        return 2;
+    }
+
+    int out = open(opt.out, O_WRONLY | O_CREAT, 0644);
+    if (out < 0) {
+        perror(opt.out);
+        return 1;
+    }
+    uint32_t start = opt.offset;
+    if (opt.offset < 0) {
+        struct stat st;
+        start = fstat(out, &st) == 0 ? st.st_size : 0;
+    }
+    uint32_t next = start;
+    uint32_t end = 0;
+
+    int fd = -1;
+    int retries = 0;
+    bool done = false;
+    double lastProgress = nowS();
+    double lastReport = 0;
+    double begin = nowS();
+    uint64_t wire = 0;
+    uint64_t badChunks = 0;
+    std::vector<uint8_t> buf;
+    bool overflow = false;
+
+    while (!done) {
+        if (fd < 0) {
+            fd = openPort(opt);
+            if (fd < 0 || !sendFetch(fd, opt, next, opt.length ? start + opt.length - next : 0)) {
+                if (fd >= 0) close(fd);
+                fd = -1;
+                if (++retries > opt.retries) break;
+                sleep(1);
+                continue;
+            }
+            lastProgress = nowS();
+        }
+        if ((nowS() - lastProgress) * 1000 > STALL_MS) {
+            if (++retries > opt.retries) break;
+            fprintf(stderr, "no data, fetching again from %lu\n", (unsigned long)next);
+            if (!sendFetch(fd, opt, next, opt.length ? start + opt.length - next : 0)) {
+                close(fd);
+                fd = -1;
+            }
+            lastProgress = nowS();
+            continue;
+        }
+
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        uint8_t chunkBuf[4096];
+        ssize_t n = read(fd, chunkBuf, sizeof(chunkBuf));
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (n <= 0) {
+            fprintf(stderr, "%s: closed, reopening\n", opt.tty);
+            close(fd);
+            fd = -1;
+            sleep(1);
+            continue;
+        }
+
+        for (ssize_t i = 0; i < n && !done; i++) {
+            if (chunkBuf[i] != 0) {
+                if (buf.size() < TELEM_MAX_ENCODED) buf.push_back(chunkBuf[i]);
+                else overflow = true;
+                continue;
+            }
+            TelemFrame frame;
+            bool ok = !overflow && !buf.empty() && telemDecode(buf.data(), buf.size(), frame);
+            size_t frameLen = buf.size() + 1;
+            buf.clear();
+            overflow = false;
+            if (!ok || frame.type != TelemType::CHUNK || frame.len < sizeof(TelemChunk)) continue;
+            if (opt.device != TELEM_ANY_DEVICE && frame.device != opt.device) continue;
+
+            TelemChunk chunk;
+            memcpy(&chunk, frame.payload, sizeof(chunk));
+            if (chunk.offset != next) continue;     // left over from an earlier fetch
+            if (chunk.flags & TelemChunkFlag::MISSING) {
+                fprintf(stderr, "%s: no such file on the feeder\n", opt.name[0] ? opt.name : "log");
+                return 1;
+            }
+
+            uint8_t data[TELEM_MAX_PAYLOAD];
+            const uint8_t* body = frame.payload + sizeof(chunk);
+            size_t bodyLen = frame.len - sizeof(chunk);
+            int32_t len = bodyLen;
+            if (chunk.flags & TelemChunkFlag::LZSS) {
+                len = lzssExpand(body, bodyLen, data, sizeof(data));
+            }
+            else if (bodyLen <= sizeof(data)) {
+                memcpy(data, body, bodyLen);
+            }
+            else {
+                len = -1;
+            }
+            if (len != chunk.len || crc32Update(0, data, len) != chunk.crc) {
+                badChunks++;
+                continue;
+            }
+
+            if (pwrite(out, data, len, next) != len) {
+                perror(opt.out);
+                return 1;
+            }
+            next += len;
+            end = chunk.end;
+            wire += frameLen;
+            lastProgress = nowS();
+            retries = 0;
+            done = chunk.flags & TelemChunkFlag::LAST;
+        }
+
+        if (nowS() - lastReport > 1) {
+            lastReport = nowS();
+            fprintf(stderr, "\r%lu / %lu bytes", (unsigned long)next, (unsigned long)end);
+        }
+    }
+    if (fd >= 0) close(fd);
+    close(out);
+
+    double seconds = nowS() - begin;
+    uint32_t got = next - start;
+    fprintf(stderr, "\r%s: %lu bytes from %lu in %.1f s (%.1f kB/s), %.0f%% on the wire, %lu bad chunks\n",
+            opt.out, (unsigned long)got, (unsigned long)start, seconds, got / 1024.0 / seconds,
+            got ? 100.0 * wire / got : 0, (unsigned long)badChunks);
+    if (!done) {
+        fprintf(stderr, "gave up after %d retries, run again to resume\n", opt.retries);
+        return 1;
+    }
+    return 0;
+}
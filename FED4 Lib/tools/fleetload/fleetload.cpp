@@ -0,0 +1,674 @@
+// Fleet load test for the host tooling.
+//
+// Runs a room of simulated feeders at once, each the real FED4 code on the
+// native shim with a card, clock and animal of its own, and puts what they
+// produce through the host pipeline as it would arrive from the cages:
+// every feeder streams its telemetry to one telemd through a pty of its
+// own, and fedingest is run over the cards every few seconds. For each
+// fleet size it reports the rows the feeders logged, how long their rows
+// took to reach telemd's files, and the time and memory telemd and
+// fedingest needed.
+//
+// Build (from "FED4 Lib"), with telemd and fedingest built as well:
+//   g++ -std=gnu++17 -O2 -pthread -Itools/native -Ilib/FED4
+//       tools/fleetload/fleetload.cpp tools/native/native.cpp
+//       lib/FED4/*.cpp -o fleetload
+//
+// Usage:
+//   fleetload [-n 10,50,100,200] [-t seconds] [-x speed] [-r pokes_per_min]
+//             [-i ingest_seconds] [-j jobs] [-s seed] [-k dir]
+//             [-T telemd] [-I fedingest]
+//
+// Each fleet size runs for -t wall seconds, the feeders' clocks running -x
+// times faster. The firmware blocks inside run(), so each feeder has a
+// thread of its own; -j of them (one per core by default) may run firmware
+// at once, the others waiting for a slot. A feeder that cannot keep up
+// with its clock falls behind it, and the "behind" columns say by how much:
+// if they grow, the load generator and not the pipeline is the limit.
+// The curve is written to stdout as CSV, one row per fleet size. -k keeps
+// the cards, telemd's files and the column files under dir/<size>; -T and
+// -I name the telemd and fedingest to run, ./telemd and ./fedingest by
+// default.
+
+#include <FED4.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Device numbers are one byte, and TELEM_ANY_DEVICE is taken
+static const int MAX_FEEDERS = 254;
+// Longest clock step while a feeder is awake with nothing due
+static const uint64_t AWAKE_STEP_US = 10000;
+// While cues play the service tick has to run at its rate
+static const uint64_t BUSY_STEP_US = 1000000ULL / TICK_HZ;
+// Telemetry a feeder holds for its port before dropping it
+static const size_t BACKLOG_MAX = 64 * 1024;
+static const uint64_t MONITOR_US = 100000;
+static const uint32_t UNIX_START = 1735722000; // 2025-01-01 09:00
+
+struct Options {
+    std::vector<int> counts = {10, 50, 100, 200};
+    double seconds = 60;
+    double speed = 20;
+    double pokesPerMin = 2;
+    double ingestPeriod = 10;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t seed = 1;
+    std::string keep;
+    std::string telemd = "./telemd";
+    std::string fedingest = "./fedingest";
+};
+
+static int64_t wallUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static double percentile(std::vector<int64_t>& v, double p) {
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// Feeders that may run firmware at once. A feeder holds a slot while it
+// runs and gives it up while it waits for its clock to come due.
+class Slots {
+    public:
+    explicit Slots(unsigned n) : _free(n) {}
+
+    void acquire() {
+        std::unique_lock<std::mutex> lock(_m);
+        _cv.wait(lock, [this]() { return _free > 0; });
+        _free--;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _free++;
+        }
+        _cv.notify_one();
+    }
+
+    private:
+    std::mutex _m;
+    std::condition_variable _cv;
+    unsigned _free;
+};
+
+struct Feeder {
+    int number = 0;
+    std::string card;
+    uint32_t unixStart = 0;
+    int pty = -1;               // master side, telemd reads the other
+    int ptySlave = -1;
+    std::string ptyName;
+    std::mt19937 rng;
+
+    // The animal: pokes in bouts, mostly on one side, and the pellet
+    // taken a few seconds after it lands
+    double rate = 0;            // pokes per second, on average
+    double leftBias = 0.5;
+    bool inBout = false;
+    uint64_t boutEndUs = 0;
+    uint64_t pressUs = 0;
+    uint64_t releaseUs = UINT64_MAX;
+    uint8_t pokePin = 0;
+    uint64_t retrieveUs = UINT64_MAX;
+    int stepsToDrop = -1;
+    uint64_t pokes = 0;
+
+    // Telemetry on its way out
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> backlog;
+    uint64_t droppedBytes = 0;
+    std::mutex m;
+    std::vector<int64_t> sentUs; // wall time each Seq was sent, by Seq
+    uint64_t rows = 0;
+
+    int64_t wallStart = 0;
+    std::vector<int64_t> behind; // how late each poke went in
+    bool finished = false;
+};
+
+struct Fleet {
+    const Options& opt;
+    Slots slots;
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    Fleet(const Options& o) : opt(o), slots(o.jobs) {}
+};
+
+// ==== The animal ====
+
+static void nextPoke(Feeder& f, uint64_t after) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    // A bout pokes at 2.5 times the feeder's rate, a rest at a quarter;
+    // rests are twice as long, so the rate is kept on average
+    for (;;) {
+        double rate = f.inBout ? f.rate * 2.5 : f.rate * 0.25;
+        uint64_t gap = (uint64_t)(-log(1 - unit(f.rng)) / rate * 1e6);
+        if (after + gap < f.boutEndUs) {
+            f.pressUs = after + std::max<uint64_t>(gap, 60000);
+            return;
+        }
+        after = f.boutEndUs;
+        f.inBout = !f.inBout;
+        double mean = f.inBout ? 600 : 1200;
+        f.boutEndUs = after + (uint64_t)(-log(1 - unit(f.rng)) * mean * 1e6);
+    }
+}
+
+static uint64_t nextInput(const Feeder& f) {
+    return std::min({f.releaseUs != UINT64_MAX ? f.releaseUs : f.pressUs, f.retrieveUs});
+}
+
+static void inputs(Feeder& f) {
+    uint64_t now = sim::nowUs();
+    if (f.releaseUs != UINT64_MAX && now >= f.releaseUs) {
+        sim::setPin(f.pokePin, HIGH);
+        f.releaseUs = UINT64_MAX;
+        f.pokes++;
+        nextPoke(f, now);
+    }
+    else if (f.releaseUs == UINT64_MAX && now >= f.pressUs) {
+        std::uniform_real_distribution<double> unit(0, 1);
+        f.pokePin = unit(f.rng) < f.leftBias ? FED4Pins::LFT_POKE : FED4Pins::RGT_POKE;
+        sim::setPin(f.pokePin, LOW);
+        f.releaseUs = now + 15000 + f.rng() % 30000;
+    }
+    if (now >= f.retrieveUs) {
+        sim::setPin(FED4Pins::WELL, HIGH);
+        f.retrieveUs = UINT64_MAX;
+    }
+}
+
+// ==== Telemetry out ====
+
+static void drain(Feeder& f) {
+    while (!f.backlog.empty()) {
+        ssize_t n = write(f.pty, f.backlog.data(), f.backlog.size());
+        if (n <= 0) break;
+        f.backlog.erase(f.backlog.begin(), f.backlog.begin() + n);
+    }
+}
+
+// Notes when each row went out, by its Seq, so its arrival can be timed
+static void onSerial(Feeder& f, const uint8_t* buf, size_t n) {
+    int64_t now = wallUs();
+    for (size_t i = 0; i < n; i++) {
+        if (buf[i] != 0) {
+            if (f.frame.size() < TELEM_MAX_ENCODED) f.frame.push_back(buf[i]);
+            continue;
+        }
+        TelemFrame frame;
+        if (!f.frame.empty() && telemDecode(f.frame.data(), f.frame.size(), frame) && frame.type == TelemType::EVENT) {
+            uint32_t seq = strtoul(std::string((const char*)frame.payload, std::min<size_t>(frame.len, 12)).c_str(), nullptr, 10);
+            std::lock_guard<std::mutex> lock(f.m);
+            if (seq >= f.sentUs.size()) f.sentUs.resize(seq + 1024, -1);
+            f.sentUs[seq] = now;
+            f.rows++;
+        }
+        f.frame.clear();
+    }
+
+    if (f.backlog.size() + n > BACKLOG_MAX) f.droppedBytes += n;
+    else f.backlog.insert(f.backlog.end(), buf, buf + n);
+    drain(f);
+}
+
+// ==== Feeder thread ====
+
+// Waits, without a slot, until the wall clock reaches the feeder's time.
+// False once the run is over.
+static bool pace(Fleet& fleet, Feeder& f, uint64_t simUs) {
+    int64_t due = f.wallStart + (int64_t)(simUs / fleet.opt.speed);
+    if (due > wallUs() + 1000) {
+        fleet.slots.release();
+        {
+            std::unique_lock<std::mutex> lock(fleet.m);
+            fleet.cv.wait_until(
+                lock, std::chrono::steady_clock::time_point(std::chrono::microseconds(due)),
+                [&fleet]() { return fleet.stopping; }
+            );
+        }
+        fleet.slots.acquire();
+    }
+    std::lock_guard<std::mutex> lock(fleet.m);
+    return !fleet.stopping;
+}
+
+// On to next, noting how late an input goes in. False once the run is over.
+static bool stepTo(Fleet& fleet, Feeder& f, uint64_t next) {
+    uint64_t now = sim::nowUs();
+    bool running = pace(fleet, f, next);
+    if (next > now) sim::advance(next - now);
+    if (running && next == nextInput(f)) {
+        int64_t due = f.wallStart + (int64_t)(next / fleet.opt.speed);
+        f.behind.push_back(std::max<int64_t>(0, wallUs() - due));
+    }
+    drain(f);
+    return running;
+}
+
+// Asleep: on to the next input or RTC alarm. At the end a press wakes the
+// feeder so run() returns.
+static bool idle(Fleet& fleet, Feeder& f, sim::Board& b) {
+    uint64_t next = nextInput(f);
+    if (b.alarmEnabled && b.alarmAtUnix != 0) {
+        next = std::min<uint64_t>(next, (uint64_t)(b.alarmAtUnix - b.unixStart) * 1000000ULL);
+    }
+    f.finished = !stepTo(fleet, f, std::max(next, sim::nowUs() + 1000));
+    if (f.finished) {
+        b.stop = true;
+        sim::setPin(FED4Pins::LFT_POKE, LOW);
+        return true;
+    }
+    inputs(f);
+    return true;
+}
+
+static void runFeeder(Fleet& fleet, Feeder& f) {
+    sim::Board b;
+    b.sdRoot = f.card;
+    b.realTime = false;
+    b.unixStart = f.unixStart;
+    b.resetCause = PM_RCAUSE_WDT; // the watchdog resume path skips the menus
+    b.onIdle = [&]() { return idle(fleet, f, b); };
+    b.onStep = [&](int steps) {
+        if (f.stepsToDrop < 0) f.stepsToDrop = 20 + f.rng() % 40;
+        f.stepsToDrop -= abs(steps);
+        if (f.stepsToDrop <= 0 && sim::pinLevel(FED4Pins::WELL) == HIGH) {
+            sim::setPin(FED4Pins::WELL, LOW);
+            f.retrieveUs = sim::nowUs() + 1000000 + f.rng() % 9000000;
+            f.stepsToDrop = -1;
+        }
+    };
+    b.onSerial = [&](const uint8_t* buf, size_t n) { onSerial(f, buf, n); };
+
+    fleet.slots.acquire();
+    sim::setBoard(&b);
+    f.wallStart = wallUs();
+    nextPoke(f, 0);
+
+    FED4* fed = new FED4();
+    fed->begin();
+    for (uint8_t i = 0; i < fed->sensorCount; i++) {
+        if (fed->sensors[i].type == SensorType::DIGITAL) sim::setPin(fed->sensors[i].pin, HIGH, false);
+    }
+
+    while (!f.finished) {
+        inputs(f);
+        fed->run();
+        if (f.finished) break;
+        uint64_t now = sim::nowUs();
+        uint64_t step = cuePlaying() || soundPlaying() || syncBusy() ? BUSY_STEP_US : AWAKE_STEP_US;
+        f.finished = !stepTo(fleet, f, std::max(std::min(nextInput(f), now + step), now + 1000));
+    }
+    delete fed;
+    sim::setBoard(nullptr);
+    fleet.slots.release();
+
+    // What is still queued for the port goes out, if telemd takes it
+    for (int i = 0; i < 200 && !f.backlog.empty(); i++) {
+        drain(f);
+        if (!f.backlog.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// ==== Host side ====
+
+struct Child {
+    pid_t pid = -1;
+    int out = -1;               // its stdout, when kept
+};
+
+static Child spawn(const std::vector<std::string>& args, bool keepOutput, const std::string& errPath) {
+    Child c;
+    int fds[2] = {-1, -1};
+    if (keepOutput && pipe2(fds, O_CLOEXEC) != 0) return c;
+    c.pid = fork();
+    if (c.pid == 0) {
+        int err = open(errPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (err >= 0) dup2(err, 2);
+        int out = keepOutput ? fds[1] : open("/dev/null", O_WRONLY);
+        dup2(out, 1);
+        std::vector<char*> argv;
+        for (const std::string& a : args) argv.push_back((char*)a.c_str());
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        fprintf(stderr, "%s: cannot run\n", argv[0]);
+        _exit(127);
+    }
+    if (keepOutput) {
+        close(fds[1]);
+        c.out = fds[0];
+    }
+    return c;
+}
+
+// Exit status, peak memory in KB and what it printed
+static int reap(Child& c, long* maxRssKb, std::string* out) {
+    if (c.out >= 0) {
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(c.out, buf, sizeof(buf))) > 0) {
+            if (out) out->append(buf, n);
+        }
+        close(c.out);
+    }
+    int status = 0;
+    struct rusage ru = {};
+    if (c.pid > 0 && wait4(c.pid, &status, 0, &ru) < 0) return -1;
+    if (maxRssKb) *maxRssKb = std::max(*maxRssKb, ru.ru_maxrss);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+struct IngestStats {
+    std::vector<int64_t> passUs;
+    uint64_t rows = 0;
+    long maxRssKb = 0;
+    int failures = 0;
+};
+
+static void ingestOnce(const Options& opt, const std::string& root, IngestStats& s) {
+    int64_t start = wallUs();
+    Child c = spawn({opt.fedingest, "-q", "-o", root + "/fleet", root + "/cards"}, true, root + "/fedingest.log");
+    std::string out;
+    int status = reap(c, &s.maxRssKb, &out);
+    s.passUs.push_back(wallUs() - start);
+    size_t at = out.find(" MB, ");
+    if (status != 0 || at == std::string::npos) {
+        s.failures++;
+        return;
+    }
+    s.rows += strtoull(out.c_str() + at + 5, nullptr, 10);
+}
+
+// Rows telemd has written since the last call, each timed from when its
+// feeder sent it
+struct Arrivals {
+    std::map<std::string, off_t> offsets;
+    std::vector<int64_t> lagUs;
+    uint64_t rows = 0;
+};
+
+static void collect(std::vector<Feeder>& feeders, const std::string& telemDir, Arrivals& a) {
+    int64_t now = wallUs();
+    for (Feeder& f : feeders) {
+        char name[16];
+        snprintf(name, sizeof(name), "FED%02u", f.number);
+        std::string dir = telemDir + "/" + name;
+        DIR* d = opendir(dir.c_str());
+        if (d == nullptr) continue;
+        while (struct dirent* e = readdir(d)) {
+            if (strncmp(e->d_name, "events_", 7) != 0) continue;
+            std::string path = dir + "/" + e->d_name;
+            FILE* in = fopen(path.c_str(), "r");
+            if (in == nullptr) continue;
+            off_t& offset = a.offsets[path];
+            fseeko(in, offset, SEEK_SET);
+            char line[600];
+            while (fgets(line, sizeof(line), in)) {
+                size_t len = strlen(line);
+                if (len == 0 || line[len - 1] != '\n') break; // still being written
+                bool header = offset == 0;
+                offset += len;
+                if (header) continue;
+                uint32_t seq = strtoul(line, nullptr, 10);
+                std::lock_guard<std::mutex> lock(f.m);
+                if (seq < f.sentUs.size() && f.sentUs[seq] >= 0) a.lagUs.push_back(now - f.sentUs[seq]);
+                a.rows++;
+            }
+            fclose(in);
+        }
+        closedir(d);
+    }
+}
+
+static bool openPty(Feeder& f) {
+    // Close on exec, or telemd would hold the masters open itself and
+    // never see its ports close
+    f.pty = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (f.pty < 0 || grantpt(f.pty) != 0 || unlockpt(f.pty) != 0) return false;
+    f.ptyName = ptsname(f.pty);
+    fcntl(f.pty, F_SETFL, fcntl(f.pty, F_GETFL) | O_NONBLOCK);
+    // Raw before telemd opens it, so no byte of a frame is translated, and
+    // held open so what is written before then waits for it
+    f.ptySlave = open(f.ptyName.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    struct termios tio;
+    if (f.ptySlave < 0 || tcgetattr(f.ptySlave, &tio) != 0) return false;
+    cfmakeraw(&tio);
+    return tcsetattr(f.ptySlave, TCSANOW, &tio) == 0;
+}
+
+static void writeConfig(Feeder& f) {
+    mkdir(f.card.c_str(), 0755);
+    std::ofstream cfg(f.card + "/CONFIG.json");
+    const char* modes[] = {
+        "{\"name\":\"FR\",\"ratio\":1}",
+        "{\"name\":\"FR\",\"ratio\":3}",
+        "{\"name\":\"VI\",\"avg\":30,\"spread\":0.75}",
+        "{\"name\":\"CHANCE\",\"chance\":0.5}",
+    };
+    // Reward window off: the feeder sleeps between events. Segments of
+    // 1 MB rather than 25, so a fleet's cards fit on the host.
+    cfg << "{\"device number\":" << f.number << ",\"animal\":" << f.number
+        << ",\"mode\":" << modes[f.rng() % 4]
+        << ",\"active sensor\":\"both\",\"reward\":{\"left\":1,\"right\":1,\"window\":false}"
+        << ",\"log\":{\"segment mb\":1},\"telemetry\":{\"enabled\":true}}";
+}
+
+struct PointResult {
+    int feeders = 0;
+    uint64_t pokes = 0;
+    uint64_t rows = 0;
+    uint64_t arrived = 0;
+    uint64_t droppedBytes = 0;
+    double lagP50 = 0, lagP99 = 0, lagMax = 0;
+    long telemdRssKb = 0;
+    IngestStats ingest;
+    double catchUpMs = 0;
+    double behindP99 = 0, behindMax = 0;
+    double seconds = 0;
+    bool failed = false;
+};
+
+static PointResult runPoint(const Options& opt, int count, uint32_t seed) {
+    PointResult r;
+    r.feeders = count;
+
+    std::string root;
+    if (opt.keep.empty()) {
+        char dirTemplate[] = "/tmp/fed4-fleet-XXXXXX";
+        root = mkdtemp(dirTemplate);
+    }
+    else {
+        mkdir(opt.keep.c_str(), 0755);
+        root = opt.keep + "/" + std::to_string(count);
+        mkdir(root.c_str(), 0755);
+    }
+    mkdir((root + "/cards").c_str(), 0755);
+    mkdir((root + "/telem").c_str(), 0755);
+
+    std::vector<Feeder> feeders(count);
+    std::vector<std::string> telemArgs = {opt.telemd, "-e", "-o", root + "/telem"};
+    std::mt19937 rng(seed);
+    std::lognormal_distribution<double> rates(log(opt.pokesPerMin / 60.0) - 0.125, 0.5);
+    std::uniform_real_distribution<double> bias(0.5, 0.9);
+    for (int i = 0; i < count; i++) {
+        Feeder& f = feeders[i];
+        f.number = i + 1;
+        f.rng.seed(seed * 1000 + i);
+        char name[16];
+        snprintf(name, sizeof(name), "/FED%03d", f.number);
+        f.card = root + "/cards" + name;
+        // Log names carry the number mod 100, so each hundred keeps its
+        // clocks a year on and their files apart
+        f.unixStart = UNIX_START + (f.number / 100) * 365 * 86400 + rng() % 240;
+        f.rate = rates(rng);
+        f.leftBias = bias(rng);
+        f.inBout = rng() % 3 != 0; // flips at once: a third start in a bout
+        writeConfig(f);
+        if (!openPty(f)) {
+            fprintf(stderr, "cannot open a pty for feeder %d\n", f.number);
+            r.failed = true;
+            return r;
+        }
+        telemArgs.push_back(f.ptyName);
+    }
+
+    Child telemd = spawn(telemArgs, false, root + "/telemd.log");
+    Fleet fleet(opt);
+    std::vector<std::thread> threads;
+    int64_t start = wallUs();
+    for (Feeder& f : feeders) threads.emplace_back(runFeeder, std::ref(fleet), std::ref(f));
+
+    Arrivals arrivals;
+    std::thread ingest([&]() {
+        for (int64_t next = start + (int64_t)(opt.ingestPeriod * 1e6); ; next += (int64_t)(opt.ingestPeriod * 1e6)) {
+            {
+                std::unique_lock<std::mutex> lock(fleet.m);
+                fleet.cv.wait_until(
+                    lock, std::chrono::steady_clock::time_point(std::chrono::microseconds(next)),
+                    [&fleet]() { return fleet.stopping; }
+                );
+                if (fleet.stopping) return;
+            }
+            ingestOnce(opt, root, r.ingest);
+        }
+    });
+
+    int64_t end = start + (int64_t)(opt.seconds * 1e6);
+    while (wallUs() < end) {
+        std::this_thread::sleep_for(std::chrono::microseconds(MONITOR_US));
+        collect(feeders, root + "/telem", arrivals);
+    }
+    {
+        std::lock_guard<std::mutex> lock(fleet.m);
+        fleet.stopping = true;
+    }
+    fleet.cv.notify_all();
+    for (std::thread& t : threads) t.join();
+    ingest.join();
+    r.seconds = (wallUs() - start) / 1e6;
+
+    // telemd has what was sent once its files stop growing
+    for (Feeder& f : feeders) {
+        r.rows += f.rows;
+        r.pokes += f.pokes;
+        r.droppedBytes += f.droppedBytes;
+    }
+    for (uint64_t last = UINT64_MAX; last != arrivals.rows;) {
+        last = arrivals.rows;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        collect(feeders, root + "/telem", arrivals);
+    }
+    for (Feeder& f : feeders) {
+        close(f.pty);
+        close(f.ptySlave);
+    }
+    if (reap(telemd, &r.telemdRssKb, nullptr) != 0) r.failed = true;
+    collect(feeders, root + "/telem", arrivals);
+
+    r.arrived = arrivals.rows;
+    r.lagP50 = percentile(arrivals.lagUs, 0.5) / 1000;
+    r.lagP99 = percentile(arrivals.lagUs, 0.99) / 1000;
+    r.lagMax = percentile(arrivals.lagUs, 1.0) / 1000;
+
+    // What the feeders flushed after the last pass, as a run after a
+    // day's cards are copied in would find it
+    IngestStats last;
+    ingestOnce(opt, root, last);
+    r.catchUpMs = last.passUs.empty() ? 0 : last.passUs[0] / 1000.0;
+    r.ingest.rows += last.rows;
+    r.ingest.maxRssKb = std::max(r.ingest.maxRssKb, last.maxRssKb);
+    r.ingest.failures += last.failures;
+    if (r.ingest.failures) r.failed = true;
+
+    std::vector<int64_t> behind;
+    for (Feeder& f : feeders) behind.insert(behind.end(), f.behind.begin(), f.behind.end());
+    r.behindP99 = percentile(behind, 0.99) / 1000;
+    r.behindMax = percentile(behind, 1.0) / 1000;
+
+    std::string rm = "rm -rf " + root;
+    if (opt.keep.empty() && system(rm.c_str()) != 0) fprintf(stderr, "could not remove %s\n", root.c_str());
+    return r;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "n:t:x:r:i:j:s:k:T:I:")) != -1) {
+        switch (c) {
+        case 'n': {
+            opt.counts.clear();
+            std::stringstream ss(optarg);
+            std::string v;
+            while (std::getline(ss, v, ',')) opt.counts.push_back(atoi(v.c_str()));
+            break;
+        }
+        case 't': opt.seconds = atof(optarg); break;
+        case 'x': opt.speed = atof(optarg); break;
+        case 'r': opt.pokesPerMin = atof(optarg); break;
+        case 'i': opt.ingestPeriod = atof(optarg); break;
+        case 'j': opt.jobs = std::max(1, atoi(optarg)); break;
+        case 's': opt.seed = atoi(optarg); break;
+        case 'k': opt.keep = optarg; break;
+        case 'T': opt.telemd = optarg; break;
+        case 'I': opt.fedingest = optarg; break;
+        default: argc = 0; break;
+        }
+    }
+    bool valid = argc > 0 && optind == argc && opt.speed > 0 && opt.pokesPerMin > 0 && opt.ingestPeriod > 0;
+    for (int n : opt.counts) valid = valid && n > 0 && n <= MAX_FEEDERS;
+    if (!valid) {
+        fprintf(stderr, "usage: %s [-n 10,50,100,200] [-t seconds] [-x speed] [-r pokes_per_min] "
+                "[-i ingest_seconds] [-j jobs] [-s seed] [-k dir] [-T telemd] [-I fedingest]\n"
+                "at most %d feeders\n", argv[0], MAX_FEEDERS);
+        return 2;
+    }
+    if (access(opt.telemd.c_str(), X_OK) != 0 || access(opt.fedingest.c_str(), X_OK) != 0) {
+        fprintf(stderr, "%s and %s have to be built first (see tools/README.md)\n",
+                opt.telemd.c_str(), opt.fedingest.c_str());
+        return 2;
+    }
+
+    printf("feeders,wall_s,pokes,rows,rows_per_s,telem_rows,telem_lost,serial_dropped_bytes,"
+           "lag_p50_ms,lag_p99_ms,lag_max_ms,telemd_rss_kb,ingest_runs,ingest_rows,ingest_p50_ms,"
+           "ingest_max_ms,ingest_catchup_ms,ingest_rss_kb,behind_p99_ms,behind_max_ms\n");
+    int failures = 0;
+    for (size_t i = 0; i < opt.counts.size(); i++) {
+        PointResult r = runPoint(opt, opt.counts[i], opt.seed + i);
+        std::vector<int64_t> passes = r.ingest.passUs;
+        double passP50 = percentile(passes, 0.5) / 1000;
+        double passMax = percentile(passes, 1.0) / 1000;
+        printf("%d,%.1f,%lu,%lu,%.1f,%lu,%ld,%lu,%.1f,%.1f,%.1f,%ld,%zu,%lu,%.1f,%.1f,%.1f,%ld,%.1f,%.1f\n",
+               r.feeders, r.seconds, (unsigned long)r.pokes, (unsigned long)r.rows,
+               r.seconds > 0 ? r.rows / r.seconds : 0, (unsigned long)r.arrived,
+               (long)r.rows - (long)r.arrived, (unsigned long)r.droppedBytes,
+               r.lagP50, r.lagP99, r.lagMax, r.telemdRssKb, r.ingest.passUs.size(),
+               (unsigned long)r.ingest.rows, passP50, passMax, r.catchUpMs, r.ingest.maxRssKb,
+               r.behindP99, r.behindMax);
+        fflush(stdout);
+        if (r.failed) failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+// Log path benchmark on the native shim: runs FED4::benchmarkLog(), which
+// writes the same rows through SdFat with a sync per flush and through the
+// raw block path (lib/FED4/RawLog.h), and prints the BENCH.json it saves.
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=gnu++17 -O2 -pthread -Itools/native -Ilib/FED4
+//       tools/logbench/logbench.cpp tools/native/native.cpp
+//       lib/FED4/*.cpp -o logbench
+//
+// Usage:
+//   logbench [-n flushes] [-l sd_latency_us]
+//
+// The shim charges the latency per sync and per multi-block write and an
+// eighth of it per block streamed, so its numbers show the shape of the
+// difference only; on a feeder call benchmarkLog() from setup() and read
+// BENCH.json off the card.
+
+#include <FED4.h>
+
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+int main(int argc, char** argv) {
+    uint16_t flushes = 500;
+    uint32_t sdLatencyUs = 20000;
+    int c;
+    while ((c = getopt(argc, argv, "n:l:")) != -1) {
+        switch (c) {
+        case 'n': flushes = atoi(optarg); break;
+        case 'l': sdLatencyUs = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n flushes] [-l sd_latency_us]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    char dirTemplate[] = "/tmp/fed4-logbench-XXXXXX";
+    std::string dir = mkdtemp(dirTemplate);
+
+    sim::Board b;
+    b.sdRoot = dir;
+    b.sdLatencyUs = sdLatencyUs;
+    b.resetCause = PM_RCAUSE_WDT; // skip the interactive menus
+    sim::setBoard(&b);
+
+    FED4* fed = new FED4();
+    fed->begin();
+    fed->benchmarkLog(flushes);
+
+    std::ifstream in(dir + "/BENCH.json");
+    std::cout << in.rdbuf() << std::endl;
+
+    std::string rm = "rm -rf " + dir;
+    if (system(rm.c_str()) != 0) fprintf(stderr, "could not remove %s\n", dir.c_str());
+    fflush(stdout);
+    _Exit(0); // the shim's interrupt threads are not joined
+}
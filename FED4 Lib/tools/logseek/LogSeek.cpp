@@ -0,0 +1,227 @@
+#include "LogSeek.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Below this many bytes the search scans instead of bisecting
+static const size_t SCAN_SPAN = 4096;
+
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+bool logSeekParseTime(const char* p, const char* end, int64_t* unixTime) {
+    int v[6] = {0};
+    int n = 0;
+    bool digits = false;
+    for (; p < end && n < 6; p++) {
+        if (*p >= '0' && *p <= '9') {
+            v[n] = v[n] * 10 + (*p - '0');
+            digits = true;
+        }
+        else if (digits && (*p == '/' || *p == ' ' || *p == ':')) {
+            n++;
+            digits = false;
+        }
+        else {
+            return false;
+        }
+    }
+    if (digits) n++;
+    if (n != 6 || v[1] < 1 || v[1] > 12 || v[0] < 1 || v[0] > 31) return false;
+    *unixTime = daysFromCivil(2000 + v[2], v[1], v[0]) * 86400 + v[3] * 3600 + v[4] * 60 + v[5];
+    return true;
+}
+
+static size_t lineEnd(const LogSeek& log, size_t pos) {
+    const void* nl = memchr(log.data + pos, '\n', log.end - pos);
+    return nl ? (const char*)nl - log.data : log.end;
+}
+
+bool logSeekRowTime(const LogSeek& log, size_t pos, int64_t* unixTime, size_t* next) {
+    size_t stop = lineEnd(log, pos);
+    *next = stop < log.end ? stop + 1 : log.end;
+    if (stop == pos || log.data[pos] == '#' || log.timeColumn < 0) return false;
+
+    const char* p = log.data + pos;
+    const char* e = log.data + stop;
+    for (int c = 0; c < log.timeColumn && p < e; c++) {
+        const char* comma = (const char*)memchr(p, ',', e - p);
+        p = comma ? comma + 1 : e;
+    }
+    const char* comma = (const char*)memchr(p, ',', e - p);
+    return logSeekParseTime(p, comma ? comma : e, unixTime);
+}
+
+// The first erased byte, as the firmware finds it
+static size_t dataEnd(const uint8_t* data, size_t size) {
+    auto erased = [](uint8_t c) { return c == 0x00 || c == 0xFF; };
+    size_t lo = 0;
+    size_t hi = (size + 511) / 512;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (erased(data[mid * 512])) hi = mid;
+        else lo = mid + 1;
+    }
+    if (lo == 0) return 0;
+    size_t end = (lo - 1) * 512;
+    while (end < size && end < lo * 512 && !erased(data[end])) end++;
+    return end;
+}
+
+// The row at the offset must be the one the entry names
+static bool entryMatches(const LogSeek& log, const LogIndexEntry& entry) {
+    int64_t t;
+    size_t next;
+    return entry.offset >= log.rows && entry.offset < log.end
+        && log.data[entry.offset - 1] == '\n'
+        && logSeekRowTime(log, entry.offset, &t, &next) && t == entry.unixTime;
+}
+
+static void readIndex(LogSeek& log, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == nullptr) return;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strcspn(line, "\n");
+        LogIndexEntry entry;
+        if (!logIndexParse(line, len, &entry)) continue;
+        if (entry.offset < log.end && (log.index.empty() || entry.offset > log.index.back().offset)) {
+            log.index.push_back(entry);
+        }
+        else {
+            log.badEntries++;
+        }
+    }
+    fclose(f);
+}
+
+bool logSeekOpen(LogSeek& log, const char* path, const char* indexPath) {
+    log = LogSeek();
+    log.fd = open(path, O_RDONLY);
+    if (log.fd < 0) return false;
+    struct stat st;
+    if (fstat(log.fd, &st) != 0) {
+        logSeekClose(log);
+        return false;
+    }
+    log.size = st.st_size;
+    if (log.size > 0) {
+        void* map = mmap(nullptr, log.size, PROT_READ, MAP_PRIVATE, log.fd, 0);
+        if (map == MAP_FAILED) {
+            logSeekClose(log);
+            return false;
+        }
+        log.data = (const char*)map;
+        madvise(map, log.size, MADV_RANDOM);
+        log.end = dataEnd((const uint8_t*)map, log.size);
+    }
+
+    // The column header is the first line not starting with '#'
+    for (size_t pos = 0; pos < log.end;) {
+        size_t stop = lineEnd(log, pos);
+        size_t next = stop < log.end ? stop + 1 : log.end;
+        if (stop > pos && log.data[pos] != '#') {
+            log.header.assign(log.data + pos, stop - pos);
+            if (!log.header.empty() && log.header.back() == '\r') log.header.pop_back();
+            log.rows = next;
+            break;
+        }
+        pos = next;
+    }
+    int column = 0;
+    for (size_t i = 0, start = 0; i <= log.header.size(); i++) {
+        if (i == log.header.size() || log.header[i] == ',') {
+            if (log.header.compare(start, i - start, "TimeStamp") == 0) log.timeColumn = column;
+            column++;
+            start = i + 1;
+        }
+    }
+    if (log.timeColumn < 0) {
+        logSeekClose(log);
+        return false;
+    }
+
+    std::string sidecar;
+    if (indexPath == nullptr) {
+        char name[4096];
+        logIndexName(path, name, sizeof(name));
+        sidecar = name;
+        indexPath = sidecar.c_str();
+    }
+    readIndex(log, indexPath);
+    return true;
+}
+
+void logSeekClose(LogSeek& log) {
+    if (log.data) munmap((void*)log.data, log.size);
+    if (log.fd >= 0) close(log.fd);
+    log.data = nullptr;
+    log.fd = -1;
+}
+
+// A place at or before the first row at or after t: the last index entry
+// before t, or without an index, the bytes bisected by the time of the
+// first row after each midpoint
+static size_t seekBefore(const LogSeek& log, int64_t t, size_t* scanned) {
+    if (!log.index.empty()) {
+        size_t lo = 0, hi = log.index.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (log.index[mid].unixTime < t) lo = mid + 1;
+            else hi = mid;
+        }
+        // Only the entries the search lands on are checked against the log
+        while (lo > 0 && !entryMatches(log, log.index[lo - 1])) lo--;
+        return lo == 0 ? log.rows : log.index[lo - 1].offset;
+    }
+
+    size_t lo = log.rows, hi = log.end;
+    while (hi - lo > SCAN_SPAN) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t pos = lineEnd(log, mid) + 1;
+        int64_t rowTime = 0;
+        bool found = false;
+        while (pos < hi && !found) {
+            size_t next;
+            found = logSeekRowTime(log, pos, &rowTime, &next);
+            *scanned += next - pos;
+            if (!found) pos = next;
+        }
+        if (!found || rowTime >= t) hi = mid;
+        else lo = pos;
+    }
+    return lo;
+}
+
+LogRange logSeekRange(const LogSeek& log, int64_t from, int64_t to) {
+    LogRange range = {log.end, log.end, 0};
+    size_t pos = seekBefore(log, from, &range.scanned);
+    bool started = false;
+    while (pos < log.end) {
+        int64_t t;
+        size_t next;
+        bool row = logSeekRowTime(log, pos, &t, &next);
+        range.scanned += next - pos;
+        if (row && !started && t >= from) {
+            range.begin = pos;
+            started = true;
+        }
+        if (row && t >= to) {
+            if (!started) range.begin = pos;
+            range.end = pos;
+            break;
+        }
+        pos = next;
+    }
+    return range;
+}
@@ -0,0 +1,59 @@
+#ifndef LOGSEEK_H
+#define LOGSEEK_H
+
+// Random access by time into a FED4 log segment. The segment is mapped
+// and its sidecar index (lib/FED4/LogIndex.h) read, so a time range is
+// found by a binary search over the index and a scan of at most the rows
+// between two entries before the range starts. Without an index the same
+// search runs over the bytes of the log, a row at a time, which still
+// reads a few pages per step rather than the whole file. An index entry
+// is only trusted if the row at its offset has the entry's time, so a
+// stale or torn sidecar slows the search down but cannot misplace it.
+//
+// Times are seconds since 1970 on the feeder's clock, which keeps local
+// time without a zone, as RTClib's unixtime() gives them.
+//
+// Host only: uses mmap.
+
+#include <LogIndex.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LogSeek {
+    int fd = -1;
+    const char* data = nullptr;
+    size_t size = 0;            // mapped
+    size_t end = 0;             // first erased byte
+    size_t rows = 0;            // first byte after the column header
+    std::string header;         // without its '\n'
+    int timeColumn = -1;
+    std::vector<LogIndexEntry> index;
+    size_t badEntries = 0;      // lines past the log or out of order
+};
+
+struct LogRange {
+    size_t begin;               // first row at or after from
+    size_t end;                 // first row at or after to, or the end
+    size_t scanned;             // bytes read to find them
+};
+
+// indexPath defaults to the sidecar next to path. A missing index is not
+// an error.
+bool logSeekOpen(LogSeek& log, const char* path, const char* indexPath = nullptr);
+void logSeekClose(LogSeek& log);
+
+// Bytes of the rows logged from 'from' up to, but not including, 'to'.
+// Lines starting with '#' inside the range are left in.
+LogRange logSeekRange(const LogSeek& log, int64_t from, int64_t to);
+
+// The time of the row starting at pos, or false for a '#' line, a blank
+// line or a row without a readable time. next is set to the next line.
+bool logSeekRowTime(const LogSeek& log, size_t pos, int64_t* unixTime, size_t* next);
+
+// "d/m/yy h:m:s" as logEvent() writes it
+bool logSeekParseTime(const char* p, const char* end, int64_t* unixTime);
+
+#endif
@@ -0,0 +1,91 @@
+// Prints the rows of a FED4 log segment between two times, found through
+// the segment's time index (see tools/logseek/LogSeek.h).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -Ilib/FED4 -Itools/logseek tools/logseek/logseek.cpp tools/logseek/LogSeek.cpp lib/FED4/LogIndex.cpp -o logseek
+//
+// Usage:
+//   logseek [-i index] [-c] [-v] FILE FROM TO
+//
+// FROM and TO are "yyyy-mm-dd hh:mm[:ss]", the log's own "d/m/yy h:m:s",
+// or seconds since 1970; TO is not included. The rows come out under the
+// log's column header, without the block trailers, so the output is a CSV
+// of its own. -c prints only the number of rows, -v how much of the log
+// had to be read to find them.
+
+#include <LogSeek.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+static bool parseArgTime(const char* s, int64_t* t) {
+    int y, mo, d, h = 0, mi = 0, sec = 0;
+    char tail;
+    if (sscanf(s, "%d-%d-%d %d:%d:%d%c", &y, &mo, &d, &h, &mi, &sec, &tail) >= 3
+        && strchr(s, '-') != nullptr) {
+        char log[64];
+        snprintf(log, sizeof(log), "%d/%d/%d %d:%d:%d", d, mo, y % 1000, h, mi, sec);
+        return logSeekParseTime(log, log + strlen(log), t);
+    }
+    if (strchr(s, '/') != nullptr) {
+        return logSeekParseTime(s, s + strlen(s), t);
+    }
+    char* end;
+    *t = strtoll(s, &end, 10);
+    return end != s && *end == '\0';
+}
+
+int main(int argc, char** argv) {
+    const char* indexPath = nullptr;
+    bool countOnly = false;
+    bool verbose = false;
+    int c;
+    while ((c = getopt(argc, argv, "i:cv")) != -1) {
+        switch (c) {
+        case 'i': indexPath = optarg; break;
+        case 'c': countOnly = true; break;
+        case 'v': verbose = true; break;
+        default: argc = 0; break;
+        }
+    }
+    int64_t from, to;
+    if (argc - optind != 3 || !parseArgTime(argv[optind + 1], &from) || !parseArgTime(argv[optind + 2], &to)) {
+        fprintf(stderr, "usage: %s [-i index] [-c] [-v] FILE FROM TO\n", argv[0]);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    LogSeek log;
+    if (!logSeekOpen(log, argv[optind], indexPath)) {
+        fprintf(stderr, "%s: cannot read, or no TimeStamp column\n", argv[optind]);
+        return 1;
+    }
+    LogRange range = logSeekRange(log, from, to);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t rows = 0;
+    if (!countOnly) printf("%s\n", log.header.c_str());
+    for (size_t pos = range.begin; pos < range.end;) {
+        const void* nl = memchr(log.data + pos, '\n', range.end - pos);
+        size_t next = nl ? (const char*)nl - log.data + 1 : range.end;
+        if (next - pos > 1 && log.data[pos] != '#') {
+            rows++;
+            if (!countOnly) fwrite(log.data + pos, 1, next - pos, stdout);
+        }
+        pos = next;
+    }
+    if (countOnly) printf("%lu\n", (unsigned long)rows);
+
+    if (verbose) {
+        fprintf(stderr, "%lu rows in bytes %lu-%lu of %lu; %lu index entries (%lu bad), "
+                "%lu bytes read to find them in %.2f ms\n",
+                (unsigned long)rows, (unsigned long)range.begin, (unsigned long)range.end,
+                (unsigned long)log.end, (unsigned long)log.index.size(), (unsigned long)log.badEntries,
+                (unsigned long)range.scanned, ms);
+    }
+    logSeekClose(log);
+    return 0;
+}
@@ -0,0 +1,337 @@
+// Integrity check for FED4 log segments (see lib/FED4/LogBlock.h).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -pthread -Ilib/FED4 tools/logverify/logverify.cpp lib/FED4/LogBlock.cpp -o logverify
+//
+// Usage:
+//   logverify [-j threads] [-q] FILE|DIR [...]
+//
+// Every block is checked against its trailer, block numbers and the "Seq"
+// column are followed through each segment and on into the segment whose
+// chain line names it as prev. Bytes no trailer covers are reported as
+// unsealed; anything but blank lines there is a flush cut off by a reset.
+// Only sealed rows are counted. Files are mapped and checked in parallel,
+// one per thread. With -q only the files with findings and the totals are
+// printed. The exit status is 1 if any block fails its CRC or has a bad
+// trailer.
+
+#include <LogBlock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Result {
+    std::string path;
+    std::string name;       // without the directory
+    std::string prev;       // from the chain line
+    bool readable = false;
+    uint64_t bytes = 0;     // up to the erased rest of the segment
+    uint64_t blocks = 0;
+    uint64_t badCrc = 0;
+    uint64_t badTrailers = 0;
+    uint64_t blockGaps = 0;
+    uint64_t unsealed = 0;  // bytes
+    uint64_t torn = 0;      // unsealed runs with more than blank lines
+    uint64_t rows = 0;
+    uint64_t seqGaps = 0;
+    uint64_t reordered = 0;
+    int64_t firstBlock = -1, lastBlock = -1;
+    int64_t firstSeq = -1, lastSeq = -1;
+};
+
+// ==== CRC-32, eight bytes at a time ====
+static uint32_t crcTable[8][256];
+
+static void crcInit() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+        crcTable[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            crcTable[t][i] = (crcTable[t - 1][i] >> 8) ^ crcTable[0][crcTable[t - 1][i] & 0xFF];
+        }
+    }
+}
+
+static uint32_t crcFast(const uint8_t* p, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF]
+            ^ crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24]
+            ^ crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF]
+            ^ crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = (crc >> 8) ^ crcTable[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+// ==== Segment scan ====
+static bool blankOnly(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != '\n' && p[i] != '\r') return false;
+    }
+    return true;
+}
+
+static void followSeq(Result& r, int64_t seq) {
+    if (r.lastSeq >= 0) {
+        if (seq <= r.lastSeq) r.reordered++;
+        else if (seq > r.lastSeq + 1) r.seqGaps++;
+    }
+    if (r.firstSeq < 0) r.firstSeq = seq;
+    r.lastSeq = std::max(r.lastSeq, seq);
+}
+
+static void scan(Result& r, const uint8_t* data, size_t size) {
+    // The segment ends at its first erased byte
+    size_t end = 0;
+    while (end < size && data[end] != 0x00 && data[end] != 0xFF) {
+        const void* nl = memchr(data + end, '\n', size - end);
+        size_t lineEnd = nl ? (const uint8_t*)nl - data + 1 : size;
+        const uint8_t* zero = (const uint8_t*)memchr(data + end, 0x00, lineEnd - end);
+        if (zero) { end = zero - data; break; }
+        const uint8_t* ff = (const uint8_t*)memchr(data + end, 0xFF, lineEnd - end);
+        if (ff) { end = ff - data; break; }
+        end = lineEnd;
+    }
+    r.bytes = end;
+
+    size_t sealedTo = 0;    // end of the last trailer
+    int seqColumn = -1;
+    // Rows since the last trailer, counted once a block covers them
+    std::vector<std::pair<size_t, int64_t>> pending;
+    bool header = false;
+
+    for (size_t pos = 0; pos < end;) {
+        const void* nl = memchr(data + pos, '\n', end - pos);
+        size_t lineEnd = nl ? (const uint8_t*)nl - data : end;
+        const char* line = (const char*)data + pos;
+        size_t lineLen = lineEnd - pos;
+        size_t next = nl ? lineEnd + 1 : end;
+
+        if (lineLen > 2 && line[0] == '#' && line[1] == 'B' && line[2] == ',') {
+            uint32_t seq, len, crc;
+            if (!logParseTrailer(line, lineLen, &seq, &len, &crc) || len > pos - sealedTo) {
+                r.badTrailers++;
+            }
+            else {
+                size_t blockStart = pos - len;
+                if (blockStart > sealedTo) {
+                    r.unsealed += blockStart - sealedTo;
+                    if (!blankOnly(data + sealedTo, blockStart - sealedTo)) r.torn++;
+                }
+                if (crcFast(data + blockStart, len) != crc) r.badCrc++;
+                for (const auto& row : pending) {
+                    if (row.first < blockStart) continue;
+                    r.rows++;
+                    if (row.second >= 0) followSeq(r, row.second);
+                }
+                if (r.lastBlock >= 0 && seq != r.lastBlock + 1) r.blockGaps++;
+                if (r.firstBlock < 0) r.firstBlock = seq;
+                r.lastBlock = seq;
+                r.blocks++;
+            }
+            sealedTo = next;
+            pending.clear();
+        }
+        else if (lineLen > 0 && line[0] == '#') {
+            const char* prev = (const char*)memmem(line, lineLen, ",prev=", 6);
+            if (prev && r.prev.empty()) {
+                const char* v = prev + 6;
+                const char* e = (const char*)memchr(v, ',', line + lineLen - v);
+                r.prev.assign(v, e ? e : line + lineLen);
+            }
+        }
+        else if (lineLen > 0 && !header) {
+            header = true;
+            int column = 0;
+            for (size_t i = 0, start = 0; i <= lineLen; i++) {
+                if (i == lineLen || line[i] == ',') {
+                    if (i - start == 3 && memcmp(line + start, "Seq", 3) == 0) seqColumn = column;
+                    column++;
+                    start = i + 1;
+                }
+            }
+        }
+        else if (lineLen > 0) {
+            int64_t seq = -1;
+            if (seqColumn >= 0) {
+                const char* p = line;
+                const char* stop = line + lineLen;
+                for (int c = 0; c < seqColumn && p < stop; c++) {
+                    const char* comma = (const char*)memchr(p, ',', stop - p);
+                    p = comma ? comma + 1 : stop;
+                }
+                if (p < stop && *p >= '0' && *p <= '9') {
+                    seq = strtoll(p, nullptr, 10);
+                }
+            }
+            pending.emplace_back(pos, seq);
+        }
+        pos = next;
+    }
+
+    if (end > sealedTo) {
+        r.unsealed += end - sealedTo;
+        if (!blankOnly(data + sealedTo, end - sealedTo)) r.torn++;
+    }
+}
+
+static void check(Result& r) {
+    int fd = open(r.path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return;
+    }
+    r.readable = true;
+    if (st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            r.readable = false;
+        }
+        else {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            scan(r, (const uint8_t*)map, st.st_size);
+            munmap(map, st.st_size);
+        }
+    }
+    close(fd);
+}
+
+static void addPath(std::vector<Result>& results, const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) return;
+        while (dirent* e = readdir(dir)) {
+            std::string name = e->d_name;
+            if (name.compare(0, 3, "FED") == 0 && name.size() > 4
+                && name.compare(name.size() - 4, 4, ".csv") == 0) {
+                Result r;
+                r.path = path + "/" + name;
+                r.name = name;
+                results.push_back(r);
+            }
+        }
+        closedir(dir);
+        return;
+    }
+    Result r;
+    r.path = path;
+    size_t slash = path.find_last_of('/');
+    r.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    results.push_back(r);
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool quiet = false;
+    int c;
+    while ((c = getopt(argc, argv, "j:q")) != -1) {
+        switch (c) {
+        case 'j': threads = std::max(1, atoi(optarg)); break;
+        case 'q': quiet = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-j threads] [-q] FILE|DIR [...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-j threads] [-q] FILE|DIR [...]\n", argv[0]);
+        return 2;
+    }
+
+    crcInit();
+    if (crcFast((const uint8_t*)"123456789", 9) != crc32Update(0, "123456789", 9)) {
+        fprintf(stderr, "CRC tables disagree with the firmware\n");
+        return 2;
+    }
+
+    std::vector<Result> results;
+    for (int i = optind; i < argc; i++) addPath(results, argv[i]);
+    std::sort(results.begin(), results.end(),
+              [](const Result& a, const Result& b) { return a.path < b.path; });
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextFile{0};
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < std::min<size_t>(threads, results.size()); t++) {
+        pool.emplace_back([&]() {
+            for (size_t i = nextFile++; i < results.size(); i = nextFile++) check(results[i]);
+        });
+    }
+    for (auto& t : pool) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Numbering runs on into the segment that names this one as prev
+    for (Result& r : results) {
+        if (r.prev.empty()) continue;
+        for (const Result& p : results) {
+            if (p.name != r.prev || p.path.size() - p.name.size() != r.path.size() - r.name.size()
+                || p.path.compare(0, p.path.size() - p.name.size(), r.path, 0, r.path.size() - r.name.size()) != 0) {
+                continue;
+            }
+            if (p.lastBlock >= 0 && r.firstBlock >= 0 && r.firstBlock != p.lastBlock + 1) r.blockGaps++;
+            if (p.lastSeq >= 0 && r.firstSeq >= 0) {
+                if (r.firstSeq <= p.lastSeq) r.reordered++;
+                else if (r.firstSeq > p.lastSeq + 1) r.seqGaps++;
+            }
+        }
+    }
+
+    Result total;
+    uint64_t unreadable = 0;
+    for (const Result& r : results) {
+        if (!r.readable) {
+            fprintf(stderr, "%s: cannot read\n", r.path.c_str());
+            unreadable++;
+            continue;
+        }
+        bool findings = r.badCrc || r.badTrailers || r.blockGaps || r.torn || r.seqGaps || r.reordered;
+        if (!quiet || findings) {
+            printf("%s: %lu blocks, %lu bad crc, %lu bad trailers, %lu block gaps, "
+                   "%lu unsealed bytes (%lu torn), %lu rows, %lu seq gaps, %lu reordered\n",
+                   r.path.c_str(), r.blocks, r.badCrc, r.badTrailers, r.blockGaps,
+                   r.unsealed, r.torn, r.rows, r.seqGaps, r.reordered);
+        }
+        total.bytes += r.bytes;
+        total.blocks += r.blocks;
+        total.badCrc += r.badCrc;
+        total.badTrailers += r.badTrailers;
+        total.blockGaps += r.blockGaps;
+        total.unsealed += r.unsealed;
+        total.torn += r.torn;
+        total.rows += r.rows;
+        total.seqGaps += r.seqGaps;
+        total.reordered += r.reordered;
+    }
+
+    printf("total: %zu files, %.1f MB in %.2f s (%.0f MB/s), %lu blocks, %lu bad crc, "
+           "%lu bad trailers, %lu block gaps, %lu unsealed bytes (%lu torn), %lu rows, "
+           "%lu seq gaps, %lu reordered\n",
+           results.size(), total.bytes / 1e6, seconds, seconds > 0 ? total.bytes / 1e6 / seconds : 0,
+           total.blocks, total.badCrc, total.badTrailers, total.blockGaps,
+           total.unsealed, total.torn, total.rows, total.seqGaps, total.reordered);
+    return (total.badCrc || total.badTrailers || unreadable) ? 1 : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef NATIVE_ADAFRUIT_NEOPIXEL_H
+#define NATIVE_ADAFRUIT_NEOPIXEL_H
+
+#include <Arduino.h>
+
+constexpr uint16_t NEO_GRBW = 0x00;
+constexpr uint16_t NEO_KHZ800 = 0x00;
+
+class Adafruit_NeoPixel {
+    public:
+    Adafruit_NeoPixel(uint16_t n, int16_t pin, uint16_t type) : _n(n) {
+        (void)pin; (void)type;
+        _pixels = new uint32_t[n]();
+    }
+    ~Adafruit_NeoPixel() { delete[] _pixels; }
+    Adafruit_NeoPixel& operator=(const Adafruit_NeoPixel& o) {
+        if (this != &o) {
+            delete[] _pixels;
+            _n = o._n;
+            _pixels = new uint32_t[_n];
+            memcpy(_pixels, o._pixels, _n * sizeof(uint32_t));
+        }
+        return *this;
+    }
+
+    void begin() {}
+    void show() { sim::board().stats.ledShows++; sim::preempt(); }
+    void clear() { memset(_pixels, 0, _n * sizeof(uint32_t)); }
+    void setBrightness(uint8_t b) { (void)b; }
+    void setPixelColor(uint16_t i, uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0) {
+        if (i < _n) _pixels[i] = Color(r, g, b, w);
+    }
+    void setPixelColor(uint16_t i, uint32_t c) { if (i < _n) _pixels[i] = c; }
+    uint32_t getPixelColor(uint16_t i) const { return i < _n ? _pixels[i] : 0; }
+    uint16_t numPixels() const { return _n; }
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b, uint8_t w = 0) {
+        return ((uint32_t)w << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+
+    private:
+    uint16_t _n;
+    uint32_t* _pixels;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef NATIVE_ADAFRUIT_SHARPMEM_H
+#define NATIVE_ADAFRUIT_SHARPMEM_H
+
+#include <Arduino.h>
+
+// Drawing is discarded; text is kept so harnesses can inspect the screen.
+class Adafruit_SharpMem : public Print {
+    public:
+    Adafruit_SharpMem(uint8_t clk, uint8_t mosi, uint8_t cs, uint16_t w = 96, uint16_t h = 96) {
+        (void)clk; (void)mosi; (void)cs; (void)w; (void)h;
+    }
+    bool begin() { return true; }
+    void clearDisplay() { text.clear(); }
+    void refresh() { sim::preempt(); }
+    void setRotation(uint8_t r) { (void)r; }
+    void setTextSize(uint8_t s) { (void)s; }
+    void setTextColor(uint16_t c) { (void)c; }
+    void setTextColor(uint16_t c, uint16_t bg) { (void)c; (void)bg; }
+    void setCursor(int16_t x, int16_t y) { (void)x; (void)y; }
+    void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+    void drawRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+    void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+    void drawPixel(int16_t, int16_t, uint16_t) {}
+    void drawFastHLine(int16_t, int16_t, int16_t, uint16_t) {}
+    void drawFastVLine(int16_t, int16_t, int16_t, uint16_t) {}
+    size_t write(uint8_t c) override {
+        if (text.size() < 4096) text.push_back((char)c);
+        return 1;
+    }
+    using Print::write;
+
+    std::string text;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host stand-in for the Arduino SAMD core. Only what the FED4 library
+// touches is provided; every call is a preemption point where pending
+// simulated interrupts are delivered (see sim.h).
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/types.h>
+
+#include "samd21.h"
+#include "sim.h"
+
+#define sniprintf snprintf
+#define __asm(...)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+constexpr uint8_t LOW  = 0;
+constexpr uint8_t HIGH = 1;
+
+constexpr uint8_t INPUT        = 0;
+constexpr uint8_t OUTPUT       = 1;
+constexpr uint8_t INPUT_PULLUP = 2;
+
+constexpr uint8_t CHANGE  = 2;
+constexpr uint8_t FALLING = 3;
+constexpr uint8_t RISING  = 4;
+
+constexpr uint8_t A0 = 14;
+constexpr uint8_t A1 = 15;
+constexpr uint8_t A2 = 16;
+constexpr uint8_t A3 = 17;
+constexpr uint8_t A4 = 18;
+constexpr uint8_t A5 = 19;
+constexpr uint8_t A7 = 9;
+
+constexpr uint32_t F_CPU = 48000000;
+
+// Analog channel of each pin; the simulated ADC reads sim::Board::analog
+// at the same index
+struct PinDescription {
+    uint32_t ulADCChannelNumber;
+};
+extern const PinDescription g_APinDescription[];
+
+#define F(str) (str)
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReadResolution(int bits);
+
+typedef void (*voidFuncPtr)(void);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(int line, voidFuncPtr cb, int mode);
+void detachInterrupt(int line);
+void interrupts();
+void noInterrupts();
+
+void tone(uint8_t pin, unsigned int freq, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Peripherals with per-board state
+#define TC3 (&sim::board().tc3)
+#define TC4 (&sim::board().tc4)
+#define TCC1 (&sim::board().tcc1)
+#define ADC (&sim::board().adc)
+
+template <typename T> T min(T a, T b) { return a < b ? a : b; }
+template <typename T> T max(T a, T b) { return a > b ? a : b; }
+template <typename T> T constrain(T x, T a, T b) { return x < a ? a : (x > b ? b : x); }
+
+// ==== Print / String ====
+class Print {
+    public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t n) {
+        for (size_t i = 0; i < n; i++) write(buf[i]);
+        return n;
+    }
+    size_t write(const char* buf, size_t n) { return write((const uint8_t*)buf, n); }
+    size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(const std::string& s) { return write(s.c_str()); }
+    size_t print(int n) { return printf_("%d", n); }
+    size_t print(unsigned int n) { return printf_("%u", n); }
+    size_t print(long n) { return printf_("%ld", n); }
+    size_t print(unsigned long n) { return printf_("%lu", n); }
+    size_t print(uint8_t n) { return printf_("%u", n); }
+    size_t print(int8_t n) { return printf_("%d", n); }
+    size_t print(uint16_t n) { return printf_("%u", n); }
+    size_t print(double f, int digits = 2) { return printf_("%.*f", digits, f); }
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+
+    private:
+    size_t printf_(const char* fmt, ...) {
+        char buf[64];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        return write((const uint8_t*)buf, n);
+    }
+};
+
+class Stream : public Print {
+    public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class String : public std::string {
+    public:
+    String() {}
+    String(const char* s) : std::string(s ? s : "") {}
+    String(const std::string& s) : std::string(s) {}
+    String(int n) : std::string(std::to_string(n)) {}
+    String(unsigned int n) : std::string(std::to_string(n)) {}
+    String(long n) : std::string(std::to_string(n)) {}
+    String(unsigned long n) : std::string(std::to_string(n)) {}
+    String(float f, int digits = 2) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", digits, f);
+        assign(buf);
+    }
+};
+
+// ==== Serial ====
+class SimSerial : public Stream {
+    public:
+    void begin(unsigned long baud) { (void)baud; }
+    operator bool() { return true; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t n) override;
+    using Print::write;
+    int availableForWrite();
+    int available() override;
+    int read() override;
+    int peek() override;
+};
+extern SimSerial Serial;
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef NATIVE_ARDUINOJSON_H
+#define NATIVE_ARDUINOJSON_H
+
+// Minimal subset of the ArduinoJson 7 API used by FED4: nested objects and
+// arrays of numbers, strings and booleans, read from and written to a Stream.
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct JsonNode {
+    enum Type { NUL, BOOL, NUM, STR, OBJ, ARR } type = NUL;
+    bool b = false;
+    double num = 0;
+    std::string str;
+    std::vector<std::pair<std::string, std::shared_ptr<JsonNode>>> obj;
+    std::vector<std::shared_ptr<JsonNode>> arr;
+
+    JsonNode* find(const std::string& key) const;
+    JsonNode* at(size_t idx) const { return idx < arr.size() ? arr[idx].get() : nullptr; }
+    JsonNode* child(const std::string& key);
+    JsonNode* child(size_t idx);
+};
+
+class JsonVariant {
+    public:
+    JsonVariant(std::shared_ptr<JsonNode> root) : _root(root) {}
+
+    JsonVariant operator[](const char* key) const {
+        JsonVariant v = *this;
+        v._path.push_back(Key{key, 0, true});
+        return v;
+    }
+    JsonVariant operator[](int idx) const {
+        JsonVariant v = *this;
+        v._path.push_back(Key{"", (size_t)idx, false});
+        return v;
+    }
+
+    template <typename T> operator T() const { return as<T>(); }
+
+    template <typename T> T as() const {
+        JsonNode* n = resolve();
+        if (n == nullptr) return T();
+        if (n->type == JsonNode::BOOL) return (T)n->b;
+        if (n->type == JsonNode::NUM) return (T)n->num;
+        return T();
+    }
+
+    template <typename T> bool is() const;
+    bool isNull() const { return resolve() == nullptr || resolve()->type == JsonNode::NUL; }
+    size_t size() const {
+        JsonNode* n = resolve();
+        if (n == nullptr) return 0;
+        return n->type == JsonNode::ARR ? n->arr.size() : n->obj.size();
+    }
+
+    template <typename T> T operator|(T fallback) const { return isNull() ? fallback : as<T>(); }
+    const char* operator|(const char* fallback) const {
+        JsonNode* n = resolve();
+        return (n && n->type == JsonNode::STR) ? n->str.c_str() : fallback;
+    }
+
+    bool operator==(const char* s) const {
+        JsonNode* n = resolve();
+        return n && n->type == JsonNode::STR && n->str == s;
+    }
+    bool operator==(bool b) const {
+        JsonNode* n = resolve();
+        return n && n->type == JsonNode::BOOL && n->b == b;
+    }
+    bool operator!=(const char* s) const { return !(*this == s); }
+
+    JsonVariant& operator=(const char* s) { JsonNode* n = create(); n->type = JsonNode::STR; n->str = s; return *this; }
+    JsonVariant& operator=(bool b) { JsonNode* n = create(); n->type = JsonNode::BOOL; n->b = b; return *this; }
+    JsonVariant& operator=(double d) { JsonNode* n = create(); n->type = JsonNode::NUM; n->num = d; return *this; }
+    JsonVariant& operator=(float d) { return *this = (double)d; }
+    JsonVariant& operator=(int d) { return *this = (double)d; }
+    JsonVariant& operator=(unsigned int d) { return *this = (double)d; }
+    JsonVariant& operator=(long d) { return *this = (double)d; }
+    JsonVariant& operator=(unsigned long d) { return *this = (double)d; }
+    JsonVariant& operator=(uint8_t d) { return *this = (double)d; }
+    JsonVariant& operator=(int8_t d) { return *this = (double)d; }
+    JsonVariant& operator=(uint16_t d) { return *this = (double)d; }
+    JsonVariant& operator=(int16_t d) { return *this = (double)d; }
+
+    bool add(double d) {
+        auto c = std::make_shared<JsonNode>();
+        c->type = JsonNode::NUM;
+        c->num = d;
+        return add(c);
+    }
+    bool add(const char* str) {
+        auto c = std::make_shared<JsonNode>();
+        c->type = JsonNode::STR;
+        c->str = str;
+        return add(c);
+    }
+
+    protected:
+    struct Key { std::string name; size_t idx; bool isName; };
+    std::shared_ptr<JsonNode> _root;
+    std::vector<Key> _path;
+
+    JsonNode* resolve() const;
+    JsonNode* create();
+    bool add(std::shared_ptr<JsonNode> c) {
+        JsonNode* n = create();
+        if (n->type != JsonNode::ARR) {
+            *n = JsonNode();
+            n->type = JsonNode::ARR;
+        }
+        n->arr.push_back(c);
+        return true;
+    }
+};
+
+template <> inline const char* JsonVariant::as<const char*>() const {
+    JsonNode* n = resolve();
+    return (n && n->type == JsonNode::STR) ? n->str.c_str() : nullptr;
+}
+
+template <> inline bool JsonVariant::is<const char*>() const {
+    JsonNode* n = resolve();
+    return n && n->type == JsonNode::STR;
+}
+template <> inline bool JsonVariant::is<int>() const {
+    JsonNode* n = resolve();
+    return n && n->type == JsonNode::NUM;
+}
+template <> inline bool JsonVariant::is<float>() const { return is<int>(); }
+template <> inline bool JsonVariant::is<bool>() const {
+    JsonNode* n = resolve();
+    return n && n->type == JsonNode::BOOL;
+}
+
+class JsonDocument : public JsonVariant {
+    public:
+    JsonDocument() : JsonVariant(std::make_shared<JsonNode>()) {}
+    void clear() { *_root = JsonNode(); }
+    JsonNode* root() const { return _root.get(); }
+};
+
+struct DeserializationError {
+    enum Code { Ok, InvalidInput, EmptyInput } code;
+    explicit operator bool() const { return code != Ok; }
+    const char* c_str() const { return code == Ok ? "Ok" : "InvalidInput"; }
+};
+
+DeserializationError deserializeJson(JsonDocument& doc, Stream& input);
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t len);
+size_t serializeJson(const JsonDocument& doc, Print& output);
+size_t serializeJson(const JsonDocument& doc, char* output, size_t size);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef NATIVE_RTCZERO_H
+#define NATIVE_RTCZERO_H
+
+#include <Arduino.h>
+
+typedef void (*voidFuncPtr)(void);
+
+class RTCZero {
+    public:
+    enum Alarm_Match : uint8_t {
+        MATCH_OFF = 0,
+        MATCH_SS = 1,
+        MATCH_MMSS = 2,
+        MATCH_HHMMSS = 3,
+    };
+
+    void begin(bool resetTime = false) { (void)resetTime; }
+    void enableAlarm(Alarm_Match match);
+    void disableAlarm();
+    void attachInterrupt(voidFuncPtr callback);
+    void detachInterrupt();
+    void standbyMode();
+
+    uint8_t getSeconds();
+    uint8_t getMinutes();
+    uint8_t getHours();
+    uint8_t getDay();
+    uint8_t getMonth();
+    uint8_t getYear();
+    uint32_t getEpoch();
+
+    void setTime(uint8_t hours, uint8_t minutes, uint8_t seconds) { (void)hours; (void)minutes; (void)seconds; }
+    void setDate(uint8_t day, uint8_t month, uint8_t year) { (void)day; (void)month; (void)year; }
+    void setAlarmTime(uint8_t hours, uint8_t minutes, uint8_t seconds);
+};
+
+#endif
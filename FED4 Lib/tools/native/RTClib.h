@@ -0,0 +1,36 @@
+#ifndef NATIVE_RTCLIB_H
+#define NATIVE_RTCLIB_H
+
+#include <Arduino.h>
+
+class DateTime {
+    public:
+    DateTime(uint32_t t = 946684800);
+    DateTime(uint16_t year, uint8_t month, uint8_t day,
+             uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+    DateTime(const char* date, const char* time);
+
+    uint16_t year() const { return 2000 + yOff; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfTheWeek() const;
+    uint32_t unixtime() const;
+
+    protected:
+    uint8_t yOff, m, d, hh, mm, ss;
+};
+
+class RTC_PCF8523 {
+    public:
+    bool begin() { return true; }
+    bool lostPower() { return false; }
+    bool initialized() { return true; }
+    void start() {}
+    void adjust(const DateTime& dt);
+    DateTime now();
+};
+
+#endif
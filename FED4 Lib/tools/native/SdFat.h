@@ -0,0 +1,117 @@
+#ifndef NATIVE_SDFAT_H
+#define NATIVE_SDFAT_H
+
+// Host stand-in for SdFat: the card is a directory on the host file system
+// (sim::Board::sdRoot). Writes and flushes cost sim::Board::sdLatencyUs.
+
+#include <Arduino.h>
+#include <fcntl.h>
+#include <memory>
+#include <vector>
+
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+#ifndef O_WRITE
+#define O_WRITE O_WRONLY
+#endif
+#define O_AT_END 0x40000000
+
+#define FILE_READ O_RDONLY
+#define FILE_WRITE (O_RDWR | O_CREAT | O_AT_END)
+
+#define SD_SCK_MHZ(mhz) ((mhz) * 1000000UL)
+
+#define FAT_DATE(y, m, d) (uint16_t)((((y) - 1980) << 9) | ((m) << 5) | (d))
+#define FAT_TIME(h, m, s) (uint16_t)(((h) << 11) | ((m) << 5) | ((s) >> 1))
+
+class FatFile : public Stream {
+    public:
+    FatFile() {}
+    virtual ~FatFile() {}
+
+    bool open(const char* path, int oflag = O_RDONLY);
+    bool open(FatFile* dir, const char* path, int oflag = O_RDONLY);
+    bool openNext(FatFile* dir, int oflag = O_RDONLY);
+    bool createContiguous(const char* path, uint32_t size);
+    bool close();
+    bool isOpen() const { return _impl != nullptr; }
+    bool isDir() const;
+    explicit operator bool() const { return isOpen(); }
+
+    int read() override;
+    int read(void* buf, size_t n);
+    int peek() override;
+    int available() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t n) override;
+    size_t write(const void* buf, size_t n) { return write((const uint8_t*)buf, n); }
+    using Print::write;
+    void flush();
+    bool sync() { flush(); return true; }
+
+    bool seekSet(uint64_t pos);
+    bool seekCur(int64_t offset) { return seekSet(curPosition() + offset); }
+    bool seekEnd(int64_t offset = 0) { return seekSet(fileSize() + offset); }
+    void rewind() { seekSet(0); }
+    uint64_t curPosition() const;
+    uint64_t fileSize() const;
+    uint64_t size() const { return fileSize(); }
+    uint64_t position() const { return curPosition(); }
+    bool truncate();
+    bool truncate(uint64_t length);
+    bool contiguousRange(uint32_t* bgnSector, uint32_t* endSector);
+    uint32_t firstSector() const;
+
+    size_t getName(char* name, size_t size);
+    bool getModifyDateTime(uint16_t* pdate, uint16_t* ptime);
+
+    static void dateTimeCallback(void (*cb)(uint16_t* date, uint16_t* time)) { (void)cb; }
+    static void dateTimeCallbackCancel() {}
+
+    protected:
+    struct Impl;
+    std::shared_ptr<Impl> _impl;
+};
+
+typedef FatFile SdBaseFile;
+class SdFile : public FatFile {};
+class File : public FatFile {};
+typedef File File32;
+typedef File FsFile;
+
+class SdCard {
+    public:
+    bool readSector(uint32_t sector, uint8_t* dst);
+    bool writeSector(uint32_t sector, const uint8_t* src);
+    bool writeStart(uint32_t sector);
+    bool writeData(const uint8_t* src);
+    bool writeStop();
+    bool erase(uint32_t firstSector, uint32_t lastSector);
+    bool isBusy() { return false; }
+    uint32_t sectorCount();
+
+    private:
+    uint32_t _next = 0;
+};
+
+class SdFat {
+    public:
+    bool begin(uint8_t csPin, uint32_t maxSck = 0) { (void)csPin; (void)maxSck; return true; }
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool mkdir(const char* path);
+    bool rename(const char* oldPath, const char* newPath);
+    File open(const char* path, int oflag = O_RDONLY);
+    SdCard* card() { return &_card; }
+    uint32_t freeClusterCount();
+    uint8_t sectorsPerCluster() { return 64; }
+    // Reads go straight to the image here, so there is no cache to drop
+    uint8_t* cacheClear() { return _cache; }
+
+    private:
+    SdCard _card;
+    uint8_t _cache[512];
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef NATIVE_STEPPER_H
+#define NATIVE_STEPPER_H
+
+#include <Arduino.h>
+
+class Stepper {
+    public:
+    Stepper(int steps, int p1, int p2, int p3, int p4) {
+        (void)steps; (void)p1; (void)p2; (void)p3; (void)p4;
+    }
+    void setSpeed(long rpm) { (void)rpm; }
+    void step(int steps);
+};
+
+#endif
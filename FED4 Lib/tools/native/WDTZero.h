@@ -0,0 +1,21 @@
+#ifndef NATIVE_WDTZERO_H
+#define NATIVE_WDTZERO_H
+
+#include <Arduino.h>
+
+constexpr uint16_t WDT_HARDCYCLE8S  = 0x5B;
+constexpr uint16_t WDT_SOFTCYCLE1M  = 0x1300;
+constexpr uint16_t WDT_SOFTCYCLE4M  = 0x4300;
+
+class WDTZero {
+    public:
+    void setup(unsigned int mode) { _mode = mode; }
+    void clear() { sim::preempt(); }
+    void attachShutdown(voidFuncPtr cb) { _shutdown = cb; }
+
+    private:
+    unsigned int _mode = 0;
+    voidFuncPtr _shutdown = nullptr;
+};
+
+#endif
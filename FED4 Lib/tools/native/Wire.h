@@ -0,0 +1,22 @@
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+// I2C master. The only simulated device is the AHT20 at 0x38 (see
+// sim::Board::envTempC); other addresses do not acknowledge.
+
+#include <Arduino.h>
+
+class TwoWire {
+    public:
+    void begin() {}
+    void setClock(uint32_t hz) { (void)hz; }
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t b);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t address, size_t n, bool stop = true);
+    int available();
+    int read();
+};
+extern TwoWire Wire;
+
+#endif
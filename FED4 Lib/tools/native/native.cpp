@@ -0,0 +1,1395 @@
+// Implementation of the native Arduino shim. See sim.h for the model.
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <ArduinoJson.h>
+#include <RTClib.h>
+#include <RTCZero.h>
+#include <SdFat.h>
+#include <Stepper.h>
+#include <Wire.h>
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// ==== Board ====
+
+static uint64_t steadyUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+sim::Board::Board() {
+    realStartUs = steadyUs();
+    for (uint8_t i = 0; i < PIN_COUNT; i++) level[i] = HIGH;
+    analog[A7] = 605; // VBAT through the 1/2 divider, about 3.9 V
+}
+
+static sim::Board defaultBoard;
+static thread_local sim::Board* currentBoard = &defaultBoard;
+
+static thread_local EicRegs eicRegs;
+static thread_local PmRegs pmRegs;
+static thread_local GclkRegs gclkRegs;
+static thread_local SysctrlRegs sysctrlRegs;
+static thread_local ScbRegs scbRegs;
+thread_local EicRegs* EIC = &eicRegs;
+thread_local PmRegs* PM = &pmRegs;
+thread_local GclkRegs* GCLK = &gclkRegs;
+thread_local SysctrlRegs* SYSCTRL = &sysctrlRegs;
+thread_local ScbRegs* SCB = &scbRegs;
+
+SimSerial Serial;
+
+const PinDescription g_APinDescription[sim::PIN_COUNT] = {
+    {0}, {1}, {2}, {3}, {4}, {5}, {6}, {7}, {8}, {9}, {10}, {11}, {12}, {13}, {14}, {15},
+    {16}, {17}, {18}, {19}, {20}, {21}, {22}, {23}, {24}, {25}, {26}, {27}, {28}, {29}, {30}, {31},
+};
+
+extern "C" void TC3_Handler() __attribute__((weak));
+extern "C" void TC4_Handler() __attribute__((weak));
+
+namespace sim {
+
+Board& board() {
+    return *currentBoard;
+}
+
+void setBoard(Board* b, bool cpu) {
+    currentBoard = b ? b : &defaultBoard;
+    if (cpu) {
+        std::lock_guard<std::mutex> lock(currentBoard->m);
+        currentBoard->cpu = std::this_thread::get_id();
+    }
+    pmRegs.RCAUSE.reg = currentBoard->resetCause;
+}
+
+uint64_t nowUs() {
+    Board& b = board();
+    if (b.realTime) {
+        return (uint64_t)((steadyUs() - b.realStartUs) * b.speed);
+    }
+    return b.clockUs;
+}
+
+uint32_t unixNow() {
+    Board& b = board();
+    return b.unixStart + b.rtcOffset + (uint32_t)(nowUs() / 1000000ULL);
+}
+
+void advance(uint64_t us) {
+    Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.clockUs += us;
+}
+
+uint8_t pinLine(uint8_t pin) {
+    // Feather M0 external interrupt numbers
+    switch (pin) {
+    case 0:  return 11;
+    case 1:  return 10;
+    case 5:  return 15;
+    case 6:  return 4;
+    case 9:  return 7;
+    case 10: return 2;
+    case 11: return 8;
+    case 12: return 3;
+    case 13: return 1;
+    default: return pin & 0x0F;
+    }
+}
+
+void raise(uint8_t line) {
+    Board& b = board();
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        b.pending |= (1UL << line);
+    }
+    b.cv.notify_all();
+}
+
+void setPin(uint8_t pin, uint8_t level, bool edge) {
+    Board& b = board();
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        changed = b.level[pin % PIN_COUNT] != level;
+        b.level[pin % PIN_COUNT] = level;
+    }
+    if (edge && changed) {
+        raise(pinLine(pin));
+    }
+}
+
+uint8_t pinLevel(uint8_t pin) {
+    Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.level[pin % PIN_COUNT];
+}
+
+void setAnalog(uint8_t pin, uint16_t value) {
+    Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.analog[pin % PIN_COUNT] = value;
+}
+
+void serialInput(const char* data, size_t n) {
+    Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.serialIn.insert(b.serialIn.end(), data, data + n);
+}
+
+bool irqMasked() {
+    Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    uint32_t attached = 0;
+    for (uint8_t line = 0; line < LINE_ALARM; line++) {
+        if (b.isr[line] != nullptr) attached |= 1UL << line;
+    }
+    return b.primask || !b.eicEnabled || (attached & ~b.eicLines)
+        || (b.alarmEnabled && b.alarmCb == nullptr);
+}
+
+void clearPending(uint32_t mask) {
+    Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.stats.dropped += __builtin_popcount(b.pending & mask & 0x7FFFFFFF);
+    b.pending &= ~mask;
+}
+
+// Next time after now at which the alarm fields match. Caller holds b.m.
+void scheduleAlarm(Board& b) {
+    uint32_t t = unixNow() + 1;
+    for (uint32_t i = 0; i <= 86400; i++, t++) {
+        DateTime dt(t);
+        bool match = dt.second() == b.alarmS;
+        if (b.alarmMatch >= RTCZero::MATCH_MMSS) match = match && dt.minute() == b.alarmM;
+        if (b.alarmMatch >= RTCZero::MATCH_HHMMSS) match = match && dt.hour() == b.alarmH;
+        if (match) {
+            b.alarmAtUnix = t;
+            return;
+        }
+    }
+    b.alarmAtUnix = 0;
+}
+
+static void checkAlarm(Board& b) {
+    if (b.alarmEnabled && b.alarmAtUnix != 0 && unixNow() >= b.alarmAtUnix) {
+        b.pending |= (1UL << LINE_ALARM);
+        scheduleAlarm(b); // the match repeats, like the real RTC
+    }
+}
+
+static uint64_t tcPeriodUs(const SimTc& tc) {
+    static const uint16_t prescalers[] = {1, 2, 4, 8, 16, 64, 256, 1024};
+    uint32_t prescaler = prescalers[(tc.COUNT16.CTRLA.reg >> TC_CTRLA_PRESCALER_Pos) & 7];
+    uint64_t ticks = (uint64_t)(tc.COUNT16.CC[0].reg + 1) * prescaler;
+    return ticks * 1000000ULL / F_CPU;
+}
+
+// Sets MC0 when the compare period has elapsed; the count is frozen in
+// standby. Caller holds b.m.
+static void checkTimers(Board& b) {
+    SimTc& tc = b.tc3;
+    if (!(tc.COUNT16.CTRLA.reg & TC_CTRLA_ENABLE) || b.standby) return;
+
+    uint64_t now = nowUs();
+    uint64_t period = tcPeriodUs(tc);
+    if (period == 0) period = 1;
+    if (b.tc3DueUs == 0) {
+        b.tc3DueUs = now + period;
+    }
+    else if (now >= b.tc3DueUs) {
+        tc.COUNT16.INTFLAG.reg.value |= TC_INTFLAG_MC0;
+        b.tc3DueUs += period;
+        if (b.tc3DueUs <= now) b.tc3DueUs = now + period; // missed ticks coalesce
+    }
+}
+
+// Counts from the last match, with the CC[0] the handler left. Caller
+// holds b.m.
+static void checkTc4(Board& b) {
+    SimTc& tc = b.tc4;
+    if (!(tc.COUNT16.CTRLA.reg & TC_CTRLA_ENABLE)) {
+        b.tc4DueUs = 0;
+        b.tc4MatchUs = 0;
+        return;
+    }
+    if (b.standby || (tc.COUNT16.INTFLAG.reg & TC_INTFLAG_MC0)) return;
+
+    uint64_t now = nowUs();
+    if (b.tc4DueUs == 0) {
+        b.tc4DueUs = (b.tc4MatchUs ? b.tc4MatchUs : now) + std::max<uint64_t>(tcPeriodUs(tc), 1);
+        b.tc4MatchUs = 0;
+    }
+    if (now >= b.tc4DueUs) {
+        tc.COUNT16.INTFLAG.reg.value |= TC_INTFLAG_MC0;
+        b.tc4MatchUs = b.tc4DueUs;
+        b.tc4DueUs = 0;
+    }
+}
+
+static bool tc4Deliverable(Board& b) {
+    return !b.primask && !b.inTc4
+        && (b.nvicEnabled & (1UL << TC4_IRQn))
+        && (b.tc4.COUNT16.INTFLAG.reg & b.tc4.COUNT16.INTENSET.reg & TC_INTFLAG_MC0)
+        && TC4_Handler != nullptr;
+}
+
+static bool timerDeliverable(Board& b) {
+    return !b.primask
+        && (b.nvicEnabled & (1UL << TC3_IRQn))
+        && (b.tc3.COUNT16.INTFLAG.reg & b.tc3.COUNT16.INTENSET.reg & TC_INTFLAG_MC0)
+        && TC3_Handler != nullptr;
+}
+
+static bool deliverable(Board& b, uint8_t line) {
+    if (b.primask) return false;
+    if (line == LINE_ALARM) return true; // RTC IRQ is never masked; a detached callback loses it
+    return b.eicEnabled && (b.eicLines & (1UL << line)) && b.isr[line] != nullptr;
+}
+
+// Runs every deliverable pending handler. Caller holds b.m.
+static void deliver(Board& b, std::unique_lock<std::mutex>& lock) {
+    if (b.cpu != std::this_thread::get_id()) return;
+    checkTc4(b);
+    if (tc4Deliverable(b)) {
+        b.inTc4 = true;
+        b.stats.delivered++;
+        lock.unlock();
+        TC4_Handler();
+        lock.lock();
+        b.inTc4 = false;
+        checkTc4(b);
+    }
+    if (b.inIsr) return;
+    checkAlarm(b);
+    checkTimers(b);
+    if (timerDeliverable(b)) {
+        b.inIsr = true;
+        b.stats.delivered++;
+        lock.unlock();
+        TC3_Handler();
+        lock.lock();
+        b.inIsr = false;
+    }
+    for (uint8_t line = 0; line < 32; line++) {
+        if (!(b.pending & (1UL << line)) || !deliverable(b, line)) continue;
+
+        b.pending &= ~(1UL << line);
+        void (*handler)() = line == LINE_ALARM ? b.alarmCb : b.isr[line];
+        if (handler == nullptr) {
+            b.stats.alarmsLost++;
+            continue;
+        }
+        b.inIsr = true;
+        b.stats.delivered++;
+        lock.unlock();
+        handler();
+        lock.lock();
+        b.inIsr = false;
+        line = 0xFF; // rescan: the handler may have raised or unmasked lines
+    }
+}
+
+void preempt() {
+    Board& b = board();
+    std::unique_lock<std::mutex> lock(b.m);
+    if (!b.realTime) {
+        b.clockUs += b.autoAdvanceUs;
+        // Wherever the firmware is, as an input would land
+        if (b.onDue && b.clockUs >= b.dueUs && !b.inDue && b.cpu == std::this_thread::get_id()) {
+            b.inDue = true;
+            lock.unlock();
+            b.onDue();
+            lock.lock();
+            b.inDue = false;
+        }
+    }
+    deliver(b, lock);
+}
+
+// Real-time wait in short slices, so unmasked interrupts (TC4 above all)
+// land close to when they are due
+void busyWait(uint64_t us) {
+    Board& b = board();
+    uint64_t end = nowUs() + us;
+    for (uint64_t now = nowUs(); now < end && !b.stop; now = nowUs()) {
+        uint64_t slice = std::min<uint64_t>(end - now, 250);
+        std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)(slice / b.speed)));
+        preempt();
+    }
+}
+
+void sdDelay() {
+    Board& b = board();
+    if (b.sdLatencyUs == 0) return;
+    if (b.realTime) {
+        busyWait(b.sdLatencyUs);
+    }
+    else {
+        advance(b.sdLatencyUs);
+    }
+}
+
+}
+
+using sim::board;
+
+// ==== Core ====
+
+unsigned long millis() {
+    sim::preempt();
+    return (unsigned long)(sim::nowUs() / 1000);
+}
+
+unsigned long micros() {
+    sim::preempt();
+    return (unsigned long)sim::nowUs();
+}
+
+void delay(unsigned long ms) {
+    sim::Board& b = board();
+    if (b.realTime) {
+        uint64_t end = sim::nowUs() + ms * 1000ULL;
+        while (sim::nowUs() < end && !b.stop) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            sim::preempt();
+        }
+    }
+    else {
+        sim::advance(ms * 1000ULL);
+        sim::preempt();
+    }
+}
+
+void delayMicroseconds(unsigned int us) {
+    if (!board().realTime) sim::advance(us);
+    sim::preempt();
+}
+
+void yield() {
+    sim::preempt();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin; (void)mode;
+    sim::preempt();
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    sim::setPin(pin, val, false);
+    if (board().onPinWrite) board().onPinWrite(pin, val);
+    sim::preempt();
+}
+
+int digitalRead(uint8_t pin) {
+    sim::preempt();
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.level[pin % sim::PIN_COUNT];
+}
+
+int analogRead(uint8_t pin) {
+    sim::preempt();
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.analog[pin % sim::PIN_COUNT];
+}
+
+void analogReadResolution(int bits) {
+    (void)bits;
+}
+
+int digitalPinToInterrupt(uint8_t pin) {
+    return sim::pinLine(pin);
+}
+
+void attachInterrupt(int line, voidFuncPtr cb, int mode) {
+    (void)mode;
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.isr[line & 31] = cb;
+    b.eicLines |= 1UL << (line & 31);
+    b.eicEnabled = true;
+}
+
+void detachInterrupt(int line) {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.isr[line & 31] = nullptr;
+}
+
+void interrupts() { __enable_irq(); }
+void noInterrupts() { __disable_irq(); }
+
+void tone(uint8_t pin, unsigned int freq, unsigned long duration) {
+    (void)pin; (void)duration;
+    board().toneHz = freq;
+    sim::preempt();
+}
+
+void noTone(uint8_t pin) {
+    (void)pin;
+    board().toneHz = 0;
+}
+
+static uint32_t nextRandom() {
+    // Same LCG as newlib's rand(), which Arduino's random() is built on.
+    sim::Board& b = board();
+    b.rngState = b.rngState * 1103515245 + 12345;
+    return (b.rngState >> 1) & 0x7FFFFFFF;
+}
+
+long random(long max) {
+    if (max == 0) return 0;
+    return nextRandom() % max;
+}
+
+long random(long min, long max) {
+    if (min >= max) return min;
+    return random(max - min) + min;
+}
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) board().rngState = seed;
+}
+
+// ==== NVIC / registers ====
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+    sim::Board& b = board();
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        if (irq == EIC_IRQn) b.eicEnabled = true;
+        b.nvicEnabled |= (1UL << irq);
+    }
+    sim::preempt();
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    if (irq == EIC_IRQn) b.eicEnabled = false;
+    b.nvicEnabled &= ~(1UL << irq);
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+    (void)irq; (void)priority; // TC4 always preempts, see sim.h
+}
+
+void NVIC_SystemReset() {
+    board().stop = true;
+}
+
+void __DSB() {
+    sim::preempt();
+}
+
+void __disable_irq() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.primask = true;
+}
+
+void __enable_irq() {
+    sim::Board& b = board();
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        b.primask = false;
+    }
+    sim::preempt();
+}
+
+uint32_t __get_PRIMASK() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.primask ? 1 : 0;
+}
+
+uint32_t __get_IPSR() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.inIsr || b.inTc4 ? 1 : 0;
+}
+
+void __set_PRIMASK(uint32_t primask) {
+    if (primask & 1) {
+        __disable_irq();
+    }
+    else {
+        __enable_irq();
+    }
+}
+
+void __WFI() {
+    sim::Board& b = board();
+    std::unique_lock<std::mutex> lock(b.m);
+    if (b.inIsr) return;
+
+    b.standby = SCB->SCR & SCB_SCR_SLEEPDEEP_Msk;
+    auto anyDeliverable = [&b]() {
+        sim::checkAlarm(b);
+        sim::checkTimers(b);
+        sim::checkTc4(b);
+        if (sim::timerDeliverable(b) || sim::tc4Deliverable(b)) return true;
+        for (uint8_t line = 0; line < 32; line++) {
+            if ((b.pending & (1UL << line)) && sim::deliverable(b, line)) return true;
+        }
+        return false;
+    };
+
+    if (b.realTime) {
+        while (!anyDeliverable() && !b.stop) {
+            b.cv.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+    else {
+        while (!anyDeliverable() && !b.stop) {
+            lock.unlock();
+            bool progressed = b.onIdle && b.onIdle();
+            lock.lock();
+            if (!progressed) {
+                b.clockUs += 1000;
+            }
+        }
+    }
+    if (b.standby) {
+        b.standby = false;
+        b.tc3DueUs = 0; // restarts with the clock
+        b.tc4DueUs = 0;
+        b.tc4MatchUs = 0;
+    }
+    sim::deliver(b, lock);
+}
+
+SimW1CReg::Value& SimW1CReg::Value::operator=(uint32_t v) {
+    sim::clearPending(v);
+    return *this;
+}
+
+SimEicEnableReg::Value& SimEicEnableReg::Value::operator=(uint32_t v) {
+    sim::Board& b = board();
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        b.eicLines = set ? b.eicLines | v : b.eicLines & ~v;
+    }
+    if (set) sim::preempt();
+    return *this;
+}
+
+SimEicEnableReg::Value::operator uint32_t() const {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.eicLines;
+}
+
+SimAdcTrigger::Value& SimAdcTrigger::Value::operator=(uint32_t v) {
+    if (!(v & ADC_SWTRIG_START)) return *this;
+
+    sim::Board& b = board();
+    {
+        std::lock_guard<std::mutex> lock(b.m);
+        SimAdc& adc = b.adc;
+        uint32_t channel = adc.INPUTCTRL.reg & ADC_INPUTCTRL_MUXPOS_Msk;
+        uint32_t value12 = (uint32_t)b.analog[channel % sim::PIN_COUNT] << 2;
+        switch ((adc.CTRLB.reg >> ADC_CTRLB_RESSEL_Pos) & 3) {
+        case 0: // 12 bit
+            b.adcResult = value12;
+            break;
+        case 1: { // 16 bit, accumulated then shifted right by ADJRES
+            uint32_t samples = adc.AVGCTRL.reg & 0xF;
+            uint32_t adjres = (adc.AVGCTRL.reg >> 4) & 7;
+            b.adcResult = std::min<uint32_t>(0xFFFF, (value12 << samples) >> adjres);
+            break;
+        }
+        case 2: // 10 bit
+            b.adcResult = value12 >> 2;
+            break;
+        default: // 8 bit
+            b.adcResult = value12 >> 4;
+            break;
+        }
+        adc.INTFLAG.reg.value |= ADC_INTFLAG_RESRDY;
+    }
+    sim::preempt();
+    return *this;
+}
+
+SimAdcResult::Value::operator uint32_t() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.adc.INTFLAG.reg.value &= ~ADC_INTFLAG_RESRDY;
+    return b.adcResult;
+}
+
+// ==== Serial ====
+
+size_t SimSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t SimSerial::write(const uint8_t* buf, size_t n) {
+    sim::Board& b = board();
+    if (b.onSerial) b.onSerial(buf, n);
+    return n;
+}
+
+int SimSerial::availableForWrite() {
+    return 64;
+}
+
+int SimSerial::available() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return (int)b.serialIn.size();
+}
+
+int SimSerial::read() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    if (b.serialIn.empty()) return -1;
+    int c = b.serialIn.front();
+    b.serialIn.pop_front();
+    return c;
+}
+
+int SimSerial::peek() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    return b.serialIn.empty() ? -1 : b.serialIn.front();
+}
+
+// ==== RTClib ====
+
+static int64_t daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+DateTime::DateTime(uint32_t t) {
+    int64_t z = t / 86400 + 719468;
+    uint32_t secs = t % 86400;
+    const int64_t era = z / 146097;
+    const unsigned doe = (unsigned)(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    int y = (int)(yoe + era * 400) + (m <= 2);
+    yOff = y - 2000;
+    hh = secs / 3600;
+    mm = (secs / 60) % 60;
+    ss = secs % 60;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec) {
+    if (year >= 2000) year -= 2000;
+    yOff = year;
+    m = month;
+    d = day;
+    hh = hour;
+    mm = min;
+    ss = sec;
+}
+
+DateTime::DateTime(const char* date, const char* time) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    yOff = atoi(date + 9);
+    m = 1;
+    for (int i = 0; i < 12; i++) {
+        if (strncmp(date, months + 3 * i, 3) == 0) m = i + 1;
+    }
+    d = atoi(date + 4);
+    hh = atoi(time);
+    mm = atoi(time + 3);
+    ss = atoi(time + 6);
+}
+
+uint8_t DateTime::dayOfTheWeek() const {
+    return (uint8_t)((daysFromCivil(year(), m, d) + 4) % 7);
+}
+
+uint32_t DateTime::unixtime() const {
+    return (uint32_t)(daysFromCivil(year(), m, d) * 86400 + hh * 3600 + mm * 60 + ss);
+}
+
+void RTC_PCF8523::adjust(const DateTime& dt) {
+    sim::Board& b = board();
+    b.rtcOffset = 0;
+    b.rtcOffset = dt.unixtime() - sim::unixNow();
+}
+
+DateTime RTC_PCF8523::now() {
+    sim::preempt();
+    return DateTime(sim::unixNow());
+}
+
+// ==== Wire ====
+
+TwoWire Wire;
+
+static uint8_t ahtCrc(const uint8_t* data, size_t n) {
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < n; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+    }
+    return crc;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    sim::Board& b = board();
+    b.i2cAddress = address;
+    b.i2cTx.clear();
+}
+
+size_t TwoWire::write(uint8_t c) {
+    board().i2cTx.push_back(c);
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+    (void)stop;
+    sim::preempt();
+    sim::Board& b = board();
+    b.stats.i2cTransfers++;
+    if (b.i2cAddress != 0x38) return 2; // address not acknowledged
+
+    if (!b.i2cTx.empty() && b.i2cTx[0] == 0xBE) {
+        b.ahtCalibrated = true;
+    }
+    else if (!b.i2cTx.empty() && b.i2cTx[0] == 0xAC) {
+        b.ahtReadyUs = sim::nowUs() + 80000;
+    }
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t n, bool stop) {
+    (void)stop;
+    sim::preempt();
+    sim::Board& b = board();
+    b.stats.i2cTransfers++;
+    b.i2cRx.clear();
+    if (address != 0x38) return 0;
+
+    uint8_t data[7];
+    bool busy = sim::nowUs() < b.ahtReadyUs;
+    data[0] = (busy ? 0x80 : 0) | (b.ahtCalibrated ? 0x08 : 0) | 0x10;
+    uint32_t rh = (uint32_t)(b.envRh / 100.0 * (1 << 20));
+    uint32_t t = (uint32_t)((b.envTempC + 50.0) / 200.0 * (1 << 20));
+    data[1] = rh >> 12;
+    data[2] = rh >> 4;
+    data[3] = ((rh & 0x0F) << 4) | ((t >> 16) & 0x0F);
+    data[4] = t >> 8;
+    data[5] = t;
+    data[6] = ahtCrc(data, 6);
+    for (size_t i = 0; i < n && i < sizeof(data); i++) b.i2cRx.push_back(data[i]);
+    return b.i2cRx.size();
+}
+
+int TwoWire::available() {
+    return board().i2cRx.size();
+}
+
+int TwoWire::read() {
+    sim::Board& b = board();
+    if (b.i2cRx.empty()) return -1;
+    uint8_t c = b.i2cRx.front();
+    b.i2cRx.pop_front();
+    return c;
+}
+
+// ==== RTCZero ====
+
+void RTCZero::enableAlarm(Alarm_Match match) {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.alarmMatch = match;
+    b.alarmEnabled = match != MATCH_OFF;
+    sim::scheduleAlarm(b);
+}
+
+void RTCZero::disableAlarm() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.alarmEnabled = false;
+}
+
+void RTCZero::attachInterrupt(voidFuncPtr callback) {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.alarmCb = callback;
+}
+
+void RTCZero::detachInterrupt() {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.alarmCb = nullptr;
+}
+
+void RTCZero::standbyMode() {
+    __WFI();
+}
+
+uint8_t RTCZero::getSeconds() { return DateTime(sim::unixNow()).second(); }
+uint8_t RTCZero::getMinutes() { return DateTime(sim::unixNow()).minute(); }
+uint8_t RTCZero::getHours() { return DateTime(sim::unixNow()).hour(); }
+uint8_t RTCZero::getDay() { return DateTime(sim::unixNow()).day(); }
+uint8_t RTCZero::getMonth() { return DateTime(sim::unixNow()).month(); }
+uint8_t RTCZero::getYear() { return DateTime(sim::unixNow()).year() - 2000; }
+uint32_t RTCZero::getEpoch() { return sim::unixNow(); }
+
+void RTCZero::setAlarmTime(uint8_t hours, uint8_t minutes, uint8_t seconds) {
+    sim::Board& b = board();
+    std::lock_guard<std::mutex> lock(b.m);
+    b.alarmH = hours;
+    b.alarmM = minutes;
+    b.alarmS = seconds;
+    sim::scheduleAlarm(b);
+}
+
+// ==== Stepper ====
+
+void Stepper::step(int steps) {
+    sim::Board& b = board();
+    uint64_t n = steps < 0 ? -steps : steps;
+    b.stats.motorSteps += n;
+    // 7 rpm at 2048 steps per revolution is ~4.2 ms per step
+    if (b.realTime) {
+        // The library busy-waits between steps, where interrupts still land
+        sim::busyWait(n * 4200);
+    }
+    else {
+        // A step at a time, so inputs land between steps
+        for (uint64_t i = 0; i < n; i++) {
+            b.clockUs += 4200;
+            sim::preempt();
+        }
+    }
+    if (b.onStep) b.onStep(steps);
+    sim::preempt();
+}
+
+// ==== SdFat ====
+
+struct FatFile::Impl {
+    int fd = -1;
+    bool dir = false;
+    std::string path;
+    std::string name;
+    uint64_t pos = 0;
+    std::vector<std::string> entries;
+    size_t nextEntry = 0;
+    ~Impl() { if (fd >= 0) ::close(fd); }
+};
+
+static std::string hostPath(const char* path) {
+    std::string p = board().sdRoot;
+    if (path[0] != '/') p += "/";
+    p += path;
+    return p;
+}
+
+bool FatFile::open(const char* path, int oflag) {
+    if (isOpen() || path[0] == '\0') return false;
+    std::string host = hostPath(path);
+    struct stat st;
+    auto impl = std::make_shared<Impl>();
+    impl->path = host;
+    const char* slash = strrchr(path, '/');
+    impl->name = slash ? slash + 1 : path;
+
+    if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        if (oflag & (O_WRONLY | O_RDWR)) return false;
+        DIR* d = opendir(host.c_str());
+        if (d == nullptr) return false;
+        while (dirent* e = readdir(d)) {
+            if (e->d_name[0] == '.') continue;
+            impl->entries.push_back(e->d_name);
+        }
+        closedir(d);
+        impl->dir = true;
+        _impl = impl;
+        return true;
+    }
+
+    int flags = oflag & ~O_AT_END;
+    impl->fd = ::open(host.c_str(), flags, 0644);
+    if (impl->fd < 0) return false;
+    if (oflag & O_AT_END) {
+        impl->pos = lseek(impl->fd, 0, SEEK_END);
+    }
+    _impl = impl;
+    return true;
+}
+
+bool FatFile::open(FatFile* dir, const char* path, int oflag) {
+    if (dir == nullptr || !dir->isDir()) return false;
+    std::string rel = dir->_impl->path.substr(board().sdRoot.size());
+    rel += "/";
+    rel += path;
+    return open(rel.c_str(), oflag);
+}
+
+bool FatFile::openNext(FatFile* dir, int oflag) {
+    if (isOpen() || dir == nullptr || !dir->isDir()) return false;
+    Impl& d = *dir->_impl;
+    if (d.nextEntry >= d.entries.size()) return false;
+    return open(dir, d.entries[d.nextEntry++].c_str(), oflag);
+}
+
+bool FatFile::createContiguous(const char* path, uint32_t size) {
+    if (isOpen()) return false; // SdFat refuses on an open file
+    if (!open(path, O_RDWR | O_CREAT | O_EXCL)) return false;
+    if (ftruncate(_impl->fd, size) != 0) {
+        close();
+        return false;
+    }
+    sim::sdDelay();
+    return true;
+}
+
+bool FatFile::close() {
+    if (!isOpen()) return false;
+    _impl.reset();
+    return true;
+}
+
+bool FatFile::isDir() const {
+    return _impl && _impl->dir;
+}
+
+int FatFile::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int FatFile::read(void* buf, size_t n) {
+    if (!isOpen() || _impl->dir) return -1;
+    sim::preempt();
+    ssize_t r = pread(_impl->fd, buf, n, _impl->pos);
+    if (r < 0) return -1;
+    _impl->pos += r;
+    return (int)r;
+}
+
+int FatFile::peek() {
+    uint64_t pos = curPosition();
+    int c = read();
+    seekSet(pos);
+    return c;
+}
+
+int FatFile::available() {
+    if (!isOpen()) return 0;
+    uint64_t left = fileSize() - curPosition();
+    return left > 0x7FFF ? 0x7FFF : (int)left;
+}
+
+size_t FatFile::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t FatFile::write(const uint8_t* buf, size_t n) {
+    if (!isOpen() || _impl->dir) return 0;
+    sim::preempt();
+    ssize_t w = pwrite(_impl->fd, buf, n, _impl->pos);
+    if (w < 0) return 0;
+    _impl->pos += w;
+    sim::Board& b = board();
+    b.stats.sdWrites++;
+    b.stats.sdBytes += w;
+    sim::sdDelay();
+    return (size_t)w;
+}
+
+void FatFile::flush() {
+    if (!isOpen()) return;
+    struct timespec times[2];
+    times[0].tv_sec = times[1].tv_sec = sim::unixNow();
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    futimens(_impl->fd, times);
+    sim::sdDelay();
+}
+
+bool FatFile::seekSet(uint64_t pos) {
+    if (!isOpen()) return false;
+    _impl->pos = pos;
+    return true;
+}
+
+uint64_t FatFile::curPosition() const {
+    return isOpen() ? _impl->pos : 0;
+}
+
+uint64_t FatFile::fileSize() const {
+    if (!isOpen() || _impl->dir) return 0;
+    struct stat st;
+    return fstat(_impl->fd, &st) == 0 ? st.st_size : 0;
+}
+
+bool FatFile::truncate() {
+    return truncate(curPosition());
+}
+
+bool FatFile::truncate(uint64_t length) {
+    if (!isOpen()) return false;
+    if (ftruncate(_impl->fd, length) != 0) return false;
+    if (_impl->pos > length) _impl->pos = length;
+    flush();
+    return true;
+}
+
+uint32_t FatFile::firstSector() const {
+    // A stable fake location derived from the inode, so raw sector I/O maps
+    // back onto this file.
+    if (!isOpen()) return 0;
+    struct stat st;
+    fstat(_impl->fd, &st);
+    return (uint32_t)((st.st_ino & 0xFFFF) << 16);
+}
+
+bool FatFile::contiguousRange(uint32_t* bgnSector, uint32_t* endSector) {
+    if (!isOpen() || fileSize() == 0) return false;
+    *bgnSector = firstSector();
+    *endSector = *bgnSector + (uint32_t)((fileSize() + 511) / 512) - 1;
+    return true;
+}
+
+size_t FatFile::getName(char* name, size_t size) {
+    if (!isOpen() || size == 0) return 0;
+    strncpy(name, _impl->name.c_str(), size - 1);
+    name[size - 1] = '\0';
+    return strlen(name);
+}
+
+bool FatFile::getModifyDateTime(uint16_t* pdate, uint16_t* ptime) {
+    if (!isOpen()) return false;
+    struct stat st;
+    if (_impl->dir || fstat(_impl->fd, &st) != 0) return false;
+    DateTime dt((uint32_t)st.st_mtime);
+    *pdate = FAT_DATE(dt.year(), dt.month(), dt.day());
+    *ptime = FAT_TIME(dt.hour(), dt.minute(), dt.second());
+    return true;
+}
+
+// Raw sector access resolves sectors back to whichever open file owns them.
+// The shim only supports files created through createContiguous().
+static std::string sectorOwner(uint32_t sector, uint64_t* offset) {
+    DIR* d = opendir(board().sdRoot.c_str());
+    std::string found;
+    if (d == nullptr) return found;
+    while (dirent* e = readdir(d)) {
+        if (e->d_name[0] == '.') continue;
+        std::string p = board().sdRoot + "/" + e->d_name;
+        struct stat st;
+        if (stat(p.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        uint32_t first = (uint32_t)((st.st_ino & 0xFFFF) << 16);
+        uint32_t count = (uint32_t)((st.st_size + 511) / 512);
+        if (sector >= first && sector < first + count) {
+            found = p;
+            *offset = (uint64_t)(sector - first) * 512;
+            break;
+        }
+    }
+    closedir(d);
+    return found;
+}
+
+bool SdCard::readSector(uint32_t sector, uint8_t* dst) {
+    uint64_t offset;
+    std::string p = sectorOwner(sector, &offset);
+    if (p.empty()) return false;
+    int fd = ::open(p.c_str(), O_RDONLY);
+    bool ok = fd >= 0 && pread(fd, dst, 512, offset) == 512;
+    if (fd >= 0) ::close(fd);
+    return ok;
+}
+
+bool SdCard::writeSector(uint32_t sector, const uint8_t* src) {
+    uint64_t offset;
+    std::string p = sectorOwner(sector, &offset);
+    if (p.empty()) return false;
+    int fd = ::open(p.c_str(), O_WRONLY);
+    bool ok = fd >= 0 && pwrite(fd, src, 512, offset) == 512;
+    if (fd >= 0) ::close(fd);
+    board().stats.sdWrites++;
+    board().stats.sdBytes += 512;
+    sim::sdDelay();
+    return ok;
+}
+
+bool SdCard::writeStart(uint32_t sector) {
+    _next = sector;
+    return true;
+}
+
+bool SdCard::writeData(const uint8_t* src) {
+    sim::Board& b = board();
+    uint32_t latency = b.sdLatencyUs;
+    b.sdLatencyUs = latency / 8; // streaming writes amortise the card's command overhead
+    bool ok = writeSector(_next++, src);
+    b.sdLatencyUs = latency;
+    return ok;
+}
+
+bool SdCard::writeStop() {
+    sim::sdDelay();
+    return true;
+}
+
+bool SdCard::erase(uint32_t firstSector, uint32_t lastSector) {
+    // Erased sectors read as zero; one file owns the whole range
+    uint64_t offset;
+    std::string p = sectorOwner(firstSector, &offset);
+    if (p.empty()) return false;
+    int fd = ::open(p.c_str(), O_WRONLY);
+    if (fd < 0) return false;
+    std::vector<uint8_t> zero(64 * 512);
+    uint64_t left = (uint64_t)(lastSector - firstSector + 1) * 512;
+    bool ok = true;
+    while (ok && left > 0) {
+        size_t n = (size_t)std::min<uint64_t>(left, zero.size());
+        ok = pwrite(fd, zero.data(), n, offset) == (ssize_t)n;
+        offset += n;
+        left -= n;
+    }
+    ::close(fd);
+    return ok;
+}
+
+uint32_t SdCard::sectorCount() {
+    return 32UL * 1024 * 1024 * 2; // 32 GB
+}
+
+bool SdFat::exists(const char* path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool SdFat::remove(const char* path) {
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool SdFat::mkdir(const char* path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool SdFat::rename(const char* oldPath, const char* newPath) {
+    return ::rename(hostPath(oldPath).c_str(), hostPath(newPath).c_str()) == 0;
+}
+
+File SdFat::open(const char* path, int oflag) {
+    File f;
+    f.open(path, oflag);
+    return f;
+}
+
+uint32_t SdFat::freeClusterCount() {
+    return 1000000;
+}
+
+// ==== ArduinoJson ====
+
+JsonNode* JsonNode::find(const std::string& key) const {
+    for (auto& kv : obj) {
+        if (kv.first == key) return kv.second.get();
+    }
+    return nullptr;
+}
+
+JsonNode* JsonNode::child(const std::string& key) {
+    if (type != OBJ) {
+        *this = JsonNode();
+        type = OBJ;
+    }
+    JsonNode* n = find(key);
+    if (n) return n;
+    obj.emplace_back(key, std::make_shared<JsonNode>());
+    return obj.back().second.get();
+}
+
+JsonNode* JsonNode::child(size_t idx) {
+    if (type != ARR) {
+        *this = JsonNode();
+        type = ARR;
+    }
+    while (arr.size() <= idx) arr.push_back(std::make_shared<JsonNode>());
+    return arr[idx].get();
+}
+
+JsonNode* JsonVariant::resolve() const {
+    JsonNode* n = _root.get();
+    for (const Key& k : _path) {
+        if (n == nullptr) return nullptr;
+        n = k.isName ? n->find(k.name) : n->at(k.idx);
+    }
+    return n;
+}
+
+JsonNode* JsonVariant::create() {
+    JsonNode* n = _root.get();
+    for (const Key& k : _path) {
+        n = k.isName ? n->child(k.name) : n->child(k.idx);
+    }
+    return n;
+}
+
+namespace {
+
+struct JsonReader {
+    const char* p;
+    const char* end;
+
+    void ws() { while (p < end && isspace((unsigned char)*p)) p++; }
+
+    bool str(std::string& out) {
+        if (p >= end || *p != '"') return false;
+        p++;
+        while (p < end && *p != '"') {
+            if (*p == '\\' && p + 1 < end) p++;
+            out.push_back(*p++);
+        }
+        if (p >= end) return false;
+        p++;
+        return true;
+    }
+
+    bool value(JsonNode& n) {
+        ws();
+        if (p >= end) return false;
+        if (*p == '{') {
+            n.type = JsonNode::OBJ;
+            p++;
+            ws();
+            if (p < end && *p == '}') { p++; return true; }
+            while (true) {
+                ws();
+                std::string key;
+                if (!str(key)) return false;
+                ws();
+                if (p >= end || *p != ':') return false;
+                p++;
+                auto child = std::make_shared<JsonNode>();
+                if (!value(*child)) return false;
+                n.obj.emplace_back(key, child);
+                ws();
+                if (p < end && *p == ',') { p++; continue; }
+                if (p < end && *p == '}') { p++; return true; }
+                return false;
+            }
+        }
+        if (*p == '[') {
+            n.type = JsonNode::ARR;
+            p++;
+            ws();
+            if (p < end && *p == ']') { p++; return true; }
+            while (true) {
+                auto child = std::make_shared<JsonNode>();
+                if (!value(*child)) return false;
+                n.arr.push_back(child);
+                ws();
+                if (p < end && *p == ',') { p++; continue; }
+                if (p < end && *p == ']') { p++; return true; }
+                return false;
+            }
+        }
+        if (*p == '"') {
+            n.type = JsonNode::STR;
+            return str(n.str);
+        }
+        if (end - p >= 4 && strncmp(p, "true", 4) == 0) { n.type = JsonNode::BOOL; n.b = true; p += 4; return true; }
+        if (end - p >= 5 && strncmp(p, "false", 5) == 0) { n.type = JsonNode::BOOL; n.b = false; p += 5; return true; }
+        if (end - p >= 4 && strncmp(p, "null", 4) == 0) { n.type = JsonNode::NUL; p += 4; return true; }
+        char* numEnd;
+        std::string tmp(p, std::min<size_t>(end - p, 64));
+        n.num = strtod(tmp.c_str(), &numEnd);
+        if (numEnd == tmp.c_str()) return false;
+        n.type = JsonNode::NUM;
+        p += numEnd - tmp.c_str();
+        return true;
+    }
+};
+
+void writeJson(const JsonNode& n, std::string& out) {
+    char buf[32];
+    switch (n.type) {
+    case JsonNode::NUL: out += "null"; break;
+    case JsonNode::BOOL: out += n.b ? "true" : "false"; break;
+    case JsonNode::NUM:
+        // Integers are stored as doubles; print them whole like ArduinoJson
+        if (n.num == std::floor(n.num) && std::fabs(n.num) < 9007199254740992.0) {
+            snprintf(buf, sizeof(buf), "%.0f", n.num);
+        }
+        else {
+            snprintf(buf, sizeof(buf), "%.9g", n.num);
+        }
+        out += buf;
+        break;
+    case JsonNode::STR: out += "\"" + n.str + "\""; break;
+    case JsonNode::OBJ:
+        out += "{";
+        for (size_t i = 0; i < n.obj.size(); i++) {
+            if (i) out += ",";
+            out += "\"" + n.obj[i].first + "\":";
+            writeJson(*n.obj[i].second, out);
+        }
+        out += "}";
+        break;
+    case JsonNode::ARR:
+        out += "[";
+        for (size_t i = 0; i < n.arr.size(); i++) {
+            if (i) out += ",";
+            writeJson(*n.arr[i], out);
+        }
+        out += "]";
+        break;
+    }
+}
+
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t len) {
+    doc.clear();
+    JsonReader r{input, input + len};
+    r.ws();
+    if (r.p == r.end) return DeserializationError{DeserializationError::EmptyInput};
+    if (!r.value(*doc.root())) {
+        doc.clear();
+        return DeserializationError{DeserializationError::InvalidInput};
+    }
+    return DeserializationError{DeserializationError::Ok};
+}
+
+DeserializationError deserializeJson(JsonDocument& doc, Stream& input) {
+    std::string text;
+    int c;
+    while ((c = input.read()) >= 0) text.push_back((char)c);
+    return deserializeJson(doc, text.data(), text.size());
+}
+
+size_t serializeJson(const JsonDocument& doc, Print& output) {
+    std::string out;
+    writeJson(*doc.root(), out);
+    return output.write((const uint8_t*)out.data(), out.size());
+}
+
+size_t serializeJson(const JsonDocument& doc, char* output, size_t size) {
+    std::string out;
+    writeJson(*doc.root(), out);
+    if (size == 0) return 0;
+    size_t n = std::min(out.size(), size - 1);
+    memcpy(output, out.data(), n);
+    output[n] = '\0';
+    return n;
+}
@@ -0,0 +1,229 @@
+#ifndef NATIVE_SAMD21_H
+#define NATIVE_SAMD21_H
+
+// SAMD21 peripheral registers touched by the FED4 library, with the CMSIS
+// names and bit values. Plain registers only store what is written; the
+// ones with side effects are implemented in native.cpp.
+
+#include <cstdint>
+
+// ==== SAMD21 registers ====
+struct SimRegBits {
+    uint32_t SYNCBUSY = 0;
+    uint32_t ENABLE = 0;
+    uint32_t SWRST = 0;
+    uint32_t RESRDY = 0;
+    uint32_t OVF = 0;
+    uint32_t MC0 = 0;
+    uint32_t STOP = 0;
+};
+
+struct SimReg {
+    uint32_t reg = 0;
+    SimRegBits bit;
+};
+
+struct SimW1CReg {
+    struct Value {
+        uint32_t value = 0;
+        Value& operator=(uint32_t v);
+        operator uint32_t() const { return value; }
+    } reg;
+};
+
+// Writing ones enables (INTENSET) or disables (INTENCLR) those lines;
+// both read the enabled lines
+struct SimEicEnableReg {
+    struct Value {
+        bool set;
+        Value& operator=(uint32_t v);
+        operator uint32_t() const;
+    } reg;
+};
+
+struct EicRegs {
+    SimReg CTRL;
+    SimReg STATUS;
+    SimReg EVCTRL;
+    SimReg WAKEUP;
+    SimEicEnableReg INTENSET{{true}};
+    SimEicEnableReg INTENCLR{{false}};
+    SimW1CReg INTFLAG;
+};
+
+struct PmRegs {
+    SimReg RCAUSE;
+    SimReg APBCMASK;
+};
+
+struct GclkRegs {
+    SimReg CTRL;
+    SimReg STATUS;
+    SimReg CLKCTRL;
+    SimReg GENCTRL;
+    SimReg GENDIV;
+};
+
+struct SysctrlRegs {
+    SimReg XOSC32K;
+    SimReg OSC32K;
+};
+
+struct ScbRegs {
+    uint32_t SCR = 0;
+    uint32_t AIRCR = 0;
+};
+
+// Per thread, like the firmware's own state (lib/FED4/PerDevice.h)
+extern thread_local EicRegs* EIC;
+extern thread_local PmRegs* PM;
+extern thread_local GclkRegs* GCLK;
+extern thread_local SysctrlRegs* SYSCTRL;
+extern thread_local ScbRegs* SCB;
+
+constexpr uint32_t PM_RCAUSE_POR   = 1 << 0;
+constexpr uint32_t PM_RCAUSE_BOD12 = 1 << 1;
+constexpr uint32_t PM_RCAUSE_BOD33 = 1 << 2;
+constexpr uint32_t PM_RCAUSE_EXT   = 1 << 4;
+constexpr uint32_t PM_RCAUSE_WDT   = 1 << 5;
+constexpr uint32_t PM_RCAUSE_SYST  = 1 << 6;
+
+constexpr uint32_t SYSCTRL_XOSC32K_RUNSTDBY = 1 << 6;
+constexpr uint32_t SYSCTRL_XOSC32K_ONDEMAND = 1 << 7;
+
+constexpr uint32_t GCLK_CLKCTRL_CLKEN    = 1 << 14;
+constexpr uint32_t GCLK_CLKCTRL_GEN_GCLK0 = 0 << 8;
+constexpr uint32_t GCLK_CLKCTRL_GEN_GCLK1 = 1 << 8;
+constexpr uint32_t GCM_EIC = 0x05;
+constexpr uint32_t GCLK_CLKCTRL_ID_TCC0_TCC1 = 0x1A;
+constexpr uint32_t GCLK_CLKCTRL_ID_TCC2_TC3 = 0x1B;
+constexpr uint32_t GCLK_CLKCTRL_ID_TC4_TC5 = 0x1C;
+#define GCLK_CLKCTRL_ID(id) ((uint32_t)(id))
+
+constexpr uint32_t SCB_SCR_SLEEPDEEP_Msk = 1 << 2;
+
+// ==== TC (16-bit counter mode) ====
+// Per board, see sim::Board. The shim raises MC0 at the compare rate while
+// the CPU is awake; GCLK0 is assumed and stops in standby. TC4 restarts
+// its period from the match, so a handler can change CC[0] for the next one.
+struct SimFlagReg {
+    struct Value {
+        uint32_t value = 0;
+        Value& operator=(uint32_t v) { value &= ~v; return *this; } // write one to clear
+        operator uint32_t() const { return value; }
+    } reg;
+};
+
+struct TcCount16 {
+    SimReg CTRLA;
+    SimReg CTRLBSET;
+    SimReg INTENSET;
+    SimReg INTENCLR;
+    SimFlagReg INTFLAG;
+    SimReg STATUS;
+    SimReg COUNT;
+    SimReg CC[2];
+};
+
+struct SimTc {
+    TcCount16 COUNT16;
+};
+
+constexpr uint32_t TC_CTRLA_SWRST          = 1 << 0;
+constexpr uint32_t TC_CTRLA_ENABLE         = 1 << 1;
+constexpr uint32_t TC_CTRLA_MODE_COUNT16   = 0 << 2;
+constexpr uint32_t TC_CTRLA_WAVEGEN_MFRQ   = 1 << 5;
+constexpr uint32_t TC_CTRLA_PRESCALER_Pos  = 8;
+constexpr uint32_t TC_CTRLA_PRESCALER_DIV1 = 0 << 8;
+constexpr uint32_t TC_CTRLA_PRESCALER_DIV8 = 3 << 8;
+constexpr uint32_t TC_CTRLA_PRESCALER_DIV16 = 4 << 8;
+constexpr uint32_t TC_CTRLA_PRESCALER_DIV64 = 5 << 8;
+constexpr uint32_t TC_INTENSET_MC0         = 1 << 4;
+constexpr uint32_t TC_INTFLAG_MC0          = 1 << 4;
+
+// ==== TCC ====
+// Plain registers: the waveform output is not simulated.
+struct SimTcc {
+    SimReg CTRLA;
+    SimReg SYNCBUSY;
+    SimReg WAVE;
+    SimReg PER;
+    SimReg CC[4];
+    SimReg PERB;
+    SimReg CCB[4];
+};
+
+constexpr uint32_t TCC_CTRLA_SWRST          = 1 << 0;
+constexpr uint32_t TCC_CTRLA_ENABLE         = 1 << 1;
+constexpr uint32_t TCC_CTRLA_PRESCALER_DIV8 = 3 << 8;
+constexpr uint32_t TCC_WAVE_WAVEGEN_NPWM    = 2;
+
+// ==== ADC ====
+// Conversions complete as soon as they are triggered.
+struct SimAdcTrigger {
+    struct Value {
+        Value& operator=(uint32_t v);
+    } reg;
+};
+
+struct SimAdcResult {
+    struct Value {
+        operator uint32_t(); // reading clears RESRDY
+    } reg;
+};
+
+struct SimAdc {
+    SimReg CTRLA;
+    SimReg REFCTRL;
+    SimReg AVGCTRL;
+    SimReg SAMPCTRL;
+    SimReg CTRLB;
+    SimReg INPUTCTRL;
+    SimAdcTrigger SWTRIG;
+    SimReg INTENSET;
+    SimFlagReg INTFLAG;
+    SimReg STATUS;
+    SimAdcResult RESULT;
+};
+
+constexpr uint32_t ADC_CTRLA_SWRST            = 1 << 0;
+constexpr uint32_t ADC_CTRLA_ENABLE           = 1 << 1;
+constexpr uint32_t ADC_REFCTRL_REFSEL_INTVCC1 = 0x2;
+constexpr uint32_t ADC_AVGCTRL_SAMPLENUM_Pos  = 0;
+constexpr uint32_t ADC_AVGCTRL_SAMPLENUM_16   = 0x4;
+#define ADC_AVGCTRL_ADJRES(n) ((uint32_t)(n) << 4)
+#define ADC_SAMPCTRL_SAMPLEN(n) ((uint32_t)(n))
+constexpr uint32_t ADC_CTRLB_PRESCALER_DIV32  = 0x3 << 8;
+constexpr uint32_t ADC_CTRLB_RESSEL_Pos       = 4;
+constexpr uint32_t ADC_CTRLB_RESSEL_12BIT     = 0x0 << 4;
+constexpr uint32_t ADC_CTRLB_RESSEL_16BIT     = 0x1 << 4;
+constexpr uint32_t ADC_CTRLB_RESSEL_10BIT     = 0x2 << 4;
+constexpr uint32_t ADC_CTRLB_RESSEL_8BIT      = 0x3 << 4;
+#define ADC_INPUTCTRL_MUXPOS(n) ((uint32_t)(n) & 0x1F)
+constexpr uint32_t ADC_INPUTCTRL_MUXPOS_Msk   = 0x1F;
+constexpr uint32_t ADC_INPUTCTRL_MUXNEG_GND   = 0x18 << 8;
+constexpr uint32_t ADC_INPUTCTRL_GAIN_DIV2    = 0xFu << 24;
+constexpr uint32_t ADC_SWTRIG_START           = 1 << 1;
+constexpr uint32_t ADC_INTFLAG_RESRDY         = 1 << 0;
+
+typedef enum {
+    RTC_IRQn = 3,
+    EIC_IRQn = 4,
+    TC3_IRQn = 18,
+    TC4_IRQn = 19,
+    ADC_IRQn = 23,
+} IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_SystemReset();
+void __DSB();
+void __WFI();
+void __disable_irq();
+void __enable_irq();
+uint32_t __get_PRIMASK();
+uint32_t __get_IPSR();      // non-zero in a handler
+void __set_PRIMASK(uint32_t primask);
+
+#endif
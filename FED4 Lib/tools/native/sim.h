@@ -0,0 +1,150 @@
+#ifndef NATIVE_SIM_H
+#define NATIVE_SIM_H
+
+// Simulated board state behind the native Arduino shim.
+//
+// Interrupt model: the main context owns the (single) CPU. Any thread may
+// raise() an interrupt line; the line is latched as pending and delivered
+// on the main context at the next preemption point, i.e. the next call into
+// the shim, provided it is enabled and the CPU is not already in a handler.
+// That is how a Cortex-M0 behaves at the granularity of library calls.
+// Lines raised while masked stay pending until unmasked, or are dropped if
+// firmware clears their flag first.
+//
+// TC3, TC4 and the ADC are emulated at register level (samd21.h): the
+// timers raise their compare interrupt at the programmed rate while the CPU
+// is awake, and ADC conversions finish as soon as they are started. TC4 has
+// the highest priority and preempts any other handler.
+//
+// Each thread drives one board at a time (setBoard()); all state here is
+// per board so several devices can run side by side in one process. Only
+// the thread that attached as the board's CPU runs handlers; stimulus
+// threads attach with cpu = false. The firmware's own state, and the
+// EIC, PM, GCLK and SCB registers, are per thread (lib/FED4/PerDevice.h),
+// so each device needs a CPU thread of its own.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "samd21.h"
+
+namespace sim {
+
+constexpr uint8_t LINE_ALARM = 31; // pseudo line for the RTC alarm
+constexpr uint8_t PIN_COUNT = 32;
+
+struct Stats {
+    uint64_t delivered = 0;    // interrupt handlers run
+    uint64_t dropped = 0;      // pending lines cleared before delivery
+    uint64_t alarmsLost = 0;   // alarm fired while its callback was detached
+    uint64_t sdWrites = 0;
+    uint64_t sdBytes = 0;
+    uint64_t ledShows = 0;
+    uint64_t motorSteps = 0;
+    uint64_t i2cTransfers = 0;
+};
+
+struct Board {
+    Board();
+
+    // ==== Configuration ====
+    std::string sdRoot = ".";       // host directory standing in for the card
+    bool realTime = true;           // scaled wall clock, else manual clock
+    double speed = 1.0;             // real-time speed-up factor
+    uint32_t unixStart = 1735722000; // RTC time at clock zero (2025-01-01 09:00)
+    uint32_t resetCause = 1;        // PM->RCAUSE at boot (POR)
+    uint32_t sdLatencyUs = 0;       // added to every SD write/flush
+    uint32_t autoAdvanceUs = 20;    // manual clock: time per shim call
+
+    // ==== Hooks (called on the main context) ====
+    std::function<void(int steps)> onStep;
+    std::function<void(const uint8_t* buf, size_t n)> onSerial;
+    std::function<bool()> onIdle;   // manual clock: __WFI with nothing pending
+    std::function<void()> onDue;    // manual clock: the clock passed dueUs
+    uint64_t dueUs = UINT64_MAX;
+    std::function<void(uint8_t pin, uint8_t level)> onPinWrite; // digitalWrite()
+
+    // ==== Live state ====
+    std::mutex m;
+    std::condition_variable cv;
+    uint64_t clockUs = 0;
+    uint64_t realStartUs = 0;
+
+    uint8_t level[PIN_COUNT] = {};
+    uint16_t analog[PIN_COUNT] = {}; // 10-bit, as analogRead() returns
+    void (*isr[32])() = {};
+    uint32_t pending = 0;
+    bool eicEnabled = false;
+    uint32_t eicLines = 0;          // EIC INTENSET, by line
+    uint32_t nvicEnabled = 0;       // other IRQs, by IRQn
+    bool primask = false;
+    bool inIsr = false;
+    bool inDue = false;
+    std::thread::id cpu;
+
+    void (*alarmCb)() = nullptr;
+    bool alarmEnabled = false;
+    uint32_t alarmAtUnix = 0;       // next RTC alarm match, 0 = none
+    uint8_t alarmMatch = 0;         // RTCZero::Alarm_Match
+    uint8_t alarmH = 0, alarmM = 0, alarmS = 0;
+
+    SimTc tc3;
+    uint64_t tc3DueUs = 0;
+    SimTc tc4;
+    uint64_t tc4DueUs = 0;
+    uint64_t tc4MatchUs = 0;
+    bool inTc4 = false;
+    SimTcc tcc1;
+    SimAdc adc;
+    uint32_t adcResult = 0;
+    bool standby = false;           // in __WFI with SLEEPDEEP set
+
+    uint32_t rtcOffset = 0;         // rtc.adjust() relative to unixStart
+    uint32_t rngState = 1;
+    uint16_t toneHz = 0;
+
+    // AHT20 on I2C
+    double envTempC = 22.0;
+    double envRh = 45.0;
+    bool ahtCalibrated = false;
+    uint64_t ahtReadyUs = 0;        // end of the conversion in progress
+    uint8_t i2cAddress = 0;
+    std::deque<uint8_t> i2cTx, i2cRx;
+
+    std::deque<uint8_t> serialIn;
+    std::atomic<bool> stop{false};
+
+    Stats stats;
+};
+
+Board& board();
+void setBoard(Board* b, bool cpu = true);
+
+// ==== Harness API ====
+void raise(uint8_t line);                  // latch an interrupt, any thread
+void setPin(uint8_t pin, uint8_t level, bool edge = true);
+uint8_t pinLine(uint8_t pin);
+uint8_t pinLevel(uint8_t pin);             // no preemption, safe off-CPU
+void setAnalog(uint8_t pin, uint16_t value);
+void advance(uint64_t us);                 // manual clock only
+uint64_t nowUs();
+uint32_t unixNow();
+void serialInput(const char* data, size_t n);
+bool irqMasked();                          // EIC or an attached line disabled, or alarm detached
+
+// ==== Shim internals ====
+void preempt();
+void busyWait(uint64_t us);
+void clearPending(uint32_t mask);
+void scheduleAlarm(Board& b);
+void sdDelay();
+
+}
+
+#endif
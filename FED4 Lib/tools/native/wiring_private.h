@@ -0,0 +1,18 @@
+#ifndef NATIVE_WIRING_PRIVATE_H
+#define NATIVE_WIRING_PRIVATE_H
+
+#include <Arduino.h>
+
+typedef enum {
+    PIO_ANALOG,
+    PIO_DIGITAL,
+    PIO_TIMER,
+    PIO_TIMER_ALT,
+} EPioType;
+
+inline int pinPeripheral(uint32_t pin, EPioType type) {
+    (void)pin; (void)type;
+    return 0;
+}
+
+#endif
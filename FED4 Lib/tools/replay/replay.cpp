@@ -0,0 +1,744 @@
+// Replays a FED4 session from its log through the real schedule code.
+//
+// Each boot in the log starts at its Seed row. The replay boots the
+// library on the native shim at the seed's time, with the session's
+// CONFIG.json and the counters the Seed row carries, then presses the
+// pokes, drops the pellets and applies the shell settings the log
+// records, each in the second it was logged. The rows the schedule writes
+// (pokes, pellets, Set VI, jams, settings) are checked against the log
+// column by column and the first row that differs is reported.
+//
+// The clock is manual: between events it jumps to the next poke, RTC
+// alarm, VI deadline or feeding window edge, so a month replays in
+// seconds.
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=gnu++17 -O2 -pthread -Itools/native -Ilib/FED4 -Itools/logseek
+//       tools/replay/replay.cpp tools/logseek/LogSeek.cpp
+//       tools/native/native.cpp lib/FED4/*.cpp -o replay
+//
+// Usage:
+//   replay [-c CONFIG.json] [-o dir] [-v] LOG...
+//
+// LOG is every segment of the session, put in order by their chain lines.
+// The config defaults to the one in the first segment's preamble (see
+// lib/FED4/LogSchema.h), or for segments without one, CONFIG.json beside
+// the first segment; settings changed from the shell start each boot at
+// the value its first Param row says they had. -o keeps the replayed card of boot N in dir/N, -v prints
+// a line per boot. Exits 1 at the first divergence.
+
+#include <FED4.h>
+#include <LogSeek.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Longest clock jump while the device is awake
+static const uint64_t MAX_STEP_US = LP_AWAKE_PERIOD * 1000000ULL;
+static const uint64_t PRESS_US = 20000;
+// Between the releases of pokes put in back to back; a press sooner than
+// the debounce after the last one is dropped
+static const uint64_t POKE_GAP_US = (SENSOR_DEBOUNCE + 10) * 1000ULL;
+// While cues play the device stays awake, and the service tick has to run
+// at its rate for them to end when they would
+static const uint64_t BUSY_STEP_US = 1000000ULL / TICK_HZ;
+// Run on after the last row so the alarm flushes what is left
+static const uint64_t TAIL_US = (2 * LP_AWAKE_PERIOD + 5) * 1000000ULL;
+
+struct Row {
+    std::vector<std::string> cells;
+    int64_t unixTime = 0;
+};
+
+struct Log {
+    std::string header;
+    std::vector<std::string> columns;
+    std::vector<Row> rows;
+    int seqCol = -1, eventCol = -1, timeCol = -1, batteryCol = -1;
+    std::vector<std::string> sensorEvents; // from the "<name> <action> Count" columns
+    std::string config;                     // the first segment's #config, see LogSchema.h
+};
+
+enum ActionKind { PRESS, RELEASE, PARAM };
+
+struct Action {
+    uint64_t us;
+    ActionKind kind;
+    int sensor;
+    std::string name, value;
+    size_t row;
+    bool early;
+};
+
+static std::vector<std::string> splitRow(const char* p, const char* end) {
+    std::vector<std::string> cells;
+    while (true) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        cells.emplace_back(p, comma ? comma : end);
+        if (comma == nullptr) break;
+        p = comma + 1;
+    }
+    return cells;
+}
+
+static bool startsWith(const std::string& s, const char* prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+struct Segment {
+    std::string path;
+    unsigned long session = 0;
+    unsigned index = 0;
+};
+
+// Segments in the order they were written: by session, then by index
+static std::vector<Segment> chainOrder(const std::vector<std::string>& paths) {
+    std::vector<Segment> segments;
+    for (const std::string& path : paths) {
+        Segment s;
+        s.path = path;
+        FILE* f = fopen(path.c_str(), "r");
+        char line[160] = "";
+        if (f && fgets(line, sizeof(line), f)) {
+            sscanf(line, "#segment=%u,session=%lu", &s.index, &s.session);
+        }
+        if (f) fclose(f);
+        segments.push_back(s);
+    }
+    std::stable_sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) {
+        return a.session != b.session ? a.session < b.session : a.index < b.index;
+    });
+    return segments;
+}
+
+static bool readLog(const std::vector<std::string>& paths, Log& log, std::string& err) {
+    for (const Segment& segment : chainOrder(paths)) {
+        LogSeek seg;
+        if (!logSeekOpen(seg, segment.path.c_str())) {
+            err = segment.path + ": cannot read, or no TimeStamp column";
+            return false;
+        }
+        for (size_t pos = 0; pos < seg.rows && log.config.empty();) {
+            const char* nl = (const char*)memchr(seg.data + pos, '\n', seg.rows - pos);
+            size_t stop = nl ? nl - seg.data : seg.rows;
+            if (stop - pos > 8 && memcmp(seg.data + pos, "#config=", 8) == 0) {
+                log.config.assign(seg.data + pos + 8, stop - pos - 8);
+            }
+            pos = stop + 1;
+        }
+        if (log.header.empty()) {
+            log.header = seg.header;
+            log.columns = splitRow(seg.header.data(), seg.header.data() + seg.header.size());
+        }
+        else if (seg.header != log.header) {
+            err = segment.path + ": columns differ from the first segment";
+            logSeekClose(seg);
+            return false;
+        }
+        for (size_t pos = seg.rows; pos < seg.end;) {
+            int64_t t;
+            size_t next;
+            bool timed = logSeekRowTime(seg, pos, &t, &next);
+            const char* nl = (const char*)memchr(seg.data + pos, '\n', seg.end - pos);
+            size_t stop = nl ? nl - seg.data : seg.end;
+            if (stop > pos && seg.data[stop - 1] == '\r') stop--;
+            Row row;
+            row.cells = splitRow(seg.data + pos, seg.data + stop);
+            row.unixTime = t;
+            // Rows cut off by a reset have fewer cells
+            if (timed && row.cells.size() == log.columns.size()) log.rows.push_back(std::move(row));
+            pos = next;
+        }
+        logSeekClose(seg);
+    }
+
+    for (size_t i = 0; i < log.columns.size(); i++) {
+        const std::string& c = log.columns[i];
+        if (c == "Seq") log.seqCol = i;
+        if (c == "TimeStamp") log.timeCol = i;
+        if (c == "Event") log.eventCol = i;
+        if (c == "Battery mV") log.batteryCol = i;
+        if (c != "Pellet Count" && c.size() > 6 && c.compare(c.size() - 6, 6, " Count") == 0) {
+            log.sensorEvents.push_back(c.substr(0, c.size() - 6));
+        }
+    }
+    if (log.eventCol < 0 || log.seqCol < 0) {
+        err = "no Seq or Event column";
+        return false;
+    }
+    return true;
+}
+
+static const std::string& event(const Log& log, const Row& row) {
+    return row.cells[log.eventCol];
+}
+
+static int sensorOf(const Log& log, const Row& row) {
+    const std::string& e = event(log, row);
+    for (size_t i = 0; i < log.sensorEvents.size(); i++) {
+        if (log.sensorEvents[i] == e) return i;
+    }
+    return -1;
+}
+
+// EventCode::COUNT for pokes, see EventCode.h
+static uint8_t codeOf(const Log& log, const Row& row) {
+    const std::string& e = event(log, row);
+    return eventCodeOf(e.data(), e.size());
+}
+
+// The rows the schedule decides: pokes, pellets, VI, jams, settings, seed
+static bool isDecision(const Log& log, const Row& row) {
+    uint8_t code = codeOf(log, row);
+    return sensorOf(log, row) >= 0 || code == EventCode::PEL || code == EventCode::SET_VI
+        || code == EventCode::ERROR || code == EventCode::PARAM || code == EventCode::SEED;
+}
+
+// "Param name=value was=old"
+static bool parseParam(const std::string& e, std::string& name, std::string& value, std::string& was) {
+    size_t eq = e.find('=');
+    size_t wasAt = e.find(" was=");
+    if (!startsWith(e, "Param ") || eq == std::string::npos || wasAt == std::string::npos || wasAt < eq) {
+        return false;
+    }
+    name = e.substr(6, eq - 6);
+    value = e.substr(eq + 1, wasAt - eq - 1);
+    was = e.substr(wasAt + 5);
+    return true;
+}
+
+static std::string rowText(const Row& row) {
+    std::string s;
+    for (size_t i = 0; i < row.cells.size(); i++) {
+        if (i) s += ',';
+        s += row.cells[i];
+    }
+    return s;
+}
+
+struct Divergence {
+    bool found = false;
+    std::string text;
+};
+
+// Every column but Seq and the battery. The Seed row starts the boot with
+// the counters the replay is given, so only its seed is compared.
+static Divergence compareRows(const Log& log, const Row& want, const Log& got, const Row& have) {
+    Divergence d;
+    auto report = [&](const std::string& column, const std::string& a, const std::string& b) {
+        d.found = true;
+        d.text = "Seq " + want.cells[log.seqCol] + " (" + want.cells[log.timeCol] + ", "
+            + event(log, want) + "): " + column + " logged " + a + ", replayed " + b
+            + "\n  logged:   " + rowText(want) + "\n  replayed: " + rowText(have);
+    };
+    if (event(log, want) != event(got, have)) {
+        report("Event", event(log, want), event(got, have));
+        return d;
+    }
+    if (codeOf(log, want) == EventCode::SEED) return d;
+
+    for (size_t i = 0; i < log.columns.size(); i++) {
+        if ((int)i == log.seqCol || (int)i == log.batteryCol) continue;
+        if ((int)i == log.timeCol) {
+            // Where in its second an input went is a guess, so what run()
+            // logs after it, or a jam 90 s of steps on, can land a second
+            // either way. The inputs themselves are put in their second.
+            int64_t slack = sensorOf(log, want) >= 0 || codeOf(log, want) == EventCode::PARAM ? 0 : 1;
+            if (llabs(want.unixTime - have.unixTime) > slack) {
+                report(log.columns[i], want.cells[i], have.cells[i]);
+                return d;
+            }
+            continue;
+        }
+        // run() refreshes the count down between events, so a row other
+        // than Set VI can show it a second either way
+        if (log.columns[i] == "VI Count Down" && codeOf(log, want) != EventCode::SET_VI) {
+            int16_t diff = (uint16_t)atoi(want.cells[i].c_str()) - (uint16_t)atoi(have.cells[i].c_str());
+            if (abs(diff) > 1) {
+                report(log.columns[i], want.cells[i], have.cells[i]);
+                return d;
+            }
+            continue;
+        }
+        if (want.cells[i] != have.cells[i]) {
+            report(log.columns[i], want.cells[i], have.cells[i]);
+            return d;
+        }
+    }
+    return d;
+}
+
+struct BootStats {
+    uint64_t pokes = 0;
+    uint64_t pellets = 0;
+    uint64_t params = 0;
+    uint64_t checked = 0;
+};
+
+// One boot: the rows from its Seed row up to the next one
+class Replay {
+    public:
+    Replay(const Log& log, size_t first, size_t last) : _log(log), _first(first), _last(last) {}
+
+    bool run(const std::string& dir, const std::string& config, BootStats& stats, std::string& err);
+
+    private:
+    const Log& _log;
+    size_t _first, _last;
+    uint32_t _seed = 0;
+    sim::Board* _b = nullptr;
+    FED4* _fed = nullptr;
+    std::vector<Action> _actions;
+    size_t _next = 0;
+    std::vector<uint64_t> _pellets;
+    size_t _nextPellet = 0;
+    std::vector<int64_t> _wakes;
+    size_t _nextWake = 0;
+    uint64_t _endUs = 0;
+    bool _finished = false;
+    bool _slept = false;
+
+    uint64_t usAt(int64_t unixTime) const {
+        return unixTime <= (int64_t)_seed ? 0 : (uint64_t)(unixTime - _seed) * 1000000ULL;
+    }
+    void plan(BootStats& stats);
+    uint64_t viDeadline(int64_t deadline);
+    void pump(bool inRun);
+    uint64_t nextStop(uint64_t now);
+    bool idle();
+    void step();
+};
+
+// Pokes and settings go in at even spacing through the second they were
+// logged in, in log order; a poke is logged when it is released. A pellet
+// may land once its second has come and the inputs logged before it are in.
+void Replay::plan(BootStats& stats) {
+    std::vector<size_t> timed;
+    for (size_t i = _first + 1; i < _last; i++) {
+        const Row& row = _log.rows[i];
+        if (sensorOf(_log, row) >= 0 || codeOf(_log, row) == EventCode::PARAM) timed.push_back(i);
+    }
+    std::vector<uint64_t> at(_last - _first, 0);
+    for (size_t j = 0; j < timed.size();) {
+        size_t k = j;
+        while (k < timed.size() && _log.rows[timed[k]].unixTime == _log.rows[timed[j]].unixTime) k++;
+        uint64_t spacing = 1000000ULL / (k - j + 1);
+        for (size_t n = j; n < k; n++) {
+            at[timed[n] - _first] = usAt(_log.rows[timed[n]].unixTime) + (n - j + 1) * spacing;
+        }
+        j = k;
+    }
+
+    uint64_t lastInput = 0;
+    for (size_t i = _first + 1; i < _last; i++) {
+        const Row& row = _log.rows[i];
+        uint64_t t = at[i - _first];
+        int sensor = sensorOf(_log, row);
+        if (sensor >= 0) {
+            _actions.push_back({t - std::min(t, PRESS_US), PRESS, sensor, "", "", i, false});
+            _actions.push_back({t, RELEASE, sensor, "", "", i, false});
+            lastInput = t;
+            stats.pokes++;
+        }
+        else if (codeOf(_log, row) == EventCode::PARAM) {
+            Action a = {t, PARAM, -1, "", "", i, false};
+            std::string was;
+            parseParam(event(_log, row), a.name, a.value, was);
+            _actions.push_back(a);
+            lastInput = t;
+            stats.params++;
+        }
+        else if (codeOf(_log, row) == EventCode::PEL) {
+            _pellets.push_back(std::max(usAt(row.unixTime), lastInput + 1000));
+            stats.pellets++;
+        }
+    }
+
+    // Asleep when its window opens, the device wakes at the next RTC alarm,
+    // at a point in the alarm's minute the log only shows by what is logged
+    // then, before any input
+    int windowCol = -1;
+    for (size_t c = 0; c < _log.columns.size(); c++) {
+        if (_log.columns[c] == "In Window") windowCol = c;
+    }
+    bool wasIn = true;
+    for (size_t i = _first + 1; i < _last && windowCol >= 0; i++) {
+        const Row& row = _log.rows[i];
+        bool in = row.cells[windowCol] == "1";
+        if (
+            in && !wasIn && row.unixTime % 3600 < 60
+            && sensorOf(_log, row) < 0 && codeOf(_log, row) != EventCode::PARAM
+        ) {
+            _wakes.push_back(row.unixTime);
+        }
+        wasIn = in;
+    }
+    _endUs = usAt(_log.rows[_last - 1].unixTime) + TAIL_US;
+}
+
+// One input at a time, so the firmware takes each edge before the next.
+// Inside run() inputs land wherever it is, as interrupts do; settings wait
+// for the main loop, as the shell applies them between runs.
+void Replay::pump(bool inRun) {
+    uint64_t now = sim::nowUs();
+    while (_next < _actions.size() && _actions[_next].us <= now) {
+        const Action& a = _actions[_next];
+        // An edge while the firmware has the EIC paused would be cleared
+        // when it restarts them, and the log shows it was not
+        if (inRun && !_b->eicEnabled) break;
+        if (a.kind == PARAM) {
+            if (inRun) break;
+            char out[64];
+            _fed->setParam(a.name.c_str(), a.value.c_str(), out, sizeof(out));
+            _next++;
+            continue;
+        }
+        const Sensor& sensor = _fed->sensors[a.sensor];
+        bool down = a.kind == PRESS;
+        if (sensor.type == SensorType::ANALOG) sim::setAnalog(sensor.pin, down ? 1023 : 0);
+        else sim::setPin(sensor.pin, down ? LOW : HIGH);
+        _next++;
+        break;
+    }
+    _b->dueUs = _next < _actions.size() ? _actions[_next].us : UINT64_MAX;
+}
+
+// A poke logged in the second a VI runs out, ahead of something the
+// schedule logged in that second, was in before run() acted on the
+// deadline. Those pokes go in at the start of the second, and the deadline
+// is seen after them.
+uint64_t Replay::viDeadline(int64_t deadline) {
+    uint64_t start = usAt(deadline);
+    if (_next >= _actions.size()) return start;
+
+    size_t from = _actions[_next].row;
+    while (from > _first + 1 && _log.rows[from - 1].unixTime >= deadline) from--;
+    size_t scheduled = _last;
+    for (size_t i = from; i < _last && _log.rows[i].unixTime <= deadline; i++) {
+        const Row& row = _log.rows[i];
+        bool input = sensorOf(_log, row) >= 0 || codeOf(_log, row) == EventCode::PARAM;
+        if (row.unixTime == deadline && isDecision(_log, row) && !input) {
+            scheduled = i;
+            break;
+        }
+    }
+    if (scheduled == _last) return start;
+
+    uint64_t release = start + 1000;
+    uint64_t last = start;
+    for (size_t k = _next; k < _actions.size() && _actions[k].row < scheduled; k++) {
+        Action& a = _actions[k];
+        if (_log.rows[a.row].unixTime != deadline) continue;
+        if (!a.early) {
+            a.us = a.kind == PRESS ? release - PRESS_US : release;
+            a.early = true;
+        }
+        if (a.kind != PRESS) {
+            last = a.us;
+            release = a.us + POKE_GAP_US;
+        }
+    }
+    return last > start ? last + 1000 : start;
+}
+
+uint64_t Replay::nextStop(uint64_t now) {
+    // Woken from sleep, the device goes straight round its loop again
+    if (_slept) {
+        _slept = false;
+        return now + 1000;
+    }
+    uint64_t next = std::min(_endUs, now + MAX_STEP_US);
+    if (_fed->viSet) {
+        // The count down is 16 bits, so a deadline run() missed comes round
+        // again every 65536 s
+        uint32_t unixNow = sim::unixNow();
+        uint64_t due = viDeadline(unixNow + (uint16_t)(_fed->feedUnixT - unixNow));
+        next = _fed->viCountDown == 0 ? now : std::min(next, std::max(due, now));
+    }
+    if (_next < _actions.size()) {
+        // A setting logs the count down as run() last left it, so run()
+        // goes just before it as it would on the device
+        const Action& a = _actions[_next];
+        next = std::min(next, a.kind == PARAM && a.us > now + 2000 ? a.us - 1000 : a.us);
+    }
+    if (cuePlaying() || soundPlaying() || syncBusy()) next = std::min(next, now + BUSY_STEP_US);
+    // A poke run() has not taken yet, such as one during a feed; a VI count
+    // down leaves them
+    for (uint8_t i = 0; i < _fed->sensorCount && !_fed->viSet; i++) {
+        if (_fed->sensors[i].poked) next = now;
+    }
+    // The last run() before a window edge leaves its count down on the rows
+    // after it, and the first one after the edge sees it
+    if (_fed->feedWindow) {
+        uint64_t edge = usAt((sim::unixNow() / 3600 + 1) * 3600);
+        next = std::min(next, edge > now + 1000 ? edge - 1000 : edge);
+    }
+    return std::max(next, now + 1000);
+}
+
+// Asleep: on to the next input or RTC alarm. At the end a press wakes the
+// device so run() returns; it is not released, so it is not counted.
+bool Replay::idle() {
+    uint64_t now = sim::nowUs();
+    _slept = true;
+    if (_next >= _actions.size() && now >= _endUs) {
+        _finished = true;
+        _b->stop = true;
+        for (uint8_t i = 0; i < _fed->sensorCount; i++) {
+            if (_fed->sensors[i].type == SensorType::DIGITAL) {
+                sim::setPin(_fed->sensors[i].pin, LOW);
+                break;
+            }
+        }
+        return true;
+    }
+
+    uint64_t next = _endUs;
+    if (_next < _actions.size()) next = std::min(next, _actions[_next].us);
+    while (_nextWake < _wakes.size() && usAt(_wakes[_nextWake]) < now) _nextWake++;
+    if (_nextWake < _wakes.size()) {
+        int64_t wake = _wakes[_nextWake];
+        uint64_t open = usAt(wake - wake % 3600);
+        if (now >= open) {
+            std::lock_guard<std::mutex> lock(_b->m);
+            _b->alarmAtUnix = wake;
+            _nextWake++;
+        }
+        else {
+            next = std::min(next, open);
+        }
+    }
+    if (_b->alarmEnabled && _b->alarmAtUnix != 0) next = std::min(next, usAt(_b->alarmAtUnix));
+    sim::advance(std::max(next, now + 1000) - now);
+    pump(false);
+    return true;
+}
+
+// The motor turns until the next logged pellet is due, and none drops for
+// a feed the log has a jam for
+void Replay::step() {
+    if (_nextPellet < _pellets.size() && sim::nowUs() >= _pellets[_nextPellet]) {
+        sim::setPin(FED4Pins::WELL, sim::pinLevel(FED4Pins::WELL) == HIGH ? LOW : HIGH);
+        _nextPellet++;
+    }
+}
+
+bool Replay::run(const std::string& dir, const std::string& config, BootStats& stats, std::string& err) {
+    const Row& seedRow = _log.rows[_first];
+    _seed = strtoul(event(_log, seedRow).c_str() + 5, nullptr, 10);
+    plan(stats);
+
+    std::ofstream out(dir + "/CONFIG.json", std::ios::binary);
+    if (!(out << config)) {
+        err = "cannot write " + dir + "/CONFIG.json";
+        return false;
+    }
+    out.close();
+
+    // The seed is the RTC time at boot. The watchdog path boots without
+    // the menus, straight into the session.
+    sim::Board b;
+    _b = &b;
+    b.sdRoot = dir;
+    b.realTime = false;
+    b.unixStart = _seed;
+    b.resetCause = PM_RCAUSE_WDT;
+    b.onIdle = [this]() { return idle(); };
+    b.onStep = [this](int) { step(); };
+    b.onDue = [this]() { pump(true); };
+    sim::setBoard(&b);
+
+    _fed = new FED4();
+    _fed->begin();
+
+    for (uint8_t i = 0; i < _fed->sensorCount; i++) {
+        Sensor& sensor = _fed->sensors[i];
+        if (sensor.type == SensorType::DIGITAL) sim::setPin(sensor.pin, HIGH, false);
+        for (size_t c = 0; c < _log.columns.size(); c++) {
+            if (_log.columns[c] == std::string(sensor.message) + " Count") {
+                sensor.count = atoi(seedRow.cells[c].c_str());
+            }
+        }
+    }
+    for (size_t c = 0; c < _log.columns.size(); c++) {
+        if (_log.columns[c] == "Pellet Count") _fed->pelletsDispensed = atoi(seedRow.cells[c].c_str());
+    }
+    std::vector<std::string> restored;
+    for (size_t i = _first + 1; i < _last; i++) {
+        std::string name, value, was;
+        if (!parseParam(event(_log, _log.rows[i]), name, value, was)) continue;
+        if (std::find(restored.begin(), restored.end(), name) != restored.end()) continue;
+        char reply[64];
+        _fed->setParam(name.c_str(), was.c_str(), reply, sizeof(reply), false);
+        restored.push_back(name);
+    }
+    // Every row on the card as it is logged, so the replay can be read back
+    flushInit(_fed->flushPolicy, 1, 1);
+
+    while (!_finished) {
+        pump(false);
+        _fed->run();
+        uint64_t now = sim::nowUs();
+        if (_finished || (_next >= _actions.size() && now >= _endUs)) break;
+        sim::advance(nextStop(now) - now);
+    }
+
+    delete _fed;
+    _fed = nullptr;
+    sim::setBoard(nullptr);
+    return true;
+}
+
+static std::vector<std::string> replayedSegments(const std::string& dir) {
+    std::vector<std::string> paths;
+    std::string cmd = "ls " + dir + " | grep '^FED.*\\.csv$'";
+    FILE* p = popen(cmd.c_str(), "r");
+    char name[256];
+    while (p && fgets(name, sizeof(name), p)) {
+        name[strcspn(name, "\n")] = '\0';
+        paths.push_back(dir + "/" + name);
+    }
+    if (p) pclose(p);
+    return paths;
+}
+
+int main(int argc, char** argv) {
+    std::string configPath, keep;
+    bool verbose = false;
+    int c;
+    while ((c = getopt(argc, argv, "c:o:v")) != -1) {
+        switch (c) {
+        case 'c': configPath = optarg; break;
+        case 'o': keep = optarg; break;
+        case 'v': verbose = true; break;
+        default: argc = 0; break;
+        }
+    }
+    if (argc - optind < 1) {
+        fprintf(stderr, "usage: %s [-c CONFIG.json] [-o dir] [-v] LOG...\n", argv[0]);
+        return 2;
+    }
+    std::vector<std::string> paths(argv + optind, argv + argc);
+
+    auto start = std::chrono::steady_clock::now();
+    Log log;
+    std::string err;
+    if (!readLog(paths, log, err)) {
+        fprintf(stderr, "%s\n", err.c_str());
+        return 2;
+    }
+
+    std::string config = log.config;
+    if (!configPath.empty() || config.empty()) {
+        if (configPath.empty()) {
+            size_t slash = paths[0].rfind('/');
+            configPath = (slash == std::string::npos ? std::string(".") : paths[0].substr(0, slash)) + "/CONFIG.json";
+        }
+        std::ifstream in(configPath, std::ios::binary);
+        std::stringstream text;
+        if (!in || !(text << in.rdbuf())) {
+            fprintf(stderr, "cannot read %s\n", configPath.c_str());
+            return 2;
+        }
+        config = text.str();
+    }
+
+    std::vector<size_t> boots;
+    for (size_t i = 0; i < log.rows.size(); i++) {
+        if (codeOf(log, log.rows[i]) == EventCode::SEED) boots.push_back(i);
+    }
+    if (boots.empty()) {
+        fprintf(stderr, "no Seed row: the log is from firmware that does not record its seed\n");
+        return 2;
+    }
+    size_t early = 0;
+    for (size_t i = 0; i < boots[0]; i++) {
+        if (isDecision(log, log.rows[i])) early++;
+    }
+    if (early > 0) printf("%lu decisions before the first Seed row are not replayed\n", (unsigned long)early);
+    if (!keep.empty()) mkdir(keep.c_str(), 0777);
+
+    BootStats total;
+    for (size_t n = 0; n < boots.size(); n++) {
+        size_t first = boots[n];
+        size_t last = n + 1 < boots.size() ? boots[n + 1] : log.rows.size();
+
+        std::string dir;
+        if (keep.empty()) {
+            char dirTemplate[] = "/tmp/fed4-replay-XXXXXX";
+            dir = mkdtemp(dirTemplate);
+        }
+        else {
+            dir = keep + "/" + std::to_string(n + 1);
+            mkdir(dir.c_str(), 0777);
+        }
+
+        BootStats stats;
+        Replay replay(log, first, last);
+        if (!replay.run(dir, config, stats, err)) {
+            fprintf(stderr, "%s\n", err.c_str());
+            return 2;
+        }
+
+        Log got;
+        if (!readLog(replayedSegments(dir), got, err) || got.header != log.header) {
+            fprintf(stderr, "boot %lu: the replay wrote no log, or other columns\n", (unsigned long)(n + 1));
+            return 2;
+        }
+        if (keep.empty()) {
+            std::string rm = "rm -rf " + dir;
+            if (system(rm.c_str()) != 0) fprintf(stderr, "could not remove %s\n", dir.c_str());
+        }
+
+        // The replay's own boot rows come before its Seed row
+        size_t j = 0;
+        while (j < got.rows.size() && codeOf(got, got.rows[j]) != EventCode::SEED) j++;
+        Divergence d;
+        for (size_t i = first; i < last && !d.found; i++) {
+            if (!isDecision(log, log.rows[i])) continue;
+            while (j < got.rows.size() && !isDecision(got, got.rows[j])) j++;
+            if (j == got.rows.size()) {
+                d.found = true;
+                d.text = "Seq " + log.rows[i].cells[log.seqCol] + " (" + log.rows[i].cells[log.timeCol]
+                    + ", " + event(log, log.rows[i]) + "): not replayed\n  logged:   " + rowText(log.rows[i]);
+                break;
+            }
+            d = compareRows(log, log.rows[i], got, got.rows[j++]);
+            stats.checked++;
+        }
+        while (!d.found && j < got.rows.size()) {
+            if (isDecision(got, got.rows[j])) {
+                d.found = true;
+                d.text = "after Seq " + log.rows[last - 1].cells[log.seqCol]
+                    + ": the replay logged more\n  replayed: " + rowText(got.rows[j]);
+            }
+            j++;
+        }
+
+        if (verbose || d.found) {
+            printf("boot %lu, seed %lu from %s: %lu pokes, %lu pellets, %lu settings, %lu rows checked\n",
+                   (unsigned long)(n + 1), strtoul(event(log, log.rows[first]).c_str() + 5, nullptr, 10),
+                   log.rows[first].cells[log.timeCol].c_str(), (unsigned long)stats.pokes,
+                   (unsigned long)stats.pellets, (unsigned long)stats.params, (unsigned long)stats.checked);
+        }
+        if (d.found) {
+            printf("first divergence at %s\n", d.text.c_str());
+            return 1;
+        }
+        total.pokes += stats.pokes;
+        total.pellets += stats.pellets;
+        total.checked += stats.checked;
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%lu boots, %lu pokes, %lu pellets: all %lu rows match (%.2f s)\n",
+           (unsigned long)boots.size(), (unsigned long)total.pokes, (unsigned long)total.pellets,
+           (unsigned long)total.checked, secs);
+    return 0;
+}
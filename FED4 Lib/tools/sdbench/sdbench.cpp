@@ -0,0 +1,145 @@
+// SD card benchmark under the FED4 log write pattern (see lib/FED4/SdStats.h
+// and FED4::flush_to_sd()).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -Ilib/FED4 tools/sdbench/sdbench.cpp lib/FED4/SdStats.cpp -o sdbench
+//
+// Usage:
+//   sdbench [-n flushes] [-b bytes_per_flush] [-p prealloc_mb] [-f] PATH
+//
+// PATH is a file on the mounted card, or a card image or block device. The
+// benchmark preallocates the log like the feeder does, then appends
+// bytes_per_flush at a time, each followed by a sync, and times the write
+// and the sync separately. The latency histogram uses the firmware's
+// buckets, so the verdict matches what CARD.json would report for the same
+// card. An existing PATH is only overwritten with -f.
+
+#include <SdStats.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    uint32_t flushes = 2000;
+    uint32_t bytes = 1024;      // FILE_RAM_BUFF_SIZE
+    uint32_t preallocMb = 25;   // FILE_PREALLOC_SIZE
+    bool force = false;
+    const char* path = nullptr;
+};
+
+static uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// Log rows of the same shape and length as the feeder's
+static void fillRows(std::vector<char>& buf, uint32_t& row) {
+    size_t pos = 0;
+    while (pos < buf.size()) {
+        char line[160];
+        int n = snprintf(line, sizeof(line),
+            "01/01/2024 12:00:%02u,1,1,%u,Left Poke,1,1,%u,%u,0,4012,1\n",
+            row % 60, row, row / 2, row / 4);
+        for (int i = 0; i < n && pos < buf.size(); i++) buf[pos++] = line[i];
+        row++;
+    }
+}
+
+static void printHistogram(const char* title, const uint32_t hist[SD_BUCKETS]) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < SD_BUCKETS; i++) total += hist[i];
+
+    printf("%s\n", title);
+    for (uint8_t i = 0; i < SD_BUCKETS; i++) {
+        if (i == SD_BUCKETS - 1) printf("  >=%8u us", sdBucketLimit(i - 1));
+        else printf("  < %8u us", sdBucketLimit(i));
+        printf(" %8u %6.2f%%\n", hist[i], total ? 100.0 * hist[i] / total : 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "n:b:p:f")) != -1) {
+        switch (c) {
+        case 'n': opt.flushes = atoi(optarg); break;
+        case 'b': opt.bytes = atoi(optarg); break;
+        case 'p': opt.preallocMb = atoi(optarg); break;
+        case 'f': opt.force = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-n flushes] [-b bytes] [-p prealloc_mb] [-f] PATH\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc || opt.bytes == 0) {
+        fprintf(stderr, "usage: %s [-n flushes] [-b bytes] [-p prealloc_mb] [-f] PATH\n", argv[0]);
+        return 2;
+    }
+    opt.path = argv[optind];
+
+    struct stat st;
+    bool exists = stat(opt.path, &st) == 0;
+    if (exists && !opt.force) {
+        fprintf(stderr, "%s exists, use -f to overwrite it\n", opt.path);
+        return 2;
+    }
+    bool regular = !exists || S_ISREG(st.st_mode);
+
+    int fd = open(opt.path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(opt.path);
+        return 1;
+    }
+
+    uint64_t prealloc = (uint64_t)opt.preallocMb * 1024 * 1024;
+    if (regular && prealloc > 0 && posix_fallocate(fd, 0, prealloc) != 0) {
+        fprintf(stderr, "%s: could not preallocate %u MB\n", opt.path, opt.preallocMb);
+    }
+
+    SdStats stats = {};
+    std::vector<char> buf(opt.bytes);
+    uint32_t row = 0;
+    uint64_t offset = 0;
+    auto benchStart = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < opt.flushes; i++) {
+        fillRows(buf, row);
+        uint32_t nowMs = elapsedUs(benchStart) / 1000;
+
+        auto start = std::chrono::steady_clock::now();
+        if (pwrite(fd, buf.data(), buf.size(), offset) != (ssize_t)buf.size()) {
+            perror("write");
+            close(fd);
+            return 1;
+        }
+        sdRecord(stats, SdOp::WRITE, elapsedUs(start), nowMs);
+        offset += buf.size();
+
+        start = std::chrono::steady_clock::now();
+        if (fdatasync(fd) != 0) {
+            perror("sync");
+            close(fd);
+            return 1;
+        }
+        sdRecord(stats, SdOp::SYNC, elapsedUs(start), nowMs);
+    }
+    double seconds = elapsedUs(benchStart) / 1e6;
+    close(fd);
+
+    printf("%s: %u flushes of %u bytes in %.2f s (%.1f kB/s)\n",
+           opt.path, opt.flushes, opt.bytes, seconds, offset / 1024.0 / seconds);
+    printf("ops %u, stalls %u (>= %u us)\n", stats.ops, stats.stalls, SD_STALL_US);
+    printf("worst %u us (%s) at %.1f s\n",
+           stats.worstUs, SdOp::NAMES[stats.worstOp], stats.worstT / 1000.0);
+    printf("p50 < %u us, p95 < %u us, p99 < %u us\n",
+           sdPercentile(stats.total, 50), sdPercentile(stats.total, 95), sdPercentile(stats.total, 99));
+    printHistogram("histogram:", stats.total);
+    printf("verdict: %s\n", stats.degraded ? "DEGRADED" : "ok");
+    return stats.degraded ? 1 : 0;
+}
@@ -0,0 +1,354 @@
+// Interrupt-race stress harness for the FED4 library.
+//
+// Runs the real FED4 code against the native shim while poke and well
+// threads toggle the input pins at random times, so simulated interrupts
+// land at arbitrary points inside run(). For each poke rate it reports how
+// many valid pokes were generated, counted by the ISR and written to the
+// log, how many log rows carry out-of-order or skipping counters, and how
+// often run() returned with interrupts still masked.
+//
+// With -R the log of each run is then cut off after that many bytes of
+// rows past its last sealed block, as a reset in the middle of a flush
+// leaves it, and the feeder boots again from the watchdog. Its first row
+// must carry on from the last sealed one: the next Seq and the same
+// counts, or the run counts a resume error.
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=gnu++17 -O2 -pthread -Itools/native -Ilib/FED4
+//       tools/stress/stress.cpp tools/native/native.cpp
+//       lib/FED4/*.cpp -o stress
+//
+// Usage:
+//   stress [-r 0.5,1,2,5,10] [-t seconds] [-x speed] [-l sd_latency_us] [-s seed]
+//          [-R torn_bytes]
+//
+// Rates are pokes per second per sensor. The curve is written to stdout as
+// CSV, one row per rate.
+
+#include <FED4.h>
+
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    std::vector<double> rates = {0.5, 1, 2, 5, 10};
+    double seconds = 120;
+    double speed = 20;
+    uint32_t sdLatencyUs = 20000;
+    uint32_t seed = 1;
+    uint32_t tornBytes = 0;
+};
+
+struct PointResult {
+    double rate = 0;
+    uint64_t generated = 0;
+    uint64_t counted = 0;
+    uint64_t logged = 0;
+    uint64_t reordered = 0;
+    uint64_t skipped = 0;
+    uint64_t maskLeaks = 0;
+    uint64_t runs = 0;
+    uint64_t droppedIrqs = 0;
+    uint64_t lostAlarms = 0;
+    uint64_t resumeErrors = 0;
+};
+
+static void sleepSim(sim::Board& b, uint64_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)(us / b.speed)));
+}
+
+// Press/release cycles with exponential gaps. Presses are kept more than the
+// firmware's 50 ms debounce apart so every generated poke is a valid one.
+static void pokeThread(sim::Board* b, uint8_t pin, double rate, uint32_t seed,
+                       std::atomic<bool>* stop, std::atomic<uint64_t>* generated) {
+    sim::setBoard(b, false);
+    std::mt19937 rng(seed);
+    std::exponential_distribution<double> gap(rate);
+    std::uniform_int_distribution<int> dwell(15, 40);
+
+    while (!*stop) {
+        uint64_t gapUs = (uint64_t)(gap(rng) * 1e6);
+        if (gapUs < 30000) gapUs = 30000;
+        sleepSim(*b, gapUs);
+        if (*stop) break;
+
+        sim::setPin(pin, LOW);
+        sleepSim(*b, dwell(rng) * 1000);
+        sim::setPin(pin, HIGH);
+        (*generated)++;
+    }
+}
+
+// The animal takes the pellet out of the well a little after it lands.
+static void wellThread(sim::Board* b, uint32_t seed, std::atomic<bool>* stop) {
+    sim::setBoard(b, false);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> retrieve(300, 3000);
+
+    while (!*stop) {
+        sleepSim(*b, 10000);
+        if (sim::pinLevel(FED4Pins::WELL) == LOW) {
+            sleepSim(*b, retrieve(rng) * 1000);
+            sim::setPin(FED4Pins::WELL, HIGH);
+        }
+    }
+}
+
+static std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> out;
+    std::stringstream ss(line);
+    std::string cell;
+    while (std::getline(ss, cell, ',')) out.push_back(cell);
+    return out;
+}
+
+static std::string logName(const std::string& dir) {
+    std::string cmd = "ls " + dir + " | grep '^FED.*\\.csv$' | head -1";
+    FILE* p = popen(cmd.c_str(), "r");
+    char name[256] = "";
+    if (p == nullptr) return "";
+    if (fgets(name, sizeof(name), p) == nullptr) name[0] = '\0';
+    pclose(p);
+    name[strcspn(name, "\n")] = '\0';
+    return name[0] == '\0' ? "" : dir + "/" + name;
+}
+
+static void scanLog(const std::string& dir, PointResult& r) {
+    std::string name = logName(dir);
+    if (name.empty()) return;
+
+    std::ifstream in(name);
+    std::string line;
+    int evIdx = -1, leftIdx = -1, rightIdx = -1;
+    long lastLeft = -1, lastRight = -1;
+
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> cols = splitCsv(line);
+        if (evIdx < 0) {
+            for (size_t i = 0; i < cols.size(); i++) {
+                if (cols[i] == "Event") evIdx = i;
+                if (cols[i] == "Left Poke Count") leftIdx = i;
+                if (cols[i] == "Right Poke Count") rightIdx = i;
+            }
+            continue;
+        }
+        if ((int)cols.size() <= std::max(leftIdx, rightIdx)) continue;
+
+        long left = atol(cols[leftIdx].c_str());
+        long right = atol(cols[rightIdx].c_str());
+        bool leftRow = cols[evIdx] == "Left Poke";
+        bool rightRow = cols[evIdx] == "Right Poke";
+        if (leftRow || rightRow) r.logged++;
+
+        if ((lastLeft >= 0 && left < lastLeft) || (lastRight >= 0 && right < lastRight)) {
+            r.reordered++;
+        }
+        if ((leftRow && lastLeft >= 0 && left > lastLeft + 1)
+            || (rightRow && lastRight >= 0 && right > lastRight + 1)) {
+            r.skipped++;
+        }
+        lastLeft = std::max(lastLeft, left);
+        lastRight = std::max(lastRight, right);
+    }
+}
+
+// The log up to its first erased byte
+static std::string readLog(const std::string& name) {
+    std::ifstream in(name, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return data.substr(0, data.find('\0'));
+}
+
+// Seq and poke counts of a row, by the header's columns
+static bool rowCounters(const std::vector<std::string>& header, const std::string& line, long out[3]) {
+    const char* names[3] = {"Seq", "Left Poke Count", "Right Poke Count"};
+    std::vector<std::string> cols = splitCsv(line);
+    for (int k = 0; k < 3; k++) {
+        size_t i = 0;
+        while (i < header.size() && header[i] != names[k]) i++;
+        if (i >= header.size() || i >= cols.size()) return false;
+        out[k] = atol(cols[i].c_str());
+    }
+    return true;
+}
+
+static bool resumeTorn(const Options& opt, const std::string& dir) {
+    std::string name = logName(dir);
+    if (name.empty()) return false;
+    std::string log = readLog(name);
+
+    std::vector<std::string> header;
+    std::string rows, pending, sealed;
+    std::stringstream ss(log);
+    std::string line;
+    while (std::getline(ss, line)) {
+        if (line.rfind("#B,", 0) == 0) sealed = pending;
+        if (line.empty() || line[0] == '#') continue;
+        if (header.empty()) header = splitCsv(line);
+        else {
+            pending = line;
+            rows += line + "\n";
+        }
+    }
+    long last[3];
+    if (rows.empty() || !rowCounters(header, sealed, last)) return false;
+
+    // Rows that never got their trailer, ending in the middle of one
+    std::string torn;
+    while (torn.size() < opt.tornBytes) torn += rows;
+    torn.resize(opt.tornBytes);
+    if (torn.back() == '\n') torn.back() = ',';
+    {
+        std::fstream out(name, std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(log.size());
+        out.write(torn.data(), torn.size());
+    }
+
+    sim::Board b;
+    b.sdRoot = dir;
+    b.speed = opt.speed;
+    b.sdLatencyUs = opt.sdLatencyUs;
+    b.resetCause = PM_RCAUSE_WDT;
+    sim::setBoard(&b);
+    FED4* fed = new FED4();
+    fed->begin();
+    delete fed;
+    sim::setBoard(nullptr);
+
+    std::string resumed = readLog(name);
+    if (resumed.size() <= log.size() + torn.size()) return false;
+    std::stringstream after(resumed.substr(log.size() + torn.size()));
+    std::getline(after, line);  // the end of the torn row
+    while (std::getline(after, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        long first[3];
+        return rowCounters(header, line, first)
+            && first[0] == last[0] + 1 && first[1] == last[1] && first[2] == last[2];
+    }
+    return false;
+}
+
+static PointResult runPoint(const Options& opt, double rate, uint32_t seed) {
+    PointResult r;
+    r.rate = rate;
+
+    char dirTemplate[] = "/tmp/fed4-stress-XXXXXX";
+    std::string dir = mkdtemp(dirTemplate);
+    {
+        // Reward window off: the device sleeps between events and the RTC
+        // alarm flushes the log every LP_AWAKE_PERIOD.
+        std::ofstream cfg(dir + "/CONFIG.json");
+        cfg << "{\"device number\":1,\"animal\":1,\"mode\":{\"name\":\"FR\",\"ratio\":1},"
+               "\"active sensor\":\"both\",\"reward\":{\"left\":1,\"right\":1,\"window\":false}}";
+    }
+
+    sim::Board b;
+    b.sdRoot = dir;
+    b.speed = opt.speed;
+    b.sdLatencyUs = opt.sdLatencyUs;
+    b.resetCause = PM_RCAUSE_WDT; // the watchdog resume path skips the interactive menus
+    uint32_t stepsSinceDrop = 0;
+    b.onStep = [&](int steps) {
+        stepsSinceDrop += abs(steps);
+        if (stepsSinceDrop >= 60 && sim::pinLevel(FED4Pins::WELL) == HIGH) {
+            stepsSinceDrop = 0;
+            sim::setPin(FED4Pins::WELL, LOW);
+        }
+    };
+    sim::setBoard(&b);
+
+    FED4* fed = new FED4();
+    fed->begin();
+
+    std::atomic<bool> stopInputs{false};
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> generated{0};
+
+    std::thread left(pokeThread, &b, FED4Pins::LFT_POKE, rate, seed * 3 + 1, &stopInputs, &generated);
+    std::thread right(pokeThread, &b, FED4Pins::RGT_POKE, rate, seed * 3 + 2, &stopInputs, &generated);
+    std::thread well(wellThread, &b, seed * 3 + 3, &stopInputs);
+
+    std::thread control([&]() {
+        sim::setBoard(&b, false);
+        sleepSim(b, (uint64_t)(opt.seconds * 1e6));
+        stopInputs = true;
+        // Let the pipeline drain and the RTC alarm flush the log. An alarm
+        // that fires while awake is not re-armed, so the next one can be up
+        // to a minute away.
+        sleepSim(b, (2 * LP_AWAKE_PERIOD + 65) * 1000000ULL);
+        done = true;
+        b.stop = true;
+        sim::setPin(FED4Pins::LFT_POKE, LOW); // wake the device out of sleep()
+    });
+
+    while (!done) {
+        fed->run();
+        r.runs++;
+        if (!done && sim::irqMasked()) r.maskLeaks++;
+    }
+
+    control.join();
+    left.join();
+    right.join();
+    well.join();
+
+    r.generated = generated;
+    for (uint8_t i = 0; i < fed->sensorCount; i++) r.counted += fed->sensors[i].count;
+    r.droppedIrqs = b.stats.dropped;
+    r.lostAlarms = b.stats.alarmsLost;
+    scanLog(dir, r);
+
+    delete fed;
+    sim::setBoard(nullptr);
+    if (opt.tornBytes > 0 && !resumeTorn(opt, dir)) r.resumeErrors++;
+    std::string rm = "rm -rf " + dir;
+    if (getenv("KEEP") == nullptr && system(rm.c_str()) != 0) fprintf(stderr, "could not remove %s\n", dir.c_str());
+    return r;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "r:t:x:l:s:R:")) != -1) {
+        switch (c) {
+        case 'r': {
+            opt.rates.clear();
+            std::stringstream ss(optarg);
+            std::string v;
+            while (std::getline(ss, v, ',')) opt.rates.push_back(atof(v.c_str()));
+            break;
+        }
+        case 't': opt.seconds = atof(optarg); break;
+        case 'x': opt.speed = atof(optarg); break;
+        case 'l': opt.sdLatencyUs = atoi(optarg); break;
+        case 's': opt.seed = atoi(optarg); break;
+        case 'R': opt.tornBytes = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-r rates] [-t seconds] [-x speed] [-l sd_latency_us] [-s seed] [-R torn_bytes]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("rate_hz,generated,counted,logged,lost,lost_pct,unlogged,reordered_rows,skipped_rows,"
+           "mask_leaks,runs,dropped_irqs,lost_alarms,throughput_hz,resume_errors\n");
+    int failures = 0;
+    for (size_t i = 0; i < opt.rates.size(); i++) {
+        PointResult r = runPoint(opt, opt.rates[i], opt.seed + i);
+        long lost = (long)r.generated - (long)r.counted;
+        double lostPct = r.generated ? 100.0 * lost / r.generated : 0;
+        printf("%.2f,%lu,%lu,%lu,%ld,%.2f,%ld,%lu,%lu,%lu,%lu,%lu,%lu,%.2f,%lu\n",
+               r.rate, r.generated, r.counted, r.logged, lost, lostPct,
+               (long)r.counted - (long)r.logged, r.reordered, r.skipped,
+               r.maskLeaks, r.runs, r.droppedIrqs, r.lostAlarms, r.counted / opt.seconds,
+               r.resumeErrors);
+        fflush(stdout);
+        if (r.maskLeaks || r.reordered || r.skipped || r.resumeErrors) failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+// Receiver for the serial telemetry stream (see lib/FED4/Telemetry.h).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -Ilib/FED4 tools/telemd/telemd.cpp lib/FED4/Telemetry.cpp lib/FED4/LogBlock.cpp -o telemd
+//
+// Usage:
+//   telemd [-o dir] [-b baud] [-e] TTY [...]
+//
+// Reads any number of serial ports (or ptys, FIFOs) at once and sorts the
+// frames by the device number inside them. For device N it writes
+//
+//   dir/FEDNN/events_<session>.csv   the log rows, under the log's header
+//   dir/FEDNN/counters.csv           one row per counters frame
+//
+// A new events file starts with each boot of the feeder. Rows that arrive
+// before the feeder's first hello frame are held until it gives the header.
+// A port that goes away is reopened every second, unless -e is given, in
+// which case telemd exits once every port is closed. Per-device totals,
+// including frames lost on the way, are printed on exit.
+
+#include <Telemetry.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <string>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+    std::string dir = ".";
+    speed_t baud = B115200;
+    bool exitOnClose = false;
+};
+
+struct Port {
+    std::string path;
+    int fd = -1;
+    time_t retryAt = 0;
+    std::vector<uint8_t> buf;
+    bool overflow = false;      // skipping to the next delimiter
+    uint64_t badFrames = 0;
+};
+
+struct Device {
+    uint8_t number = 0;
+    std::string dir;
+    uint32_t session = 0;
+    std::string header;
+    FILE* events = nullptr;
+    FILE* counters = nullptr;
+    std::vector<std::string> pending;   // rows seen before the header
+    bool haveSeq = false;
+    uint16_t nextSeq = 0;
+    uint64_t frames = 0;
+    uint64_t rows = 0;
+    uint64_t lost = 0;
+    uint64_t late = 0;
+    uint32_t dropped = 0;               // as reported by the feeder
+};
+
+static volatile sig_atomic_t stopFlag = 0;
+
+static void onSignal(int) {
+    stopFlag = 1;
+}
+
+static speed_t baudFlag(long baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    default: return 0;
+    }
+}
+
+static bool openPort(Port& port, const Options& opt) {
+    port.fd = open(port.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port.fd < 0) port.fd = open(port.path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (port.fd < 0) return false;
+
+    // Anything that is not a tty (a FIFO, a capture file) is read as is
+    struct termios tio;
+    if (tcgetattr(port.fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, opt.baud);
+        cfsetospeed(&tio, opt.baud);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(port.fd, TCSANOW, &tio);
+    }
+    port.buf.clear();
+    port.overflow = false;
+    fprintf(stderr, "%s: open\n", port.path.c_str());
+    return true;
+}
+
+static void closePort(Port& port) {
+    if (port.fd >= 0) {
+        close(port.fd);
+        fprintf(stderr, "%s: closed\n", port.path.c_str());
+    }
+    port.fd = -1;
+    port.retryAt = time(nullptr) + 1;
+}
+
+static FILE* openAppend(const std::string& path, const char* header) {
+    struct stat st;
+    bool fresh = stat(path.c_str(), &st) != 0 || st.st_size == 0;
+    FILE* f = fopen(path.c_str(), "a");
+    if (f == nullptr) {
+        perror(path.c_str());
+        return nullptr;
+    }
+    if (fresh && header != nullptr) fprintf(f, "%s\n", header);
+    return f;
+}
+
+static Device& device(std::map<uint8_t, Device>& devices, const Options& opt, uint8_t number) {
+    Device& dev = devices[number];
+    if (dev.dir.empty()) {
+        char name[16];
+        snprintf(name, sizeof(name), "FED%02u", number);
+        dev.number = number;
+        dev.dir = opt.dir + "/" + name;
+        mkdir(dev.dir.c_str(), 0755);
+    }
+    return dev;
+}
+
+static void onHello(Device& dev, const TelemFrame& frame) {
+    if (frame.len < sizeof(TelemHello)) return;
+    TelemHello hello;
+    memcpy(&hello, frame.payload, sizeof(hello));
+    std::string header((const char*)frame.payload + sizeof(hello), frame.len - sizeof(hello));
+
+    if (dev.events != nullptr && hello.session == dev.session && header == dev.header) return;
+    if (dev.events != nullptr) fclose(dev.events);
+
+    dev.session = hello.session;
+    dev.header = header;
+    char name[48];
+    snprintf(name, sizeof(name), "/events_%lu.csv", (unsigned long)hello.session);
+    dev.events = openAppend(dev.dir + name, header.c_str());
+    if (dev.events == nullptr) return;
+    for (const std::string& row : dev.pending) fprintf(dev.events, "%s\n", row.c_str());
+    dev.pending.clear();
+}
+
+static void onEvent(Device& dev, const TelemFrame& frame) {
+    std::string row((const char*)frame.payload, frame.len);
+    dev.rows++;
+    if (dev.events == nullptr) {
+        if (dev.pending.size() < 4096) dev.pending.push_back(row);
+        return;
+    }
+    fprintf(dev.events, "%s\n", row.c_str());
+}
+
+static void onCounters(Device& dev, const TelemFrame& frame) {
+    if (frame.len != sizeof(TelemCounters)) return;
+    TelemCounters c;
+    memcpy(&c, frame.payload, sizeof(c));
+    dev.dropped = c.dropped;
+
+    if (dev.counters == nullptr) {
+        std::string header = "Host Time,Device Millis,Device Time,Seq,Pellets,Battery mV,Jammed,Dropped Frames";
+        for (uint8_t i = 0; i < TELEM_MAX_SENSORS; i++) header += ",Count " + std::to_string(i + 1);
+        dev.counters = openAppend(dev.dir + "/counters.csv", header.c_str());
+        if (dev.counters == nullptr) return;
+    }
+    fprintf(dev.counters, "%ld,%lu,%lu,%lu,%u,%u,%u,%lu",
+            (long)time(nullptr), (unsigned long)c.millis, (unsigned long)c.unixTime,
+            (unsigned long)c.eventSeq, c.pellets, c.batteryMv, c.jammed, (unsigned long)c.dropped);
+    for (uint8_t i = 0; i < TELEM_MAX_SENSORS; i++) {
+        if (i < c.sensorCount) fprintf(dev.counters, ",%u", c.counts[i]);
+        else fprintf(dev.counters, ",");
+    }
+    fprintf(dev.counters, "\n");
+}
+
+static void onFrame(std::map<uint8_t, Device>& devices, const Options& opt, const TelemFrame& frame) {
+    Device& dev = device(devices, opt, frame.device);
+    dev.frames++;
+
+    // A feeder that rebooted numbers its frames from 0 again
+    if (frame.seq == 0) dev.haveSeq = false;
+    if (dev.haveSeq) {
+        uint16_t ahead = frame.seq - dev.nextSeq;
+        if (ahead < 0x8000) dev.lost += ahead;
+        else dev.late++;
+    }
+    if (!dev.haveSeq || (uint16_t)(frame.seq - dev.nextSeq) < 0x8000) dev.nextSeq = frame.seq + 1;
+    dev.haveSeq = true;
+
+    switch (frame.type) {
+    case TelemType::HELLO: onHello(dev, frame); break;
+    case TelemType::EVENT: onEvent(dev, frame); break;
+    case TelemType::COUNTERS: onCounters(dev, frame); break;
+    default: break;
+    }
+}
+
+// Splits what was read into frames at the 0x00 delimiters
+static void readPort(Port& port, std::map<uint8_t, Device>& devices, const Options& opt) {
+    uint8_t chunk[4096];
+    for (;;) {
+        ssize_t n = read(port.fd, chunk, sizeof(chunk));
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        if (n <= 0) {
+            closePort(port);
+            return;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (chunk[i] != 0) {
+                if (port.buf.size() < TELEM_MAX_ENCODED) port.buf.push_back(chunk[i]);
+                else port.overflow = true;
+                continue;
+            }
+            TelemFrame frame;
+            if (!port.overflow && !port.buf.empty() && telemDecode(port.buf.data(), port.buf.size(), frame)) {
+                onFrame(devices, opt, frame);
+            }
+            else if (!port.buf.empty() || port.overflow) {
+                port.badFrames++;
+            }
+            port.buf.clear();
+            port.overflow = false;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "o:b:e")) != -1) {
+        switch (c) {
+        case 'o': opt.dir = optarg; break;
+        case 'b': opt.baud = baudFlag(atol(optarg)); break;
+        case 'e': opt.exitOnClose = true; break;
+        default:
+            opt.baud = 0;
+            break;
+        }
+    }
+    if (optind >= argc || opt.baud == 0) {
+        fprintf(stderr, "usage: %s [-o dir] [-b baud] [-e] TTY [...]\n", argv[0]);
+        return 2;
+    }
+    mkdir(opt.dir.c_str(), 0755);
+
+    std::vector<Port> ports;
+    for (int i = optind; i < argc; i++) {
+        Port port;
+        port.path = argv[i];
+        ports.push_back(port);
+    }
+    for (Port& port : ports) {
+        if (!openPort(port, opt)) {
+            perror(port.path.c_str());
+            if (opt.exitOnClose) return 1;
+            port.retryAt = time(nullptr) + 1;
+        }
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    std::map<uint8_t, Device> devices;
+
+    while (!stopFlag) {
+        std::vector<pollfd> fds;
+        std::vector<Port*> polled;
+        bool anyOpen = false;
+        for (Port& port : ports) {
+            if (port.fd < 0 && !opt.exitOnClose && time(nullptr) >= port.retryAt && !openPort(port, opt)) {
+                port.retryAt = time(nullptr) + 1;
+            }
+            if (port.fd < 0) continue;
+            anyOpen = true;
+            fds.push_back({port.fd, POLLIN, 0});
+            polled.push_back(&port);
+        }
+        if (!anyOpen && opt.exitOnClose) break;
+
+        if (poll(fds.data(), fds.size(), 200) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) readPort(*polled[i], devices, opt);
+        }
+        for (auto& entry : devices) {
+            if (entry.second.events) fflush(entry.second.events);
+            if (entry.second.counters) fflush(entry.second.counters);
+        }
+    }
+
+    for (Port& port : ports) {
+        if (port.badFrames) fprintf(stderr, "%s: %lu bad frames\n", port.path.c_str(), (unsigned long)port.badFrames);
+        if (port.fd >= 0) close(port.fd);
+    }
+    for (auto& entry : devices) {
+        Device& dev = entry.second;
+        fprintf(stderr, "FED%02u: %lu frames, %lu rows, %lu lost, %lu late, %lu dropped by the feeder\n",
+                dev.number, (unsigned long)dev.frames, (unsigned long)dev.rows,
+                (unsigned long)dev.lost, (unsigned long)dev.late, (unsigned long)dev.dropped);
+        if (dev.events) fclose(dev.events);
+        if (dev.counters) fclose(dev.counters);
+    }
+    return 0;
+}
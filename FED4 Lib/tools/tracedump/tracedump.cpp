@@ -0,0 +1,109 @@
+// Decoder for the TRACE_NN.BIN files the FED4 writes after a watchdog or
+// hard-fault reset (see lib/FED4/Trace.h).
+//
+// Build (from "FED4 Lib"):
+//   g++ -std=c++17 -O2 -Ilib/FED4 tools/tracedump/tracedump.cpp -o tracedump
+//
+// Usage:
+//   tracedump TRACE_01.BIN [...]
+//
+// Prints the reset cause, the faulting PC/LR if any, then one line per
+// entry, oldest first, with the time since the previous entry. Boots are
+// marked so the moments before the reset are easy to find at the end.
+
+#include <Trace.h>
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+static const char* const EVENT_NAMES[TraceEv::COUNT] = {
+    "?", "BOOT", "RUN", "SLEEP", "WAKE", "ISR_SENSOR", "ISR_WELL",
+    "ISR_ALARM", "SD_FLUSH", "SD_FLUSH_END", "SD_OPEN", "MOTOR", "FEED",
+    "FEED_END", "WDT_WARN", "HARDFAULT",
+};
+
+static void printResetCause(uint32_t cause) {
+    static const char* const bits[] = {"POR", "BOD12", "BOD33", "?", "EXT", "WDT", "SYST"};
+    bool first = true;
+    for (int i = 0; i < 7; i++) {
+        if (cause & (1u << i)) {
+            printf("%s%s", first ? "" : "|", bits[i]);
+            first = false;
+        }
+    }
+    if (first) printf("none");
+}
+
+static int dump(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) {
+        perror(path);
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(f);
+        return 1;
+    }
+    if (header.version != TRACE_FILE_VER || header.entrySize != sizeof(TraceEntry)) {
+        fprintf(stderr, "%s: unsupported version %u (entry size %u)\n",
+                path, header.version, header.entrySize);
+        fclose(f);
+        return 1;
+    }
+
+    std::vector<TraceEntry> entries(header.count);
+    size_t n = fread(entries.data(), sizeof(TraceEntry), header.count, f);
+    fclose(f);
+    if (n != header.count) {
+        fprintf(stderr, "%s: truncated, %zu of %u entries\n", path, n, header.count);
+        entries.resize(n);
+    }
+
+    printf("%s\n", path);
+    printf("  reset cause  ");
+    printResetCause(header.resetCause);
+    printf("\n  boot count   %u\n", header.bootCount);
+    if (header.bootUnix != 0) {
+        time_t t = header.bootUnix;
+        char buf[32];
+        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+        printf("  traced boot  %s\n", buf);
+    }
+    if (header.faultPc != 0) {
+        printf("  hard fault   pc=0x%08x lr=0x%08x\n", header.faultPc, header.faultLr);
+    }
+    printf("  entries      %zu\n\n", entries.size());
+
+    printf("%12s %10s  %-12s %4s %6s\n", "millis", "delta", "event", "arg", "data");
+    uint32_t last = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const TraceEntry& e = entries[i];
+        const char* name = e.type < TraceEv::COUNT ? EVENT_NAMES[e.type] : "?";
+        if (e.type == TraceEv::BOOT) {
+            printf("---- boot %u ----\n", e.data);
+            last = e.t;
+        }
+        printf("%12u %+10d  %-12s %4u %6u\n", e.t, (int32_t)(e.t - last), name, e.arg, e.data);
+        last = e.t;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s TRACE_NN.BIN [...]\n", argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) printf("\n");
+        failures += dump(argv[i]);
+    }
+    return failures ? 1 : 0;
+}